@@ -0,0 +1,58 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#ifndef CXML_CXARENA_H
+#define CXML_CXARENA_H
+
+#include "cxmem.h"
+#include <stddef.h>
+
+/*
+ * Bump (arena) allocator.
+ *
+ * Memory is handed out from large blocks by bumping an offset, and is never freed
+ * piecemeal: cxml_arena_reset() releases everything allocated at once.
+ * Objects owning heap memory of their own (a cxml_string, or a cxml_list, for example)
+ * can register a cleanup, which is run when the arena is reset.
+ * A reset arena keeps its largest block, so an arena that is repeatedly filled and
+ * reset with about the same amount of data stops calling malloc altogether.
+ * A zeroed cxml_arena is a valid (empty) arena.
+ */
+
+// size of the first block of an arena
+#define _CXML_ARENA_BLOCK_SIZE      (4096)
+// alignment of every allocation
+#define _CXML_ARENA_ALIGN           (_Alignof(max_align_t))
+
+struct _cxml_arena_block{
+    struct _cxml_arena_block *prev;
+    size_t size;                    // bytes available in the block
+};
+
+struct _cxml_arena_cleanup{
+    void (*fn)(void *item);
+    void *item;
+    struct _cxml_arena_cleanup *next;
+};
+
+typedef struct _cxml_arena{
+    struct _cxml_arena_block *block;        // current block (linked to the previous blocks)
+    size_t used;                            // bytes allocated from the current block
+    struct _cxml_arena_cleanup *cleanups;   // most recently registered first
+}cxml_arena;
+
+void cxml_arena_init(cxml_arena *arena);
+
+void *cxml_arena_alloc(cxml_arena *arena, size_t size);
+
+void *cxml_arena_calloc(cxml_arena *arena, size_t size);
+
+void cxml_arena_on_reset(cxml_arena *arena, void (*fn)(void *item), void *item);
+
+void cxml_arena_reset(cxml_arena *arena);
+
+void cxml_arena_free(cxml_arena *arena);
+
+#endif //CXML_CXARENA_H
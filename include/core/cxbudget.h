@@ -0,0 +1,99 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#ifndef CXML_CXBUDGET_H
+#define CXML_CXBUDGET_H
+
+#include <stdbool.h>
+#include <time.h>
+
+#if !defined(__STDC_NO_ATOMICS__)
+    #include <stdatomic.h>
+    typedef atomic_bool cxml_cancel_flag;
+#else
+    typedef volatile bool cxml_cancel_flag;
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    #define _CXML_THREAD_LOCAL  __declspec(thread)
+#else
+    #define _CXML_THREAD_LOCAL  _Thread_local
+#endif
+
+/*
+ * Evaluation budgets.
+ *
+ * A budget bounds the work done by each XPath evaluation (cxml_xpath(), prepared queries,
+ * cursors), and each query call (cxml_find(), cxml_find_all()), made while it is installed
+ * (see cxml_budget_set()). An evaluation is aborted once it has visited more nodes than allowed,
+ * selected more nodes (in a single step) than allowed, run past its deadline, or once its
+ * cancellation flag has been set (possibly by another thread).
+ * A visit is charged for each node walked (the children scanned by a step, the descendants
+ * walked), not again when the node is selected.
+ * The limits are checked at step and predicate boundaries, and while walking descendants;
+ * the clock and the cancellation flag are only read every _CXML_BUDGET_CHECK_INTERVAL visits.
+ * An aborted XPath evaluation returns NULL, an aborted query call returns the nodes found
+ * so far; in both cases, the status of the budget tells why the call was aborted.
+ * A budget is installed for the calling thread only: calls made by other threads are
+ * bounded by the budget they installed, if any. The same budget must not be installed
+ * by several threads at once (it holds the state of the call being evaluated).
+ */
+
+// visits between two reads of the clock and the cancellation flag
+#define _CXML_BUDGET_CHECK_INTERVAL     (256)
+
+typedef enum{
+    CXML_BUDGET_OK,
+    CXML_BUDGET_VISITS_EXCEEDED,
+    CXML_BUDGET_RESULTS_EXCEEDED,
+    CXML_BUDGET_DEADLINE_EXCEEDED,
+    CXML_BUDGET_CANCELLED
+}cxml_budget_status;
+
+typedef struct _cxml_budget{
+    long max_visits;                // nodes a call may visit (0 for no limit)
+    long max_results;               // nodes a call may select at once (0 for no limit)
+    double timeout;                 // seconds a call may run (0 for no limit)
+    cxml_cancel_flag *cancel;       // the call is aborted once the flag is set (NULL if none)
+    // state of the last call
+    cxml_budget_status status;
+    long visits;
+    long ticks;                     // visits until the next check of the clock and flag
+    struct timespec deadline;
+}cxml_budget;
+
+extern _CXML_THREAD_LOCAL cxml_budget *_cxml_budget;
+
+void cxml_budget_init(cxml_budget *budget);
+
+void cxml_budget_set(cxml_budget *budget);
+
+void _cxml_budget_begin();
+
+bool _cxml_budget__check(cxml_budget *budget);
+
+bool _cxml_budget_results(long size);
+
+/*
+ * Account for `n` nodes visited by the call being evaluated.
+ * Returns false if the call must be aborted.
+ */
+inline static bool _cxml_budget_visit(long n){
+    cxml_budget *budget = _cxml_budget;
+    if (!budget) return true;
+    if (budget->status != CXML_BUDGET_OK) return false;
+    budget->visits += n;
+    if ((budget->ticks -= n) > 0 && (!budget->max_visits || budget->visits <= budget->max_visits)){
+        return true;
+    }
+    return _cxml_budget__check(budget);
+}
+
+// true if the call being evaluated has been aborted
+inline static bool _cxml_budget_exhausted(){
+    return _cxml_budget && _cxml_budget->status != CXML_BUDGET_OK;
+}
+
+#endif //CXML_CXBUDGET_H
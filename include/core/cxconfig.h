@@ -40,6 +40,8 @@ typedef struct _cxml_config{
     bool ensure_ns_attribute_unique;
     // allows elements have a default namespace
     bool allow_default_namespace;
+    // reject input that isn't well-formed utf-8
+    bool validate_encoding;
     // other configs goes here
 }cxml_config;
 
@@ -79,5 +81,7 @@ void cxml_cfg_allow_default_namespace(bool allow);
 
 void cxml_cfg_allow_duplicate_namespaces(bool enable);
 
+void cxml_cfg_validate_encoding(bool validate);
+
 
 #endif //CXML_CXCONFIG_H
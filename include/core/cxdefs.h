@@ -96,19 +96,31 @@ typedef enum{
 
 
 typedef struct _cx_name {
-    int pname_len;
-    int lname_len;
-    char *pname;            // prefix name
-    char *lname;            // local name
+    int pname_len;          // prefix name length (0 if the name has no prefix)
+    int lname_len;          // local name length
     cxml_string  qname;     // qualified name
 }cxml_name;
 
+/*
+ * the prefix name and local name are not stored, they're read off the qualified name:
+ * `pname:lname` or `lname`
+ */
+// prefix name (NULL if the name has no prefix)
+#define cxml_name_pname(__name)                                         \
+((__name)->pname_len ? cxml_string_as_raw(&(__name)->qname) : NULL)
+
+// local name (NULL if the name has no local name)
+#define cxml_name_lname(__name)                                         \
+((__name)->lname_len ?                                                  \
+    (cxml_string_as_raw(&(__name)->qname) +                             \
+    ((__name)->pname_len ? (__name)->pname_len + 1 : 0)) : NULL)
+
 /** core nodes **/
 // namespace node
 typedef struct _cx_ns_node{
     _cxml_node_t _type;
-    bool is_default;        // default namespace e.g. xmlns='foo://'
-    bool is_global;         // global namespaces like 'xml'
+    bool is_default: 1;     // default namespace e.g. xmlns='foo://'
+    bool is_global: 1;      // global namespaces like 'xml'
     unsigned int pos;
     cxml_string prefix;     // prefix can be empty if it's a default namespace
     cxml_string uri;        // namespace name
@@ -118,13 +130,13 @@ typedef struct _cx_ns_node{
 // element node
 typedef struct _cx_elem_node{
     _cxml_node_t _type;         // node type
-    bool has_child;
-    bool has_parent;
-    bool has_text;
-    bool has_attribute;
-    bool has_comment;
-    bool is_self_enclosing;
-    bool is_namespaced;         // determines whether a node is under a namespace or not
+    bool has_child: 1;
+    bool has_parent: 1;
+    bool has_text: 1;
+    bool has_attribute: 1;
+    bool has_comment: 1;
+    bool is_self_enclosing: 1;
+    bool is_namespaced: 1;      // determines whether a node is under a namespace or not
     unsigned int pos;
     cxml_list children;         // list of child nodes
     cxml_name name;             // node name
@@ -137,23 +149,25 @@ typedef struct _cx_elem_node{
 // root/document node
 typedef struct _cx_doc_node{
     _cxml_node_t _type;             // node type
+    bool has_child: 1;
+    bool is_well_formed: 1;         // is the xml document well formed?
     unsigned int pos;
-    bool has_child;
-    bool is_well_formed;            // is the xml document well formed?
     cxml_list children;             // child nodes
     cxml_string name;               // node name
     cxml_elem_node *root_element;
     cxml_list *namespaces;          // store global namespaces
+    struct _cxml_node_index *index; // optional pre-order node index (see cxindex.h)
 }cxml_root_node;
 
 // text node
 typedef struct _cx_text_node{
     _cxml_node_t _type;
+    bool has_entity: 1;
+    bool is_cdata: 1;
     unsigned int pos;
-    bool has_entity;
-    bool is_cdata;
     cxml_string value;
-    cxml_number number_value;
+    cxml_number number_value;       // computed on first use
+    cxml_string *decoded;           // value with its references decoded, computed on first use
     void* parent;
 }cxml_text_node;
 
@@ -163,7 +177,7 @@ typedef struct _cx_attr_node{
     unsigned int pos;
     cxml_name name;
     cxml_string value;
-    cxml_number number_value;
+    cxml_number number_value;       // computed on first use
     cxml_ns_node *namespace;
     cxml_elem_node *parent;
 }cxml_attr_node;
@@ -205,6 +219,13 @@ struct _cx_obj_node{
     _cxml_node_t _type;
 };
 
+// memory usage report
+typedef struct{
+    int nodes;                  // number of nodes (attributes and namespaces inclusive)
+    size_t node_bytes;          // bytes held by the node structs
+    size_t data_bytes;          // bytes held by strings, child lists, attribute tables, etc.
+}cxml_mem_report;
+
 /************cxml nodes public************/
 
 typedef cxml_elem_node       cxml_element_node;
@@ -341,8 +362,16 @@ void* _cxml_get_node_parent(void *node);
 
 void* _cxml_node_parent(void *node);
 
+cxml_number *_cxml_get_node_number(void *node);
+
+const char *_cxml_find_pred_entity(const char *start, const char *end);
+
 void _cxml_unset_parent(void *node);
 
 int _cxml_cmp_node(const void *n1, const void *n2);
 
+void cxml_memory_report(void *node, cxml_mem_report *report);
+
+void cxml_print_memory_report(void *node);
+
 #endif //CXML_CXDEFS_H
@@ -0,0 +1,91 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#ifndef CXML_CXFROZEN_H
+#define CXML_CXFROZEN_H
+
+#include "cxdefs.h"
+
+/*
+ * Frozen (read-only) document.
+ *
+ * A frozen document is a compact struct-of-arrays copy of a cxml document.
+ * Nodes are identified by their pre-order index (0 is the root node), and all
+ * names and string values live in a single buffer.
+ * Element names, attribute names and namespace uris are interned as symbols,
+ * so that name tests are integer comparisons.
+ * A frozen document is never modified after cxml_freeze() returns, and can
+ * therefore be read from several threads at once, by the functions below, by
+ * cxml_xp_frozen_path_eval() (see xpath/cxxpfrozen.h) and by cxml_frozen_find_all()
+ * (each thread bounded by its own budget, if any, see core/cxbudget.h). Functions that parse an expression
+ * with the shared XPath parser (like cxml_xpath_frozen()) can't be called concurrently.
+ */
+typedef struct _cxml_frozen_doc{
+    /* nodes */
+    int size;
+    unsigned char *kind;        // node type (_cxml_node_t)
+    int *name;                  // name symbol (elements, processing-instruction targets), -1 if none
+    int *ns;                    // namespace uri symbol (namespaced elements), -1 if none
+    int *parent;                // parent node, -1 for the root node
+    int *first_child;           // first child node, -1 if none
+    int *next_sibling;          // next sibling node, -1 if none
+    int *end;                   // last node in the subtree of the node
+    int *value;                 // offset of the string value in `buffer`, -1 if none
+    int *value_len;             // length of the string value
+    int *attr_start;            // index of the first attribute of the node
+    int *attr_count;            // number of attributes of the node
+    /* attributes */
+    int attr_size;
+    int *attr_name;             // attribute name symbol
+    int *attr_value;            // offset of the attribute value in `buffer`
+    int *attr_value_len;        // length of the attribute value
+    /* symbols */
+    int sym_size;
+    int *sym_off;               // offset of the symbol in `buffer`
+    int *sym_len;               // length of the symbol
+    cxml_table symbols;         // symbol -> (id + 1)
+    /* string storage (every string is nul-terminated) */
+    cxml_string buffer;
+}cxml_frozen_doc;
+
+/*
+ * Nodes of a frozen document (pre-order indexes), as selected by the XPath
+ * and query engines (see cxml_xpath_frozen() and cxml_frozen_find_all()),
+ * in document order.
+ */
+typedef struct{
+    int size;
+    int capacity;
+    int *nodes;
+}cxml_frozen_set;
+
+// symbol matching any element (see cxml_frozen_next_element()), unlike -1 (no symbol) which matches none
+#define CXML_FROZEN_ANY_SYMBOL     (-2)
+
+cxml_frozen_doc *cxml_freeze(cxml_root_node *root);
+
+void cxml_frozen_free(cxml_frozen_doc *doc);
+
+int cxml_frozen_symbol(cxml_frozen_doc *doc, const char *name);
+
+const char *cxml_frozen_symbol_name(cxml_frozen_doc *doc, int sym, int *len);
+
+const char *cxml_frozen_name(cxml_frozen_doc *doc, int node, int *len);
+
+const char *cxml_frozen_value(cxml_frozen_doc *doc, int node, int *len);
+
+const char *cxml_frozen_attribute(cxml_frozen_doc *doc, int node, const char *name, int *len);
+
+int cxml_frozen_next_element(cxml_frozen_doc *doc, int scope, int sym, int after);
+
+void cxml_frozen_text(cxml_frozen_doc *doc, int node, cxml_string *acc);
+
+void cxml_frozen_set_init(cxml_frozen_set *set);
+
+void cxml_frozen_set_add(cxml_frozen_set *set, int node);
+
+void cxml_frozen_set_free(cxml_frozen_set *set);
+
+#endif //CXML_CXFROZEN_H
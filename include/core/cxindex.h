@@ -0,0 +1,52 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#ifndef CXML_CXINDEX_H
+#define CXML_CXINDEX_H
+
+#include "cxdefs.h"
+
+/*
+ * Optional per-document pre-order node index.
+ *
+ * All nodes reachable through `children` lists (attributes and namespaces excluded)
+ * are laid out in document (pre-)order, together with the pre-order index of the
+ * last node in each node's subtree, and the pre-order index of each node's parent.
+ * The subtree of nodes[i] is then the contiguous range (i, end[i]], and `a` is an
+ * ancestor of `d` iff a < d <= end[a].
+ *
+ * Nodes are located by their `pos` fields, which the parser assigns in document order.
+ * Building the index never modifies the document: when the `pos` fields are out of
+ * order (e.g. after the document has been modified, or for nodes created outside
+ * the parser), nodes are located by address instead.
+ */
+struct _cxml_index_entry{
+    void *node;
+    int i;                      // pre-order index of `node`
+};
+
+typedef struct _cxml_node_index{
+    int size;
+    int capacity;
+    void **nodes;               // nodes in document order (nodes[0] is the root node)
+    int *end;                   // pre-order index of the last node in the subtree of nodes[i]
+    int *parent;                // pre-order index of the parent of nodes[i] (-1 for the root node)
+    unsigned int *pos;          // `pos` of nodes[i] (non-decreasing when `by_node` is NULL), used to locate nodes
+    struct _cxml_index_entry *by_node;  // nodes sorted by address, if their `pos` fields are out of order
+}cxml_node_index;
+
+cxml_node_index *cxml_index_document(cxml_root_node *root);
+
+void cxml_index_free(cxml_node_index *index);
+
+int cxml_index_find(cxml_node_index *index, void *node);
+
+bool cxml_index_is_ancestor(cxml_node_index *index, int ancestor, int node);
+
+cxml_node_index *_cxml_index_get(void *node);
+
+void _cxml_index_invalidate(void *node);
+
+#endif //CXML_CXINDEX_H
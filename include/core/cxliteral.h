@@ -20,7 +20,8 @@ typedef enum {
 // for now, we support only NaN, and double number types.
 typedef enum {
     CXML_NUMERIC_DOUBLE_T,
-    CXML_NUMERIC_NAN_T
+    CXML_NUMERIC_NAN_T,
+    CXML_NUMERIC_UNSET_T    // not yet computed (text/attribute nodes, see _cxml_get_node_number())
 }cxml_number_t;
 
 // literal values
@@ -48,6 +49,8 @@ int _cxml_is_double(const char *start, int len);
 
 cxml_number cxml_literal_to_num(cxml_string *str);
 
+cxml_number _cxml_value_to_num(cxml_string *str);
+
 bool cxml_number_is_d_equal(double a, double b);
 
 bool cxml_number_is_equal(cxml_number* num1, cxml_number* num2);
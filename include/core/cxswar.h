@@ -0,0 +1,31 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#ifndef CXML_CXSWAR_H
+#define CXML_CXSWAR_H
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Word-at-a-time (SWAR) helpers, for scanning text 8 bytes at a time.
+ * A word is loaded with _cxml_swar_load() (which has no alignment requirement),
+ * and tested against byte masks repeated over the word.
+ */
+
+// 0x01 and 0x80 in every byte of a word
+#define _CXML_SWAR_ONES                 (~(uint64_t)0 / 255)
+#define _CXML_SWAR_HIGHS                (_CXML_SWAR_ONES * 0x80)
+// non-zero if a byte of the word is zero, or is __b
+#define _cxml_swar_has_zero(__w)        (((__w) - _CXML_SWAR_ONES) & ~(__w) & _CXML_SWAR_HIGHS)
+#define _cxml_swar_has_byte(__w, __b)   _cxml_swar_has_zero((__w) ^ (_CXML_SWAR_ONES * (uint8_t)(__b)))
+
+inline static uint64_t _cxml_swar_load(const char *s){
+    uint64_t w;
+    memcpy(&w, s, 8);
+    return w;
+}
+
+#endif //CXML_CXSWAR_H
@@ -26,9 +26,23 @@ typedef struct {
     int count;
     int capacity;
     _cxml_ht_entry *entries;    // store key-value pairs in the table
+    int *order;                 // index (in `entries`) of each entry, in insertion order
     cxml_list keys;             // store all keys being added to the table
 } cxml_table;
 
+/*
+ * Iterate over the entries (`_cxml_ht_entry*`) of a table, in insertion order.
+ * The keys aren't hashed (unlike `cxml_table_get()` on each of the `keys`),
+ * and the table must not be modified while being iterated.
+ */
+#define cxml_table_for_each(_entry, __table)                                            \
+_cxml_ht_entry *_entry = NULL;                                                          \
+for(int __00i00##_entry = 0;                                                            \
+    __00i00##_entry < cxml_table_size(__table) ?                                        \
+        (_entry = cxml_table_entry(__table, __00i00##_entry), 1) : 0;                   \
+    __00i00##_entry++                                                                   \
+)
+
 void cxml_table_free(cxml_table *table);
 
 cxml_table new_cxml_table();
@@ -49,8 +63,17 @@ void *cxml_table_get(cxml_table *table, const char *key);
 
 void* cxml_table_get_raw(cxml_table *table, const void *key);
 
+uint32_t cxml_table_hash(const char *key);
+
+void* cxml_table_get_hashed(cxml_table *table, const char *key, uint32_t hash);
+
 bool cxml_table_is_empty(cxml_table *table);
 
 int cxml_table_size(cxml_table *table);
 
+// the `i`th entry of `table` (in insertion order), 0 <= i < cxml_table_size(table)
+inline static _cxml_ht_entry *cxml_table_entry(cxml_table *table, int i){
+    return &table->entries[table->order[i]];
+}
+
 #endif //CXML_CXTABLE_H
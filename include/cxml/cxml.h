@@ -7,6 +7,10 @@
 #define CXML_CXML_H
 
 #include "xml/cxprinter.h"
+#include "core/cxindex.h"
+#include "core/cxfrozen.h"
+#include "core/cxarena.h"
+#include "core/cxbudget.h"
 
 #if defined(CXML_USE_QUERY_MOD)
     #include "query/cxqapi.h"
@@ -7,6 +7,7 @@
 #define CXML_CXQAPI_H
 
 #include "xml/cxparser.h"
+#include "core/cxfrozen.h"
 #include "cxql.h"
 
 // General functions
@@ -22,6 +23,37 @@ cxml_elem_node *cxml_get_root_element(cxml_root_node *node);
 
 double cxml_get_number(void *node);
 
+/*
+ * Selection cursor.
+ *
+ * Produces the elements matching a query (as cxml_find_all() would), or the descendants
+ * of the first element matching a query (as cxml_find_descendants() would), one at a time,
+ * in document order, skipping the first `offset` nodes, and producing at most `limit` nodes
+ * (0 for no limit). The document is walked as the nodes are requested, keeping only
+ * the path from the root to the current node.
+ * A cursor can also match several queries at once (see cxml_find_many_iter_init()),
+ * producing the elements matching any of them.
+ * The document must not be modified while the cursor is in use.
+ */
+#define _CXML_FIND_ITER_STACK_SIZE  (32)
+
+typedef struct{
+    _cxml_query *query;                 // NULL when producing descendants
+    _cxml_query **queries;              // queries matched at once, if several
+    int n_queries;
+    int match;                          // first of the queries matched by the last node produced (-1 if none)
+    int offset;                         // nodes yet to be skipped
+    int limit;                          // nodes yet to be produced, if limited
+    bool limited;
+    void *node;                         // first node to be visited
+    void **range;                       // descendants read off the document's index, if indexed
+    int range_size;
+    int depth;
+    int capacity;
+    struct _cxml_list__node **frames;   // next child to be visited, at each level
+    struct _cxml_list__node *stack[_CXML_FIND_ITER_STACK_SIZE];
+}cxml_find_iter;
+
 /*
  * create, select, update, delete  (CSUD)
  * The query api allows selection of nodes anywhere in the document,
@@ -37,6 +69,10 @@ cxml_element_node* cxml_find(void *root, const char *query);
 
 void cxml_find_all(void *root, const char *query, cxml_list *acc);
 
+void cxml_find_all_many(void *root, const char **queries, int n, cxml_list *accs);
+
+void cxml_frozen_find_all(cxml_frozen_doc *doc, const char *query, cxml_frozen_set *acc);
+
 void cxml_find_children(void *root, const char *query, cxml_list *acc);
 
 void cxml_children(void *node, cxml_list *acc);
@@ -69,6 +105,20 @@ void cxml_descendants(void *node, cxml_list *acc);
 
 void cxml_find_descendants(void *root, const char *query, cxml_list *acc);
 
+void cxml_find_iter_init(cxml_find_iter *iter, void *root, const char *query, int offset, int limit);
+
+void cxml_find_descendants_iter_init(
+        cxml_find_iter *iter, void *root, const char *query, int offset, int limit);
+
+void cxml_find_many_iter_init(
+        cxml_find_iter *iter, void *root, const char **queries, int n, int offset, int limit);
+
+void *cxml_find_iter_next(cxml_find_iter *iter);
+
+int cxml_find_iter_collect(cxml_find_iter *iter, cxml_list *accs, int n);
+
+void cxml_find_iter_free(cxml_find_iter *iter);
+
 void *cxml_next_sibling(void *node);
 
 extern void* (*cxml_next)(void *node);
@@ -40,6 +40,24 @@ typedef struct{
     struct _cxml_q_attr *q_attr;
 }_cxml_q;
 
+#define     _CXQ_MATCHER_ATTR        (1)
+#define     _CXQ_MATCHER_TEXT        (2)
+#define     _CXQ_MATCHER_COMM        (3)
+
+/*
+ * A query sub-expression (_cxml_q) compiled for matching elements:
+ * the attribute key is hashed once, and partial matches search
+ * the value with a precomputed (Horspool) shift table.
+ */
+typedef struct{
+    int kind;                   // _CXQ_MATCHER_*, 0 if nothing can be matched
+    int flags;                  // _CXQ_MATCH_*
+    const char *key;            // attribute key
+    uint32_t hash;              // hash of the attribute key
+    cxml_string *value;         // attribute value, text or comment to be matched
+    unsigned char *shift;       // shift on each byte, for partial matches
+}_cxml_q_matcher;
+
 /*
  * query expression e.g. "<tag_name>/[name='ziord']/id='xy'/"
  * would be parsed into a _cxml_query object
@@ -48,6 +66,8 @@ typedef struct{
     cxml_string q_name;      // pseudonymous to tag name
     cxml_list q_o_list;      // _cxml_q (optional),
     cxml_list q_r_list;      // _cxml_q (rigid)
+    _cxml_q_matcher *q_o_matchers;  // q_o_list compiled, cheapest first
+    _cxml_q_matcher *q_r_matchers;  // q_r_list compiled, cheapest first
     const char* expr;
 }_cxml_query;
 
@@ -62,5 +82,9 @@ _cxml_query *cxq_parse_query(const char *query);
 
 void cxq_free_query(_cxml_query *query);
 
+bool cxq_matcher_lcontains(_cxml_q_matcher *matcher, const char *chars, unsigned int len);
+
+bool cxq_matcher_contains(_cxml_q_matcher *matcher, cxml_string *str);
+
 
 #endif //CXML_CXQL_H
@@ -26,4 +26,32 @@ char *u8_strchr(char *s, u_int32_t ch, int *charn);
 /* count the number of characters in a UTF-8 string */
 int u8_strlen(char *s);
 
+/* single character to UTF-8, returns the number of bytes written to dest (0 if invalid) */
+int u8_wc_toutf8(char *dest, u_int32_t ch);
+
+/* is the utf-8 sequence starting at raw well-formed? (checks a single character) */
+bool is_valid_utf8_start(const char *raw);
+
+/* are the first len bytes of s well-formed UTF-8? valid_len receives the length of the
+   longest well-formed prefix */
+bool u8_validate(const char *s, size_t len, size_t *valid_len);
+
+/* are the first len bytes of s all ASCII? */
+bool u8_is_ascii(const char *s, size_t len);
+
+/* is s (len bytes) a well-formed multi-byte sequence cut short by the end of input? */
+bool u8_is_partial(const char *s, size_t len);
+
+/* count the number of characters in the first len bytes of s */
+size_t u8_count(const char *s, size_t len);
+
+/* character number to byte offset, within the first len bytes of s */
+size_t u8_offset_n(const char *s, size_t len, size_t charnum);
+
+/* ISO-8859-1 to UTF-8, returns the number of bytes written to dest */
+size_t u8_from_latin1(char *dest, const char *src, size_t len);
+
+/* UTF-16 to UTF-8, returns the number of bytes written to dest */
+size_t u8_from_utf16(char *dest, const char *src, size_t len, bool big_endian, bool final, size_t *consumed);
+
 #endif //CXML_CXUTF8HOOK_H
@@ -28,7 +28,6 @@ typedef struct _cxml_parser{
     // node position counter
     unsigned int pos_c;
     cxml_list errors;
-    cxml_table attr_checker;
     // temporarily store attributes after they're being parsed for post-processing.
     cxml_list attr_list;
     _cxml_stack _cx_stack;
@@ -37,7 +36,7 @@ typedef struct _cxml_parser{
     // config
     cxml_config cfg;
     // namespace scope lookup - for namespace scoping and resolution
-    struct _cxml_scope_table *current_scope;
+    struct _cxml_ns_scope *current_scope;
 }_cxml_parser;
 
 
@@ -8,21 +8,81 @@
 
 #include "core/cxtable.h"
 
-struct _cxml_scope_table{
-    /* symbols/items in the scope */
-    cxml_table symbols;
-    /* outer/enclosing scope */
-    struct _cxml_scope_table *enclosing_scope;
+/*
+ * Namespace scope.
+ *
+ * Names (namespace prefixes, namespace names and attribute local names) are interned as symbols,
+ * and namespace bindings (prefix symbol -> namespace) are kept on a single flat stack.
+ * Each symbol has a slot holding the index of its current (innermost) binding, so
+ * resolving a prefix is a hash of the prefix followed by an array lookup.
+ * Each element opens a frame when entered, and the bindings declared in the frame
+ * are popped (restoring the bindings they shadowed) when the element is closed.
+ */
+
+// symbol of the (empty) prefix of the default namespace
+#define _CXML_NS_DEFAULT_SYMBOL     (0)
+
+struct _cxml_ns_symbol{
+    char *name;
+    int len;
+    uint32_t hash;
+};
+
+struct _cxml_ns_binding{
+    int symbol;             // prefix symbol
+    int uri;                // namespace name (uri) symbol
+    int shadowed;           // binding shadowed by this binding, -1 if none
+    void *ns;               // namespace node
+};
+
+// expanded name of a namespaced attribute
+struct _cxml_ns_attr{
+    int uri;                // namespace name (uri) symbol
+    int lname;              // local name symbol
 };
 
-void _cxml_scope_table_init(struct _cxml_scope_table *table);
+struct _cxml_ns_scope{
+    /* interned names */
+    int sym_size;
+    int sym_cap;
+    struct _cxml_ns_symbol *symbols;
+    int *current;           // symbol -> current binding of the symbol, -1 if unbound
+    int slot_cap;
+    int *slots;             // hash slots (symbol + 1, 0 if empty)
+    /* bindings */
+    int size;
+    int capacity;
+    struct _cxml_ns_binding *bindings;
+    /* frames (size of `bindings` when each open element was entered) */
+    int depth;
+    int frame_cap;
+    int *frames;
+    /* expanded names of the namespaced attributes of the current element */
+    int attr_size;
+    int attr_cap;
+    struct _cxml_ns_attr *attrs;
+};
+
+struct _cxml_ns_scope *_cxml_ns_scope_new();
+
+void _cxml_ns_scope_free(struct _cxml_ns_scope *scope);
+
+int _cxml_ns_scope_intern(struct _cxml_ns_scope *scope, const char *name, int len);
+
+int _cxml_ns_scope_find(struct _cxml_ns_scope *scope, const char *name, int len);
+
+void _cxml_ns_scope_enter(struct _cxml_ns_scope *scope);
+
+void _cxml_ns_scope_leave(struct _cxml_ns_scope *scope);
+
+int _cxml_ns_scope_bind(struct _cxml_ns_scope *scope, int symbol, int uri, void *ns);
 
-void _cxml_scope_table_free(struct _cxml_scope_table *scope);
+struct _cxml_ns_binding *_cxml_ns_scope_current(struct _cxml_ns_scope *scope, int symbol);
 
-struct _cxml_scope_table * _cxml_scope_table_new();
+struct _cxml_ns_binding *_cxml_ns_scope_lookup(struct _cxml_ns_scope *scope, const char *prefix, int len);
 
-void* _cxml_scope_table_lookup(struct _cxml_scope_table *table, const char *name);
+int _cxml_ns_scope_add_attr(struct _cxml_ns_scope *scope, int uri, int lname);
 
-int _cxml_scope_table_insert(struct _cxml_scope_table *table, const char *name, void *symbol);
+void _cxml_ns_scope_clear_attrs(struct _cxml_ns_scope *scope);
 
 #endif //CXML_CXSCOPE_H
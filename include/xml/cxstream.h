@@ -8,6 +8,18 @@
 
 #include "core/cxmem.h"
 
+/*
+ * Encodings of streamed input.
+ * Input in any other encoding than utf-8 is transcoded to utf-8 as it is read.
+ */
+typedef enum{
+    CXML_ENC_UNKNOWN,       // not yet detected
+    CXML_ENC_UTF8,
+    CXML_ENC_UTF16LE,
+    CXML_ENC_UTF16BE,
+    CXML_ENC_LATIN1         // ISO-8859-1
+}_cxml_encoding_t;
+
 typedef struct {
     // is the lexer in an open state?
     bool _is_open;
@@ -30,6 +42,21 @@ typedef struct {
 
     // name of current file being processed.
     const char *file_name;
+
+    // number of bytes at the end of the stream buffer whose encoding is yet to be validated
+    // (a multi-byte sequence split across two reads)
+    size_t _nbytes_unchecked;
+
+    // encoding of the file being processed
+    _cxml_encoding_t _encoding;
+
+    // bytes read from file, but not yet transcoded/copied into the stream buffer
+    char *_raw_buff;
+    size_t _raw_size;
+    size_t _raw_cap;
+
+    // is the file exhausted? (all of it copied into the stream buffer)
+    bool _eof;
 } _cxml_stream;
 
 
@@ -49,4 +76,6 @@ void _cxml__open_stream(
 
 void _cxml__close_stream(_cxml_stream *stream);
 
+size_t _cxml__stream_read(_cxml_stream *stream, char *dest, size_t size);
+
 #endif //CXML_CXSTREAM_H
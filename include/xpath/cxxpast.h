@@ -22,7 +22,9 @@ typedef enum{
     CXML_XP_AST_STR_LITERAL_NODE,
     CXML_XP_AST_STEP_NODE,
     CXML_XP_AST_NODETEST_NODE,
-    CXML_XP_AST_PATH_NODE
+    CXML_XP_AST_PATH_NODE,
+    CXML_XP_AST_FILTER_NODE,
+    CXML_XP_AST_VARIABLE_NODE
 }cxml_xp_ast_t;
 
 
@@ -81,6 +83,25 @@ typedef enum{
     CXML_XP_ABBREV_STEP_TPARENT // '//..'
 }cxml_xp_abbrev_step_t;
 
+/*
+ * Axes written out in full (AxisName '::').
+ * The child and attribute axes are stored in their abbreviated forms (as are
+ * 'self::node()' and 'parent::node()' -> '.' and '..'), hence CXML_XP_AXIS_NIL.
+ */
+typedef enum{
+    CXML_XP_AXIS_NIL,
+    CXML_XP_AXIS_ANCESTOR,
+    CXML_XP_AXIS_ANCESTOR_OR_SELF,
+    CXML_XP_AXIS_DESCENDANT,
+    CXML_XP_AXIS_DESCENDANT_OR_SELF,
+    CXML_XP_AXIS_FOLLOWING,
+    CXML_XP_AXIS_FOLLOWING_SIBLING,
+    CXML_XP_AXIS_PARENT,
+    CXML_XP_AXIS_PRECEDING,
+    CXML_XP_AXIS_PRECEDING_SIBLING,
+    CXML_XP_AXIS_SELF
+}cxml_xp_axis_t;
+
 
 typedef enum {
     CXML_XP_RET_STRING = 2,
@@ -110,6 +131,7 @@ typedef struct{
 typedef struct{
     cxml_xp_ast_t type;
     struct cxml_xp_astnode* expr_node;
+    struct _cxml_xp_program* program;   // compiled expr_node, if compilable (see cxxpvm.h)
 }cxml_xp_predicate;
 
 typedef struct{
@@ -151,6 +173,7 @@ typedef struct{
     short abbrev_step;              // '.' -> 1 | '..' -> 2 | None -> 0
     short path_spec;                // '/' -> 1 | '//' -> 2 | None -> 0
     bool has_attr_axis;             // '@'
+    cxml_xp_axis_t axis;            // AxisName '::' -> CXML_XP_AXIS_NIL if abbreviated
     cxml_xp_nodetest* node_test;    // NodeTest  -> stores node-test directly
     cxml_list predicates;           // Predicate* -> stores predicate directly
 }cxml_xp_step;
@@ -161,9 +184,24 @@ typedef struct{
     cxml_list steps;        // ->stores step directly
 }cxml_xp_path;
 
+typedef struct{
+    cxml_xp_ast_t type;
+    struct cxml_xp_astnode* expr_node;  // '(' Expr ')'
+    cxml_list predicates;               // Predicate+ -> stores predicate directly
+}cxml_xp_filter;
+
+typedef struct{
+    cxml_xp_ast_t type;
+    cxml_string name;       // '$' name
+}cxml_xp_variable;
+
 typedef struct cxml_xp_astnode{  // cxml xpath ast node
     cxml_xp_ast_t type;
     cxml_xp_ast_t wrapped_type;
+    // set by the optimizer (cxxpopt.c): the node lives inside a predicate, but its value
+    // doesn't depend on the context node, so it is evaluated once per query.
+    bool is_invariant;
+    void *value;        // (_cxml_xp_data*) value of an invariant node, once evaluated
     union{
         cxml_xp_unaryop* unary;
         cxml_xp_binaryop* binary;
@@ -173,6 +211,8 @@ typedef struct cxml_xp_astnode{  // cxml xpath ast node
         cxml_xp_string* str_literal;
         cxml_xp_step* step;
         cxml_xp_path* path;
+        cxml_xp_filter* filter;
+        cxml_xp_variable* variable;
     }wrapped_node;
 }cxml_xp_astnode;
 
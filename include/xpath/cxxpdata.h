@@ -37,10 +37,16 @@ void _cxml_xp_data_init(_cxml_xp_data **data);
 
 _cxml_xp_data *_cxml_xp_new_data();
 
-void _cxml_xp_data_free(_cxml_xp_data *data);
+void _cxml_xp_data_free(void *data);
 
 void _cxml_xp_data_clear(_cxml_xp_data *data);
 
+void _cxml_xp_data_copy(_cxml_xp_data *cpy, _cxml_xp_data *ori);
+
+cxml_string *_cxml_xp__node_string_ref(void* node);
+
+void _cxml_xp__forget_string_vals();
+
 void _cxml_xp__node_string_val(void* node, cxml_string* acc);
 
 void _cxml_xp__node_num_val(void* node, cxml_number *num);
@@ -10,10 +10,132 @@
 #include "xml/cxprinter.h"
 #include "cxxpresolver.h"
 #include "cxxplib.h"
+#include "cxxpprofile.h"
+#include "cxxpfrozen.h"
+
+/*
+ * Pipelined path evaluation.
+ *
+ * A pipe produces the nodes selected by a path one at a time (in document order),
+ * with a single pre-order walk of the context node's subtree.
+ * Each node visited carries the set of states (the number of leading steps of the path
+ * matched, ending at the node) it continues, so that subtrees continuing no state
+ * are skipped, and evaluation stops as soon as the consumer stops pulling nodes.
+ * Paths made of name-tests and type-tests, with '/' and '//' separators, at most one
+ * positional predicate (e.g. [1]) per step, and an optional (last) attribute step,
+ * are pipelined. Every other path is evaluated step by step.
+ */
+#define _CXML_XP_PIPE_MAX_STEPS         (31)
+#define _CXML_XP_PIPE_MAX_POSITIONS     (4)
+#define _CXML_XP_PIPE_STACK_SIZE        (32)
+
+struct _cxml_xp_pipe_frame{
+    void *node;                         // element/root node whose children are being visited
+    struct _cxml_list__node *next;      // next child of `node` to be visited
+    uint32_t src;                       // states continued by the children of `node`
+    uint32_t desc;                      // states continued by any descendant of `node` ('//' steps)
+    int counts[_CXML_XP_PIPE_MAX_POSITIONS];   // matches of each positional step among the children
+};
+
+typedef struct _cxml_xp_pipe{
+    int size;                                           // number of steps
+    bool absolute;                                      // path begins with '/' or '//'
+    bool attr_step;                                     // last step selects attributes
+    cxml_xp_step *steps[_CXML_XP_PIPE_MAX_STEPS + 1];   // steps[1..size]
+    int positions[_CXML_XP_PIPE_MAX_STEPS + 1];         // position selected by each step, 0 if none
+    int slots[_CXML_XP_PIPE_MAX_STEPS + 1];             // counter (frame->counts) of each positional step
+    uint32_t child_from;                                // states followed by a '/' step
+    uint32_t desc_from;                                 // states followed by a '//' step
+    uint32_t node_mask;                                 // states followed by a step selecting child nodes
+    int depth;
+    int capacity;
+    struct _cxml_xp_pipe_frame *frames;
+    struct _cxml_xp_pipe_frame stack[_CXML_XP_PIPE_STACK_SIZE];
+    cxml_set attrs;                                     // selected attributes of the current element
+    struct _cxml_list__node *next_attr;
+    long visited;                                       // nodes walked
+}_cxml_xp_pipe;
+
+bool _cxml_xp_pipe_plan(_cxml_xp_pipe *pipe, cxml_xp_path *path);
+
+void _cxml_xp_pipe_open(_cxml_xp_pipe *pipe, void *context);
+
+void *_cxml_xp_pipe_next(_cxml_xp_pipe *pipe);
+
+void _cxml_xp_pipe_close(_cxml_xp_pipe *pipe);
+
+bool _cxml_xp_fold(cxml_xp_astnode *node, _cxml_xp_fold_t fold, cxml_number *acc);
+
+bool _cxml_xp_exists(cxml_xp_astnode *node, bool *exists);
+
+/*
+ * XPath result cursor.
+ *
+ * Produces the nodes selected by an expression one at a time, skipping the first `offset`
+ * nodes, and producing at most `limit` nodes (0 for no limit).
+ * Pipelined paths (see above) are pulled on demand, so only as much of the document
+ * as needed to produce the nodes requested is visited. Other expressions are evaluated
+ * once (when the cursor is initialized), and their node-set is then iterated.
+ * The document must not be modified while the cursor is in use.
+ */
+typedef struct{
+    int offset;                     // nodes yet to be skipped
+    int limit;                      // nodes yet to be produced, if limited
+    bool limited;
+    cxml_xp_astnode *ast;           // (owned) ast of a pipelined path
+    _cxml_xp_pipe pipe;
+    cxml_set *nodeset;              // node-set of an expression that isn't pipelined
+    struct _cxml_list__node *next;
+    cxml_root_node *virtual_root;   // root node created when the root is an element
+    cxml_ns_node *xml_namespace;
+}cxml_xpath_iter;
+
+/*
+ * Prepared XPath queries.
+ *
+ * A prepared query is parsed and optimized once (see cxml_xpath_prepare()), and can be
+ * evaluated any number of times, against any document, binding different values
+ * to the variables ($name) it references between evaluations.
+ * The predicates of the query are compiled (see cxxpvm.h) for the types of the values
+ * bound, and are compiled again only when the type of a variable changes.
+ */
+typedef struct{
+    cxml_string name;
+    _cxml_xp_data value;
+}_cxml_xp_binding;
+
+typedef struct _cxml_xp_query{
+    cxml_string expr;
+    cxml_xp_astnode *ast;
+    cxml_list bindings;     // _cxml_xp_binding*
+    bool recompile;         // a variable was bound to a value of another type since the last evaluation
+}cxml_xp_query;
 
 /**Debug**/
 void cxml_xp_debug_expr();
 
 /** public api **/
 cxml_set* cxml_xpath(void *root, const char *expr);
+
+cxml_set* cxml_xpath_profile(void *root, const char *expr, cxml_xp_profile *profile);
+
+void cxml_xpath_iter_init(cxml_xpath_iter *iter, void *root, const char *expr, int offset, int limit);
+
+void *cxml_xpath_iter_next(cxml_xpath_iter *iter);
+
+void cxml_xpath_iter_free(cxml_xpath_iter *iter);
+
+cxml_xp_query *cxml_xpath_prepare(const char *expr);
+
+void cxml_xp_query_bind_string(cxml_xp_query *query, const char *name, const char *value);
+
+void cxml_xp_query_bind_number(cxml_xp_query *query, const char *name, double value);
+
+void cxml_xp_query_bind_boolean(cxml_xp_query *query, const char *name, bool value);
+
+void cxml_xp_query_bind_nodeset(cxml_xp_query *query, const char *name, cxml_set *value);
+
+cxml_set *cxml_xp_query_eval(cxml_xp_query *query, void *root);
+
+void cxml_xp_query_free(cxml_xp_query *query);
 #endif
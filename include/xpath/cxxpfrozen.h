@@ -0,0 +1,39 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#ifndef CXML_CXXPFROZEN_H
+#define CXML_CXXPFROZEN_H
+
+#include "core/cxfrozen.h"
+
+/*
+ * XPath over frozen documents.
+ *
+ * Location paths whose steps are on the child, descendant(-or-self), self and parent
+ * axes (abbreviated or not), without predicates, and whose node tests are unprefixed
+ * names, '*', node(), text(), comment() or processing-instruction(), are evaluated
+ * directly over the tables of a frozen document (see core/cxfrozen.h): name tests are
+ * symbol comparisons, and descendant steps are scans of the subtree ranges.
+ *
+ * A path is prepared once (parsed with the shared XPath parser, see cxml_xpath_frozen_prepare()),
+ * and its evaluation (cxml_xp_frozen_path_eval()) reads nothing but the path and the document,
+ * so that prepared paths can be evaluated against frozen documents from several threads at once.
+ */
+struct _cxml_xp_frozen_step;
+
+typedef struct _cxml_xp_frozen_path{
+    int size;
+    struct _cxml_xp_frozen_step *steps;
+}cxml_xp_frozen_path;
+
+cxml_xp_frozen_path *cxml_xpath_frozen_prepare(const char *expr);
+
+bool cxml_xp_frozen_path_eval(cxml_xp_frozen_path *path, cxml_frozen_doc *doc, cxml_frozen_set *acc);
+
+void cxml_xp_frozen_path_free(cxml_xp_frozen_path *path);
+
+bool cxml_xpath_frozen(cxml_frozen_doc *doc, const char *expr, cxml_frozen_set *acc);
+
+#endif //CXML_CXXPFROZEN_H
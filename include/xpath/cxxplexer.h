@@ -14,6 +14,7 @@
  * wildcards
  * comments
  * function calls
+ * variable references
  *
  */
 #include "xml/cxlexer.h"
@@ -66,6 +67,9 @@ typedef enum{
     CXML_XP_TOKEN_NODE_F,       // node()
     /* ***** */
 
+    CXML_XP_TOKEN_VARIABLE,     // $name
+    CXML_XP_TOKEN_D_COLON,      // '::'
+
     CXML_XP_TOKEN_END
 } _cxml_xp_token_t;
 
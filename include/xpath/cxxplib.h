@@ -27,4 +27,50 @@ struct _cxml_xp_func_LU_val{
     _cxml_xp_ret_t ret_type; // return type
 };
 
+/*
+ * Extension functions.
+ *
+ * Native functions registered with cxml_xpath_register_function() can be called
+ * (by name) in any expression, predicates included, as the built-in functions are.
+ * `arity` is the number of arguments the function takes, or -n for a variadic function
+ * taking at least n arguments. The arguments are evaluated before the function is called,
+ * and `result` is initialized to an empty value of the declared return type, which the
+ * function sets (without changing its type).
+ * A pure function's result depends only on its arguments, so a call whose arguments don't
+ * depend on the context node is evaluated once per query (see cxxpopt.c); an impure function
+ * can obtain the context node with cxml_xpath_context_node().
+ * Registered functions can't shadow the built-in functions, and must remain registered
+ * while the queries calling them are in use.
+ */
+typedef void (*cxml_xp_ext_fn)(_cxml_xp_data **args, int argc, _cxml_xp_data *result, void *user_data);
+
+struct _cxml_xp_ext_fn{
+    cxml_string name;
+    int arity;
+    _cxml_xp_ret_t ret_type;
+    bool pure;
+    cxml_xp_ext_fn fn;
+    void *user_data;
+};
+
+bool cxml_xpath_register_function(const char *name, int arity, _cxml_xp_ret_t ret_type,
+                                  bool pure, cxml_xp_ext_fn fn, void *user_data);
+
+void cxml_xpath_unregister_functions();
+
+void *cxml_xpath_context_node();
+
+bool _cxml_xp_is_ext_fn(int pos);
+
+void _cxml_xp_call_fn(cxml_xp_functioncall *node,
+                      _cxml_xp_data *(*_pop)(void),
+                      void (*_push)(_cxml_xp_data *));
+
+// aggregates computed while a path is evaluated (see _cxml_xp_fold() in cxxpeval.c)
+typedef enum{
+    _CXML_XP_FOLD_EXISTS,
+    _CXML_XP_FOLD_COUNT,
+    _CXML_XP_FOLD_SUM
+}_cxml_xp_fold_t;
+
 #endif //CXML_CXXPLIB_H
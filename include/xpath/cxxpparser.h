@@ -7,10 +7,24 @@
 #define CXML_CXXPPARSER_H
 
 #include "xml/cxparser.h"
+#include "core/cxarena.h"
+#include "core/cxbudget.h"
 #include "cxxplexer.h"
 #include "cxxpdata.h"
 #include "cxxpvisitors.h"
 #include "cxxpcontext.h"
+#include "cxxpprofile.h"
+
+// resolution of the prefix of a name test, in the scope of a node
+struct _cxml_xp_ns_memo{
+    void *node_test;                // name test (cxml_xp_nodetest*) whose prefix was resolved
+    void *scope;                    // nearest element (or the root node) declaring namespaces
+    cxml_ns_node *ns;               // namespace bound to the prefix in `scope`
+    cxml_ns_node *check_ns;         // namespace last compared with `ns`
+    bool same_uri;                  // do `ns` and `check_ns` have the same namespace name?
+};
+
+#define _CXML_XP_NS_MEMO_SIZE   (8)
 
 
 typedef struct {
@@ -18,14 +32,18 @@ typedef struct {
     int consume_cnt;
     // flag to indicate if the result of evaluating an expr is an empty node-set
     bool is_empty_nodeset;
+    // flag to indicate if the steps of the path being evaluated follow a step on an axis,
+    // so that their context nodes may nest (see cxml_xp_visit_Path())
+    bool after_axis;
     // flag to determine if the parsed path nodes resides inside a predicate node
     bool from_predicate;
     // previous token being parsed
     _cxml_xp_token prev_tok;
     // current token being parsed
     _cxml_xp_token current_tok;
-    // list to store all allocated _cxml_xp_data objects for later de-allocation
-    cxml_list data_nodes;
+    // evaluation arena: the _cxml_xp_data objects and cached node-sets of the query
+    // (reset when the query has been evaluated, see _cxml_xpath_parser_free())
+    cxml_arena arena;
     // xpath ast stack
     _cxml_stack ast_stack;
     // result accumulator stack
@@ -34,6 +52,8 @@ typedef struct {
     cxml_set nodeset;
     // global xml namespace
     cxml_ns_node *xml_namespace;
+    // prefixes of the name tests resolved during the query (see cmp_expanded_name())
+    struct _cxml_xp_ns_memo ns_memo[_CXML_XP_NS_MEMO_SIZE];
     // lexer for the xpath expression
     _cxml_xp_lexer lexer;
     // current root node
@@ -41,12 +61,18 @@ typedef struct {
     cxml_elem_node *root_element;
     // lru cache for already evaluated nodes
     _cxml_lru_cache lru_cache;
-    // list to store all allocated cxml_list objects used in caching, for later de-allocation
-    cxml_list alloc_set_list;
+    // invariant ast nodes whose values have been evaluated
+    cxml_list invariants;
+    // string values of the element/root nodes converted during the query (node -> cxml_string*)
+    cxml_table str_values;
     // context_state stack
     _cxml_stack ctx_stack;
     // context state of the xpath node objects
     struct _cxml_xp_context_state context;
+    // profile of the query, when profiled (see cxml_xpath_profile())
+    cxml_xp_profile *profile;
+    // variable bindings of the prepared query being evaluated (see cxml_xp_query_eval())
+    cxml_list *bindings;
 } _cxml_xp_parser;
 
 _cxml_xp_parser _xpath_parser;
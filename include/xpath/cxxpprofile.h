@@ -0,0 +1,85 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#ifndef CXML_CXXPPROFILE_H
+#define CXML_CXXPPROFILE_H
+
+#include <time.h>
+#include "cxxpast.h"
+#include "core/cxtable.h"
+
+/*
+ * XPath query profiles.
+ *
+ * A profile describes how a query was evaluated (see cxml_xpath_profile()).
+ * The plan of the query is the tree of its paths, the steps of the paths, and the
+ * predicates of the steps (and of filter expressions), each of which has an entry
+ * recording what its evaluation did. Entries are listed in plan order (pre-order),
+ * with the depth of each entry in the tree.
+ * The time spent by an entry includes the time spent by its nested entries.
+ */
+
+typedef enum{
+    CXML_XP_PROFILE_EXPR,       // the query (when it isn't a path or a filter expression)
+    CXML_XP_PROFILE_PATH,
+    CXML_XP_PROFILE_STEP,
+    CXML_XP_PROFILE_PREDICATE,
+    CXML_XP_PROFILE_FILTER
+}cxml_xp_profile_t;
+
+// optimizations (rewrites) applied to an entry, or to an expression within the entry
+typedef enum{
+    CXML_XP_REWRITE_PIPELINED = 1,      // path evaluated lazily, in a single walk of the document
+    CXML_XP_REWRITE_FOLDED = 2,         // count()/sum() computed as the path selected its nodes
+    CXML_XP_REWRITE_EXISTS = 4,         // path tested for a single node
+    CXML_XP_REWRITE_HOISTED = 8,        // invariant expression evaluated once per query
+    CXML_XP_REWRITE_REORDERED = 16,     // operands of and/or swapped (cheaper operand first)
+    CXML_XP_REWRITE_COMPILED = 32,      // predicate expression compiled (see cxxpvm.h)
+    CXML_XP_REWRITE_CONSTANT = 64       // predicate always true/false, tested once per step
+}cxml_xp_rewrite_t;
+
+typedef struct{
+    cxml_xp_profile_t type;
+    int depth;                  // depth of the entry in the plan
+    cxml_string expr;           // expression of the entry (a step excludes its predicates)
+    int rewrites;               // cxml_xp_rewrite_t flags
+    long calls;                 // number of times evaluated
+    long visited;               // nodes the entry started from (for paths: nodes examined by the steps,
+                                // or walked, for pipelined paths)
+    long produced;              // nodes selected (or that passed a predicate)
+    long cache_hits;            // (paths) evaluations served by the node-set cache
+    double time;                // seconds spent
+}cxml_xp_profile_entry;
+
+typedef struct _cxml_xp_profile{
+    cxml_string expr;
+    double parse_time;          // seconds spent parsing (and optimizing) the query
+    double eval_time;           // seconds spent evaluating the query
+    int size;                   // number of nodes selected by the query
+    cxml_list entries;          // cxml_xp_profile_entry*, in plan order
+    cxml_table nodes;           // (ast node -> entry (owning the node))
+}cxml_xp_profile;
+
+// evaluation of an entry, being timed
+typedef struct{
+    cxml_xp_profile_entry *entry;
+    clock_t start;
+}_cxml_xp_profile_span;
+
+void _cxml_xp_profile_init(cxml_xp_profile *profile, const char *expr);
+
+void _cxml_xp_profile_plan(cxml_xp_profile *profile, cxml_xp_astnode *ast_node);
+
+void _cxml_xp_profile_rewrite(void *node, cxml_xp_rewrite_t rewrite);
+
+void _cxml_xp_profile_begin(_cxml_xp_profile_span *span, void *node);
+
+void _cxml_xp_profile_end(_cxml_xp_profile_span *span, long visited, long produced, long cache_hits);
+
+void cxml_xp_profile_print(cxml_xp_profile *profile);
+
+void cxml_xp_profile_free(cxml_xp_profile *profile);
+
+#endif //CXML_CXXPPROFILE_H
@@ -36,6 +36,11 @@ void cxml_xp_dvisit(cxml_xp_astnode *ast_node);
  */
 void cxml_xp_bvisit(cxml_xp_astnode *ast_node, cxml_string *acc);
 
+void cxml_xp_bvisit_Predicate(cxml_xp_predicate *node, cxml_string *acc);
+
+// a step, without its predicates
+void cxml_xp_bvisit_StepTest(cxml_xp_step *node, cxml_string *acc);
+
 
 /*************************************
  *  optimization checking visitor    *
@@ -44,6 +49,15 @@ void cxml_xp_bvisit(cxml_xp_astnode *ast_node, cxml_string *acc);
 void cxml_xp_ovisit(cxml_xp_astnode *ast_node, _cxml_xp_ret_t *ret_type);
 
 
+/*************************************
+ *          optimization pass        *
+ *************************************
+ */
+void cxml_xp_optimize(cxml_xp_astnode *ast_node);
+
+void cxml_xp_recompile(cxml_xp_astnode *ast_node);
+
+
 /*************************************
  *          eval node visitor        *
  *************************************
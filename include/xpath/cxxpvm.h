@@ -0,0 +1,121 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#ifndef CXML_CXXPVM_H
+#define CXML_CXXPVM_H
+
+#include "cxxpast.h"
+
+/*
+ * Compiled predicates.
+ *
+ * The expression of a predicate is evaluated once per node being filtered, so, once the
+ * ast of a query has been optimized, each predicate expression is lowered (when possible)
+ * into a program: a linear sequence of instructions over typed registers (numbers,
+ * borrowed strings, and booleans), which is run with the registers on the (C) stack.
+ * Unlike the ast visitor, running a program doesn't allocate any intermediate value,
+ * or use the evaluation stacks.
+ *
+ * The node-sets a program works with are the nodes selected by a single step from the
+ * context node (for example `@id`, `price`, `text()`, or `.`), or an invariant node-set
+ * (see cxxpopt.c), which are only ever iterated, never built.
+ * Expressions using anything else (for example `a/b`, `.//b`, or `concat()`) aren't
+ * compiled, and are evaluated by the ast visitor.
+ */
+
+// registers available to a program
+#define _CXML_XP_VM_MAX_REGS     (32)
+
+// register (or operand) types
+typedef enum{
+    _CXML_XP_VM_NUM,
+    _CXML_XP_VM_STR,
+    _CXML_XP_VM_BOOL,
+    _CXML_XP_VM_NODES
+}_cxml_xp_vm_t;
+
+typedef enum{
+    _CXML_XP_VM_LOAD_NUM,           // dst = k.num
+    _CXML_XP_VM_LOAD_STR,           // dst = k.str
+    _CXML_XP_VM_LOAD_BOOL,          // dst = a
+    _CXML_XP_VM_LOAD_POS,           // dst = position()
+    _CXML_XP_VM_LOAD_LAST,          // dst = last()
+    _CXML_XP_VM_LOAD_INV,           // dst = value of the invariant k.inv (converted to the type of dst)
+    _CXML_XP_VM_CTX_STR,            // dst = string value of the context node
+    _CXML_XP_VM_CTX_NUM,            // dst = number value of the context node
+    _CXML_XP_VM_MOVE,               // dst = a
+    _CXML_XP_VM_NUM_TO_BOOL,        // dst = boolean(a)
+    _CXML_XP_VM_STR_TO_BOOL,        // dst = boolean(a)
+    _CXML_XP_VM_STR_TO_NUM,         // dst = number(a)
+    _CXML_XP_VM_BOOL_TO_NUM,        // dst = number(a)
+    _CXML_XP_VM_BOOL_TO_STR,        // dst = string(a)
+    _CXML_XP_VM_NODES_TO_BOOL,      // dst = boolean(nodes a)
+    _CXML_XP_VM_NODES_TO_NUM,       // dst = number(nodes a)
+    _CXML_XP_VM_NODES_TO_STR,       // dst = string(nodes a)
+    _CXML_XP_VM_COUNT,              // dst = count(nodes a)
+    _CXML_XP_VM_ARITH,              // dst = a `op` b
+    _CXML_XP_VM_NEG,                // dst = -a
+    _CXML_XP_VM_NOT,                // dst = not(a)
+    _CXML_XP_VM_CMP_NUM,            // dst = a `op` b
+    _CXML_XP_VM_CMP_STR,            // dst = a `op` b (= and != only)
+    _CXML_XP_VM_CMP_BOOL,           // dst = a `op` b (= and != only)
+    _CXML_XP_VM_CMP_NODES_NUM,      // dst = nodes a `op` b (b `op` nodes a, if flip)
+    _CXML_XP_VM_CMP_NODES_STR,      // dst = nodes a `op` b (b `op` nodes a, if flip)
+    _CXML_XP_VM_CMP_NODES_BOOL,     // dst = nodes a `op` b (b `op` nodes a, if flip)
+    _CXML_XP_VM_CMP_NODES_NODES,    // dst = nodes a `op` nodes b
+    _CXML_XP_VM_STR_LEN,            // dst = string-length(a)
+    _CXML_XP_VM_CONTAINS,           // dst = contains(a, b)
+    _CXML_XP_VM_STARTS_WITH,        // dst = starts-with(a, b)
+    _CXML_XP_VM_JUMP_IF_TRUE,       // if a: goto k.target
+    _CXML_XP_VM_JUMP_IF_FALSE       // if !a: goto k.target
+}_cxml_xp_vm_op;
+
+typedef struct{
+    _cxml_xp_vm_op op;
+    cxml_xp_op cmp;         // operator of a comparison or an arithmetic instruction
+    bool flip;              // the node-set is the right operand of the comparison
+    int dst, a, b;          // registers, or node-set operands (for node-set instructions)
+    union{
+        cxml_number num;
+        cxml_string *str;
+        cxml_xp_astnode *inv;
+        int target;
+    }k;
+}_cxml_xp_vm_ins;
+
+typedef enum{
+    _CXML_XP_VM_SELF,       // '.'
+    _CXML_XP_VM_CHILD,      // nm | * | nt()
+    _CXML_XP_VM_ATTR,       // @nm | @*
+    _CXML_XP_VM_INV         // invariant node-set
+}_cxml_xp_vm_nodes_t;
+
+// node-set operand
+struct _cxml_xp_vm_nodes{
+    _cxml_xp_vm_nodes_t type;
+    union{
+        cxml_xp_step *step;
+        cxml_xp_astnode *inv;
+    };
+};
+
+struct _cxml_xp_program{
+    int size;
+    int capacity;
+    _cxml_xp_vm_ins *code;
+    int n_nodes;
+    struct _cxml_xp_vm_nodes *nodes;
+    int n_regs;
+    int ret;                // register (or node-set operand) holding the value of the expression
+    _cxml_xp_vm_t ret_type;
+};
+
+struct _cxml_xp_program *_cxml_xp_compile(cxml_xp_astnode *expr_node);
+
+bool _cxml_xp_run(struct _cxml_xp_program *program);
+
+void _cxml_xp_program_free(struct _cxml_xp_program *program);
+
+#endif //CXML_CXXPVM_H
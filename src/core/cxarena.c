@@ -0,0 +1,99 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#include "core/cxarena.h"
+
+#define _cxml_arena__align(n)   (((n) + (_CXML_ARENA_ALIGN - 1)) & ~((size_t)_CXML_ARENA_ALIGN - 1))
+// the memory of a block follows its (aligned) header
+#define _cxml_arena__hdr        _cxml_arena__align(sizeof(struct _cxml_arena_block))
+#define _cxml_arena__mem(b)     ((char *)(b) + _cxml_arena__hdr)
+
+
+void cxml_arena_init(cxml_arena *arena){
+    if (!arena) return;
+    arena->block = NULL;
+    arena->used = 0;
+    arena->cleanups = NULL;
+}
+
+static void _cxml_arena__grow(cxml_arena *arena, size_t size){
+    // each block is (at least) twice as large as the previous one
+    size_t block_size = arena->block ? arena->block->size * 2 : _CXML_ARENA_BLOCK_SIZE;
+    while (block_size < size) block_size *= 2;
+    struct _cxml_arena_block *block = ALLOCR(char, (_cxml_arena__hdr + block_size),
+                                             "CXMLFatalError: Not enough memory to allocate arena block.");
+    block->prev = arena->block;
+    block->size = block_size;
+    arena->block = block;
+    arena->used = 0;
+}
+
+/*
+ * Allocate `size` bytes (aligned for any type) from the arena.
+ * The memory is valid until the arena is reset.
+ */
+void *cxml_arena_alloc(cxml_arena *arena, size_t size){
+    size = _cxml_arena__align(size ? size : 1);
+    if (!arena->block || arena->block->size - arena->used < size){
+        _cxml_arena__grow(arena, size);
+    }
+    void *mem = _cxml_arena__mem(arena->block) + arena->used;
+    arena->used += size;
+    return mem;
+}
+
+void *cxml_arena_calloc(cxml_arena *arena, size_t size){
+    void *mem = cxml_arena_alloc(arena, size);
+    memset(mem, 0, size);
+    return mem;
+}
+
+/*
+ * Call `fn(item)` when the arena is next reset (or freed).
+ * Cleanups run in the reverse order of their registration.
+ */
+void cxml_arena_on_reset(cxml_arena *arena, void (*fn)(void *item), void *item){
+    struct _cxml_arena_cleanup *cleanup = cxml_arena_alloc(arena, sizeof(struct _cxml_arena_cleanup));
+    cleanup->fn = fn;
+    cleanup->item = item;
+    cleanup->next = arena->cleanups;
+    arena->cleanups = cleanup;
+}
+
+static void _cxml_arena__run_cleanups(cxml_arena *arena){
+    // a cleanup lives in the arena, so it must be read before the next one runs
+    struct _cxml_arena_cleanup *cleanup = arena->cleanups, *next;
+    arena->cleanups = NULL;
+    while (cleanup){
+        next = cleanup->next;
+        cleanup->fn(cleanup->item);
+        cleanup = next;
+    }
+}
+
+/*
+ * Release everything allocated from the arena, keeping only its current
+ * (largest) block for the allocations to come.
+ */
+void cxml_arena_reset(cxml_arena *arena){
+    if (!arena) return;
+    _cxml_arena__run_cleanups(arena);
+    if (!arena->block) return;
+    struct _cxml_arena_block *block = arena->block->prev, *prev;
+    while (block){
+        prev = block->prev;
+        FREE(block);
+        block = prev;
+    }
+    arena->block->prev = NULL;
+    arena->used = 0;
+}
+
+void cxml_arena_free(cxml_arena *arena){
+    if (!arena) return;
+    cxml_arena_reset(arena);
+    FREE(arena->block);
+    cxml_arena_init(arena);
+}
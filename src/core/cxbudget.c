@@ -0,0 +1,87 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#include "core/cxbudget.h"
+
+// budget of the calls being made by the thread (NULL if unbounded)
+_CXML_THREAD_LOCAL cxml_budget *_cxml_budget = NULL;
+
+
+void cxml_budget_init(cxml_budget *budget){
+    if (!budget) return;
+    budget->max_visits = 0;
+    budget->max_results = 0;
+    budget->timeout = 0;
+    budget->cancel = NULL;
+    budget->status = CXML_BUDGET_OK;
+    budget->visits = 0;
+    budget->ticks = _CXML_BUDGET_CHECK_INTERVAL;
+    budget->deadline.tv_sec = 0;
+    budget->deadline.tv_nsec = 0;
+}
+
+/*
+ * Bound each call made from now on by the calling thread with `budget`
+ * (NULL for unbounded calls). The limits of `budget` apply to each call separately.
+ */
+void cxml_budget_set(cxml_budget *budget){
+    _cxml_budget = budget;
+}
+
+/*
+ * Start a call (with a fresh budget).
+ */
+void _cxml_budget_begin(){
+    cxml_budget *budget = _cxml_budget;
+    if (!budget) return;
+    budget->status = CXML_BUDGET_OK;
+    budget->visits = 0;
+    budget->ticks = _CXML_BUDGET_CHECK_INTERVAL;
+    if (budget->timeout > 0){
+        timespec_get(&budget->deadline, TIME_UTC);
+        double secs = (double)budget->deadline.tv_sec + budget->deadline.tv_nsec / 1e9 + budget->timeout;
+        budget->deadline.tv_sec = (time_t)secs;
+        budget->deadline.tv_nsec = (long)((secs - (double)budget->deadline.tv_sec) * 1e9);
+    }
+}
+
+bool _cxml_budget__check(cxml_budget *budget){
+    if (budget->max_visits && budget->visits > budget->max_visits){
+        budget->status = CXML_BUDGET_VISITS_EXCEEDED;
+        return false;
+    }
+    if (budget->ticks > 0) return true;
+    budget->ticks = _CXML_BUDGET_CHECK_INTERVAL;
+    if (budget->cancel && *budget->cancel){
+        budget->status = CXML_BUDGET_CANCELLED;
+        return false;
+    }
+    if (budget->timeout > 0){
+        struct timespec now;
+        timespec_get(&now, TIME_UTC);
+        if (now.tv_sec > budget->deadline.tv_sec
+            || (now.tv_sec == budget->deadline.tv_sec && now.tv_nsec >= budget->deadline.tv_nsec))
+        {
+            budget->status = CXML_BUDGET_DEADLINE_EXCEEDED;
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Account for `size` nodes selected at once by the call being evaluated.
+ * Returns false if the call must be aborted.
+ */
+bool _cxml_budget_results(long size){
+    cxml_budget *budget = _cxml_budget;
+    if (!budget) return true;
+    if (budget->status != CXML_BUDGET_OK) return false;
+    if (budget->max_results && size > budget->max_results){
+        budget->status = CXML_BUDGET_RESULTS_EXCEEDED;
+        return false;
+    }
+    return true;
+}
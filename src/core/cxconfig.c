@@ -20,7 +20,8 @@ static cxml_config _cxml_config_gb = {
         .preserve_dtd_structure = 0,
         .strict_transpose = 0,
         .ensure_ns_attribute_unique = 1,
-        .allow_default_namespace = 1
+        .allow_default_namespace = 1,
+        .validate_encoding = 0
 };
 
 
@@ -44,7 +45,8 @@ cxml_config cxml_get_config_defaults(){
             .preserve_dtd_structure = 0,
             .strict_transpose = 0,
             .ensure_ns_attribute_unique = 1,
-            .allow_default_namespace = 1
+            .allow_default_namespace = 1,
+            .validate_encoding = 0
     };
 }
 
@@ -113,3 +115,7 @@ void cxml_cfg_allow_default_namespace(bool allow){
 void cxml_cfg_allow_duplicate_namespaces(bool allow){
     _cxml_config_gb.ensure_ns_attribute_unique = !allow;
 }
+
+void cxml_cfg_validate_encoding(bool validate){
+    _cxml_config_gb.validate_encoding = validate;
+}
@@ -3,7 +3,8 @@
  * Distributed under the terms of the MIT license.
  */
 
-#include "core/cxdefs.h"
+#include "core/cxindex.h"
+#include "core/cxswar.h"
 
 // transpose_text = 1 : & -> &amp;  transpose forward
 // transpose_text = 0 : &amp; -> &  transpose backward/reverse
@@ -36,8 +37,6 @@ static void _cxml_table_attr_free(cxml_table *table, bool _FREE);
 //* --impls--*
 
 void cxml_name_init(cxml_name *name){
-    name->pname = NULL;
-    name->lname = NULL;
     name->pname_len = 0;
     name->lname_len = 0;
     cxml_string_init(&name->qname);
@@ -67,6 +66,7 @@ void cxml_root_node_init(cxml_root_node* root_node){
     cxml_string_init(&root_node->name);
     cxml_list_init(&root_node->children);
     root_node->namespaces = NULL;
+    root_node->index = NULL;
     root_node->root_element = NULL;
     root_node->has_child = false;
     root_node->_type = CXML_ROOT_NODE;
@@ -96,6 +96,8 @@ void cxml_text_node_init(cxml_text_node *text) {
     text->has_entity = false;
     cxml_string_init(&text->value);
     cxml_number_init(&text->number_value);
+    text->number_value.type = CXML_NUMERIC_UNSET_T;
+    text->decoded = NULL;
     text->parent = NULL;
     text->is_cdata = 0;
     text->pos = 0;
@@ -107,6 +109,7 @@ void cxml_attr_node_init(cxml_attr_node* cx_attr){
     cxml_name_init(&cx_attr->name);
     cxml_string_init(&cx_attr->value);
     cxml_number_init(&cx_attr->number_value);
+    cx_attr->number_value.type = CXML_NUMERIC_UNSET_T;
     cx_attr->parent = NULL;
     cx_attr->pos = 0;
     cx_attr->namespace = NULL;
@@ -141,7 +144,6 @@ void cxml_dtd_node_init(cxml_dtd_node* dtd){
 void cxml_name_free(cxml_name *name){
     if (!name) return;
     cxml_string_free(&name->qname);
-    name->pname = name->lname = NULL;
     name->pname_len = name->lname_len = 0;
 }
 
@@ -151,6 +153,10 @@ void cxml_text_node_free(cxml_text_node *text) {
                  cxml_string_len(&text->value),
                  cxml_string_as_raw(&text->value));
     cxml_string_free(&text->value);
+    if (text->decoded){
+        cxml_string_free(text->decoded);
+        FREE(text->decoded);
+    }
     // don't free parent, it would be freed automatically when
     // freeing root/document node
     FREE(text);
@@ -181,6 +187,7 @@ void cxml_root_node_free(cxml_root_node* doc){
         FREE(doc->namespaces);
     }
     cxml_list_free(&doc->children);
+    cxml_index_free(doc->index);
     FREE(doc);
 }
 
@@ -405,6 +412,60 @@ void* _cxml_get_node_parent(void *node){
     }
 }
 
+/*
+ * Find the first predefined entity character (_CXML_PRED_ENTITY) in [start, end),
+ * or `end` if there's none.
+ * Text is scanned a word (8 bytes) at a time, so entity-free text is skipped quickly.
+ */
+const char *_cxml_find_pred_entity(const char *start, const char *end){
+    uint64_t w;
+    while (end - start >= 8){
+        w = _cxml_swar_load(start);
+        if (_cxml_swar_has_byte(w, '&') | _cxml_swar_has_byte(w, '<') | _cxml_swar_has_byte(w, '>')
+            | _cxml_swar_has_byte(w, '"') | _cxml_swar_has_byte(w, '\''))
+        {
+            break;
+        }
+        start += 8;
+    }
+    for (; start < end; start++){
+        switch (*start)
+        {
+            case '&': case '<': case '>': case '"': case '\'':
+                return start;
+            default:
+                break;
+        }
+    }
+    return end;
+}
+
+/*
+ * Obtain the number value of the text/attribute `node` (NULL for other node types).
+ * The number value is computed from the string value of the node on first use.
+ */
+cxml_number *_cxml_get_node_number(void *node){
+    cxml_number *num;
+    cxml_string *value;
+    switch (_cxml_node_type(node))
+    {
+        case CXML_TEXT_NODE:
+            num = &_unwrap_cxtext_node(node)->number_value;
+            value = &_unwrap_cxtext_node(node)->value;
+            break;
+        case CXML_ATTR_NODE:
+            num = &_unwrap_cxattr_node(node)->number_value;
+            value = &_unwrap_cxattr_node(node)->value;
+            break;
+        default:
+            return NULL;
+    }
+    if (num->type == CXML_NUMERIC_UNSET_T){
+        *num = _cxml_value_to_num(value);
+    }
+    return num;
+}
+
 void* _cxml_node_parent(void *node){
     switch (_cxml_node_type(node))
     {
@@ -471,6 +532,139 @@ void _cxml_unset_parent(void *node){
 }
 
 
+/*
+ * memory usage report
+ */
+static void _cxml_report__list(cxml_list *list, cxml_mem_report *report){
+    report->data_bytes += sizeof(struct _cxml_list__node) * (size_t)cxml_list_size(list);
+}
+
+static void _cxml_report__name(cxml_name *name, cxml_mem_report *report){
+    report->data_bytes += name->qname._cap;
+}
+
+static void _cxml_report__namespaces(cxml_list *namespaces, cxml_mem_report *report){
+    if (!namespaces) return;
+    report->data_bytes += sizeof(cxml_list);
+    _cxml_report__list(namespaces, report);
+    cxml_for_each(ns, namespaces)
+    {
+        report->nodes++;
+        report->node_bytes += sizeof(cxml_ns_node);
+        report->data_bytes += (_unwrap__cxnode(ns, ns)->prefix._cap
+                               + _unwrap__cxnode(ns, ns)->uri._cap);
+    }
+}
+
+static void _cxml_report__node(void *node, cxml_mem_report *report){
+    report->nodes++;
+    switch (_cxml_node_type(node))
+    {
+        case CXML_ROOT_NODE:
+        {
+            cxml_root_node *root = node;
+            report->node_bytes += sizeof(cxml_root_node);
+            report->data_bytes += root->name._cap;
+            _cxml_report__namespaces(root->namespaces, report);
+            _cxml_report__list(&root->children, report);
+            cxml_for_each(child, &root->children)
+            {
+                _cxml_report__node(child, report);
+            }
+            break;
+        }
+        case CXML_ELEM_NODE:
+        {
+            cxml_elem_node *elem = node;
+            report->node_bytes += sizeof(cxml_elem_node);
+            _cxml_report__name(&elem->name, report);
+            _cxml_report__namespaces(elem->namespaces, report);
+            if (elem->attributes){
+                cxml_attr_node *attr;
+                report->data_bytes += (sizeof(cxml_table)
+                                       + (sizeof(_cxml_ht_entry) + sizeof(int)) * (size_t)elem->attributes->capacity);
+                _cxml_report__list(&elem->attributes->keys, report);
+                cxml_table_for_each(entry, elem->attributes)
+                {
+                    attr = entry->value;
+                    report->nodes++;
+                    report->node_bytes += sizeof(cxml_attr_node);
+                    _cxml_report__name(&attr->name, report);
+                    report->data_bytes += attr->value._cap;
+                }
+            }
+            _cxml_report__list(&elem->children, report);
+            cxml_for_each(child, &elem->children)
+            {
+                _cxml_report__node(child, report);
+            }
+            break;
+        }
+        case CXML_TEXT_NODE:
+            report->node_bytes += sizeof(cxml_text_node);
+            report->data_bytes += _unwrap__cxnode(text, node)->value._cap;
+            if (_unwrap__cxnode(text, node)->decoded){
+                report->data_bytes += sizeof(cxml_string) + _unwrap__cxnode(text, node)->decoded->_cap;
+            }
+            break;
+        case CXML_COMM_NODE:
+            report->node_bytes += sizeof(cxml_comm_node);
+            report->data_bytes += _unwrap__cxnode(comm, node)->value._cap;
+            break;
+        case CXML_PI_NODE:
+            report->node_bytes += sizeof(cxml_pi_node);
+            report->data_bytes += (_unwrap__cxnode(pi, node)->target._cap
+                                   + _unwrap__cxnode(pi, node)->value._cap);
+            break;
+        case CXML_DTD_NODE:
+            report->node_bytes += sizeof(cxml_dtd_node);
+            report->data_bytes += _unwrap__cxnode(dtd, node)->value._cap;
+            break;
+        case CXML_XHDR_NODE:
+        {
+            cxml_table *attrs = &_unwrap__cxnode(xhdr, node)->attributes;
+            report->node_bytes += sizeof(cxml_xhdr_node);
+            report->data_bytes += (sizeof(_cxml_ht_entry) + sizeof(int)) * (size_t)attrs->capacity;
+            _cxml_report__list(&attrs->keys, report);
+            break;
+        }
+        default:
+            report->nodes--;
+            break;
+    }
+}
+
+/*
+ * Measure the memory held by `node` and all the nodes under it
+ * (attributes and namespaces inclusive).
+ * `node_bytes` counts the node structs, `data_bytes` counts everything the nodes
+ * point to (strings, child-list cells, attribute tables, namespace lists).
+ * Allocator overhead isn't accounted for.
+ */
+void cxml_memory_report(void *node, cxml_mem_report *report){
+    if (!report) return;
+    report->nodes = 0;
+    report->node_bytes = report->data_bytes = 0;
+    if (!node) return;
+    _cxml_report__node(node, report);
+}
+
+/*
+ * Print a memory usage report of `node` (see cxml_memory_report()),
+ * including the average number of bytes per node.
+ */
+void cxml_print_memory_report(void *node){
+    cxml_mem_report report;
+    cxml_memory_report(node, &report);
+    printf("nodes: %d\n"
+           "node bytes: %zu\n"
+           "data bytes: %zu\n"
+           "bytes per node: %.2f\n",
+           report.nodes, report.node_bytes, report.data_bytes,
+           report.nodes ? (double)(report.node_bytes + report.data_bytes) / report.nodes : 0.0);
+}
+
+
 /***
  * utility function definitions for unwrapping nodes
  * ***/
@@ -0,0 +1,309 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#include "core/cxfrozen.h"
+
+#define _id_cast            (void*)(intptr_t)
+#define _cast_id            (int)(intptr_t)
+
+struct _cxml_freezer{
+    cxml_frozen_doc *doc;
+    int node_c;
+    int attr_c;
+    int sym_cap;
+    cxml_table interned;    // source name -> (symbol id + 1)
+};
+
+/*
+ * count the nodes and attributes in the subtree of `node`
+ */
+static void _cxml_frozen__count(void *node, int *nodes, int *attrs){
+    (*nodes)++;
+    if (_cxml_node_type(node) == CXML_ELEM_NODE){
+        *attrs += cxml_table_size(_unwrap__cxnode(elem, node)->attributes);
+    }
+    if (_cxml_node_type(node) == CXML_ELEM_NODE || _cxml_node_type(node) == CXML_ROOT_NODE)
+    {
+        cxml_for_each(child, _cxml__get_node_children(node))
+        {
+            _cxml_frozen__count(child, nodes, attrs);
+        }
+    }
+}
+
+/*
+ * copy `len` bytes of `str` into the buffer (nul-terminated), returning its offset
+ */
+static int _cxml_frozen__store(cxml_frozen_doc *doc, const char *str, int len){
+    int off = _cxml_int_cast cxml_string_len(&doc->buffer);
+    cxml_string_append(&doc->buffer, str, len);
+    cxml_string_append(&doc->buffer, "", 1);
+    return off;
+}
+
+inline static int _cxml_frozen__store_str(cxml_frozen_doc *doc, cxml_string *str){
+    return _cxml_frozen__store(doc, cxml_string_as_raw(str), _cxml_int_cast cxml_string_len(str));
+}
+
+static int _cxml_frozen__intern(struct _cxml_freezer *fz, cxml_string *name){
+    if (!cxml_string_len(name)) return -1;
+    char *raw = cxml_string_as_raw(name);
+    void *id = cxml_table_get(&fz->interned, raw);
+    if (id) return _cast_id id - 1;
+    cxml_frozen_doc *doc = fz->doc;
+    if (doc->sym_size == fz->sym_cap){
+        fz->sym_cap = fz->sym_cap ? fz->sym_cap * 2 : 16;
+        doc->sym_off = RALLOC(int, doc->sym_off, fz->sym_cap);
+        doc->sym_len = RALLOC(int, doc->sym_len, fz->sym_cap);
+    }
+    int sym = doc->sym_size++;
+    doc->sym_len[sym] = _cxml_int_cast cxml_string_len(name);
+    doc->sym_off[sym] = _cxml_frozen__store(doc, raw, doc->sym_len[sym]);
+    cxml_table_put(&fz->interned, raw, _id_cast (sym + 1));
+    return sym;
+}
+
+static void _cxml_frozen__add(struct _cxml_freezer *fz, void *node, int parent){
+    cxml_frozen_doc *doc = fz->doc;
+    int i = fz->node_c++;
+    doc->kind[i] = (unsigned char)_cxml_node_type(node);
+    doc->name[i] = -1;
+    doc->ns[i] = -1;
+    doc->parent[i] = parent;
+    doc->first_child[i] = -1;
+    doc->next_sibling[i] = -1;
+    doc->value[i] = -1;
+    doc->value_len[i] = 0;
+    doc->attr_start[i] = fz->attr_c;
+    doc->attr_count[i] = 0;
+    cxml_string *value = NULL;
+    switch (_cxml_node_type(node))
+    {
+        case CXML_ELEM_NODE:
+        {
+            cxml_elem_node *elem = node;
+            doc->name[i] = _cxml_frozen__intern(fz, &elem->name.qname);
+            if (elem->namespace){
+                doc->ns[i] = _cxml_frozen__intern(fz, &elem->namespace->uri);
+            }
+            if (elem->attributes){
+                cxml_attr_node *attr;
+                cxml_for_each(key, &elem->attributes->keys)
+                {
+                    attr = cxml_table_get(elem->attributes, key);
+                    doc->attr_name[fz->attr_c] = _cxml_frozen__intern(fz, &attr->name.qname);
+                    doc->attr_value[fz->attr_c] = _cxml_frozen__store_str(doc, &attr->value);
+                    doc->attr_value_len[fz->attr_c] = _cxml_int_cast cxml_string_len(&attr->value);
+                    fz->attr_c++;
+                }
+                doc->attr_count[i] = fz->attr_c - doc->attr_start[i];
+            }
+            break;
+        }
+        case CXML_TEXT_NODE:
+            value = &_unwrap__cxnode(text, node)->value;
+            break;
+        case CXML_COMM_NODE:
+            value = &_unwrap__cxnode(comm, node)->value;
+            break;
+        case CXML_PI_NODE:
+            doc->name[i] = _cxml_frozen__intern(fz, &_unwrap__cxnode(pi, node)->target);
+            value = &_unwrap__cxnode(pi, node)->value;
+            break;
+        case CXML_DTD_NODE:
+            value = &_unwrap__cxnode(dtd, node)->value;
+            break;
+        default:
+            break;
+    }
+    if (value){
+        doc->value[i] = _cxml_frozen__store_str(doc, value);
+        doc->value_len[i] = _cxml_int_cast cxml_string_len(value);
+    }
+    if (_cxml_node_type(node) == CXML_ELEM_NODE || _cxml_node_type(node) == CXML_ROOT_NODE)
+    {
+        int prev = -1;
+        cxml_for_each(child, _cxml__get_node_children(node))
+        {
+            if (prev == -1){
+                doc->first_child[i] = fz->node_c;
+            }else{
+                doc->next_sibling[prev] = fz->node_c;
+            }
+            prev = fz->node_c;
+            _cxml_frozen__add(fz, child, i);
+        }
+    }
+    doc->end[i] = fz->node_c - 1;
+}
+
+/*
+ * Create a frozen (read-only) copy of the document `root`.
+ * `root` is left untouched, and can be freed once frozen.
+ */
+cxml_frozen_doc *cxml_freeze(cxml_root_node *root){
+    if (!root || root->_type != CXML_ROOT_NODE) return NULL;
+    int nodes = 0, attrs = 0;
+    _cxml_frozen__count(root, &nodes, &attrs);
+
+    cxml_frozen_doc *doc = CALLOC(cxml_frozen_doc, 1);
+    doc->size = nodes;
+    doc->kind = ALLOC(unsigned char, nodes);
+    doc->name = ALLOC(int, nodes);
+    doc->ns = ALLOC(int, nodes);
+    doc->parent = ALLOC(int, nodes);
+    doc->first_child = ALLOC(int, nodes);
+    doc->next_sibling = ALLOC(int, nodes);
+    doc->end = ALLOC(int, nodes);
+    doc->value = ALLOC(int, nodes);
+    doc->value_len = ALLOC(int, nodes);
+    doc->attr_start = ALLOC(int, nodes);
+    doc->attr_count = ALLOC(int, nodes);
+    doc->attr_size = attrs;
+    int attr_cap = attrs ? attrs : 1;
+    doc->attr_name = ALLOC(int, attr_cap);
+    doc->attr_value = ALLOC(int, attr_cap);
+    doc->attr_value_len = ALLOC(int, attr_cap);
+    cxml_string_init(&doc->buffer);
+    cxml_table_init(&doc->symbols);
+
+    struct _cxml_freezer fz = {.doc = doc, .node_c = 0, .attr_c = 0, .sym_cap = 0};
+    cxml_table_init(&fz.interned);
+    _cxml_frozen__add(&fz, root, -1);
+    cxml_table_free(&fz.interned);
+
+    // the buffer no longer grows, symbols can now be keyed by their copies in the buffer
+    char *buff = cxml_string_as_raw(&doc->buffer);
+    for (int i = 0; i < doc->sym_size; i++){
+        cxml_table_put(&doc->symbols, buff + doc->sym_off[i], _id_cast (i + 1));
+    }
+    return doc;
+}
+
+void cxml_frozen_free(cxml_frozen_doc *doc){
+    if (!doc) return;
+    FREE(doc->kind);
+    FREE(doc->name);
+    FREE(doc->ns);
+    FREE(doc->parent);
+    FREE(doc->first_child);
+    FREE(doc->next_sibling);
+    FREE(doc->end);
+    FREE(doc->value);
+    FREE(doc->value_len);
+    FREE(doc->attr_start);
+    FREE(doc->attr_count);
+    FREE(doc->attr_name);
+    FREE(doc->attr_value);
+    FREE(doc->attr_value_len);
+    FREE(doc->sym_off);
+    FREE(doc->sym_len);
+    cxml_table_free(&doc->symbols);
+    cxml_string_free(&doc->buffer);
+    FREE(doc);
+}
+
+/*
+ * Obtain the symbol of `name` (an element/attribute name or a namespace uri),
+ * or -1 if `name` doesn't occur in the document.
+ */
+int cxml_frozen_symbol(cxml_frozen_doc *doc, const char *name){
+    if (!doc || !name) return -1;
+    void *id = cxml_table_get(&doc->symbols, name);
+    return id ? _cast_id id - 1 : -1;
+}
+
+const char *cxml_frozen_symbol_name(cxml_frozen_doc *doc, int sym, int *len){
+    if (!doc || sym < 0 || sym >= doc->sym_size) return NULL;
+    if (len) *len = doc->sym_len[sym];
+    return doc->buffer._raw_chars + doc->sym_off[sym];
+}
+
+/*
+ * Obtain the name of the element/processing-instruction `node`
+ */
+const char *cxml_frozen_name(cxml_frozen_doc *doc, int node, int *len){
+    if (!doc || node < 0 || node >= doc->size) return NULL;
+    return cxml_frozen_symbol_name(doc, doc->name[node], len);
+}
+
+/*
+ * Obtain the value of the text/comment/processing-instruction/dtd `node`
+ */
+const char *cxml_frozen_value(cxml_frozen_doc *doc, int node, int *len){
+    if (!doc || node < 0 || node >= doc->size || doc->value[node] == -1) return NULL;
+    if (len) *len = doc->value_len[node];
+    return doc->buffer._raw_chars + doc->value[node];
+}
+
+/*
+ * Obtain the value of the attribute `name` of the element `node`
+ */
+const char *cxml_frozen_attribute(cxml_frozen_doc *doc, int node, const char *name, int *len){
+    if (!doc || node < 0 || node >= doc->size) return NULL;
+    int sym = cxml_frozen_symbol(doc, name);
+    if (sym == -1) return NULL;
+    for (int i = doc->attr_start[node], n = i + doc->attr_count[node]; i < n; i++){
+        if (doc->attr_name[i] == sym){
+            if (len) *len = doc->attr_value_len[i];
+            return doc->buffer._raw_chars + doc->attr_value[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Obtain the next element in document order after the node `after`, whose name is
+ * the symbol `sym`, and which is a descendant of the node `scope`. -1 if none.
+ * If `sym` is CXML_FROZEN_ANY_SYMBOL, any element matches, and if `sym` is -1 (the symbol
+ * of a name that doesn't occur in the document, see cxml_frozen_symbol()), none does.
+ *
+ * All matching descendants of `scope` can be visited with:
+ *  for (int n = cxml_frozen_next_element(doc, scope, sym, scope); n != -1;
+ *       n = cxml_frozen_next_element(doc, scope, sym, n)){...}
+ */
+int cxml_frozen_next_element(cxml_frozen_doc *doc, int scope, int sym, int after){
+    if (!doc || scope < 0 || scope >= doc->size || after < scope || sym == -1) return -1;
+    for (int i = after + 1, end = doc->end[scope]; i <= end; i++){
+        if (doc->kind[i] == CXML_ELEM_NODE && (sym == CXML_FROZEN_ANY_SYMBOL || doc->name[i] == sym)){
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Obtain the string value (concatenation of all descendant texts) of `node`
+ */
+void cxml_frozen_text(cxml_frozen_doc *doc, int node, cxml_string *acc){
+    if (!doc || !acc || node < 0 || node >= doc->size) return;
+    for (int i = node, end = doc->end[node]; i <= end; i++){
+        if (doc->kind[i] == CXML_TEXT_NODE){
+            cxml_string_append(acc, doc->buffer._raw_chars + doc->value[i], doc->value_len[i]);
+        }
+    }
+}
+
+void cxml_frozen_set_init(cxml_frozen_set *set){
+    if (!set) return;
+    set->size = 0;
+    set->capacity = 0;
+    set->nodes = NULL;
+}
+
+void cxml_frozen_set_add(cxml_frozen_set *set, int node){
+    if (!set) return;
+    if (set->size == set->capacity){
+        set->capacity = set->capacity ? set->capacity * 2 : 16;
+        set->nodes = RALLOC(int, set->nodes, set->capacity);
+    }
+    set->nodes[set->size++] = node;
+}
+
+void cxml_frozen_set_free(cxml_frozen_set *set){
+    if (!set) return;
+    FREE(set->nodes);
+    cxml_frozen_set_init(set);
+}
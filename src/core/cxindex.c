@@ -0,0 +1,162 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#include "core/cxindex.h"
+
+#define _CXML_INDEX_INIT_CAP    (32)
+
+inline static bool _has_pos(void *node){
+    // xml header and dtd nodes have no `pos` field
+    return (_cxml_node_type(node) != CXML_XHDR_NODE
+            && _cxml_node_type(node) != CXML_DTD_NODE);
+}
+
+static void _cxml_index__grow(cxml_node_index *index){
+    index->capacity = index->capacity ? index->capacity * 2 : _CXML_INDEX_INIT_CAP;
+    index->nodes = RALLOC(void*, index->nodes, index->capacity);
+    index->end = RALLOC(int, index->end, index->capacity);
+    index->parent = RALLOC(int, index->parent, index->capacity);
+    index->pos = RALLOC(unsigned int, index->pos, index->capacity);
+}
+
+/*
+ * lay out `node` and its subtree in pre-order.
+ * `ordered` is unset when the `pos` fields of the nodes aren't strictly increasing
+ * in document order (e.g. after the document has been modified).
+ */
+static void _cxml_index__add(
+        cxml_node_index *index,
+        void *node,
+        int parent,
+        unsigned int *last_pos,
+        bool *ordered)
+{
+    if (index->size == index->capacity){
+        _cxml_index__grow(index);
+    }
+    int i = index->size++;
+    index->nodes[i] = node;
+    index->parent[i] = parent;
+    if (_has_pos(node)){
+        unsigned int pos = _cxml_get_node_pos(node);
+        if (pos <= *last_pos) *ordered = false;
+        *last_pos = pos;
+    }
+    // nodes without a `pos` field take the `pos` of the preceding node,
+    // keeping the `pos` array non-decreasing.
+    index->pos[i] = *last_pos;
+    if (_cxml_node_type(node) == CXML_ELEM_NODE || _cxml_node_type(node) == CXML_ROOT_NODE)
+    {
+        cxml_for_each(child, _cxml__get_node_children(node))
+        {
+            _cxml_index__add(index, child, i, last_pos, ordered);
+        }
+    }
+    index->end[i] = index->size - 1;
+}
+
+static int _cxml_index__cmp_entries(const void *a, const void *b){
+    uintptr_t x = (uintptr_t)((const struct _cxml_index_entry *)a)->node;
+    uintptr_t y = (uintptr_t)((const struct _cxml_index_entry *)b)->node;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Build the pre-order node index of the document `root`, if not already built.
+ * The index is owned by `root`, and is discarded whenever the structure of the
+ * document is modified through the query api, or when `root` is freed.
+ */
+cxml_node_index *cxml_index_document(cxml_root_node *root){
+    if (!root || root->_type != CXML_ROOT_NODE) return NULL;
+    if (root->index) return root->index;
+    cxml_node_index *index = CALLOC(cxml_node_index, 1);
+    unsigned int last_pos = 0;
+    bool ordered = true;
+    _cxml_index__add(index, root, -1, &last_pos, &ordered);
+    if (!ordered){
+        // node positions are out of document order, and can't locate nodes:
+        // locate them by address instead (leaving their positions as they are)
+        index->by_node = ALLOC(struct _cxml_index_entry, index->size);
+        for (int i = 0; i < index->size; i++){
+            index->by_node[i].node = index->nodes[i];
+            index->by_node[i].i = i;
+        }
+        qsort(index->by_node, (size_t)index->size, sizeof(struct _cxml_index_entry), _cxml_index__cmp_entries);
+    }
+    root->index = index;
+    return index;
+}
+
+void cxml_index_free(cxml_node_index *index){
+    if (!index) return;
+    FREE(index->nodes);
+    FREE(index->end);
+    FREE(index->parent);
+    FREE(index->pos);
+    FREE(index->by_node);
+    FREE(index);
+}
+
+/*
+ * Obtain the pre-order index of `node` in `index`, or -1 if `node` isn't indexed.
+ * (attribute, namespace, xml header and dtd nodes are never found).
+ */
+int cxml_index_find(cxml_node_index *index, void *node){
+    if (!index || !node || !_has_pos(node)) return -1;
+    if (index->by_node){
+        struct _cxml_index_entry key = {.node = node};
+        struct _cxml_index_entry *entry = bsearch(&key, index->by_node, (size_t)index->size,
+                                                  sizeof(struct _cxml_index_entry), _cxml_index__cmp_entries);
+        return entry ? entry->i : -1;
+    }
+    unsigned int pos = _cxml_get_node_pos(node);
+    int lo = 0, hi = index->size, mid;
+    // lower bound of `pos`
+    while (lo < hi){
+        mid = lo + ((hi - lo) >> 1);
+        if (index->pos[mid] < pos){
+            lo = mid + 1;
+        }else{
+            hi = mid;
+        }
+    }
+    for (; lo < index->size && index->pos[lo] == pos; lo++){
+        if (index->nodes[lo] == node) return lo;
+    }
+    return -1;
+}
+
+/*
+ * Check if the node at pre-order index `ancestor` is a proper ancestor of
+ * the node at pre-order index `node`.
+ */
+bool cxml_index_is_ancestor(cxml_node_index *index, int ancestor, int node){
+    if (!index || ancestor < 0 || node >= index->size) return false;
+    return ancestor < node && node <= index->end[ancestor];
+}
+
+/*
+ * Obtain the node index of the document `node` belongs to, if available.
+ */
+cxml_node_index *_cxml_index_get(void *node){
+    while (node && _cxml_node_type(node) != CXML_ROOT_NODE){
+        node = _cxml_node_parent(node);
+    }
+    return node ? _unwrap__cxnode(root, node)->index : NULL;
+}
+
+/*
+ * Discard the node index of the document `node` belongs to, if available.
+ * Must be called whenever the structure of a document changes.
+ */
+void _cxml_index_invalidate(void *node){
+    while (node && _cxml_node_type(node) != CXML_ROOT_NODE){
+        node = _cxml_node_parent(node);
+    }
+    if (node && _unwrap__cxnode(root, node)->index){
+        cxml_index_free(_unwrap__cxnode(root, node)->index);
+        _unwrap__cxnode(root, node)->index = NULL;
+    }
+}
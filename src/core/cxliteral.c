@@ -12,6 +12,19 @@
 #define _cxml_number__lt(a, b)  ((b)-(a) > (fmax(fabs((a)), fabs((b))) * DBL_EPSILON))
 #define _cxml_number__ne(a, b)  (!_cxml_number__eq(a, b))
 
+// largest integer n such that every integer in [0, n] is exactly representable as a double
+#define _CXML_MAX_EXACT_INT     (1ULL << 53)
+// maximum number of significant decimal digits held in the mantissa
+#define _CXML_MAX_SIG_DIGITS    (19)
+// exponent saturation limit (far outside the range of a double)
+#define _CXML_MAX_EXP           (100000)
+
+// powers of ten exactly representable as a double
+static const double _cxml_pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
 #define __init_number(_num)                \
     (_num)->type = CXML_NUMERIC_NAN_T;     \
     (_num)->dec_val = 0;
@@ -28,6 +41,117 @@ cxml_number new_cxml_number(){
     return literal;
 }
 
+inline static int _cxml_hex_val(char ch){
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    return (tolower((unsigned char)ch) - 'a') + 10;
+}
+
+/*
+ * slow path: convert `digits` (decimal digits without a decimal point) scaled by 10^`exp`.
+ * The decimal point is never handed to strtod(), so the conversion isn't affected by the
+ * current locale.
+ */
+static double _cxml_literal_slow_d(const char *start, const char *end, int exp){
+    char buff[64], *str = buff;
+    size_t len = (end - start) + 16;
+    if (len > sizeof(buff)) str = ALLOC(char, len);
+    char *p = str;
+    for (const char *q = start; q < end; q++){
+        if (*q != '.') *p++ = *q;
+    }
+    sprintf(p, "e%d", exp);
+    double val = strtod(str, NULL);
+    if (str != buff) FREE(str);
+    return val;
+}
+
+/*
+ * Scan the longest numeric literal prefix of [start, end) (after an optional sign),
+ * storing its value in `val`.
+ * Returns a pointer past the last character scanned, or `start` if no number was found.
+ *
+ * Hexadecimal integers (0x..) and decimals are supported, decimals are converted
+ * exactly from the mantissa and a table of powers of ten whenever both are exactly
+ * representable as doubles (i.e. most numbers found in documents), and through strtod()
+ * otherwise. The conversion is locale-independent.
+ */
+static const char *_cxml_literal_scan(const char *start, const char *end, double *val){
+    const char *p = start;
+    bool neg = false;
+    *val = 0;
+    if (p < end && (*p == '+' || *p == '-')) neg = (*p++ == '-');
+
+    // HexStart HexDigit+
+    if (end - p > 2 && *p == '0' && tolower((unsigned char)p[1]) == 'x'
+        && isxdigit((unsigned char)p[2]))
+    {
+        double hex = 0;
+        for (p += 2; p < end && isxdigit((unsigned char)*p); p++){
+            hex = hex * 16 + _cxml_hex_val(*p);
+        }
+        *val = neg ? -hex : hex;
+        return p;
+    }
+
+    // Digit* (DecimalPoint Digit*)? Exp?
+    const char *digits = p;
+    unsigned long long mant = 0;
+    int sig = 0, n_digits = 0, exp = 0, frac = 0;
+    bool exact = true;
+    for (; p < end && isdigit((unsigned char)*p); p++, n_digits++){
+        if (!mant && *p == '0') continue;
+        if (sig < _CXML_MAX_SIG_DIGITS){
+            mant = mant * 10 + (*p - '0');
+            sig++;
+        }else{
+            exp++;
+            if (*p != '0') exact = false;
+        }
+    }
+    if (p < end && *p == '.'){
+        for (p++; p < end && isdigit((unsigned char)*p); p++, n_digits++){
+            frac++;
+            if (sig < _CXML_MAX_SIG_DIGITS){
+                if (mant || *p != '0'){
+                    mant = mant * 10 + (*p - '0');
+                    sig++;
+                }
+                exp--;
+            }else if (*p != '0'){
+                exact = false;
+            }
+        }
+    }
+    if (!n_digits) return start;
+    const char *digits_end = p;
+
+    if (p < end && (*p == 'e' || *p == 'E')){
+        const char *q = p + 1;
+        bool exp_neg = false;
+        int e = 0;
+        if (q < end && (*q == '+' || *q == '-')) exp_neg = (*q++ == '-');
+        if (q < end && isdigit((unsigned char)*q)){
+            for (; q < end && isdigit((unsigned char)*q); q++){
+                if (e < _CXML_MAX_EXP) e = e * 10 + (*q - '0');
+            }
+            exp += exp_neg ? -e : e;
+            frac += exp_neg ? e : -e;
+            p = q;
+        }
+    }
+
+    double d;
+    if (!mant){
+        d = 0;
+    }else if (exact && mant <= _CXML_MAX_EXACT_INT && exp >= -22 && exp <= 22){
+        d = exp < 0 ? (double)mant / _cxml_pow10[-exp] : (double)mant * _cxml_pow10[exp];
+    }else{
+        d = _cxml_literal_slow_d(digits, digits_end, -frac);
+    }
+    *val = neg ? -d : d;
+    return p;
+}
+
 static long _cxml_literal_r2l(const char *str, int base){
     char* endptr;
     return strtol(str, &endptr, base);
@@ -59,9 +183,15 @@ cxml_set_literal(cxml_number* literal, cxml_literal_t literal_type, cxml_string
             break;
         case CXML_INTEGER_LITERAL:
         case CXML_DOUBLE_LITERAL:
+        {
+            const char *start = cxml_string_as_raw(str);
+            if (!start) break;
+            const char *end = start + cxml_string_len(str);
+            while (start < end && isspace((unsigned char)*start)) start++;
             literal->type = CXML_NUMERIC_DOUBLE_T;
-            literal->dec_val = cxml_literal_to_double(str);
+            _cxml_literal_scan(start, end, &literal->dec_val);
             break;
+        }
         default:
             break;
     }
@@ -206,20 +336,22 @@ int _cxml_is_double(const char *current, int _len) {
     return 0;
 }
 
-static cxml_number cxml_literal_raw_to_num(const char *str, int len){
+static cxml_number cxml_literal_raw_to_num(const char *str, int len, bool strip_quotes){
     cxml_number num = new_cxml_number();
-    const char* start = str;
-    int ret;
-    if ((ret = _cxml_is_integer(start, len))){
-        num.type = CXML_NUMERIC_DOUBLE_T;
-        if (ret == 1){
-            num.dec_val = _cxml_literal_r2d(start);
-        }else{
-            num.dec_val = (double)_cxml_literal_r2l(start, 16);
-        }
-    }else if (_cxml_is_double(start, len)){
+    if (len <= 0) return num;
+    const char *start = str, *end = str + len - 1;
+    if (strip_quotes){
+        _cxml_clean_string(&start, &end);
+    }else{
+        while (start < end && isspace((unsigned char)*start)) start++;
+        while (end > start && isspace((unsigned char)*end)) end--;
+    }
+    // the number is valid only if the entire (cleaned) string is scanned
+    double val;
+    const char *stop = _cxml_literal_scan(start, end + 1, &val);
+    if (stop != start && stop == end + 1){
         num.type = CXML_NUMERIC_DOUBLE_T;
-        num.dec_val = _cxml_literal_r2d(start);
+        num.dec_val = val;
     }
     return num;
 }
@@ -227,7 +359,17 @@ static cxml_number cxml_literal_raw_to_num(const char *str, int len){
 cxml_number cxml_literal_to_num(cxml_string *str){
     const char* start = cxml_string_as_raw(str);
     if (!start) return new_cxml_number();
-    return cxml_literal_raw_to_num(start, (int)cxml_string_len(str));
+    return cxml_literal_raw_to_num(start, (int)cxml_string_len(str), true);
+}
+
+/*
+ * Obtain the number value of the string value of a text/attribute node.
+ * Unlike cxml_literal_to_num(), quoted numbers aren't numbers.
+ */
+cxml_number _cxml_value_to_num(cxml_string *str){
+    const char* start = cxml_string_as_raw(str);
+    if (!start) return new_cxml_number();
+    return cxml_literal_raw_to_num(start, (int)cxml_string_len(str), false);
 }
 
 bool cxml_number_is_d_equal(double a, double b){
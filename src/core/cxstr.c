@@ -389,13 +389,14 @@ const char*  cxml_string_mb_strstr(cxml_string* str, const char* sub_str){
 
 static const char*  _cxstr_mb_strstr(cxml_string* str, const char* sub_str, int* index){
     if (!str || !sub_str) return NULL;
-    char* s = str->_raw_chars;
     int i = 0, j = 0, k;
     if (!index) index = &k;
     *index = 0;
     size_t len =  strlen(sub_str);
     if (len == 0) return sub_str;  // catch empty substring checks ""
     if (len > str->_len) return NULL;
+    // u8_strchr() expects a nul-terminated string
+    char* s = cxml_string_as_raw(str);
     uint32_t tmp = u8_nextchar(sub_str, &i);
     char* i_ptr;
     while ((i_ptr = u8_strchr(s, tmp, &i)) != NULL){
@@ -423,5 +424,5 @@ int  cxml_string_mb_index(cxml_string* str, uint32_t ch){
 
 int cxml_string_mb_len(cxml_string* str){
     if (!str) return 0;
-    return u8_strlen(cxml_string_as_raw(str));
+    return (int)u8_count(str->_raw_chars, str->_len);
 }
@@ -12,6 +12,7 @@
     (__table)->count = 0;                   \
     (__table)->capacity = 0;                \
     (__table)->entries = NULL;              \
+    (__table)->order = NULL;                \
     cxml_list__init(&(__table)->keys);
 
 extern void cxml_list__init(cxml_list *list);
@@ -59,13 +60,16 @@ inline static uint32_t _cxml_table_hash(const char *key) {
     return hash;
 }
 
-static int _cxml_table_find_entry_index(
+uint32_t cxml_table_hash(const char *key){
+    return _cxml_table_hash(key);
+}
+
+static int _cxml_table_find_hashed_entry_index(
         cxml_table* table,
         const void* key,
+        uint32_t hash,
         const _cxml_table_hash_t hash_type)
 {
-    uint32_t hash = hash_type == CXML_TABLE_HASH_STRING ?
-                    _cxml_table_hash(key) : _cxml__ptr_hash(key);
     int deleted = -1, index = (int) (hash & (table->capacity - 1));
     _cxml_ht_entry *entry;
     while (true){
@@ -94,8 +98,17 @@ static int _cxml_table_find_entry_index(
     }
 }
 
+inline static int _cxml_table_find_entry_index(
+        cxml_table* table,
+        const void* key,
+        const _cxml_table_hash_t hash_type)
+{
+    uint32_t hash = hash_type == CXML_TABLE_HASH_STRING ?
+                    _cxml_table_hash(key) : _cxml__ptr_hash(key);
+    return _cxml_table_find_hashed_entry_index(table, key, hash, hash_type);
+}
+
 static void _cxml_table_rehash(cxml_table *table, _cxml_table_hash_t hash_type) {
-    int old_capacity = table->capacity;  /*old capacity*/
     _cxml_ht_entry *old_entries = table->entries;
     int new_capacity;
     // reuse existing capacity if actual table count/usage is less than or equal to
@@ -109,16 +122,20 @@ static void _cxml_table_rehash(cxml_table *table, _cxml_table_hash_t hash_type)
     }
     table->capacity = new_capacity;
     table->entries = CALLOC(_cxml_ht_entry, new_capacity);
+    table->order = RALLOC(int, table->order, new_capacity);
 
     if (table->count) {  // does the table contain any entry yet?
         _cxml_ht_entry *entry;
+        int index;
         table->count = 0;  // set count to 0 to prevent insertion compromise
-        for (int i = 0; i < old_capacity; i++)
+        // re-insert the entries in insertion order, keeping track of their new index
+        for (int i = 0; i < table->keys.len; i++)
         {
-            entry = &old_entries[i];
-            if (entry->key != NULL) {
-                _cxml_table__put(table, entry->key, entry->value, false, hash_type);
-            }
+            entry = &old_entries[table->order[i]];
+            index = _cxml_table_find_entry_index(table, entry->key, hash_type);
+            table->entries[index] = *entry;
+            table->order[i] = index;
+            table->count++;
         }
         FREE(old_entries);
     }
@@ -142,7 +159,10 @@ int _cxml_table__put(
         table->entries[index].key = key;
         table->entries[index].value = value;
         // key shouldn't be ordered (added to the list) if it is already present.
-        order_key ? cxml_list_append(&table->keys, (void*)key) : (void)0;
+        if (order_key){
+            table->order[table->keys.len] = index;
+            cxml_list_append(&table->keys, (void*)key);
+        }
         // increment only if it's a new/unused entry
         is_unused_entry ? table->count++ : 0;
         return 1;
@@ -186,6 +206,19 @@ void* cxml_table_get(cxml_table *table, const char *key){
     return NULL;
 }
 
+/*
+ * Same as cxml_table_get(), with the `hash` of `key` (from cxml_table_hash())
+ * computed beforehand, when the same key is looked up in many tables.
+ */
+void* cxml_table_get_hashed(cxml_table *table, const char *key, uint32_t hash){
+    if (table == NULL || key == NULL || cxml_table_is_empty(table)) return NULL;
+    int index = _cxml_table_find_hashed_entry_index(table, key, hash, CXML_TABLE_HASH_STRING);
+    if (table->entries[index].key != NULL){
+        return table->entries[index].value;
+    }
+    return NULL;
+}
+
 void* cxml_table_get_raw(cxml_table *table, const void *key){
     if (table == NULL || key == NULL || cxml_table_is_empty(table)) return NULL;
     int index = _cxml_table_find_entry_index(table, key, CXML_TABLE_HASH_RAW_PTR);
@@ -205,6 +238,13 @@ inline static void _cxml_table__remove(
         // only "nullify" the key, leave the value field, this
         // indicates a tombstone or deleted entry.
         table->entries[index].key = NULL;
+        for (int i = 0; i < table->keys.len; i++){
+            if (table->order[i] == index){
+                memmove(table->order + i, table->order + i + 1,
+                        sizeof(int) * (size_t)(table->keys.len - i - 1));
+                break;
+            }
+        }
         cxml_list_search_delete(&table->keys,
                                 hash_type == CXML_TABLE_HASH_STRING
                                    ? cxml_list_cmp_str_items
@@ -239,6 +279,7 @@ int cxml_table_size(cxml_table *table){
 void cxml_table_free(cxml_table *table) {
     if (table->capacity > 0) {
         FREE(table->entries);
+        FREE(table->order);
     }
     cxml_list_free(&table->keys);
     __init_table(table)
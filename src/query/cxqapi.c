@@ -4,6 +4,8 @@
  */
 
 #include "query/cxqapi.h"
+#include "core/cxindex.h"
+#include "core/cxbudget.h"
 
 
 /********************************
@@ -84,20 +86,15 @@ inline static void _stringify(
 }
 
 /*
- * Find the comment node whose string value matches `value`
- * `match_specific` if true, ensures exact matches, and if false
- * ensures partial matches.
+ * Find the comment node whose string value matches the comment of `matcher`,
+ * exactly or partially (as specified by the matcher's flags).
  */
-static cxml_comm_node *_find_matching_comment(
-        cxml_elem_node *elem,
-        cxml_string *value,
-        bool match_specific)
-{
-    if (match_specific){
+static cxml_comm_node *_find_matching_comment(cxml_elem_node *elem, _cxml_q_matcher *matcher){
+    if (matcher->flags & _CXQ_MATCH_EXACT){
         cxml_for_each(child, &elem->children)
         {
             if ((*(_cxml_node_t *)(child) == CXML_COMM_NODE)
-                && cxml_string_equals(&_unwrap_cxnode(cxml_comm_node, child)->value, value))
+                && cxml_string_equals(&_unwrap_cxnode(cxml_comm_node, child)->value, matcher->value))
             {
                 return child;
             }
@@ -106,7 +103,7 @@ static cxml_comm_node *_find_matching_comment(
         cxml_for_each(child, &elem->children)
         {
             if ((*(_cxml_node_t *)(child) == CXML_COMM_NODE)
-                && cxml_string_contains(&_unwrap_cxnode(cxml_comm_node, child)->value, value))
+                && cxq_matcher_contains(matcher, &_unwrap_cxnode(cxml_comm_node, child)->value))
             {
                 return child;
             }
@@ -116,19 +113,14 @@ static cxml_comm_node *_find_matching_comment(
 }
 
 /*
- * Find the text node whose string value matches `value`
- * `match_specific` if true, ensures exact matches, and if false
- * ensures partial matches.
+ * Find the text node whose string value matches the text of `matcher`,
+ * exactly or partially (as specified by the matcher's flags).
  */
-static cxml_text_node* _find_matching_text(
-        cxml_elem_node *elem,
-        cxml_string *value,
-        bool match_specific)
-{
-    if (match_specific){
+static cxml_text_node* _find_matching_text(cxml_elem_node *elem, _cxml_q_matcher *matcher){
+    if (matcher->flags & _CXQ_MATCH_EXACT){
         cxml_for_each(child, &elem->children){
             if ((_cxml_node_type(child) == CXML_TEXT_NODE)
-                && cxml_string_equals(&_unwrap_cxnode(cxml_text_node, child)->value, value))
+                && cxml_string_equals(&_unwrap_cxnode(cxml_text_node, child)->value, matcher->value))
             {
                 return child;
             }
@@ -136,7 +128,7 @@ static cxml_text_node* _find_matching_text(
     }else{
         cxml_for_each(child, &elem->children){
             if ((_cxml_node_type(child) == CXML_TEXT_NODE)
-                && cxml_string_contains(&_unwrap_cxnode(cxml_text_node, child)->value, value))
+                && cxq_matcher_contains(matcher, &_unwrap_cxnode(cxml_text_node, child)->value))
             {
                 return child;
             }
@@ -146,183 +138,60 @@ static cxml_text_node* _find_matching_text(
 }
 
 /*
- * Determine if `element` satisfies all rigid query sub-expressions in the
- * _cxml_query object's `q_r_list` (rigid query list) of query expressions
+ * Determine if `element` satisfies the (compiled) query sub-expression `matcher`
  */
-static bool _elem_matches_rigid_query(cxml_elem_node *element, _cxml_query *q_obj){
-    int match_count = 0;
+static bool _elem_matches_sub_query(cxml_elem_node *element, _cxml_q_matcher *matcher){
     cxml_attr_node *attr;
-    cxml_for_each(expr, &q_obj->q_r_list)
+    switch (matcher->kind)
     {
-        if (((_cxml_q*)expr)->q_attr)
-        {
-            if (((_cxml_q *) expr)->q_attr->flags & _CXQ_MATCH_KEY_ONLY){
-                if (cxml_table_get(
-                        element->attributes,
-                        cxml_string_as_raw(((_cxml_q *) expr)->q_attr->key)))
-                {
-                    match_count++;
-                } else {
-                    return NULL;
-                }
-            }
-            else if ((attr = cxml_table_get(
-                    element->attributes,
-                    cxml_string_as_raw(((_cxml_q *) expr)->q_attr->key))))
-            {
-                if ((((_cxml_q*)expr)->q_attr->flags & _CXQ_MATCH_EXACT)
-                    && (cxml_string_equals(&attr->value, ((_cxml_q *) expr)->q_attr->value)))
-                {
-                    match_count++;
-                }
-                else if ((((_cxml_q*)expr)->q_attr->flags & _CXQ_MATCH_PARTIAL)
-                         && (cxml_string_contains(&attr->value, ((_cxml_q *) expr)->q_attr->value)))
-                {
-                    match_count++;
-                }
-                else {
-                    return NULL;
-                }
-            }
-        }
-        else if (((_cxml_q*)expr)->q_text)
-        {
-            if (((_cxml_q*)expr)->q_text->flags & _CXQ_MATCH_ANY){
-                if (element->has_text) match_count++; else return NULL;
-            }
-            else if (((_cxml_q*)expr)->q_text->flags & _CXQ_MATCH_EXACT){
-                if (_find_matching_text(
-                        element,
-                        ((_cxml_q *) expr)->q_text->text,
-                        true))
-                {
-                    match_count++;
-                }else{
-                    return NULL;
-                }
+        case _CXQ_MATCHER_ATTR:
+            attr = cxml_table_get_hashed(element->attributes, matcher->key, matcher->hash);
+            if (!attr) return false;
+            if (matcher->flags & _CXQ_MATCH_KEY_ONLY) return true;
+            if (matcher->flags & _CXQ_MATCH_EXACT){
+                return cxml_string_equals(&attr->value, matcher->value);
             }
-            else if (((_cxml_q*)expr)->q_text->flags & _CXQ_MATCH_PARTIAL){
-                if (_find_matching_text(
-                        element,
-                        ((_cxml_q *) expr)->q_text->text,
-                        false))
-                {
-                    match_count++;
-                } else{
-                    return NULL;
-                }
+            if (matcher->flags & _CXQ_MATCH_PARTIAL){
+                return cxq_matcher_contains(matcher, &attr->value);
             }
-        }
-        else if (((_cxml_q*)expr)->q_comm)
-        {
-            if (((_cxml_q*)expr)->q_comm->flags & _CXQ_MATCH_ANY){
-                if (element->has_comment) match_count++; else return NULL;
-            }
-            else if (((_cxml_q*)expr)->q_comm->flags & _CXQ_MATCH_EXACT){
-                if (_find_matching_comment(
-                        element,
-                        ((_cxml_q *) expr)->q_comm->comment,
-                        true))
-                {
-                    match_count++;
-                }else{
-                    return NULL;
-                }
+            return false;
+        case _CXQ_MATCHER_TEXT:
+            if (matcher->flags & _CXQ_MATCH_ANY) return element->has_text;
+            if (matcher->flags & (_CXQ_MATCH_EXACT | _CXQ_MATCH_PARTIAL)){
+                return _find_matching_text(element, matcher) != NULL;
             }
-            else if (((_cxml_q*)expr)->q_comm->flags & _CXQ_MATCH_PARTIAL){
-                if (_find_matching_comment(
-                        element,
-                        ((_cxml_q *) expr)->q_comm->comment,
-                        false))
-                {
-                    match_count++;
-                }else{
-                    return NULL;
-                }
+            return false;
+        case _CXQ_MATCHER_COMM:
+            if (matcher->flags & _CXQ_MATCH_ANY) return element->has_comment;
+            if (matcher->flags & (_CXQ_MATCH_EXACT | _CXQ_MATCH_PARTIAL)){
+                return _find_matching_comment(element, matcher) != NULL;
             }
-        }
+            return false;
+        default:
+            return false;
+    }
+}
+
+/*
+ * Determine if `element` satisfies all rigid query sub-expressions in the
+ * _cxml_query object's `q_r_list` (rigid query list) of query expressions
+ * (tried cheapest first, see cxq_parse_query())
+ */
+static bool _elem_matches_rigid_query(cxml_elem_node *element, _cxml_query *q_obj){
+    for (int i = 0; i < cxml_list_size(&q_obj->q_r_list); i++){
+        if (!_elem_matches_sub_query(element, &q_obj->q_r_matchers[i])) return false;
     }
-    return (match_count == cxml_list_size(&q_obj->q_r_list));
+    return true;
 }
 
 /*
  * Determine if `element` satisfies at lease one optional query sub-expression in the
  * _cxml_query object's `q_o_list` (optional query list) of query expressions
+ * (tried cheapest first, see cxq_parse_query())
  */
-static bool _elem_matches_optional_query(void *child, _cxml_query *q_obj){
-    cxml_attr_node *attr;
-    cxml_for_each(expr, &q_obj->q_o_list)
-    {
-        // match by attribute
-        if (((_cxml_q*)expr)->q_attr)
-        {
-            if (((_cxml_q*)expr)->q_attr->flags & _CXQ_MATCH_KEY_ONLY)
-            {
-                if (cxml_table_get(_unwrap__cxnode(elem, child)->attributes,
-                                   cxml_string_as_raw(((_cxml_q *) expr)->q_attr->key)))
-                {
-                    return true;
-                }
-            }
-            else if ((attr = cxml_table_get(_unwrap__cxnode(elem, child)->attributes,
-                                           cxml_string_as_raw(((_cxml_q *) expr)->q_attr->key))))
-            {
-                if ((((_cxml_q*)expr)->q_attr->flags & _CXQ_MATCH_EXACT)
-                    && (cxml_string_equals(&attr->value, ((_cxml_q *) expr)->q_attr->value)))
-                {
-                    return true;
-                }
-                else if ((((_cxml_q*)expr)->q_attr->flags & _CXQ_MATCH_PARTIAL)
-                         && (cxml_string_contains(&attr->value, ((_cxml_q *) expr)->q_attr->value)))
-                {
-                    return true;
-                }
-            }
-        }
-        // match by text
-        else if (((_cxml_q*)expr)->q_text)
-        {
-            if (((_cxml_q*)expr)->q_text->flags & _CXQ_MATCH_ANY)
-            {
-                if (_unwrap__cxnode(elem, child)->has_text) return child;
-            }
-            else if (((_cxml_q*)expr)->q_text->flags & _CXQ_MATCH_EXACT)
-            {
-                if (_find_matching_text(child, ((_cxml_q *) expr)->q_text->text, true))
-                {
-                    return true;
-                }
-            }
-            else if (((_cxml_q*)expr)->q_text->flags & _CXQ_MATCH_PARTIAL)
-            {
-                if (_find_matching_text(child, ((_cxml_q *) expr)->q_text->text, false))
-                {
-                    return true;
-                }
-            }
-        }
-        // match by comment
-        else if (((_cxml_q*)expr)->q_comm)
-        {
-            if (((_cxml_q*)expr)->q_comm->flags & _CXQ_MATCH_ANY)
-            {
-                if (_unwrap__cxnode(elem, child)->has_comment) return child;
-            }
-            else if (((_cxml_q*)expr)->q_comm->flags & _CXQ_MATCH_EXACT)
-            {
-                if (_find_matching_comment(child, ((_cxml_q *) expr)->q_comm->comment, true))
-                {
-                    return true;
-                }
-            }
-            else if (((_cxml_q*)expr)->q_comm->flags & _CXQ_MATCH_PARTIAL)
-            {
-                if (_find_matching_comment(child, ((_cxml_q *) expr)->q_comm->comment, false))
-                {
-                    return true;
-                }
-            }
-        }
+static bool _elem_matches_optional_query(cxml_elem_node *element, _cxml_query *q_obj){
+    for (int i = 0; i < cxml_list_size(&q_obj->q_o_list); i++){
+        if (_elem_matches_sub_query(element, &q_obj->q_o_matchers[i])) return true;
     }
     return false;
 }
@@ -390,6 +259,24 @@ inline static void _descendants(cxml_list *nodes, cxml_list *acc){
     }
 }
 
+/*
+ * Obtain the descendants of `node` (an element or root node).
+ * When the document `node` belongs to is indexed (see cxml_index_document()),
+ * the descendants are read off the index as a contiguous range, instead of
+ * walking the `children` lists.
+ */
+inline static void _node_descendants(void *node, cxml_list *acc){
+    cxml_node_index *index = _cxml_index_get(node);
+    int i = cxml_index_find(index, node);
+    if (i != -1){
+        for (int j = i + 1; j <= index->end[i]; j++){
+            cxml_list_append(acc, index->nodes[j]);
+        }
+    }else{
+        _descendants(_cxml__get_node_children(node), acc);
+    }
+}
+
 inline static void set_parent_field(void *child, void *parent){
     switch (_cxml_node_type(child))
     {
@@ -478,6 +365,7 @@ inline static void update_parent_fields_after_delete(cxml_elem_node *parent){
 
 inline static void _update_parent(void *parent){
     if (!parent) return;
+    _cxml_index_invalidate(parent);
     if (_cxml_node_type(parent) == CXML_ELEM_NODE)
     {
         update_parent_fields_after_delete(parent);
@@ -503,6 +391,7 @@ inline static int link_child_to_parent(void *child, void *parent, const int *ind
     // second, update the parent's respective fields (has_text, has_child, etc.)
     // third, update the child's `parent` field
     cxml_list *children = _cxml__get_node_children(parent);
+    _cxml_index_invalidate(parent);
 
     if (_cxml_node_type(parent) == CXML_ELEM_NODE){
         if (!index){
@@ -529,22 +418,6 @@ inline static int link_child_to_parent(void *child, void *parent, const int *ind
     return 1;
 }
 
-/*
- * Obtain the cxml_literal_t type of a cxml_string object
- */
-inline static cxml_literal_t _get_literal_type(cxml_string *v){
-    int ret;
-    char *raw = cxml_string_as_raw(v);
-    int len = _cxml_int_cast cxml_string_len(v);
-    if ((ret = _cxml_is_integer(raw, len))){
-        return ret == 1 ? CXML_INTEGER_LITERAL : CXML_XINTEGER_LITERAL;
-    }else if (_cxml_is_double(raw, len)){
-        return CXML_DOUBLE_LITERAL;
-    }else{
-        return CXML_STRING_LITERAL;
-    }
-}
-
 /*
  * Find all elements in root (including root itself) by name that matches
  * the tag name specified in the _cxml_query object `q_obj`
@@ -563,6 +436,7 @@ static void _cxml__find_all_by_name(
     }
     cxml_for_each(child, children)
     {
+        if (!_cxml_budget_visit(1)) return;
         if (_cxml_node_type(child) == CXML_ELEM_NODE)
         {
             if (cxml_string_equals(
@@ -570,6 +444,7 @@ static void _cxml__find_all_by_name(
                     &q_obj->q_name))
             {
                 cxml_list_append(acc, child);
+                if (!_cxml_budget_results(cxml_list_size(acc))) return;
             }
             _cxml__find_all_by_name(q_obj, NULL, _cxml__get_node_children(child), acc);
         }
@@ -599,6 +474,7 @@ static void _cxml__find_all_by_any(
     }
     cxml_for_each(child, children)
     {
+        if (!_cxml_budget_visit(1)) return;
         if (_cxml_node_type(child) == CXML_ELEM_NODE)
         {
             if (cxml_string_equals(
@@ -610,6 +486,7 @@ static void _cxml__find_all_by_any(
                 }else if (_elem_matches_optional_query(child, q_obj)){
                     cxml_list_append(acc, child);
                 }
+                if (!_cxml_budget_results(cxml_list_size(acc))) return;
             }
             _cxml__find_all_by_any(q_obj, NULL, _cxml__get_node_children(child), acc);
         }
@@ -635,6 +512,7 @@ static cxml_element_node *_cxml__find_by_name(
     cxml_elem_node *elem = NULL;
     cxml_for_each(child, children)
     {
+        if (!_cxml_budget_visit(1)) return NULL;
         if (_cxml_node_type(child) == CXML_ELEM_NODE)
         {
             if (cxml_string_equals(&_unwrap_cxnode(cxml_elem_node, child)->name.qname,
@@ -672,6 +550,7 @@ static cxml_element_node *_cxml__find_by_any(
     }
     cxml_for_each(child, children)
     {
+        if (!_cxml_budget_visit(1)) return NULL;
         if (_cxml_node_type(child) == CXML_ELEM_NODE)
         {
             if (cxml_string_equals(&_unwrap__cxnode(elem, child)->name.qname, &q_obj->q_name)){
@@ -692,6 +571,7 @@ static cxml_element_node *_cxml__find_by_any(
  * Helper function for finding all elements that satisfies the given query criteria
  */
 static void _cxml__find_all(_cxml_query  *q_obj, void *root, cxml_list *acc){
+    _cxml_budget_begin();
     cxml_elem_node *root_elem = _get_root_element(root);
     if (!root_elem) return;
     // if no rigid, use only tag name as match
@@ -703,10 +583,48 @@ static void _cxml__find_all(_cxml_query  *q_obj, void *root, cxml_list *acc){
     _cxml__find_all_by_any(q_obj, root_elem, &root_elem->children, acc);
 }
 
+inline static bool _elem_matches_query(cxml_elem_node *elem, _cxml_query *q_obj){
+    if (!cxml_string_equals(&elem->name.qname, &q_obj->q_name)) return false;
+    // if no rigid, use only tag name as match
+    if (cxml_list_is_empty(&q_obj->q_r_list)) return true;
+    return _elem_matches_rigid_query(elem, q_obj) || _elem_matches_optional_query(elem, q_obj);
+}
+
+/*
+ * Append `elem` to the accumulator (in `accs`) of each of the `n` query objects
+ * (in `q_objs`) it matches
+ */
+static bool _cxml__match_many(_cxml_query **q_objs, int n, cxml_elem_node *elem, cxml_list *accs){
+    for (int i = 0; i < n; i++){
+        if (_elem_matches_query(elem, q_objs[i])){
+            cxml_list_append(&accs[i], elem);
+            if (!_cxml_budget_results(cxml_list_size(&accs[i]))) return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Find all elements in `children` (and in their descendants) that satisfy
+ * the query criteria of any of the `n` query objects in `q_objs`, in a single walk
+ */
+static void _cxml__find_all_many(_cxml_query **q_objs, int n, cxml_list *children, cxml_list *accs){
+    cxml_for_each(child, children)
+    {
+        if (!_cxml_budget_visit(1)) return;
+        if (_cxml_node_type(child) == CXML_ELEM_NODE)
+        {
+            if (!_cxml__match_many(q_objs, n, child, accs)) return;
+            _cxml__find_all_many(q_objs, n, _cxml__get_node_children(child), accs);
+        }
+    }
+}
+
 /*
  * Helper function for finding the first element that satisfies the given query criteria
  */
 static cxml_element_node *_cxml__find(_cxml_query  *q_obj, void *root){
+    _cxml_budget_begin();
     cxml_elem_node *root_elem = _get_root_element(root);
     if (!root_elem) return NULL;
     // if no rigid, use only tag name as match
@@ -904,10 +822,7 @@ inline static void _remove_ns_prefix(cxml_name *name){
     // remove the prefix part + ':'
     char *raw = cxml_string_as_raw(&name->qname);
     memmove(raw, (raw + name->pname_len + 1), name->lname_len);
-    name->pname = NULL;
     name->pname_len = 0;
-    // reset local name to point at the updated string
-    name->lname = cxml_string_as_raw(&name->qname);
     name->qname._len = name->lname_len;
 }
 
@@ -982,6 +897,121 @@ void cxml_find_all(void *root, const char *query, cxml_list *acc){
     cxq_free_query(q_obj);
 }
 
+/*
+ * Obtains all *element* 'childs' of `root` that match each of the `n` given queries,
+ * into the `n` lists of `accs` (the elements matching queries[i] into accs[i]),
+ * as `n` calls to cxml_find_all() would, but walking the document only once.
+ *
+ * `root` can be a cxml_root_node, or a cxml_elem_node object.
+ */
+void cxml_find_all_many(void *root, const char **queries, int n, cxml_list *accs){
+    if (!accs || !queries || n <= 0 || !_is_valid_root(root)) return;
+    for (int i = 0; i < n; i++){
+        if (!queries[i]) return;
+    }
+    _cxml_query **q_objs = ALLOC(_cxml_query *, n);
+    for (int i = 0; i < n; i++){
+        q_objs[i] = cxq_parse_query(queries[i]);
+    }
+    _cxml_budget_begin();
+    cxml_elem_node *root_elem = _get_root_element(root);
+    if (root_elem && _cxml__match_many(q_objs, n, root_elem, accs)){
+        _cxml__find_all_many(q_objs, n, &root_elem->children, accs);
+    }
+    for (int i = 0; i < n; i++){
+        cxq_free_query(q_objs[i]);
+    }
+    FREE(q_objs);
+}
+
+inline static bool _frozen_value_matches(_cxml_q_matcher *matcher, const char *chars, int len){
+    if (matcher->flags & _CXQ_MATCH_EXACT){
+        return matcher->value
+               && cxml_string_len(matcher->value) == (unsigned int)len
+               && memcmp(matcher->value->_raw_chars, chars, (size_t)len) == 0;
+    }
+    if (matcher->flags & _CXQ_MATCH_PARTIAL){
+        return cxq_matcher_lcontains(matcher, chars, (unsigned int)len);
+    }
+    return false;
+}
+
+/*
+ * Determine if the element `node` of the frozen document `doc` satisfies the (compiled)
+ * query sub-expression `matcher` (see _elem_matches_sub_query()), `key` being the symbol
+ * of the matcher's attribute key
+ */
+static bool _frozen_matches_sub_query(cxml_frozen_doc *doc, int node, _cxml_q_matcher *matcher, int key){
+    const char *buff = doc->buffer._raw_chars;
+    int kind;
+    switch (matcher->kind)
+    {
+        case _CXQ_MATCHER_ATTR:
+            for (int i = doc->attr_start[node], n = i + doc->attr_count[node]; i < n; i++){
+                if (doc->attr_name[i] != key) continue;
+                if (matcher->flags & _CXQ_MATCH_KEY_ONLY) return true;
+                return _frozen_value_matches(matcher, buff + doc->attr_value[i], doc->attr_value_len[i]);
+            }
+            return false;
+        case _CXQ_MATCHER_TEXT:
+        case _CXQ_MATCHER_COMM:
+            kind = matcher->kind == _CXQ_MATCHER_TEXT ? CXML_TEXT_NODE : CXML_COMM_NODE;
+            for (int c = doc->first_child[node]; c != -1; c = doc->next_sibling[c]){
+                if (doc->kind[c] != kind) continue;
+                if ((matcher->flags & _CXQ_MATCH_ANY)
+                    || _frozen_value_matches(matcher, buff + doc->value[c], doc->value_len[c]))
+                {
+                    return true;
+                }
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+/*
+ * Obtains all elements of the frozen document `doc` that match the given query criteria,
+ * (as cxml_find_all() would, on the document `doc` was frozen from) into `acc`.
+ * The elements are scanned in document order, without walking the tree.
+ */
+void cxml_frozen_find_all(cxml_frozen_doc *doc, const char *query, cxml_frozen_set *acc){
+    if (!doc || !query || !acc) return;
+    _cxml_query *q_obj = cxq_parse_query(query);
+    int name = cxml_frozen_symbol(doc, cxml_string_as_raw(&q_obj->q_name));
+    int n_r = cxml_list_size(&q_obj->q_r_list), n_o = cxml_list_size(&q_obj->q_o_list);
+    if (name == -1){
+        cxq_free_query(q_obj);
+        return;
+    }
+    // the symbols of the attribute keys (rigid, then optional)
+    int *keys = ALLOC(int, (n_r + n_o + 1));
+    for (int i = 0; i < n_r + n_o; i++){
+        _cxml_q_matcher *matcher = i < n_r ? &q_obj->q_r_matchers[i] : &q_obj->q_o_matchers[i - n_r];
+        keys[i] = matcher->kind == _CXQ_MATCHER_ATTR ? cxml_frozen_symbol(doc, matcher->key) : -1;
+    }
+    _cxml_budget_begin();
+    int i, j;
+    for (int node = 1; node < doc->size; node++)
+    {
+        if (!_cxml_budget_visit(1)) break;
+        if (doc->kind[node] != CXML_ELEM_NODE || doc->name[node] != name) continue;
+        // if no rigid, use only tag name as match
+        if (n_r){
+            for (i = 0; i < n_r && _frozen_matches_sub_query(doc, node, &q_obj->q_r_matchers[i], keys[i]); i++);
+            if (i < n_r){
+                for (j = 0; j < n_o
+                            && !_frozen_matches_sub_query(doc, node, &q_obj->q_o_matchers[j], keys[n_r + j]); j++);
+                if (j == n_o) continue;
+            }
+        }
+        cxml_frozen_set_add(acc, node);
+        if (!_cxml_budget_results(acc->size)) break;
+    }
+    FREE(keys);
+    cxq_free_query(q_obj);
+}
+
 /*
  * Obtains all children of the first *element* that matches the given query criteria.
  *
@@ -1128,7 +1158,7 @@ void cxml_find_ancestors(void *root, const char *query, cxml_list *acc){
  */
 void cxml_descendants(void *node, cxml_list *acc){
     if (!_is_valid_root(node) || !acc) return;
-    _descendants(_cxml__get_node_children(node), acc);
+    _node_descendants(node, acc);
 }
 
 /*
@@ -1142,8 +1172,219 @@ void cxml_find_descendants(void *root, const char *query, cxml_list *acc){
     if (!acc || !query || !root) return;
     cxml_elem_node *elem = cxml_find(root, query);
     if (elem){
-        _descendants(_cxml__get_node_children(elem), acc);
+        _node_descendants(elem, acc);
+    }
+}
+
+inline static void _cxml_find_iter__setup(cxml_find_iter *iter, int offset, int limit){
+    iter->query = NULL;
+    iter->queries = NULL;
+    iter->n_queries = 0;
+    iter->match = -1;
+    iter->offset = offset > 0 ? offset : 0;
+    iter->limit = limit;
+    iter->limited = limit > 0;
+    iter->node = NULL;
+    iter->range = NULL;
+    iter->range_size = 0;
+    iter->depth = 0;
+    iter->capacity = _CXML_FIND_ITER_STACK_SIZE;
+    iter->frames = iter->stack;
+}
+
+// open a frame for visiting the children of `node`
+static void _cxml_find_iter__enter(cxml_find_iter *iter, void *node){
+    cxml_list *children = _cxml__get_node_children(node);
+    struct _cxml_list__node *head = children->head;
+    if (!head) return;
+    if (iter->depth == iter->capacity){
+        iter->capacity *= 2;
+        if (iter->frames == iter->stack){
+            iter->frames = ALLOC(struct _cxml_list__node *, iter->capacity);
+            memcpy(iter->frames, iter->stack, sizeof(iter->stack));
+        }else{
+            iter->frames = RALLOC(struct _cxml_list__node *, iter->frames, iter->capacity);
+        }
     }
+    iter->frames[iter->depth++] = head;
+}
+
+/*
+ * Initialize the cursor `iter` over the elements of `root` (including root itself)
+ * that match the given query criteria (see cxml_find_all()).
+ *
+ * `root` can be a cxml_root_node, or a cxml_elem_node object.
+ */
+void cxml_find_iter_init(cxml_find_iter *iter, void *root, const char *query, int offset, int limit){
+    if (!iter) return;
+    _cxml_find_iter__setup(iter, offset, limit);
+    if (!query || !_is_valid_root(root)) return;
+    iter->node = _get_root_element(root);
+    if (iter->node) iter->query = cxq_parse_query(query);
+}
+
+/*
+ * Initialize the cursor `iter` over the elements of `root` (including root itself)
+ * that match any of the `n` given queries, in a single walk (see cxml_find_all_many()).
+ * The nodes can be obtained one at a time (cxml_find_iter_next()), or be gathered
+ * by query (cxml_find_iter_collect()).
+ *
+ * `root` can be a cxml_root_node, or a cxml_elem_node object.
+ */
+void cxml_find_many_iter_init(
+        cxml_find_iter *iter, void *root, const char **queries, int n, int offset, int limit)
+{
+    if (!iter) return;
+    _cxml_find_iter__setup(iter, offset, limit);
+    if (!queries || n <= 0 || !_is_valid_root(root)) return;
+    for (int i = 0; i < n; i++){
+        if (!queries[i]) return;
+    }
+    iter->node = _get_root_element(root);
+    if (!iter->node) return;
+    iter->queries = ALLOC(_cxml_query *, n);
+    iter->n_queries = n;
+    for (int i = 0; i < n; i++){
+        iter->queries[i] = cxq_parse_query(queries[i]);
+    }
+}
+
+/*
+ * Initialize the cursor `iter` over the descendants of the first element
+ * that matches the given query criteria (see cxml_find_descendants()).
+ *
+ * `root` can be a cxml_root_node, or a cxml_elem_node object.
+ */
+void cxml_find_descendants_iter_init(
+        cxml_find_iter *iter, void *root, const char *query, int offset, int limit)
+{
+    if (!iter) return;
+    _cxml_find_iter__setup(iter, offset, limit);
+    cxml_elem_node *elem = cxml_find(root, query);
+    if (!elem) return;
+    // descendants are a contiguous range of an indexed document
+    cxml_node_index *index = _cxml_index_get(elem);
+    int i = cxml_index_find(index, elem);
+    if (i != -1){
+        iter->range = &index->nodes[i + 1];
+        iter->range_size = index->end[i] - i;
+    }else{
+        _cxml_find_iter__enter(iter, elem);
+    }
+}
+
+// (records the first query matched by `elem`, for cxml_find_iter_collect())
+inline static bool _cxml_find_iter__matches(cxml_find_iter *iter, cxml_elem_node *elem){
+    if (iter->queries){
+        for (int i = 0; i < iter->n_queries; i++){
+            if (_elem_matches_query(elem, iter->queries[i])){
+                iter->match = i;
+                return true;
+            }
+        }
+        return false;
+    }
+    return !iter->query || _elem_matches_query(elem, iter->query);
+}
+
+static void *_cxml_find_iter__advance(cxml_find_iter *iter){
+    struct _cxml_list__node *next;
+    void *node;
+    if (iter->range){
+        if (!iter->range_size) return NULL;
+        iter->range_size--;
+        return *iter->range++;
+    }
+    for (;;){
+        if (iter->node){
+            node = iter->node;
+            iter->node = NULL;
+        }else{
+            if (!iter->depth) return NULL;
+            next = iter->frames[iter->depth - 1];
+            if (!next){
+                iter->depth--;
+                continue;
+            }
+            iter->frames[iter->depth - 1] = next->next;
+            node = next->item;
+        }
+        if (_cxml_node_type(node) == CXML_ELEM_NODE){
+            _cxml_find_iter__enter(iter, node);
+            if (_cxml_find_iter__matches(iter, node)) return node;
+        }else if (!iter->query && !iter->queries){
+            return node;
+        }
+    }
+}
+
+/*
+ * Obtain the next node, NULL when exhausted.
+ */
+void *cxml_find_iter_next(cxml_find_iter *iter){
+    if (!iter || (iter->limited && !iter->limit)) return NULL;
+    if (iter->range){
+        // skip the offset at once
+        int skip = iter->offset < iter->range_size ? iter->offset : iter->range_size;
+        iter->range += skip;
+        iter->range_size -= skip;
+        iter->offset = 0;
+    }
+    for (; iter->offset; iter->offset--){
+        if (!_cxml_find_iter__advance(iter)) return NULL;
+    }
+    void *node = _cxml_find_iter__advance(iter);
+    if (node && iter->limited) iter->limit--;
+    return node;
+}
+
+/*
+ * Obtain the next `n` nodes (all the remaining nodes if `n` <= 0), appending each node
+ * to the list of each query it matches: accs[i] for the i-th query of a cursor
+ * initialized with several queries, accs[0] otherwise.
+ * Returns the number of nodes obtained.
+ */
+int cxml_find_iter_collect(cxml_find_iter *iter, cxml_list *accs, int n){
+    if (!iter || !accs) return 0;
+    int count = 0;
+    void *node;
+    while ((n <= 0 || count < n) && (node = cxml_find_iter_next(iter))){
+        count++;
+        if (!iter->queries){
+            cxml_list_append(accs, node);
+            continue;
+        }
+        // the queries before the first query matched (when the node was produced) don't match
+        cxml_list_append(&accs[iter->match], node);
+        for (int i = iter->match + 1; i < iter->n_queries; i++){
+            if (_elem_matches_query(node, iter->queries[i])){
+                cxml_list_append(&accs[i], node);
+            }
+        }
+    }
+    return count;
+}
+
+void cxml_find_iter_free(cxml_find_iter *iter){
+    if (!iter) return;
+    if (iter->query){
+        cxq_free_query(iter->query);
+        iter->query = NULL;
+    }
+    if (iter->queries){
+        for (int i = 0; i < iter->n_queries; i++){
+            cxq_free_query(iter->queries[i]);
+        }
+        FREE(iter->queries);
+        iter->queries = NULL;
+        iter->n_queries = 0;
+    }
+    if (iter->frames != iter->stack) FREE(iter->frames);
+    iter->frames = iter->stack;
+    iter->depth = 0;
+    iter->node = NULL;
+    iter->range = NULL;
+    iter->range_size = 0;
 }
 
 /*
@@ -1477,10 +1718,10 @@ int cxml_set_name(void *node, const char *pname, const char *lname){
         if (!lname)
         {
             // prefix name cannot exist without a local name
-            if (!name->lname || !name->lname_len){
+            if (!name->lname_len){
                 return 0;
             }else{
-                lname = name->lname;
+                lname = cxml_name_lname(name);
                 lname_len = name->lname_len;
             }
         }else{
@@ -1524,8 +1765,6 @@ int cxml_set_name(void *node, const char *pname, const char *lname){
         }
         cxml_string_free(&name->qname);
         name->qname = tmp;
-        name->pname = cxml_string_as_raw(&name->qname);
-        name->lname = name->pname + name->pname_len + 1;
         // update the attribute in the table if attribute
         attrs ? cxml_table_put(attrs, cxml_string_as_raw(&name->qname), node) : 0;
         return 1;
@@ -1549,9 +1788,6 @@ int cxml_set_name(void *node, const char *pname, const char *lname){
         name->lname_len = lname_len;
         // add lname to qname
         cxml_string_append(&name->qname, lname, name->lname_len);
-        name->lname = name->pname_len ?  // ensure we start after the prefix if prefix is available
-                      (cxml_string_as_raw(&name->qname) + name->pname_len + 1) : // + 1 for ':'
-                      cxml_string_as_raw(&name->qname);
         // update the attribute in the table if attribute
         attrs ? cxml_table_put(attrs, cxml_string_as_raw(&name->qname), node) : 0;
         return 1;
@@ -1595,11 +1831,11 @@ int cxml_set_namespace(void *node, cxml_namespace_node *ns){
     }
     if (ns->is_default){
         // cannot set a default namespace on a node with a prefixed name
-        if (name->pname) return 0;
+        if (cxml_name_pname(name)) return 0;
     }else{
-        if (!name->pname) return 0;
+        if (!cxml_name_pname(name)) return 0;
         // node's prefix name must be same as namespace prefix
-        if (!cxml_string_lraw_equals(&ns->prefix, name->pname, name->pname_len)) return 0;
+        if (!cxml_string_lraw_equals(&ns->prefix, cxml_name_pname(name), name->pname_len)) return 0;
     }
     if (_cxml_node_type(node) == CXML_ELEM_NODE){
         _unwrap_cxnode(cxml_elem_node, node)->namespace = ns;
@@ -1663,7 +1899,7 @@ int cxml_set_attribute_value(cxml_attribute_node *node, const char *value){
     if (!node || !value || node->_type != CXML_ATTR_NODE) return 0;
     cxml_string_free(&node->value);
     cxml_string_append(&node->value, value, _cxml_int_cast strlen(value));
-    cxml_set_literal(&node->number_value, _get_literal_type(&node->value), &node->value);
+    node->number_value.type = CXML_NUMERIC_UNSET_T;
     return 1;
 }
 
@@ -1688,7 +1924,7 @@ int cxml_set_attribute_data(
     if (cxml_set_name(node, pname, lname)){
         cxml_string_free(&node->value);
         cxml_string_append(&node->value, value, _cxml_int_cast strlen(value));
-        cxml_set_literal(&node->number_value, _get_literal_type(&node->value), &node->value);
+        node->number_value.type = CXML_NUMERIC_UNSET_T;
         return 1;
     }
     return 0;
@@ -1701,7 +1937,12 @@ int cxml_set_text_value(cxml_text_node *text, const char *value, bool is_cdata){
     if (!text || !value || text->_type != CXML_TEXT_NODE) return 0;
     cxml_string_free(&text->value);
     cxml_string_append(&text->value, value, _cxml_int_cast strlen(value));
-    cxml_set_literal(&text->number_value, _get_literal_type(&text->value), &text->value);
+    text->number_value.type = CXML_NUMERIC_UNSET_T;
+    if (text->decoded){
+        cxml_string_free(text->decoded);
+        FREE(text->decoded);
+        text->decoded = NULL;
+    }
     text->is_cdata = is_cdata;
     return 1;
 }
@@ -2078,8 +2319,8 @@ int cxml_unbind_element(cxml_elem_node *element){
         || !element->is_namespaced
         || !element->namespace
         ) return 0;
-    if (element->name.pname
-        && cxml_string_raw_equals(&element->namespace->prefix, element->name.pname))
+    if (cxml_name_pname(&element->name)
+        && cxml_string_raw_equals(&element->namespace->prefix, cxml_name_pname(&element->name)))
     {
         _remove_ns_prefix(&element->name);
     }
@@ -2096,8 +2337,8 @@ int cxml_unbind_attribute(cxml_attr_node *attr){
         || _cxml_node_type(attr) != CXML_ATTR_NODE
         || !attr->namespace
         ) return 0;
-    if (attr->name.pname
-        && cxml_string_raw_equals(&attr->namespace->prefix, attr->name.pname))
+    if (cxml_name_pname(&attr->name)
+        && cxml_string_raw_equals(&attr->namespace->prefix, cxml_name_pname(&attr->name)))
     {
         // update attr in its parent
         cxml_table_remove(attr->parent->attributes, cxml_string_as_raw(&attr->name.qname));
@@ -2178,6 +2419,7 @@ int cxml_drop_xml_hdr(cxml_xhdr_node *xhdr){
  */
 int cxml_delete_descendants(cxml_element_node *node){
     if (!node) return 0;
+    _cxml_index_invalidate(node);
     cxml_for_each(child, &node->children)
     {
         cxml_node_free(child);
@@ -2195,6 +2437,7 @@ int cxml_delete_descendants(cxml_element_node *node){
  */
 int cxml_drop_descendants(cxml_element_node *node, cxml_list *acc){
     if (!node || !acc || node->_type != CXML_ELEM_NODE) return 0;
+    _cxml_index_invalidate(node);
     cxml_for_each(child, &node->children)
     {
         _cxml_unset_parent(child);
@@ -2218,6 +2461,7 @@ int cxml_drop_descendants(cxml_element_node *node, cxml_list *acc){
 int cxml_delete_parent(void *node){
     void *parent = _cxml_get_node_parent(node);
     if (!parent) return 0;
+    _cxml_index_invalidate(parent);
     cxml_list *children = _cxml__get_node_children(parent);
     cxml_for_each(child, children)
     {
@@ -2462,11 +2706,7 @@ double cxml_get_number(void *node){
         || (_cxml_node_type(node) != CXML_TEXT_NODE
          && _cxml_node_type(node) != CXML_ATTR_NODE))
         return 0;
-    if (_cxml_node_type(node) == CXML_ATTR_NODE){
-        return _unwrap__cxnode(attr, node)->number_value.dec_val;
-    }else{
-        return _unwrap__cxnode(text, node)->number_value.dec_val;
-    }
+    return _cxml_get_node_number(node)->dec_val;
 }
 
 /*
@@ -31,6 +31,8 @@ void cxq_init_query(_cxml_query *q_object) {
     cxml_list_init(&q_object->q_o_list);
     cxml_list_init(&q_object->q_r_list);
     cxml_string_init(&q_object->q_name);
+    q_object->q_o_matchers = NULL;
+    q_object->q_r_matchers = NULL;
     q_object->expr = NULL;
 }
 
@@ -389,6 +391,105 @@ _cxml_query *_cxq__parse__query(_cxml_query_lexer *lexer) {
     return query;
 }
 
+/*
+ * Relative cost of matching an element with `matcher`:
+ * flags are cheaper than attribute lookups, which are cheaper than
+ * the scan of the element's children (texts and comments)
+ */
+static int _cxq__matcher_cost(_cxml_q_matcher *matcher){
+    if (!matcher->kind) return 0;
+    int partial = (matcher->flags & _CXQ_MATCH_PARTIAL) ? 1 : 0;
+    if (matcher->kind == _CXQ_MATCHER_ATTR){
+        return (matcher->flags & _CXQ_MATCH_KEY_ONLY) ? 1 : 2 + partial;
+    }
+    return (matcher->flags & _CXQ_MATCH_ANY) ? 0 : 4 + partial;
+}
+
+static void _cxq__compile_q(_cxml_q *q, _cxml_q_matcher *matcher){
+    matcher->kind = 0;
+    matcher->flags = 0;
+    matcher->key = NULL;
+    matcher->hash = 0;
+    matcher->value = NULL;
+    matcher->shift = NULL;
+    if (q->q_attr){
+        matcher->kind = _CXQ_MATCHER_ATTR;
+        matcher->flags = q->q_attr->flags;
+        matcher->key = cxml_string_as_raw(q->q_attr->key);
+        if (matcher->key) matcher->hash = cxml_table_hash(matcher->key);
+        matcher->value = q->q_attr->value;
+    }else if (q->q_text){
+        matcher->kind = _CXQ_MATCHER_TEXT;
+        matcher->flags = q->q_text->flags;
+        matcher->value = q->q_text->text;
+    }else if (q->q_comm){
+        matcher->kind = _CXQ_MATCHER_COMM;
+        matcher->flags = q->q_comm->flags;
+        matcher->value = q->q_comm->comment;
+    }
+    if ((matcher->flags & _CXQ_MATCH_PARTIAL) && matcher->value){
+        // bad character shifts (capped, which only shortens them)
+        unsigned int len = cxml_string_len(matcher->value);
+        unsigned char *chars = (unsigned char *)cxml_string_as_raw(matcher->value);
+        unsigned char max = len < 255 ? (unsigned char)len : 255;
+        matcher->shift = ALLOC(unsigned char, 256);
+        memset(matcher->shift, max, 256);
+        for (unsigned int i = 0; len && i < len - 1; i++){
+            matcher->shift[chars[i]] = (len - 1 - i) < 255 ? (unsigned char)(len - 1 - i) : 255;
+        }
+    }
+}
+
+/*
+ * Compile the sub-expressions in `list` into an array of matchers,
+ * ordered cheapest first (matching doesn't depend on the order)
+ */
+static _cxml_q_matcher *_cxq__compile_q_list(cxml_list *list){
+    int n = cxml_list_size(list);
+    if (!n) return NULL;
+    _cxml_q_matcher *matchers = ALLOC(_cxml_q_matcher, n), tmp;
+    int i = 0, j;
+    cxml_for_each(q, list)
+    {
+        _cxq__compile_q(q, &matchers[i]);
+        // (stable) insertion by cost
+        for (j = i; j > 0 && _cxq__matcher_cost(&matchers[j - 1]) > _cxq__matcher_cost(&matchers[j]); j--){
+            tmp = matchers[j];
+            matchers[j] = matchers[j - 1];
+            matchers[j - 1] = tmp;
+        }
+        i++;
+    }
+    return matchers;
+}
+
+/*
+ * Determine if the `len` bytes of `chars` contain the (partial match) value of `matcher`
+ */
+bool cxq_matcher_lcontains(_cxml_q_matcher *matcher, const char *chars, unsigned int len){
+    if (!matcher->value) return false;
+    unsigned int n = cxml_string_len(matcher->value);
+    if (!n) return true;  // all strings contains ""
+    if (n > len) return false;
+    const unsigned char *haystack = (const unsigned char *)chars;
+    const unsigned char *needle = (unsigned char *)matcher->value->_raw_chars;
+    if (n == 1) return memchr(haystack, needle[0], len) != NULL;
+    unsigned char last = needle[n - 1], ch = 0;
+    for (unsigned int i = 0; i <= len - n; i += matcher->shift[ch]){
+        ch = haystack[i + n - 1];
+        if (ch == last && memcmp(haystack + i, needle, n - 1) == 0) return true;
+    }
+    return false;
+}
+
+/*
+ * Determine if the string `str` contains the (partial match) value of `matcher`
+ */
+bool cxq_matcher_contains(_cxml_q_matcher *matcher, cxml_string *str){
+    if (!str) return false;
+    return cxq_matcher_lcontains(matcher, str->_raw_chars, cxml_string_len(str));
+}
+
 _cxml_query *cxq_parse_query(const char *query_expr) {
     _cxml_query_lexer *lexer = cxq__create_lexer(query_expr);
     _cxml_query *query = _cxq__parse__query(lexer);
@@ -401,6 +502,8 @@ _cxml_query *cxq_parse_query(const char *query_expr) {
                     "Nameless <> expression, query "
                     "expression must have a name.");
         }
+        query->q_o_matchers = _cxq__compile_q_list(&query->q_o_list);
+        query->q_r_matchers = _cxq__compile_q_list(&query->q_r_list);
     }
     return query;
 }
@@ -419,6 +522,14 @@ void cxq_free_query(_cxml_query *query) {
     cxml_for_each(r_node, qr_list){
         cxq_free_q(r_node);
     }
+    for (int i = 0; query->q_o_matchers && i < cxml_list_size(qo_list); i++){
+        FREE(query->q_o_matchers[i].shift);
+    }
+    for (int i = 0; query->q_r_matchers && i < cxml_list_size(qr_list); i++){
+        FREE(query->q_r_matchers[i].shift);
+    }
+    FREE(query->q_o_matchers);
+    FREE(query->q_r_matchers);
     cxml_list_free(qo_list);
     cxml_list_free(qr_list);
     FREE(query);
@@ -5,6 +5,7 @@
 
 
 #include "utils/cxutf8hook.h"
+#include "core/cxswar.h"
 
 static const u_int32_t offsetsFromUTF8[6] = {
         0x00000000UL, 0x00003080UL, 0x000E2080UL,
@@ -48,13 +49,7 @@ bool is_valid_utf8_start(const char *raw){
 
 /* number of characters */
 int u8_strlen(char *s) {
-    int count = 0;
-    int i = 0;
-
-    while (u8_nextchar(s, &i) != 0)
-        count++;
-
-    return count;
+    return (int) u8_count(s, strlen(s));
 }
 
 /* reads the next utf-8 sequence out of a string, updating an index */
@@ -73,17 +68,246 @@ u_int32_t u8_nextchar(const char *s, int *i) {
 }
 
 char *u8_strchr(char *s, u_int32_t ch, int *charn) {
-    int i = 0, lasti = 0;
-    u_int32_t c;
+    char seq[4];
+    int seq_len = ch ? u8_wc_toutf8(seq, ch) : 0;
+    size_t len = strlen(s);
+    const char *p = s, *end = s + len;
 
     *charn = 0;
-    while (s[i]) {
-        c = u8_nextchar(s, &i);
-        if (c == ch) {
-            return &s[lasti];
+    if (!seq_len) return NULL;
+    // the lead byte of a sequence never occurs inside another sequence,
+    // so candidates can be found with memchr() on the lead byte alone.
+    while ((p = memchr(p, seq[0], (size_t) (end - p))) != NULL) {
+        if ((size_t) (end - p) >= (size_t) seq_len && !memcmp(p, seq, seq_len)) {
+            *charn = (int) u8_count(s, (size_t) (p - s));
+            return (char *) p;
         }
-        lasti = i;
-        (*charn)++;
+        p++;
     }
     return NULL;
 }
+
+int u8_wc_toutf8(char *dest, u_int32_t ch) {
+    if (ch < 0x80) {
+        dest[0] = (char) ch;
+        return 1;
+    }
+    if (ch < 0x800) {
+        dest[0] = (char) ((ch >> 6) | 0xC0);
+        dest[1] = (char) ((ch & 0x3F) | 0x80);
+        return 2;
+    }
+    if (ch < 0x10000) {
+        dest[0] = (char) ((ch >> 12) | 0xE0);
+        dest[1] = (char) (((ch >> 6) & 0x3F) | 0x80);
+        dest[2] = (char) ((ch & 0x3F) | 0x80);
+        return 3;
+    }
+    if (ch < 0x110000) {
+        dest[0] = (char) ((ch >> 18) | 0xF0);
+        dest[1] = (char) (((ch >> 12) & 0x3F) | 0x80);
+        dest[2] = (char) (((ch >> 6) & 0x3F) | 0x80);
+        dest[3] = (char) ((ch & 0x3F) | 0x80);
+        return 4;
+    }
+    return 0;
+}
+
+/*
+ * Word-at-a-time (SWAR) kernels.
+ * Each step loads 8 bytes into a 64-bit word; ASCII runs are skipped a word at a time,
+ * and continuation bytes (10xxxxxx) of a word are counted without branching
+ * (see core/cxswar.h).
+ */
+
+/* high bit set for every continuation byte of w */
+#define _u8_cont_bits(w)    ((w) & ~((w) << 1) & _CXML_SWAR_HIGHS)
+
+/* number of continuation bytes of w */
+#define _u8_cont_count(w)   ((int) (((_u8_cont_bits(w) >> 7) * _CXML_SWAR_ONES) >> 56))
+
+/*
+ * length of the well-formed sequence starting at s (n bytes available),
+ * 0 if the sequence is ill-formed, -1 if the sequence is well-formed so far,
+ * but truncated by the end of the input.
+ * (Unicode, table 3-7 "Well-Formed UTF-8 Byte Sequences")
+ */
+static int _u8_check_seq(const unsigned char *s, size_t n) {
+    unsigned char lo = 0x80, hi = 0xBF;
+    int len;
+    if (s[0] < 0x80) return 1;
+    if (s[0] < 0xC2) return 0;
+    if (s[0] < 0xE0) {
+        len = 2;
+    } else if (s[0] < 0xF0) {
+        len = 3;
+        if (s[0] == 0xE0) lo = 0xA0;            // overlong
+        else if (s[0] == 0xED) hi = 0x9F;       // surrogates
+    } else if (s[0] < 0xF5) {
+        len = 4;
+        if (s[0] == 0xF0) lo = 0x90;            // overlong
+        else if (s[0] == 0xF4) hi = 0x8F;       // > U+10FFFF
+    } else {
+        return 0;
+    }
+    for (int i = 1; i < len; i++) {
+        if ((size_t) i >= n) return -1;
+        if (s[i] < lo || s[i] > hi) return 0;
+        lo = 0x80, hi = 0xBF;
+    }
+    return len;
+}
+
+/*
+ * Check that the `len` bytes of `s` are well-formed UTF-8.
+ * If `valid_len` is not NULL, it receives the length of the longest
+ * well-formed prefix of `s` (`len` if `s` is well-formed).
+ */
+bool u8_validate(const char *s, size_t len, size_t *valid_len) {
+    const unsigned char *u = (const unsigned char *) s;
+    size_t i = 0;
+    int n;
+    while (i < len) {
+        // ascii fast path
+        while (len - i >= 8 && !(_cxml_swar_load(s + i) & _CXML_SWAR_HIGHS)) i += 8;
+        while (i < len && u[i] < 0x80) i++;
+        if (i == len) break;
+        if ((n = _u8_check_seq(u + i, len - i)) <= 0) {
+            if (valid_len) *valid_len = i;
+            return false;
+        }
+        i += n;
+    }
+    if (valid_len) *valid_len = len;
+    return true;
+}
+
+/* are the `len` bytes of `s` all ASCII? */
+bool u8_is_ascii(const char *s, size_t len) {
+    size_t i = 0;
+    for (; len - i >= 8; i += 8) {
+        if (_cxml_swar_load(s + i) & _CXML_SWAR_HIGHS) return false;
+    }
+    for (; i < len; i++) {
+        if ((unsigned char) s[i] >= 0x80) return false;
+    }
+    return true;
+}
+
+/*
+ * Is `s` (`len` bytes) the start of a well-formed multi-byte sequence,
+ * cut short by the end of the input?
+ */
+bool u8_is_partial(const char *s, size_t len) {
+    return len && len < 4 && _u8_check_seq((const unsigned char *) s, len) == -1;
+}
+
+/* number of characters in the first `len` bytes of s */
+size_t u8_count(const char *s, size_t len) {
+    size_t i = 0, conts = 0;
+    for (; len - i >= 8; i += 8) {
+        conts += _u8_cont_count(_cxml_swar_load(s + i));
+    }
+    for (; i < len; i++) {
+        conts += !isutf(s[i]);
+    }
+    return len - conts;
+}
+
+/* character number to byte offset, within the first `len` bytes of s (`len` if out of range) */
+size_t u8_offset_n(const char *s, size_t len, size_t charnum) {
+    size_t i = 0, leads;
+    // skip whole words as long as the character doesn't start within the word
+    for (; len - i >= 8; i += 8) {
+        leads = 8 - _u8_cont_count(_cxml_swar_load(s + i));
+        if (leads > charnum) break;
+        charnum -= leads;
+    }
+    for (; i < len; i++) {
+        if (isutf(s[i]) && !charnum--) return i;
+    }
+    return len;
+}
+
+/*
+ * ISO-8859-1 to UTF-8. `dest` must have room for 2 * `len` bytes.
+ * Returns the number of bytes written to `dest`.
+ */
+size_t u8_from_latin1(char *dest, const char *src, size_t len) {
+    const unsigned char *s = (const unsigned char *) src;
+    size_t i = 0, n = 0;
+    while (i < len) {
+        // ascii fast path
+        while (len - i >= 8 && !(_cxml_swar_load(src + i) & _CXML_SWAR_HIGHS)) {
+            memcpy(dest + n, src + i, 8);
+            i += 8, n += 8;
+        }
+        if (i == len) break;
+        if (s[i] < 0x80) {
+            dest[n++] = (char) s[i];
+        } else {
+            dest[n++] = (char) ((s[i] >> 6) | 0xC0);
+            dest[n++] = (char) ((s[i] & 0x3F) | 0x80);
+        }
+        i++;
+    }
+    return n;
+}
+
+/*
+ * UTF-16 (little or big endian) to UTF-8. `dest` must have room for 3 * (`len` / 2) bytes.
+ * Conversion stops before a code unit or surrogate pair cut short by the end of `src`,
+ * unless `final` is set, in which case it is converted to U+FFFD (as are unpaired surrogates).
+ * `consumed` receives the number of bytes of `src` converted.
+ * Returns the number of bytes written to `dest`.
+ */
+size_t u8_from_utf16(char *dest, const char *src, size_t len, bool big_endian, bool final, size_t *consumed) {
+    // code units below 0x80 (host independent byte masks)
+    static const unsigned char le_mask[8] = {0x80, 0xFF, 0x80, 0xFF, 0x80, 0xFF, 0x80, 0xFF};
+    static const unsigned char be_mask[8] = {0xFF, 0x80, 0xFF, 0x80, 0xFF, 0x80, 0xFF, 0x80};
+    const unsigned char *s = (const unsigned char *) src;
+    int hi = big_endian ? 0 : 1, lo = !hi;
+    uint64_t mask;
+    memcpy(&mask, big_endian ? be_mask : le_mask, 8);
+    size_t i = 0, n = 0;
+    u_int32_t ch, ch2;
+    while (len - i >= 2) {
+        // ascii fast path
+        while (len - i >= 8 && !(_cxml_swar_load(src + i) & mask)) {
+            dest[n] = (char) s[i + lo];
+            dest[n + 1] = (char) s[i + 2 + lo];
+            dest[n + 2] = (char) s[i + 4 + lo];
+            dest[n + 3] = (char) s[i + 6 + lo];
+            i += 8, n += 4;
+        }
+        if (len - i < 2) break;
+        ch = ((u_int32_t) s[i + hi] << 8) | s[i + lo];
+        if (ch >= 0xD800 && ch <= 0xDBFF) {
+            if (len - i < 4) {
+                if (!final) break;
+                ch = 0xFFFD;
+                i += 2;
+            } else {
+                ch2 = ((u_int32_t) s[i + 2 + hi] << 8) | s[i + 2 + lo];
+                if (ch2 >= 0xDC00 && ch2 <= 0xDFFF) {
+                    ch = 0x10000 + ((ch - 0xD800) << 10) + (ch2 - 0xDC00);
+                    i += 4;
+                } else {
+                    ch = 0xFFFD;
+                    i += 2;
+                }
+            }
+        } else {
+            if (ch >= 0xDC00 && ch <= 0xDFFF) ch = 0xFFFD;
+            i += 2;
+        }
+        n += u8_wc_toutf8(dest + n, ch);
+    }
+    // odd trailing byte
+    if (final && len - i == 1) {
+        n += u8_wc_toutf8(dest + n, 0xFFFD);
+        i++;
+    }
+    if (consumed) *consumed = i;
+    return n;
+}
@@ -33,7 +33,6 @@ static _cxml_token new_cxml_err_token(_cxml_lexer *cxlexer, const char *msg);
 
 static _cxml_token lex_comment(_cxml_lexer *cxlexer);
 
-static void set_type(_cxml_token *token);
 
 static void _cxml__read(_cxml_lexer *cxlexer);
 
@@ -69,6 +68,21 @@ inline static bool has_utf8_bom(const char *str){
             && ((unsigned char)str[idx] & 0XFF)   == 0xBF);
 }
 
+/*
+ * Validate the encoding of `len` bytes of input starting at `start`.
+ * Returns the number of trailing bytes left unchecked, which can only be
+ * non-zero for a multi-byte sequence cut short by the end of a stream read.
+ */
+static size_t _cxml__check_encoding(const char *start, size_t len, bool at_end){
+    size_t valid_len;
+    if (u8_validate(start, len, &valid_len)) return 0;
+    if (at_end || !u8_is_partial(start + valid_len, len - valid_len)){
+        cxml_error("CXML Error: Invalid UTF-8 byte sequence (0x%02X) in input\n",
+                   (unsigned char)start[valid_len]);
+    }
+    return len - valid_len;
+}
+
 void _cxml_lexer_init(
         _cxml_lexer *cxlexer,
         const char *source,
@@ -76,6 +90,9 @@ void _cxml_lexer_init(
         bool stream)
 {
     cxlexer->cfg = cxml_get_config();
+    // set before the first read, which checks whether the input ends with it
+    cxlexer->_should_stream = stream;
+    cxlexer->_stream = stream;
     if (stream && filename){
         _cxml_stream_init(&cxlexer->_stream_obj, filename, cxlexer->cfg.chunk_size);
         cxlexer->start = cxlexer->current = cxlexer->_stream_obj._stream_buff;
@@ -84,6 +101,9 @@ void _cxml_lexer_init(
     }else{
         cxlexer->start = (void*)source;
         cxlexer->current = (void*)source;
+        if (source && cxlexer->cfg.validate_encoding){
+            _cxml__check_encoding(source, strlen(source), true);
+        }
     }
     // escape utf-8 byte order mark if present.
     if (cxlexer->current && has_utf8_bom(cxlexer->current)){
@@ -96,8 +116,6 @@ void _cxml_lexer_init(
     cxlexer->preserve_sp = cxlexer->cfg.preserve_space;
     cxlexer->preserve_cm = cxlexer->cfg.preserve_comment;
     cxlexer->preserve_cd = cxlexer->cfg.preserve_cdata;
-    cxlexer->_should_stream = stream;
-    cxlexer->_stream = stream;
     cxlexer->_returned = 0;
 }
 
@@ -161,12 +179,14 @@ static _cxml_token new_cxml_token(_cxml_lexer *cxlexer, _cxml_token_t type) {
     }else{
         token.start = cxlexer->start;
     }
+    // numeric values of text and attribute values are resolved lazily, on first use
+    // (see _cxml_get_node_number())
     if (token.type == CXML_TOKEN_STRING){
         token.length--;  // escape ending quotation '"' | '\''
-        set_type(&token);
+        token.literal_type = CXML_STRING_LITERAL;
     }
     else if (token.type == CXML_TOKEN_TEXT){
-        set_type(&token);
+        token.literal_type = CXML_STRING_LITERAL;
     }else{
         token.literal_type = CXML_NON_LITERAL;
     }
@@ -282,15 +302,19 @@ static void _cxml__read(_cxml_lexer *cxlexer){
             _cxml__adjust_stream_buffer(cxlexer);
         }
 
-        if ((actual_byte_count = fread((stream_obj->_stream_buff + stream_obj->_nbytes_read_into_sbuff),
-                                       sizeof(char), byte_count, stream_obj->_file)) < byte_count)
-        {
-            if (feof(stream_obj->_file)){
-                stream_obj->_stream_buff[(stream_obj->_nbytes_read_into_sbuff + actual_byte_count)] = '\0';
-                cxlexer->_should_stream = 0;
-            }else{
-                cxml_error("CXML Error: Error occurred while streaming file\n");
-            }
+        // non utf-8 input is transcoded (to utf-8) into the stream buffer
+        actual_byte_count = _cxml__stream_read(stream_obj,
+                                               stream_obj->_stream_buff + stream_obj->_nbytes_read_into_sbuff,
+                                               byte_count);
+        if (stream_obj->_eof){
+            stream_obj->_stream_buff[(stream_obj->_nbytes_read_into_sbuff + actual_byte_count)] = '\0';
+            cxlexer->_should_stream = 0;
+        }
+        if (cxlexer->cfg.validate_encoding){
+            stream_obj->_nbytes_unchecked = _cxml__check_encoding(
+                    stream_obj->_stream_buff + stream_obj->_nbytes_read_into_sbuff - stream_obj->_nbytes_unchecked,
+                    actual_byte_count + stream_obj->_nbytes_unchecked,
+                    !cxlexer->_should_stream);
         }
         stream_obj->_nbytes_read_into_sbuff += actual_byte_count;
     }
@@ -370,17 +394,6 @@ inline static bool is_open_or_close(_cxml_lexer *cxlexer, char ch) {
     return (ch == '>' || ch == '<') || is_at_end(cxlexer);
 }
 
-static void set_type(_cxml_token* token){
-    int ret;
-    if ((ret = _cxml_is_integer(token->start, token->length))){
-        token->literal_type = ret == 1 ? CXML_INTEGER_LITERAL : CXML_XINTEGER_LITERAL;
-    }else if (_cxml_is_double(token->start, token->length)){
-        token->literal_type = CXML_DOUBLE_LITERAL;
-    }else{
-        token->literal_type = CXML_STRING_LITERAL;
-    }
-}
-
 //<tag attr="value">real value</tag>
 static _cxml_token_t lex_attr_identifier(_cxml_lexer *cxlexer) {
     while (_cxml__is_identifier(peek(cxlexer)))
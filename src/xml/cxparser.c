@@ -25,7 +25,6 @@ static void x__dtd(_cxml_parser *parser);
 
 static void x__pi(_cxml_parser *parser);
 
-static void cxml_free_attr_checker(cxml_table *attr_checker);
 
 static bool _cxml_p__is_whitespace(_cxml_token token);
 
@@ -52,7 +51,6 @@ void _cxml_parser_init(
     parser->root_node = NULL;
     cxml_list_init(&parser->errors);
     cxml_list_init(&parser->attr_list);
-    cxml_table_init(&parser->attr_checker);
     parser->current_scope = NULL;
     parser->xml_doctype = NULL;
     _cxml_stack_init(&parser->_cx_stack);  // init stack
@@ -75,20 +73,12 @@ void _cxml_parser_free(_cxml_parser *cxparser) {
     _cxml_stack_free(&(cxparser->_cx_stack));
     cxml_list_free(&cxparser->errors);
     // we do not free the root node as this would be used by other processes
-    _cxml_scope_table_free(cxparser->current_scope);
+    _cxml_ns_scope_free(cxparser->current_scope);
     cxml_list_free(&cxparser->attr_list);
-    cxml_free_attr_checker(&cxparser->attr_checker);
     // make freed state definite
     _cxml_parser_init(cxparser, "", NULL, false);
 }
 
-void cxml_free_attr_checker(cxml_table *attr_checker){
-    cxml_for_each(key, &attr_checker->keys){
-        FREE(key);
-    }
-    cxml_table_free(attr_checker);
-}
-
 _CX_ATR_NORETURN static void
 _cxml_p__handle_error(_cxml_parser *cxparser, _cxml_token *token) {
     /*
@@ -212,12 +202,14 @@ _cxml_p__check_equals(const char *str_val, const char *check, int len1, int len2
 static void
 _cxml_p__check_pred_entity(cxml_string *str, int *has, cxml_config *cfg) {
     /*
-     * inspect str for predefined entities
+     * inspect str for predefined entities (only flagged here, entities are
+     * handled by the printer when the text is written out)
      */
     // "<>&\"'"
     if (cfg->transpose_text) { // transpose forward
         // check if any untransposed predefined entity (&, <, >) exists in str
-        *has = strpbrk(cxml_string_as_raw(str), _CXML_PRED_ENTITY) ? 1 : 0;
+        const char *end = str->_raw_chars + str->_len;
+        *has = _cxml_find_pred_entity(str->_raw_chars, end) != end;
         return;
     }
     *has = -1;
@@ -258,23 +250,17 @@ int _cxml_is_ns_URI_equal(const char *found, const char *expected, int f_len, in
 }
 
 inline static void _backtrack_ns_scope(_cxml_parser *parser) {
-    struct _cxml_scope_table *scope = parser->current_scope;
-    parser->current_scope = scope->enclosing_scope;
-    _cxml_scope_table_free(scope);
+    // pop the namespaces declared by the element being closed
+    _cxml_ns_scope_leave(parser->current_scope);
 }
 
 inline static void _set_lname(cxml_name *name, int lname_len){
     // for when name has no prefix - local name is same as qualified name
-    // dirty hack -> since we do not want to copy lname
-    // we just have the `lname` pointer point to the beginning of `qname`
-    name->lname = cxml_string_as_raw(&name->qname);
     name->lname_len = lname_len;
 }
 
 inline static void _set_name(cxml_name *name, int pname_len, int lname_len){
     // for when name has a prefix
-    name->pname = cxml_string_as_raw(&name->qname);
-    name->lname = name->pname + pname_len + 1;
     name->pname_len = pname_len;
     name->lname_len = lname_len;
 }
@@ -340,10 +326,8 @@ static void x__name(_cxml_parser *cxparser) {
     {
         cxparser->root_element = node;
     }
-    // create a new namespace scope:
-    struct _cxml_scope_table *new_scope = _cxml_scope_table_new();
-    new_scope->enclosing_scope = cxparser->current_scope;
-    cxparser->current_scope = new_scope;
+    // open a new namespace scope:
+    _cxml_ns_scope_enter(cxparser->current_scope);
 }
 
 static void x__ns(_cxml_parser *cxparser){
@@ -472,12 +456,15 @@ static void x__ns(_cxml_parser *cxparser){
                                cxparser);
     _cxml_p__consume(cxparser, CXML_TOKEN_STRING);
     namespace->is_default = !is_prefix;
-    // insert the namespace into the current scope
-    if (_cxml_scope_table_insert(cxparser->current_scope,
-                             is_prefix ?
-                             cxml_string_as_raw(&namespace->prefix) :
-                             _cxml_xmlns_name,
-                             namespace) == 0x02)
+    // bind the namespace in the current scope
+    struct _cxml_ns_scope *scope = cxparser->current_scope;
+    int prefix = is_prefix ?
+                 _cxml_ns_scope_intern(scope, namespace->prefix._raw_chars,
+                                       _cxml_int_cast namespace->prefix._len) :
+                 _CXML_NS_DEFAULT_SYMBOL;
+    int uri = _cxml_ns_scope_intern(scope, namespace->uri._raw_chars,
+                                    _cxml_int_cast namespace->uri._len);
+    if (!_cxml_ns_scope_bind(scope, prefix, uri, namespace))
     {
         cxparser->err_msg = "CXML Parse Error: Duplicate namespaces "
                             "found in element declaration.";
@@ -525,7 +512,6 @@ static void x__attr(_cxml_parser *cxparser) {
                                    cxparser->current_tok.start,
                                    cxparser->current_tok.length,
                                    cxparser);
-        cxml_set_literal(&attr->number_value, cxparser->current_tok.literal_type, &attr->value);
         attr->parent = _cxml_stack__get(&cxparser->_cx_stack);
         _cxml_p__consume(cxparser, CXML_TOKEN_STRING);
         attr->parent->has_attribute = true;
@@ -765,9 +751,6 @@ static void x__text(_cxml_parser *cxparser) {
                 TEXT->has_entity = true; // useful for transposition
             }
         }
-        // literals
-        // set text literal type and numeric val if applicable
-        cxml_set_literal(&TEXT->number_value, cxparser->current_tok.literal_type, &TEXT->value);
         if (_cxml_node_type(TEXT->parent) == CXML_ELEM_NODE){
             cxml_list_append(&_unwrap_cxnode(cxml_elem_node, TEXT->parent)->children, TEXT);
             _unwrap_cxnode(cxml_elem_node, TEXT->parent)->has_text = 1;
@@ -853,53 +836,43 @@ _CX_ATR_NORETURN static void _cxml_ns_error(
                parser->cxlexer.line,
                "CXML Parse Error: Could not find namespace "
                "corresponding to the prefix",
-               name->pname_len, name->pname,
+               name->pname_len, cxml_name_pname(name),
                _for, cxml_string_as_raw(&name->qname))
 }
 
-static cxml_ns_node *_get_ns(
-        _cxml_parser *parser,
-        cxml_name *name,
-        const char* _name)
+inline static struct _cxml_ns_binding *_get_ns(_cxml_parser *parser, cxml_name *name)
 {
-    if (name){
-        char buff[name->pname_len + 1];
-        memcpy(buff, name->pname, name->pname_len);
-        buff[name->pname_len] = '\0';
-        return _cxml_scope_table_lookup(parser->current_scope, buff);
-    }
-    return _cxml_scope_table_lookup(parser->current_scope, _name);
+    return _cxml_ns_scope_lookup(parser->current_scope,
+                                 cxml_string_as_raw(&name->qname),
+                                 name->pname_len);
 }
 
 static void _resolve_namespace(_cxml_parser *parser, cxml_elem_node *elem)
 {
     // one way to optimize this is to not deal with namespace resolution
     // first try to resolve element
+    struct _cxml_ns_binding *binding;
     cxml_ns_node *ns;
-    if (elem->name.pname)
+    if (elem->name.pname_len)
     {
-        ns = _get_ns(parser, &elem->name, NULL);
-        if (ns == NULL){  // Constraint (2) Prefix Declared
+        binding = _get_ns(parser, &elem->name);
+        if (binding == NULL){  // Constraint (2) Prefix Declared
             _cxml_ns_error(parser, &elem->name, "for element");
         }
-        elem->namespace = ns;
+        elem->namespace = binding->ns;
         elem->is_namespaced = 1;
     }else if (parser->cfg.allow_default_namespace){ // we need to check for default namespaces
         // we do not need to check if ns is NULL or not, since ns is a default
-        ns = _get_ns(parser, NULL, _cxml_xmlns_name);
-        // we need to prevent global namespace 'xmlns' or 'xml' from being attached to `elem`
-        // since those aren't default namespaces (xmlns:xml=".../" && xmlns:xmlns=".../")
-        // the global `xml` namespace requires that the element or attribute
-        // explicitly uses the `xml` prefix, and the global `xmlns` namespace cannot be
-        // used as a namespace prefix with an element or attribute
-        if (ns && ns->is_default){ // only bind a default namespace to `elem`
+        binding = _cxml_ns_scope_current(parser->current_scope, _CXML_NS_DEFAULT_SYMBOL);
+        ns = binding ? binding->ns : NULL;
+        // only bind a default namespace to `elem`
+        if (ns && ns->is_default){
             elem->namespace = ns;
             elem->is_namespaced = 1;
         }
     }
     // next we resolve attributes
     cxml_attr_node *attr;
-    cxml_string expanded_name;
     cxml_for_each(node, &parser->attr_list)
     {
         attr = node;
@@ -913,26 +886,21 @@ static void _resolve_namespace(_cxml_parser *parser, cxml_elem_node *elem)
         if (!elem->attributes){
             elem->attributes = new_alloc_cxml_table();
         }
-        if (attr->name.pname){
-            ns = _get_ns(parser, &attr->name, NULL);
-            if (ns == NULL){  // Constraint (2) Prefix Declared
+        if (attr->name.pname_len){
+            binding = _get_ns(parser, &attr->name);
+            if (binding == NULL){  // Constraint (2) Prefix Declared
                 _cxml_ns_error(parser, &attr->name, "for attribute");
             }
-            attr->namespace = ns;
-            if (parser->cfg.ensure_ns_attribute_unique){
-                expanded_name = new_cxml_string();
-                // expand `x:name` to `foo-uri:name`
-                cxml_string_str_append(&expanded_name, &ns->uri);
-                cxml_string_append(&expanded_name, ":", 1);
-                cxml_string_append(&expanded_name, attr->name.lname, attr->name.lname_len);
-
-                // Constraint (4) Attributes Unique
-                if (cxml_table_put(&parser->attr_checker,
-                                   cxml_string_as_raw(&expanded_name),
-                                   cxml_string_as_raw(&expanded_name)) == 0x02)
-                {
-                    goto err;
-                }
+            attr->namespace = binding->ns;
+            // Constraint (4) Attributes Unique
+            // the expanded name `foo-uri:name` of `x:name` is the pair (uri, local name)
+            if (parser->cfg.ensure_ns_attribute_unique
+                && !_cxml_ns_scope_add_attr(parser->current_scope, binding->uri,
+                                            _cxml_ns_scope_intern(parser->current_scope,
+                                                                  cxml_name_lname(&attr->name),
+                                                                  attr->name.lname_len)))
+            {
+                goto err;
             }
             cxml_table_put(elem->attributes,
                            cxml_string_as_raw(&attr->name.qname),
@@ -955,9 +923,8 @@ static void _resolve_namespace(_cxml_parser *parser, cxml_elem_node *elem)
     }
     // free attributes stored earlier in x__attr()
     cxml_list_free(&parser->attr_list);
-    // free any allocated string and the attr_checker,
-    // used in namespace uniqueness validation
-    cxml_free_attr_checker(&parser->attr_checker);
+    // clear the expanded names used in namespace uniqueness validation
+    _cxml_ns_scope_clear_attrs(parser->current_scope);
 }
 
 static void x__elem(_cxml_parser *cxparser) {
@@ -1140,7 +1107,7 @@ static void x__dispatch_token(_cxml_parser *cxparser) {
 }
 
 static void _inject_global_namespaces(_cxml_parser *parser){
-    parser->current_scope =  _cxml_scope_table_new();
+    parser->current_scope = _cxml_ns_scope_new();
     parser->root_node->namespaces = new_alloc_cxml_list();
     cxml_ns_node *ns;
     for (int i = 0; i < 2; i++) {
@@ -1152,7 +1119,14 @@ static void _inject_global_namespaces(_cxml_parser *parser){
         cxml_string_append(&ns->uri,
                            _cxml_reserved_namespaces[i],
                            _cxml_reserved_namespaces_len[i]);
-        _cxml_scope_table_insert(parser->current_scope, _cxml_reserved_prefixes[i], ns);
+        _cxml_ns_scope_bind(parser->current_scope,
+                            _cxml_ns_scope_intern(parser->current_scope,
+                                                  _cxml_reserved_prefixes[i],
+                                                  _cxml_reserved_prefixes_len[i]),
+                            _cxml_ns_scope_intern(parser->current_scope,
+                                                  _cxml_reserved_namespaces[i],
+                                                  _cxml_reserved_namespaces_len[i]),
+                            ns);
         cxml_list_append(parser->root_node->namespaces, ns);
     }
 }
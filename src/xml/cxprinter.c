@@ -4,6 +4,7 @@
  */
 
 #include "xml/cxprinter.h"
+#include "utils/cxutf8hook.h"
 
 
 /***************************
@@ -69,6 +70,135 @@ inline static void _remove_newline(cxml_string *str){
 }
 
 
+/*
+ * check if the '&' at `chars[i]` starts an entity reference, which must be
+ * written out as is. Character references are escaped (like any standalone '&').
+ * Deformed references are errors in strict mode.
+ */
+static bool _is_reference(const char *chars, int i, int len, cxml_config *cfg){
+    // possible character reference &#[0-9]+ | &#x[0-9a-fA-F]+
+    if (i + 1 < len && chars[i + 1] == '#'){
+        if (cfg->strict_transpose
+            && ((i + 2) >= len || !_is_valid_char_reference(&chars[i + 2], len - (i + 2))))
+        {
+            __transpose_err("Invalid/deformed character reference found.", len, chars);
+        }
+        return false;
+    }
+    if (i + 2 < len && _is_valid_ent_reference(&chars[i + 2], len - (i + 2))){
+        return true;
+    }
+    if (cfg->strict_transpose){
+        __transpose_err("Invalid/deformed entity reference found.", len, chars);
+    }
+    return false;
+}
+
+static void _escape_text(
+        const char *chars,
+        int len,
+        cxml_string *acc,
+        bool is_cdata,
+        cxml_config *cfg)
+{
+    /*
+     * transpose forward, writing the transposed text directly into `acc`.
+     * runs of chars without predefined entities are appended at once.
+     */
+    const char *start = chars, *end = chars + len, *p = chars;
+    int _ind;
+    while ((p = _cxml_find_pred_entity(p, end)) != end)
+    {
+        switch(*p){
+            case '<':   _ind = 0x00;  break;
+            case '>':   _ind = 0x01;  break;
+            case '&':   _ind = 0x02;  break;
+            case '"':   _ind = 0x03;  break;
+            default:    _ind = 0x04;  break;
+        }
+        // strict_transpose transposes ALL predefined entities if true,
+        // and only '&', '<', '>' if false
+        if ((_ind > 0x02 && !cfg->strict_transpose)
+            // ensure we don't mistake any of the &amp;, &#38;,..etc for a standalone '&'
+            || (_ind == 0x02 && !is_cdata && _is_reference(chars, _cxml_int_cast(p - chars), len, cfg)))
+        {
+            p++;
+            continue;
+        }
+        cxml_string_append(acc, start, _cxml_int_cast(p - start));
+        cxml_string_append(acc, _cxml_pred_entities_t[_ind], _cxml_pred_entities_t_lens[_ind]);
+        start = ++p;
+    }
+    cxml_string_append(acc, start, _cxml_int_cast(end - start));
+}
+
+// longest reference considered when decoding text, e.g. &#x0010FFFF;
+#define _CXML_MAX_REFERENCE_LEN     (16)
+
+static int _decode_char_reference(const char *start, const char *end, char *buff){
+    // &#[0-9]+; | &#x[0-9a-fA-F]+;
+    // start is after '#', end is at ';'
+    u_int32_t ch = 0;
+    int base = 10;
+    if (start < end && *start == 'x'){
+        base = 16;
+        start++;
+    }
+    if (start == end) return 0;
+    for (; start < end; start++){
+        if (base == 10 && isdigit((unsigned char)*start)){
+            ch = ch * 10 + (*start - '0');
+        }else if (base == 16 && isxdigit((unsigned char)*start)){
+            ch = ch * 16 + (isdigit((unsigned char)*start) ? *start - '0'
+                                                           : (tolower((unsigned char)*start) - 'a') + 10);
+        }else{
+            return 0;
+        }
+        if (ch > 0x10FFFF) return 0;
+    }
+    // surrogates and nul aren't characters
+    if (!ch || (ch >= 0xD800 && ch <= 0xDFFF)) return 0;
+    return u8_wc_toutf8(buff, ch);
+}
+
+static void _unescape_text(const char *chars, int len, cxml_string *acc){
+    /*
+     * transpose backward, decoding predefined entities and character references
+     * directly into `acc`. Text between references is appended at once, and
+     * unknown or deformed references are kept as is.
+     */
+    const char *start = chars, *end = chars + len, *p = chars, *semi;
+    char buff[4];
+    int n, ind;
+    while ((p = memchr(p, '&', end - p)))
+    {
+        n = 0;
+        semi = memchr(p + 1, ';', _cxml_int_cast((end - (p + 1)) < _CXML_MAX_REFERENCE_LEN ?
+                                                 (end - (p + 1)) : _CXML_MAX_REFERENCE_LEN));
+        if (semi && p[1] == '#'){
+            n = _decode_char_reference(p + 2, semi, buff);
+        }else if (semi){
+            for (ind = 0; ind < _CXML_PRED_ENTITY_LEN; ind++){
+                if ((semi - p + 1) == _cxml_pred_entities_t_lens[ind]
+                    && !memcmp(p, _cxml_pred_entities_t[ind], _cxml_pred_entities_t_lens[ind]))
+                {
+                    buff[0] = *_cxml_pred_entities_ut[ind];
+                    n = 1;
+                    break;
+                }
+            }
+        }
+        if (!n){
+            p++;
+            continue;
+        }
+        cxml_string_append(acc, start, _cxml_int_cast(p - start));
+        cxml_string_append(acc, buff, n);
+        start = p = semi + 1;
+    }
+    cxml_string_append(acc, start, _cxml_int_cast(end - start));
+}
+
 void
 _transpose_text_entities(
         cxml_string *str,
@@ -96,119 +226,12 @@ _transpose_text_entities(
     // transpose backward:
     // &amp; -> &
     // &lt;  -> < ..etc
-    // cxml_string *str = text;
-
-    // predefined entity transpose
-
-    int _ind=0;
-    if (cfg->transpose_text && transpose_fwd) {
-        const char* chars = cxml_string_as_raw(str);
-        int chars_len = _cxml_int_cast cxml_string_len(str);
-        char ch;
-        for (int i = 0; i < chars_len; i++) {
-            ch = chars[i];
-            // is ch among xml predefined entities?
-            // this switch sets _ind to -1 if not so, else the index of
-            // ch in the predefined entities string/char array.
-            // this is then used to find the corresponding transformation
-            // in _cxml_pred_entities_t, as well as the right length for such
-            // transformation, and then forwarded to append.
-            // strict_transpose transposes ALL predefined entities if true,
-            // and only '&', '<', '>' if false
-            if (cfg->strict_transpose){
-                switch(ch){
-                    case '<':   _ind = 0x00;  break;
-                    case '>':   _ind = 0x01;  break;
-                    case '&':   _ind = 0x02;  break;
-                    case '"':   _ind = 0x03;  break;
-                    case '\'':  _ind = 0x04;  break;
-                    default:    _ind = -1;    break;
-                }
-            }else{
-                switch(ch){
-                    case '<':   _ind = 0x00;  break;
-                    case '>':   _ind = 0x01;  break;
-                    case '&':   _ind = 0x02;  break;
-                    default:    _ind = -1;    break;
-                }
-            }
-
-            if (_ind != -1)
-            {
-                if (is_cdata) goto append_transpose;
-
-                // ensure we don't mistake any of the &amp;, &quot;,..etc for a '&'
-                // since we're only matching first letters
-                if (_ind == 0x02)
-                {
-                    // append predefined entity to transpose since it's no match
-                    // i.e. transpose such '&' as it doesn't match any predefined
-                    // entity ("&lt;", "&gt;", "&amp;", "&quot;", "&apos;")
-                    // because it stands alone
-                    if (i+1 > chars_len)  goto append_transpose; // if not, it's not a match
-
-                    // possible character reference &#[0-9]+ | &#x[0-9a-fA-F]+
-                    if  (chars[i + 1] == '#')
-                    {
-                        if (cfg->strict_transpose
-                            && (((i + 2) >= chars_len)
-                                || !_is_valid_char_reference(&chars[i + 2], chars_len - (i + 2))))
-                        {
-                            __transpose_err("Invalid/deformed character reference found.",
-                                            chars_len, chars);
-                        }
-                        // escape the character found since it's invalid/deformed
-                        goto append_transpose;
-                    }
-                    else
-                    {
-                        if (((i + 2) >= chars_len)
-                            || !_is_valid_ent_reference(&chars[i + 2], chars_len - (i + 2)))
-                        {
-                            if (cfg->strict_transpose){
-                                __transpose_err("Invalid/deformed entity reference found.",
-                                                chars_len, chars);
-                            }
-                            // escape the character found since it's invalid/deformed
-                            goto append_transpose;
-                        }
-                        // entity reference is valid
-                        goto append_char;
-                    }
-                }
-                // append transpose since a predefined entity match occurred.
-                goto append_transpose;
-            }
-            else{
-                // append char since no predefined entity match occurred.
-                goto append_char;
-            }
-            // append ch char if we match a predefined
-            // entity or character reference in text when ch is '&',
-            // i.e. when ch overlaps with any of the predefined entities.
-            // This can only happen when ch is '&'.
-            // This means that ch is not a standalone '&' but actually part of
-            // a predefined entity in text --> (&amp;, &gt;, etc.)
-            append_char:
-            cxml_string_append(transpose, &ch, 1);
-            continue;
-
-            // append predefined entity if ch doesn't overlap
-            // with any predefined entity or character reference
-            append_transpose:
-            cxml_string_append(transpose, _cxml_pred_entities_t[_ind],
-                               _cxml_pred_entities_t_lens[_ind]);
-        }
-    }
-    else if (cfg->transpose_text && !transpose_fwd)
-    {
-        cxml_string into = new_cxml_string();
-        for (int i = 0; i < _CXML_PRED_ENTITY_LEN; i++) {
-            // do not modify `str`
-            cxml_string_replace(str, _cxml_pred_entities_t[i], _cxml_pred_entities_ut[i], &into);
-        }
-        cxml_string_str_append(transpose, &into);
-        cxml_string_free(&into);
+    // &#60; -> < ..etc
+    if (!cfg->transpose_text || !cxml_string_len(str)) return;
+    if (transpose_fwd){
+        _escape_text(str->_raw_chars, _cxml_int_cast str->_len, transpose, is_cdata, cfg);
+    }else{
+        _unescape_text(str->_raw_chars, _cxml_int_cast str->_len, transpose);
     }
 }
 
@@ -225,17 +248,38 @@ inline static void _space_indent(cxml_string* str, int level, cxml_config *cfg){
     }
 }
 
-static void _text(
+static void _text_chars(
         cxml_text_node* text,
+        const char *chars,
+        int len,
         cxml_string* acc,
-        int transpose_fwd,
         cxml_config *cfg)
 {
-    // transpose if the parser is configured to transpose text
+    // transpose forward if the parser is configured to transpose text
     // and if entities exist
     if (cfg->transpose_text && (text->has_entity || text->is_cdata)){
-        _transpose_text_entities(&text->value, acc, transpose_fwd, text->is_cdata, cfg);
+        _escape_text(chars, len, acc, text->is_cdata, cfg);
     }else{ // else normal append
+        cxml_string_append(acc, chars, len);
+    }
+}
+
+static void _text(
+        cxml_text_node* text,
+        cxml_string* acc,
+        int transpose_fwd,
+        cxml_config *cfg)
+{
+    if (transpose_fwd){
+        _text_chars(text, text->value._raw_chars, _cxml_int_cast text->value._len, acc, cfg);
+    }else if (cfg->transpose_text && (text->has_entity || text->is_cdata)){
+        // decoded on first access, and kept on the node
+        if (!text->decoded){
+            text->decoded = new_alloc_cxml_string();
+            _unescape_text(text->value._raw_chars, _cxml_int_cast text->value._len, text->decoded);
+        }
+        cxml_string_str_append(acc, text->decoded);
+    }else{
         cxml_string_str_append(acc, &text->value);
     }
 }
@@ -512,40 +556,28 @@ static void _cxml_print_text(
         const int* level,
         cxml_config *cfg)
 {
+    // strip text (in place, the text is written out directly from the node's value)
+    const char *chars = text_node->value._raw_chars;
+    int start = 0, end = _cxml_int_cast text_node->value._len;
+    while (start < end && isspace((unsigned char)chars[start])) start++;
+    while (end > start && isspace((unsigned char)chars[end - 1])) end--;
 
-    // temporarily hold text_node->value object
-    cxml_string tmp = text_node->value;
-
-    // strip text, and assign the new cxml_string to text_node temporarily
-    cxml_string stripped = new_cxml_string();
-    cxml_string_strip_space(&text_node->value, &stripped);
-    text_node->value = stripped;
-
-    // check if cxml_string returned is emtpy, if so, skip appending anything.
-    bool is_empty = !text_node->value._len;
-    if (is_empty) goto free_label;
+    // check if the stripped text is emtpy, if so, skip appending anything.
+    if (start == end) return;
 
     // add space indent for justification/alignment with nodes before it
     _space_indent(str_acc, (*level+1), cfg);
 
     if (text_node->is_cdata){
         cxml_string_append(str_acc, "<![CDATA[", 9);
-        _text(text_node, str_acc, 1, cfg);
+        _text_chars(text_node, chars + start, end - start, str_acc, cfg);
         cxml_string_append(str_acc, "]]>", 3);
     }else{
         // transpose forward when printing element to string, and forward
         // when printing element to file (to ensure that xml doc is well-defined)
-        _text(text_node, str_acc, 1, cfg);
+        _text_chars(text_node, chars + start, end - start, str_acc, cfg);
     }
-
-    free_label:
-    // free the stripped cxml_string
-    cxml_string_free(&text_node->value);
-
-    // assign text_node its original value
-    text_node->value = tmp;
-    !is_empty ?
-    cxml_string_append(str_acc, "\n", 1) : (void)0;
+    cxml_string_append(str_acc, "\n", 1);
 }
 
 
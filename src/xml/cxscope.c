@@ -5,31 +5,181 @@
 
 #include "xml/cxscope.h"
 
-void _cxml_scope_table_init(struct _cxml_scope_table *table){
-    table->enclosing_scope = NULL;
-    cxml_table_init(&table->symbols);
+#define _CXML_NS_INIT_CAP   (16)
+
+inline static uint32_t _cxml_ns_hash(const char *name, int len){
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < len; i++){
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+// find the hash slot of `name`, either holding its symbol, or empty.
+static int _cxml_ns_slot(struct _cxml_ns_scope *scope, const char *name, int len, uint32_t hash){
+    int mask = scope->slot_cap - 1, i = (int)(hash & (uint32_t)mask), sym;
+    struct _cxml_ns_symbol *symbol;
+    while ((sym = scope->slots[i])){
+        symbol = &scope->symbols[sym - 1];
+        if (symbol->hash == hash && symbol->len == len && !memcmp(symbol->name, name, len)){
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return i;
 }
 
-void _cxml_scope_table_free(struct _cxml_scope_table *table){
-    if (!table) return ;
-    cxml_table_free(&table->symbols);
-    FREE(table);
+static void _cxml_ns_scope__grow_slots(struct _cxml_ns_scope *scope){
+    FREE(scope->slots);
+    scope->slot_cap = scope->slot_cap ? scope->slot_cap * 2 : _CXML_NS_INIT_CAP;
+    scope->slots = CALLOC(int, scope->slot_cap);
+    struct _cxml_ns_symbol *symbol;
+    for (int i = 0; i < scope->sym_size; i++){
+        symbol = &scope->symbols[i];
+        scope->slots[_cxml_ns_slot(scope, symbol->name, symbol->len, symbol->hash)] = i + 1;
+    }
 }
 
-struct _cxml_scope_table * _cxml_scope_table_new(){
-    struct _cxml_scope_table *scope = ALLOC(struct _cxml_scope_table, 1);
-    _cxml_scope_table_init(scope);
+struct _cxml_ns_scope *_cxml_ns_scope_new(){
+    struct _cxml_ns_scope *scope = CALLOC(struct _cxml_ns_scope, 1);
+    _cxml_ns_scope__grow_slots(scope);
+    // the default namespace has the empty prefix
+    _cxml_ns_scope_intern(scope, "", 0);
     return scope;
 }
 
-void* _cxml_scope_table_lookup(struct _cxml_scope_table *table, const char *name){
-    if (!table) return NULL;
-    void *val = cxml_table_get(&table->symbols, name);
-    if (val == NULL) return _cxml_scope_table_lookup(table->enclosing_scope, name);
-    return val;
+void _cxml_ns_scope_free(struct _cxml_ns_scope *scope){
+    if (!scope) return;
+    for (int i = 0; i < scope->sym_size; i++){
+        FREE(scope->symbols[i].name);
+    }
+    FREE(scope->symbols);
+    FREE(scope->current);
+    FREE(scope->slots);
+    FREE(scope->bindings);
+    FREE(scope->frames);
+    FREE(scope->attrs);
+    FREE(scope);
+}
+
+/*
+ * Obtain the symbol of `name` (`len` chars), interning `name` if not yet interned.
+ */
+int _cxml_ns_scope_intern(struct _cxml_ns_scope *scope, const char *name, int len){
+    uint32_t hash = _cxml_ns_hash(name, len);
+    int slot = _cxml_ns_slot(scope, name, len, hash);
+    if (scope->slots[slot]) return scope->slots[slot] - 1;
+    if (scope->sym_size == scope->sym_cap){
+        scope->sym_cap = scope->sym_cap ? scope->sym_cap * 2 : _CXML_NS_INIT_CAP;
+        scope->symbols = RALLOC(struct _cxml_ns_symbol, scope->symbols, scope->sym_cap);
+        scope->current = RALLOC(int, scope->current, scope->sym_cap);
+    }
+    int sym = scope->sym_size++;
+    struct _cxml_ns_symbol *symbol = &scope->symbols[sym];
+    symbol->name = ALLOC(char, len + 1);
+    if (len) memcpy(symbol->name, name, len);
+    symbol->name[len] = '\0';
+    symbol->len = len;
+    symbol->hash = hash;
+    scope->current[sym] = -1;
+    scope->slots[slot] = sym + 1;
+    // keep the load factor of the slots under 0.5
+    if (scope->sym_size * 2 > scope->slot_cap){
+        _cxml_ns_scope__grow_slots(scope);
+    }
+    return sym;
+}
+
+/*
+ * Obtain the symbol of `name` (`len` chars), or -1 if `name` was never interned.
+ */
+int _cxml_ns_scope_find(struct _cxml_ns_scope *scope, const char *name, int len){
+    int slot = _cxml_ns_slot(scope, name, len, _cxml_ns_hash(name, len));
+    return scope->slots[slot] - 1;
+}
+
+/*
+ * Open the frame of an element
+ */
+void _cxml_ns_scope_enter(struct _cxml_ns_scope *scope){
+    if (scope->depth == scope->frame_cap){
+        scope->frame_cap = scope->frame_cap ? scope->frame_cap * 2 : _CXML_NS_INIT_CAP;
+        scope->frames = RALLOC(int, scope->frames, scope->frame_cap);
+    }
+    scope->frames[scope->depth++] = scope->size;
+}
+
+/*
+ * Close the frame of an element, popping the bindings declared in the frame.
+ */
+void _cxml_ns_scope_leave(struct _cxml_ns_scope *scope){
+    if (!scope->depth) return;
+    int start = scope->frames[--scope->depth];
+    struct _cxml_ns_binding *binding;
+    while (scope->size > start){
+        binding = &scope->bindings[--scope->size];
+        scope->current[binding->symbol] = binding->shadowed;
+    }
+}
+
+/*
+ * Bind the prefix `symbol` to the namespace `ns` (whose name is the symbol `uri`)
+ * in the current frame.
+ * Returns 0 if the prefix is already bound in the current frame, 1 otherwise.
+ */
+int _cxml_ns_scope_bind(struct _cxml_ns_scope *scope, int symbol, int uri, void *ns){
+    int current = scope->current[symbol];
+    if (current != -1 && current >= (scope->depth ? scope->frames[scope->depth - 1] : 0)){
+        return 0;
+    }
+    if (scope->size == scope->capacity){
+        scope->capacity = scope->capacity ? scope->capacity * 2 : _CXML_NS_INIT_CAP;
+        scope->bindings = RALLOC(struct _cxml_ns_binding, scope->bindings, scope->capacity);
+    }
+    scope->bindings[scope->size].symbol = symbol;
+    scope->bindings[scope->size].uri = uri;
+    scope->bindings[scope->size].shadowed = current;
+    scope->bindings[scope->size].ns = ns;
+    scope->current[symbol] = scope->size++;
+    return 1;
+}
+
+/*
+ * Obtain the current binding of the prefix `symbol`, NULL if none.
+ */
+struct _cxml_ns_binding *_cxml_ns_scope_current(struct _cxml_ns_scope *scope, int symbol){
+    if (symbol < 0 || scope->current[symbol] == -1) return NULL;
+    return &scope->bindings[scope->current[symbol]];
+}
+
+/*
+ * Obtain the current binding of `prefix` (`len` chars), NULL if none.
+ */
+struct _cxml_ns_binding *_cxml_ns_scope_lookup(struct _cxml_ns_scope *scope, const char *prefix, int len){
+    return _cxml_ns_scope_current(scope, _cxml_ns_scope_find(scope, prefix, len));
+}
+
+/*
+ * Record the expanded name (`uri`, `lname`) of a namespaced attribute of the current element.
+ * Returns 0 if the current element already has an attribute with the same expanded name.
+ * (elements have few namespaced attributes, a linear scan is cheaper than hashing)
+ */
+int _cxml_ns_scope_add_attr(struct _cxml_ns_scope *scope, int uri, int lname){
+    for (int i = 0; i < scope->attr_size; i++){
+        if (scope->attrs[i].uri == uri && scope->attrs[i].lname == lname) return 0;
+    }
+    if (scope->attr_size == scope->attr_cap){
+        scope->attr_cap = scope->attr_cap ? scope->attr_cap * 2 : _CXML_NS_INIT_CAP;
+        scope->attrs = RALLOC(struct _cxml_ns_attr, scope->attrs, scope->attr_cap);
+    }
+    scope->attrs[scope->attr_size].uri = uri;
+    scope->attrs[scope->attr_size].lname = lname;
+    scope->attr_size++;
+    return 1;
 }
 
-int _cxml_scope_table_insert(struct _cxml_scope_table *table, const char *name, void *symbol){
-    if (!table) return -1;
-    return cxml_table_put(&table->symbols, name, symbol);
+void _cxml_ns_scope_clear_attrs(struct _cxml_ns_scope *scope){
+    scope->attr_size = 0;
 }
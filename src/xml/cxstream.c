@@ -5,8 +5,11 @@
 
 #include <errno.h>
 #include "xml/cxlexer.h"
+#include "utils/cxutf8hook.h"
 
 #define _cxml__def_chunk_size   (0x100000)
+// number of bytes inspected when detecting the encoding of a file
+#define _cxml__enc_probe_size   (256)
 
 
 void _cxml__open_stream(_cxml_stream *stream, const char *fn, size_t chunk_size) {
@@ -31,6 +34,12 @@ void _cxml_stream_init(_cxml_stream* stream_obj,
         _cxml__open_stream(stream_obj, filename, stream_obj->_chunk_curr_size);
         stream_obj->_is_open = 1;
         stream_obj->_nbytes_read_into_sbuff = 0;
+        stream_obj->_nbytes_unchecked = 0;
+        stream_obj->_encoding = CXML_ENC_UNKNOWN;
+        stream_obj->_raw_buff = NULL;
+        stream_obj->_raw_size = 0;
+        stream_obj->_raw_cap = 0;
+        stream_obj->_eof = 0;
         stream_obj->file_name = filename;
     }
 }
@@ -39,6 +48,124 @@ void _cxml__close_stream(_cxml_stream *stream) {
     stream->_is_open = 0;
     stream->_chunk_curr_size ? FREE(stream->_stream_buff) : (void)0;
     stream->_file ? fclose(stream->_file) : 0;
+    FREE(stream->_raw_buff);
+    stream->_raw_buff = NULL;
+}
+
+static size_t _cxml__fread(_cxml_stream *stream, char *dest, size_t size){
+    size_t count = fread(dest, sizeof(char), size, stream->_file);
+    if (count < size && !feof(stream->_file)){
+        cxml_error("CXML Error: Error occurred while streaming file\n");
+    }
+    return count;
+}
+
+/*
+ * Is `name` (`len` chars) a name of the ISO-8859-1 encoding?
+ */
+static bool _cxml__is_latin1(const char *name, size_t len){
+    static const char *names[] = {"ISO-8859-1", "ISO_8859-1", "ISO8859-1", "LATIN1", "LATIN-1", "L1"};
+    size_t j;
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++){
+        if (strlen(names[i]) != len) continue;
+        for (j = 0; j < len && toupper((unsigned char)name[j]) == names[i][j]; j++);
+        if (j == len) return true;
+    }
+    return false;
+}
+
+/*
+ * Obtain the encoding named in the xml declaration at the start of `buff`,
+ * CXML_ENC_UTF8 if none (or if the encoding isn't supported).
+ */
+static _cxml_encoding_t _cxml__declared_encoding(const char *buff, size_t len){
+    if (len < 5 || memcmp(buff, "<?xml", 5)) return CXML_ENC_UTF8;
+    const char *end = buff + len, *p, *name;
+    for (p = buff + 5; p + 8 < end && !(p[0] == '?' && p[1] == '>'); p++){
+        if (memcmp(p, "encoding", 8)) continue;
+        p += 8;
+        while (p < end && (isspace((unsigned char)*p) || *p == '=')) p++;
+        if (p >= end || (*p != '"' && *p != '\'')) break;
+        name = ++p;
+        while (p < end && *p != '"' && *p != '\'') p++;
+        if (p < end && _cxml__is_latin1(name, (size_t)(p - name))) return CXML_ENC_LATIN1;
+        break;
+    }
+    return CXML_ENC_UTF8;
+}
+
+/*
+ * Detect the encoding of the file from its byte order mark, or its xml declaration.
+ * The inspected bytes are kept in the raw buffer.
+ */
+static void _cxml__detect_encoding(_cxml_stream *stream){
+    stream->_raw_cap = _cxml__enc_probe_size;
+    stream->_raw_buff = ALLOCR(char, stream->_raw_cap, "Not enough memory to read file (%s)\n",
+                               stream->file_name);
+    stream->_raw_size = _cxml__fread(stream, stream->_raw_buff, _cxml__enc_probe_size);
+    unsigned char *b = (unsigned char *)stream->_raw_buff;
+    size_t n = stream->_raw_size;
+    if (n >= 2 && ((b[0] == 0xFF && b[1] == 0xFE) || (n >= 4 && b[0] == '<' && !b[1] && b[2] == '?' && !b[3]))){
+        stream->_encoding = CXML_ENC_UTF16LE;
+    }else if (n >= 2 && ((b[0] == 0xFE && b[1] == 0xFF) || (n >= 4 && !b[0] && b[1] == '<' && !b[2] && b[3] == '?'))){
+        stream->_encoding = CXML_ENC_UTF16BE;
+    }else{
+        stream->_encoding = _cxml__declared_encoding(stream->_raw_buff, n);
+    }
+}
+
+/*
+ * Read at most `size` bytes of utf-8 encoded input from the file into `dest`,
+ * transcoding the input if the file isn't utf-8 encoded.
+ * Returns the number of bytes written into `dest`. `stream->_eof` is set once the
+ * file is exhausted, in which case less than `size` bytes are written.
+ */
+size_t _cxml__stream_read(_cxml_stream *stream, char *dest, size_t size){
+    if (stream->_encoding == CXML_ENC_UNKNOWN){
+        _cxml__detect_encoding(stream);
+    }
+    size_t count = 0, in, consumed;
+    if (stream->_encoding == CXML_ENC_UTF8){
+        // hand over bytes left from the detection, then read straight into the stream buffer
+        if (stream->_raw_size){
+            count = stream->_raw_size < size ? stream->_raw_size : size;
+            memcpy(dest, stream->_raw_buff, count);
+            memmove(stream->_raw_buff, stream->_raw_buff + count, stream->_raw_size - count);
+            stream->_raw_size -= count;
+        }
+        if (count < size){
+            count += _cxml__fread(stream, dest + count, size - count);
+        }
+        stream->_eof = count < size;
+        return count;
+    }
+    /*
+     * a transcoded chunk can be larger than its input: at most twice as large for latin-1,
+     * and one and a half times as large for utf-16. Taking in (size - 2) / 2 bytes per
+     * read therefore always leaves room for the nul terminator in `dest`.
+     */
+    in = (size - 2) / 2;
+    if (stream->_raw_cap < in){
+        stream->_raw_cap = in;
+        stream->_raw_buff = RALLOCR(char, stream->_raw_buff, in, "Not enough memory to continue "
+                                    "streaming file: '%s'\n", stream->file_name);
+    }
+    if (stream->_raw_size < in && !feof(stream->_file)){
+        stream->_raw_size += _cxml__fread(stream, stream->_raw_buff + stream->_raw_size, in - stream->_raw_size);
+    }
+    if (in > stream->_raw_size) in = stream->_raw_size;
+    bool final = feof(stream->_file) && in == stream->_raw_size;
+    if (stream->_encoding == CXML_ENC_LATIN1){
+        count = u8_from_latin1(dest, stream->_raw_buff, in);
+        consumed = in;
+    }else{
+        count = u8_from_utf16(dest, stream->_raw_buff, in,
+                              stream->_encoding == CXML_ENC_UTF16BE, final, &consumed);
+    }
+    memmove(stream->_raw_buff, stream->_raw_buff + consumed, stream->_raw_size - consumed);
+    stream->_raw_size -= consumed;
+    stream->_eof = final && !stream->_raw_size;
+    return count;
 }
 
 void _cxml__adjust_stream_buffer(_cxml_lexer *cxlexer) {
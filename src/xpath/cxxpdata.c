@@ -3,7 +3,9 @@
  * Distributed under the terms of the MIT license.
  */
 
-#include "xpath/cxxpdata.h"
+#include "xpath/cxxpparser.h"
+#include <math.h>
+#include <float.h>
 
 void _cxml_xp_data_init(_cxml_xp_data **data) {
     (*data)->type = CXML_XP_DATA_NIL;
@@ -26,7 +28,7 @@ static void _cxml_stringify_node(void* root, cxml_string* acc, bool check_type){
             text = child;
             // stop searching immediately we confirm that at least one text node's
             // numeric type is NaN
-            if (check_type && text->number_value.type == CXML_NUMERIC_NAN_T){
+            if (check_type && _cxml_get_node_number(text)->type == CXML_NUMERIC_NAN_T){
                 break;
             }
             cxml_string_str_append(acc, &text->value);
@@ -78,11 +80,79 @@ static void __get_string_val(void* node, cxml_string* acc, bool check_type){
 }
 
 
+// string value of nodes without one (CXML_XHDR_NODE & CXML_DTD_NODE)
+static cxml_string _cxml_xp__empty_str = {0};
+
+/*
+ * Obtain the text node of `node` if it is the only child of `node`, NULL otherwise.
+ */
+inline static cxml_text_node *_cxml_xp__sole_text_child(void *node){
+    cxml_list *children = _cxml__get_node_children(node);
+    if (cxml_list_size(children) != 1) return NULL;
+    void *child = cxml_list_get(children, 0);
+    return _cxml_node_type(child) == CXML_TEXT_NODE ? child : NULL;
+}
+
 /*
  * xpath cxml-node value getters
  */
+
+/*
+ * Obtain the string value of `node` as a borrowed reference.
+ * The string values of elements (and roots) having more than a single text child
+ * are built once, and kept for the duration of the query, since the same nodes
+ * are usually converted repeatedly when filtering, and comparing node-sets.
+ * They aren't kept across queries, as the document may be modified in between;
+ * frozen documents (see core/cxfrozen.h) can't be, but need no such memo: the
+ * texts of an element are contiguous in their tables (see cxml_frozen_text()).
+ */
+cxml_string *_cxml_xp__node_string_ref(void* node /*: cxml node*/){
+    if (!node) return &_cxml_xp__empty_str;
+    switch (_cxml_node_type(node))
+    {
+        case CXML_TEXT_NODE:
+            return &_unwrap_cxtext_node(node)->value;
+        case CXML_COMM_NODE:
+            return &_unwrap_cxcomm_node(node)->value;
+        case CXML_ATTR_NODE:
+            return &_unwrap_cxattr_node(node)->value;
+        case CXML_PI_NODE:
+            return &_unwrap_cxpi_node(node)->value;
+        case CXML_ROOT_NODE:
+        case CXML_ELEM_NODE:
+        {
+            cxml_text_node *text = _cxml_xp__sole_text_child(node);
+            if (text) return &text->value;
+            cxml_string *str = cxml_table_get_raw(&_xpath_parser.str_values, node);
+            if (!str){
+                str = ALLOC(cxml_string, 1);
+                cxml_string_init(str);
+                _cxml_stringify_node(node, str, false);
+                cxml_table_put_raw(&_xpath_parser.str_values, node, str);
+            }
+            return str;
+        }
+        // CXML_XHDR_NODE & CXML_DTD_NODE not considered
+        default:
+            return &_cxml_xp__empty_str;
+    }
+}
+
+/*
+ * Free the string values memoized by _cxml_xp__node_string_ref()
+ */
+void _cxml_xp__forget_string_vals(){
+    cxml_string *str;
+    cxml_for_each(node, &_xpath_parser.str_values.keys){
+        str = cxml_table_get_raw(&_xpath_parser.str_values, node);
+        cxml_string_free(str);
+        FREE(str);
+    }
+    cxml_table_free(&_xpath_parser.str_values);
+}
+
 void _cxml_xp__node_string_val(void* node /*: cxml node*/, cxml_string* acc){
-    __get_string_val(node, acc, false);
+    cxml_string_str_append(acc, _cxml_xp__node_string_ref(node));
 }
 
 void _cxml_xp__node_num_val(void* node /*: cxml node*/, cxml_number *num){
@@ -93,13 +163,20 @@ void _cxml_xp__node_num_val(void* node /*: cxml node*/, cxml_number *num){
     switch(_cxml_get_node_type(node))
     {
         case CXML_TEXT_NODE:
-            *num = _unwrap_cxtext_node(node)->number_value;
-            break;
         case CXML_ATTR_NODE:
-            *num = _unwrap_cxattr_node(node)->number_value;
+            *num = *_cxml_get_node_number(node);
             break;
         default:
         {
+            // an element with a single text child has the number of its text
+            cxml_text_node *text;
+            if ((_cxml_get_node_type(node) == CXML_ELEM_NODE
+                 || _cxml_get_node_type(node) == CXML_ROOT_NODE)
+                && (text = _cxml_xp__sole_text_child(node)))
+            {
+                *num = *_cxml_get_node_number(text);
+                break;
+            }
             cxml_string str = new_cxml_string();
             __get_string_val(node, &str, true);
             *num = cxml_literal_to_num(&str);
@@ -139,14 +216,14 @@ void _cxml_xp__node_lname_val(void *node /*: cxml node*/, cxml_string *name){
     switch(_cxml_get_node_type(node))
     {
         case CXML_ELEM_NODE:
-            _unwrap_cxelem_node(node)->name.lname ?
-            cxml_string_append(name, _unwrap_cxelem_node(node)->name.lname,
+            _unwrap_cxelem_node(node)->name.lname_len ?
+            cxml_string_append(name, cxml_name_lname(&_unwrap_cxelem_node(node)->name),
                                _unwrap_cxelem_node(node)->name.lname_len) :
             cxml_string_append(name, "", 1);
             break;
         case CXML_ATTR_NODE:
-            _unwrap_cxattr_node(node)->name.lname ?
-            cxml_string_append(name, _unwrap_cxattr_node(node)->name.lname,
+            _unwrap_cxattr_node(node)->name.lname_len ?
+            cxml_string_append(name, cxml_name_lname(&_unwrap_cxattr_node(node)->name),
                                    _unwrap_cxattr_node(node)->name.lname_len) :
             cxml_string_append(name, "", 1);
             break;
@@ -191,8 +268,38 @@ void _cxml_xp_data_to_numeric(_cxml_xp_data *data, cxml_number *num){
     }
 }
 
+/*
+ * Formats a number the way XPath's string() function does: integers
+ * without a fractional part ("1", "-2"), "NaN", "Infinity"/"-Infinity",
+ * negative zero as "0", and every other number with just enough decimal
+ * digits to tell it apart from its neighbours, never in exponent notation.
+ */
+static int _cxml_xp__number_to_chars(double val, char *buff, int size) {
+    if (isnan(val)) {
+        return snprintf(buff, size, "NaN");
+    } else if (isinf(val)) {
+        return snprintf(buff, size, val < 0 ? "-Infinity" : "Infinity");
+    } else if (val == 0) {
+        return snprintf(buff, size, "0");
+    } else if (val == floor(val)) {
+        return snprintf(buff, size, "%.0f", val);
+    }
+    // find the fewest significant digits that still read back as `val`,
+    // then print that many digits in positional notation.
+    int prec;
+    for (prec = 1; prec < DBL_DECIMAL_DIG; prec++) {
+        snprintf(buff, size, "%.*e", prec - 1, val);
+        if (strtod(buff, NULL) == val) break;
+    }
+    snprintf(buff, size, "%.*e", prec - 1, val);
+    int exp = (int)strtol(strchr(buff, 'e') + 1, NULL, 10);
+    int frac = prec - 1 - exp;
+    return snprintf(buff, size, "%.*f", frac > 0 ? frac : 0, val);
+}
+
 void _cxml_xp_data_to_string(_cxml_xp_data *data, cxml_string *str) {
-#define _BUFF_SIZE  100
+// enough for the digits of DBL_MAX or of the smallest subnormal double
+#define _BUFF_SIZE  400
     switch (data->type)
     {
         case CXML_XP_DATA_NUMERIC:
@@ -203,7 +310,7 @@ void _cxml_xp_data_to_string(_cxml_xp_data *data, cxml_string *str) {
             if (num->type == CXML_NUMERIC_NAN_T){
                 cxml_string_append(str, "NaN", 3);
             }else{
-                chars = snprintf(buff, _BUFF_SIZE, "%lf", num->dec_val);
+                chars = _cxml_xp__number_to_chars(num->dec_val, buff, _BUFF_SIZE);
                 cxml_string_append(str, buff, chars);
             }
             break;
@@ -273,13 +380,15 @@ void _cxml_xp_data_to_boolean(_cxml_xp_data *data, bool *bol){
 /*
  * xpath data management functions
  */
-void _cxml_xp_data_free(_cxml_xp_data *data){
-    if (data->type == CXML_XP_DATA_STRING){
-        cxml_string_free(&data->str);
-    }else if (data->type == CXML_XP_DATA_NODESET){
-        cxml_set_free(&data->nodeset);
+void _cxml_xp_data_free(void *data /*: _cxml_xp_data*/){
+    // data objects live in the evaluation arena (see _cxml_xp_new_data()),
+    // only their contents are freed here.
+    _cxml_xp_data *d = data;
+    if (d->type == CXML_XP_DATA_STRING){
+        cxml_string_free(&d->str);
+    }else if (d->type == CXML_XP_DATA_NODESET){
+        cxml_set_free(&d->nodeset);
     }
-    FREE(data);
 }
 
 void _cxml_xp_data_clear(_cxml_xp_data *data){
@@ -315,3 +424,24 @@ void _cxml_xp_data_clear(_cxml_xp_data *data){
     _cxml_xp_data_init(&data);
 }
 
+
+void _cxml_xp_data_copy(_cxml_xp_data *cpy, _cxml_xp_data *ori){
+    // copy the contents of `ori` into the (cleared) data `cpy`
+    switch(ori->type)
+    {
+        case CXML_XP_DATA_STRING:
+            cxml_string_dcopy(&cpy->str, &ori->str);
+            break;
+        case CXML_XP_DATA_NODESET:
+            cxml_set_copy(&cpy->nodeset, &ori->nodeset);
+            break;
+        case CXML_XP_DATA_NUMERIC:
+            cpy->number = ori->number;
+            break;
+        case CXML_XP_DATA_BOOLEAN:
+            cpy->boolean = ori->boolean;
+            break;
+        default: break;
+    }
+    cpy->type = ori->type;
+}
@@ -4,6 +4,9 @@
  */
 
 #include "xpath/cxxpeval.h"
+#include "core/cxindex.h"
+#include "xpath/cxxpvm.h"
+#include <math.h>
 
 
 #define _CXML_MAX_CACHEABLE_SET_SIZE (500000)
@@ -12,12 +15,20 @@
 /*************************************************************/
 extern void query_string(const char *expr);
 
+extern void _cxml_xp_lexer_init(_cxml_xp_lexer *xplexer, const char *expr);
+
 extern void cxml_set__init_with(cxml_set *recipient, cxml_set *donor);
 
 static bool is_not_prolog_type(_cxml_node_t node_type);
 
 static bool _evaluate_predicate_expr(_cxml_xp_data *res_d);
 
+static bool _test_predicate_expr(cxml_xp_astnode *expr_node);
+
+static bool _test_predicate(cxml_xp_predicate *predicate);
+
+_cxml_xp_data *_cxml_xp_invariant_value(cxml_xp_astnode * ast_node);
+
 inline static void
 _process_nametest(cxml_elem_node *elem,
                   cxml_xp_nodetest *node_test,
@@ -33,6 +44,8 @@ _process_typetest(
 
 static void cxml_xp_visit_Predicate(cxml_xp_predicate *node);
 
+static void _sort_nodeset_by_pos(cxml_list *nodes);
+
 /*************************************************************/
 
 
@@ -47,83 +60,113 @@ inline static cxml_ns_node* _get_xml_namespace(){
     return xml_ns;
 }
 
+_CX_ATR_NORETURN static void _cxml_xp_unknown_prefix(cxml_name *name){
+    int buff_size = name->pname_len + 40;
+    char buff[buff_size];
+    snprintf(buff, buff_size, "Unknown namespace prefix - `%.*s`",
+             name->pname_len, cxml_name_pname(name));
+    _cxml_xp_eval_err(buff);
+}
+
+// obtain the namespace bound to the prefix of `node_test` in the namespaces declared
+// by `scope` and its ancestors
+static cxml_ns_node *_resolve_prefix(cxml_xp_nodetest *node_test, cxml_elem_node *scope){
+    cxml_name *name = &node_test->name_test.name;
+    while (scope->_type != CXML_ROOT_NODE)
+    {
+        if (scope->namespaces){
+            cxml_for_each(_ns, scope->namespaces)
+            {
+                if (!(_unwrap_cxnode(cxml_ns_node, _ns))->is_default
+                    && cxml_string_lraw_equals(&(_unwrap_cxnode(cxml_ns_node, _ns))->prefix,
+                                               cxml_name_pname(name), name->pname_len))
+                {
+                    return _ns;
+                }
+            }
+        }
+        scope = scope->parent;
+    }
+    // check if the namespace referenced was the global namespace 'xml'
+    if (memcmp(cxml_string_as_raw(&name->qname),
+               _CXML_RESERVED_NS_PREFIX_XML,
+               _CXML_RESERVED_NS_PREFIX_XML_LEN) == 0)
+    {
+        // check if the namespace is available
+        if (!_xpath_parser.xml_namespace)
+        {
+            _xpath_parser.xml_namespace = _get_xml_namespace();
+        }
+        return _xpath_parser.xml_namespace;
+    }
+    // fail if no namespace was found
+    _cxml_xp_unknown_prefix(name);
+    return NULL;
+}
+
+/*
+ * Resolve the prefix of `node_test` in `scope` (the nearest element declaring namespaces,
+ * or the root node), once per scope: the nodes of a document usually share a few scopes
+ * (often a single one, when every namespace is declared by the root element).
+ */
+static struct _cxml_xp_ns_memo *_cxml_xp_ns_resolve(cxml_xp_nodetest *node_test, cxml_elem_node *scope){
+    struct _cxml_xp_ns_memo *memo = &_xpath_parser.ns_memo[
+            ((uintptr_t)node_test / sizeof(cxml_xp_nodetest)) % _CXML_XP_NS_MEMO_SIZE];
+    if (memo->node_test != node_test || memo->scope != scope){
+        memo->ns = _resolve_prefix(node_test, scope);
+        memo->node_test = node_test;
+        memo->scope = scope;
+        memo->check_ns = NULL;
+    }
+    return memo;
+}
+
 static bool cmp_expanded_name(cxml_elem_node *elem, cxml_attr_node *attr, cxml_xp_nodetest *node_test){
     cxml_ns_node *check_ns;
-    cxml_name *check_name;
+    cxml_name *check_name, *test_name = &node_test->name_test.name;
     cxml_elem_node *curr;
     if (elem){
-        if (!elem->namespace || !elem->name.pname) return false;
+        if (!elem->namespace || !cxml_name_pname(&elem->name)) return false;
         check_ns = elem->namespace;
         check_name = &elem->name;
         curr = elem;
     }
     else{
-        if (!attr->namespace || !attr->name.pname) return false;
+        if (!attr->namespace || !cxml_name_pname(&attr->name)) return false;
         check_ns = attr->namespace;
         check_name = &attr->name;
         curr = attr->parent;
     }
-    // ensure `namespaces` isn't NULL, if so, ensure we hit the root node
+    // the prefix of the nametest is resolved in the scope of the node, that is, the declarations
+    // of the nearest element declaring namespaces (and its ancestors), before any name is
+    // compared, so that an unknown prefix fails on the first namespaced node tested
     while (curr->_type != CXML_ROOT_NODE && curr->namespaces == NULL) curr = curr->parent;
-
-    // we need to obtain the namespace bound to the pname/prefix in the nametest.
-    // we then obtain the expanded name of the nametest using the namespace found
-    // and then compare with the current element's expanded name
-    cxml_ns_node *ns = NULL;
-    while (curr->_type != CXML_ROOT_NODE)
-    {
-        cxml_for_each(_ns, curr->namespaces)
-        {
-            if (!(_unwrap_cxnode(cxml_ns_node, _ns))->is_default
-                && cxml_string_lraw_equals(&(_unwrap_cxnode(cxml_ns_node, _ns))->prefix,
-                                           node_test->name_test.name.pname,
-                                           node_test->name_test.name.pname_len))
-            {
-                ns = _ns;
-                goto cmp;
-            }
-        }
-        curr = curr->parent;
-    }
-
-    cmp:
-    if (ns == NULL) {
-        // check if the namespace referenced was the global namespace 'xml'
-        if (memcmp(node_test->name_test.name.pname,
-                   _CXML_RESERVED_NS_PREFIX_XML,
-                   _CXML_RESERVED_NS_PREFIX_XML_LEN) == 0)
+    struct _cxml_xp_ns_memo *memo = _cxml_xp_ns_resolve(node_test, curr);
+    // expanded name -> namespace name (URI) + local name
+    if (node_test->name_test.t_type == CXML_XP_NAME_TEST_PNAME_LNAME){
+        if (!cxml_string_llraw_equals(cxml_name_lname(test_name),
+                                      cxml_name_lname(check_name),
+                                      test_name->lname_len,
+                                      check_name->lname_len))
         {
-            // check if the namespace is available
-            if (!_xpath_parser.xml_namespace)
-            {
-                _xpath_parser.xml_namespace = _get_xml_namespace();
-            }
-            ns = _xpath_parser.xml_namespace;
-        }else{ // fail if no namespace was found
-            int buff_size = node_test->name_test.name.pname_len + 40;
-            char buff[buff_size];
-            snprintf(buff, buff_size, "Unknown namespace prefix - `%.*s`",
-                     node_test->name_test.name.pname_len,
-                     node_test->name_test.name.pname);
-            _cxml_xp_eval_err(buff);
+            return false;
         }
+    }else if (node_test->name_test.t_type != CXML_XP_NAME_TEST_PNAME_WILDCARD){
+        return false;
     }
-    // compare with the namespace found
-    if (node_test->name_test.t_type == CXML_XP_NAME_TEST_PNAME_LNAME){
-        // expanded name -> namespace name (URI) + local name
-        // check that URI and local name are equal
-        return cxml_string_equals(&ns->uri, &check_ns->uri)
-               && cxml_string_llraw_equals(node_test->name_test.name.lname,
-                                           check_name->lname,
-                                           node_test->name_test.name.lname_len,
-                                           check_name->lname_len);
-    }else if (node_test->name_test.t_type == CXML_XP_NAME_TEST_PNAME_WILDCARD){
-        return ((ns == check_ns) || cxml_string_equals(&ns->uri, &check_ns->uri));
+    // the namespace found is compared with the namespace of the node (once per namespace)
+    if (memo->check_ns != check_ns){
+        memo->check_ns = check_ns;
+        memo->same_uri = memo->ns == check_ns || cxml_string_equals(&memo->ns->uri, &check_ns->uri);
     }
-    return false;
+    return memo->same_uri;
 }
 
 
+/*
+ * The attributes of an element are scanned in place (see cxml_table_for_each()),
+ * in document order, without hashing their names again.
+ */
 static void
 _get_attrs(cxml_elem_node *node,
            cxml_set *node_set,
@@ -131,25 +174,22 @@ _get_attrs(cxml_elem_node *node,
 {
     if (node->has_attribute)
     {
-        if (node_test == NULL) goto else_; // handles typetest
         cxml_attr_node *attr;
-        if (node_test->name_test.t_type == CXML_XP_NAME_TEST_PNAME_WILDCARD)  // @pname: *
+        if (node_test && node_test->name_test.t_type == CXML_XP_NAME_TEST_PNAME_WILDCARD)  // @pname: *
         {
-            cxml_for_each(key, &node->attributes->keys)
+            cxml_table_for_each(entry, node->attributes)
             {
-                attr = cxml_table_get(node->attributes, key);
-                if (attr->name.pname
-                    && cmp_expanded_name(NULL, attr, node_test))
+                attr = entry->value;
+                if (attr->name.pname_len && cmp_expanded_name(NULL, attr, node_test))
                 {
                     cxml_set_add(node_set, attr);
                 }
             }
         }
-        else{  // * (wildcard)
-            else_: ;
-            cxml_for_each(key, &node->attributes->keys)
+        else{  // * (wildcard), or node() (typetest)
+            cxml_table_for_each(entry, node->attributes)
             {
-                cxml_set_add(node_set, cxml_table_get(node->attributes, key));
+                cxml_set_add(node_set, entry->value);
             }
         }
     }
@@ -164,14 +204,13 @@ _get_attr(cxml_elem_node *node,
     if (node->has_attribute)
     {
         cxml_attr_node *attr;
+        cxml_name *name = &node_test->name_test.name;
         if (node_test->name_test.t_type == CXML_XP_NAME_TEST_PNAME_LNAME)  // pname:lname
         {
-            attr = cxml_table_get(
-                    node->attributes,
-                    cxml_string_as_raw(&node_test->name_test.name.qname));
+            attr = cxml_table_get(node->attributes, cxml_string_as_raw(&name->qname));
             if (attr)
             {
-                (attr->name.pname && cmp_expanded_name(NULL, attr, node_test)) ?
+                (attr->name.pname_len && cmp_expanded_name(NULL, attr, node_test)) ?
                 cxml_set_add(node_set, attr) : (void)0;
             } else {
                 /* This handles cases where the namespace prefix names don't match but
@@ -182,17 +221,13 @@ _get_attr(cxml_elem_node *node,
                  * </foo>
                  *  //@x:a must match both x:a='1' and y:a='3' despite both attributes having
                  *  namespaces with unequal prefix names.
-                 *  However, the approach used here is quite inefficient.
+                 *  An element has at most one attribute with a given expanded name,
+                 *  so the scan stops at the first match.
                  */
-                cxml_for_each(key, &node->attributes->keys)
+                cxml_table_for_each(entry, node->attributes)
                 {
-                    attr = cxml_table_get(node->attributes, key);
-                    if (cxml_string_llraw_equals(
-                            attr->name.lname,
-                            node_test->name_test.name.lname,
-                            attr->name.lname_len,
-                            node_test->name_test.name.lname_len)
-                        && cmp_expanded_name(NULL, attr, node_test))
+                    attr = entry->value;
+                    if (cmp_expanded_name(NULL, attr, node_test))
                     {
                         cxml_set_add(node_set, attr);
                         return;
@@ -202,16 +237,13 @@ _get_attr(cxml_elem_node *node,
         }
         else if (node_test->name_test.t_type == CXML_XP_NAME_TEST_WILDCARD_LNAME)   // *:lname
         {
-            cxml_for_each(key, &node->attributes->keys)
+            cxml_table_for_each(entry, node->attributes)
             {
-                attr = cxml_table_get(node->attributes, key);
-                if (attr->name.lname
-                    && cxml_string_llraw_equals(
-                            attr->name.lname,
-                            node_test->name_test.name.lname,
-                            attr->name.lname_len,
-                            node_test->name_test.name.lname_len)
-                    )
+                attr = entry->value;
+                if (cxml_string_llraw_equals(cxml_name_lname(&attr->name),
+                                             cxml_name_lname(name),
+                                             attr->name.lname_len,
+                                             name->lname_len))
                 {
                     cxml_set_add(node_set, attr);
                 }
@@ -220,89 +252,87 @@ _get_attr(cxml_elem_node *node,
         else{  // name (unprefixed) -> CXML_XP_NAME_TEST_NAME
             cxml_set_add(node_set, cxml_table_get(
                     node->attributes,
-                    cxml_string_as_raw(&node_test->name_test.name.qname)));
+                    cxml_string_as_raw(&name->qname)));
         }
     }
 }
 
-inline static void
-_process_nametest(cxml_elem_node *elem,
-                  cxml_xp_nodetest *node_test,
-                  cxml_set *acc)
+static bool
+_match_nametest(cxml_elem_node *elem, cxml_xp_nodetest *node_test)
 {
     switch(node_test->name_test.t_type)
     {
         case CXML_XP_NAME_TEST_NAME:           // '//nm'
-            if (cxml_string_equals(&elem->name.qname,
-                                   &node_test->name_test.name.qname))
-            {
-                cxml_set_add(acc, elem);
-            }
-            break;
+            return cxml_string_equals(&elem->name.qname,
+                                      &node_test->name_test.name.qname);
         case CXML_XP_NAME_TEST_PNAME_WILDCARD:  // '//pn:*'
         case CXML_XP_NAME_TEST_PNAME_LNAME:   // '//pn:ln'
-            if (cmp_expanded_name(elem, NULL, node_test)){
-                cxml_set_add(acc, elem);
-            }
-            break;
+            return cmp_expanded_name(elem, NULL, node_test);
         case CXML_XP_NAME_TEST_WILDCARD:       // '//*'
-            cxml_set_add(acc, elem);
-            break;
+            return true;
         case CXML_XP_NAME_TEST_WILDCARD_LNAME:  // '//*:ln'
-            if (cxml_string_llraw_equals(elem->name.lname,
-                                         node_test->name_test.name.lname,
-                                         elem->name.lname_len,
-                                         node_test->name_test.name.lname_len))
-            {
-                cxml_set_add(acc, elem);
-            }
-            break;
+            return cxml_string_llraw_equals(cxml_name_lname(&elem->name),
+                                            cxml_name_lname(&node_test->name_test.name),
+                                            elem->name.lname_len,
+                                            node_test->name_test.name.lname_len);
         default:
-            break;
+            return false;
     }
 }
 
-static void
-_process_typetest(
-        cxml_xp_nodetest* node_test,  /* xpath node_test */
-        _cxml_node_t cxml_node_type,   /* cxml node type */
-        void* cxml_node,            /* cxml node to be stored*/
-        cxml_set* node_set)          /* node-set in which cxml_node would be added */
+inline static void
+_process_nametest(cxml_elem_node *elem,
+                  cxml_xp_nodetest *node_test,
+                  cxml_set *acc)
+{
+    if (_match_nametest(elem, node_test)){
+        cxml_set_add(acc, elem);
+    }
+}
+
+static bool
+_match_typetest(cxml_xp_nodetest* node_test, _cxml_node_t cxml_node_type, void* cxml_node)
 {
     switch (node_test->type_test.t_type)
     {
         case CXML_XP_TYPE_TEST_NODE: // like a wildcard, captures any node
-            is_not_prolog_type(cxml_node_type) ? // do not capture xml header & dtd
-            cxml_set_add(node_set, cxml_node) : (void)0;
-            break;
+            return is_not_prolog_type(cxml_node_type); // do not capture xml header & dtd
         case CXML_XP_TYPE_TEST_TEXT:
-            (cxml_node_type == CXML_TEXT_NODE) ?
-            cxml_set_add(node_set, cxml_node) : (void)0;
-            break;
+            return cxml_node_type == CXML_TEXT_NODE;
         case CXML_XP_TYPE_TEST_COMMENT:
-            (cxml_node_type == CXML_COMM_NODE) ?
-            cxml_set_add(node_set, cxml_node) : (void)0;
-            break;
+            return cxml_node_type == CXML_COMM_NODE;
         case CXML_XP_TYPE_TEST_PI:
-            if (cxml_node_type == CXML_PI_NODE)
-            {
-                if (node_test->type_test.has_target) // type-test has target?
-                {
-                    // check if the proc node has the same target as the type-test target
-                    cxml_string_equals(
-                            &node_test->type_test.target,
-                            &_unwrap_cxpi_node(cxml_node)->target) ?
-                    cxml_set_add(node_set, cxml_node) : (void)0;
-                }else{
-                    cxml_set_add(node_set, cxml_node);
-                }
-            }
-            break;
+            if (cxml_node_type != CXML_PI_NODE) return false;
+            // check if the proc node has the same target as the type-test target
+            // (if the type-test has a target)
+            return !node_test->type_test.has_target
+                   || cxml_string_equals(&node_test->type_test.target,
+                                         &_unwrap_cxpi_node(cxml_node)->target);
         default:
-            break;
+            return false;
     }
 }
 
+static void
+_process_typetest(
+        cxml_xp_nodetest* node_test,  /* xpath node_test */
+        _cxml_node_t cxml_node_type,   /* cxml node type */
+        void* cxml_node,            /* cxml node to be stored*/
+        cxml_set* node_set)          /* node-set in which cxml_node would be added */
+{
+    if (_match_typetest(node_test, cxml_node_type, cxml_node)){
+        cxml_set_add(node_set, cxml_node);
+    }
+}
+
+// node test of a step (on an axis whose principal node type is element)
+static bool _match_node_test(cxml_xp_nodetest *node_test, void *node){
+    if (node_test->t_type == CXML_XP_NODE_TEST_NAMETEST){
+        return _cxml_node_type(node) == CXML_ELEM_NODE && _match_nametest(node, node_test);
+    }
+    return _match_typetest(node_test, _cxml_node_type(node), node);
+}
+
 inline static void
 _save_attr_if_matches(cxml_elem_node *elem,
                       cxml_xp_nodetest *node_test,
@@ -352,13 +382,17 @@ static bool is_not_prolog_type(_cxml_node_t node_type){
 }
 
 _cxml_xp_data *_cxml_xp_new_data() {
-    _cxml_xp_data *res = ALLOC(_cxml_xp_data, 1);
-    // store for later de-allocation
-    cxml_list_append(&_xpath_parser.data_nodes, res);
+    _cxml_xp_data *res = cxml_arena_alloc(&_xpath_parser.arena, sizeof(_cxml_xp_data));
+    // the contents of the data are freed when the arena is reset
+    cxml_arena_on_reset(&_xpath_parser.arena, _cxml_xp_data_free, res);
     _cxml_xp_data_init(&res);
     return res;
 }
 
+static void _cxml_xp__free_cached_nodeset(void *nodeset /*: cxml_list*/){
+    cxml_list_free(nodeset);
+}
+
 static void
 add_parent(void* _node, cxml_set* acc){
 #define _add(_n_set, _val)                         \
@@ -421,10 +455,10 @@ name -> select element with name
 node-type() -> selects node type (node(), comment(), etc.)
  */
 
-static void
-_recursive_find_all(
-        /* root elem / root node*/
-        void* root,
+inline static void
+_match_descendant(
+        /* descendant being matched */
+        void* child,
         /*  '//.'  | '//..'  <- 1 (self), 2 (parent), 0 (none) */
         cxml_xp_abbrev_step_t abbrev_step_type,
         /* node test to be performed */
@@ -432,42 +466,68 @@ _recursive_find_all(
         /* result accumulator */
         cxml_set* acc)
 {
-    cxml_for_each(child, _cxml__get_node_children(root))
+    if (node_test == NULL)  // '//.'  | '//..' -> abbreviated step (no node-test)
     {
-        if (node_test == NULL)  // '//.'  | '//..' -> abbreviated step (no node-test)
+        if (abbrev_step_type == CXML_XP_ABBREV_STEP_TSELF){  // '//.'
+            // exclude xml header and dtd nodes
+            is_not_prolog_type(_cxml_node_type(child)) ? cxml_set_add(acc, child) : (void)0;
+        }
+        else if (abbrev_step_type == CXML_XP_ABBREV_STEP_TPARENT) // '//..'
         {
-            if (abbrev_step_type == CXML_XP_ABBREV_STEP_TSELF){  // '//.'
-                // exclude xml header and dtd nodes
-                is_not_prolog_type(_cxml_node_type(child)) ? cxml_set_add(acc, child) : (void)0;
-            }
-            else if (abbrev_step_type == CXML_XP_ABBREV_STEP_TPARENT) // '//..'
-            {
-                add_parent(child, acc);
-            }
+            add_parent(child, acc);
         }
-        // is it a pure node-test (without attributes)?
-        else if (!node_test->has_attr_axis)  // '//nm  | // * | //nt()'
+    }
+    // is it a pure node-test (without attributes)?
+    else if (!node_test->has_attr_axis)  // '//nm  | // * | //nt()'
+    {
+        // name-test
+        if ((node_test->t_type == CXML_XP_NODE_TEST_NAMETEST)
+            && (_cxml_node_type(child) == CXML_ELEM_NODE))
         {
-            // name-test
-            if ((node_test->t_type == CXML_XP_NODE_TEST_NAMETEST)
-                && (_cxml_node_type(child) == CXML_ELEM_NODE))
-            {
-                _process_nametest(child, node_test, acc);
-            }
-            // type-test
-            else if (node_test->t_type == CXML_XP_NODE_TEST_TYPETEST) // //nt() -> node-type
-            {
-                _process_typetest(node_test, _cxml_node_type(child), child, acc);
-            }
+            _process_nametest(child, node_test, acc);
         }
-        // '//@nm | //@* | //@nt()'
-        else
+        // type-test
+        else if (node_test->t_type == CXML_XP_NODE_TEST_TYPETEST) // //nt() -> node-type
         {
-            if (_cxml_node_type(child) == CXML_ELEM_NODE)
-            {
-                _save_attr_if_matches(child, node_test, acc);
-            }
+            _process_typetest(node_test, _cxml_node_type(child), child, acc);
+        }
+    }
+    // '//@nm | //@* | //@nt()'
+    else
+    {
+        if (_cxml_node_type(child) == CXML_ELEM_NODE)
+        {
+            _save_attr_if_matches(child, node_test, acc);
         }
+    }
+}
+
+static void
+_recursive_find_all(
+        /* root elem / root node*/
+        void* root,
+        /*  '//.'  | '//..'  <- 1 (self), 2 (parent), 0 (none) */
+        cxml_xp_abbrev_step_t abbrev_step_type,
+        /* node test to be performed */
+        cxml_xp_nodetest* node_test,
+        /* result accumulator */
+        cxml_set* acc)
+{
+    // when the document is indexed, the descendants of root form a contiguous
+    // range in document order, so we scan the range instead of recursing.
+    cxml_node_index *index = _xpath_parser.root_node->index;
+    int i = cxml_index_find(index, root);
+    if (i != -1){
+        for (int j = i + 1; j <= index->end[i]; j++){
+            if (!_cxml_budget_visit(1)) return;
+            _match_descendant(index->nodes[j], abbrev_step_type, node_test, acc);
+        }
+        return;
+    }
+    cxml_for_each(child, _cxml__get_node_children(root))
+    {
+        if (!_cxml_budget_visit(1)) return;
+        _match_descendant(child, abbrev_step_type, node_test, acc);
         if (_cxml_node_type(child) == CXML_ELEM_NODE)
         {
             _recursive_find_all(
@@ -495,6 +555,7 @@ _find_all(
         // capture child element nodes with matching names.
         cxml_for_each(node, children)
         {
+            if (!_cxml_budget_visit(1)) return;
             if (node_test->t_type == CXML_XP_NODE_TEST_NAMETEST)
             {
                 if (_cxml_node_type(node) == CXML_ELEM_NODE){
@@ -511,6 +572,263 @@ _find_all(
 }
 
 
+/*
+ * Pipelined path evaluation (see cxxpeval.h)
+ *
+ * A state i (0 <= i <= pipe->size) of a node means that the first i steps of the path
+ * match, with the node selected by the ith step (state 0 is the context node).
+ * A child continues the states in the `src` of its parent's frame, selecting the child
+ * when it matches the following step; and `desc` carries the states followed by a '//'
+ * step down the subtree. The node is selected by the path when it is in state pipe->size.
+ */
+static int _cxml_xp_literal_position(cxml_xp_astnode *expr){
+    if (expr->wrapped_type != CXML_XP_AST_NUM_NODE) return 0;
+    cxml_number num = cxml_literal_to_num(&expr->wrapped_node.num->val);
+    if (num.type != CXML_NUMERIC_DOUBLE_T
+        || num.dec_val < 1 || num.dec_val > INT32_MAX
+        || num.dec_val != (double)(int)num.dec_val)
+    {
+        return 0;
+    }
+    return (int)num.dec_val;
+}
+
+/*
+ * Prepare `pipe` for the evaluation of `path`.
+ * Returns false if `path` cannot be pipelined.
+ */
+bool _cxml_xp_pipe_plan(_cxml_xp_pipe *pipe, cxml_xp_path *path){
+    pipe->size = 0;
+    pipe->absolute = false;
+    pipe->attr_step = false;
+    pipe->child_from = 0;
+    pipe->desc_from = 0;
+    int n_pos = 0, i = 0, j;
+    cxml_xp_step *step;
+    cxml_for_each(_step, &path->steps)
+    {
+        step = _step;
+        // (the other axes are walked one context node at a time)
+        if (step->axis) return false;
+        if (step->abbrev_step){
+            // a leading '.' selects the context node, the steps following it
+            // are evaluated from the context node
+            if (i++ == 0 && step->abbrev_step == 1 && !step->path_spec
+                && cxml_list_is_empty(&step->predicates)
+                && cxml_list_size(&path->steps) > 1)
+            {
+                continue;
+            }
+            return false;
+        }
+        // attribute steps can only be the last step
+        if (pipe->attr_step || pipe->size == _CXML_XP_PIPE_MAX_STEPS) return false;
+        if (i++ == 0 && step->path_spec) pipe->absolute = true;
+        j = ++pipe->size;
+        pipe->steps[j] = step;
+        pipe->positions[j] = 0;
+        if (step->path_spec == 2){
+            pipe->desc_from |= 1u << (j - 1);
+        }else{
+            pipe->child_from |= 1u << (j - 1);
+        }
+        if (cxml_list_is_empty(&step->predicates)){
+            pipe->attr_step = step->has_attr_axis;
+            continue;
+        }
+        if (step->has_attr_axis
+            || cxml_list_size(&step->predicates) > 1
+            || n_pos == _CXML_XP_PIPE_MAX_POSITIONS)
+        {
+            return false;
+        }
+        cxml_xp_predicate *pred = cxml_list_first(&step->predicates);
+        if (!(pipe->positions[j] = _cxml_xp_literal_position(pred->expr_node))) return false;
+        pipe->slots[j] = n_pos++;
+    }
+    if (!pipe->size) return false;
+    pipe->node_mask = (1u << pipe->size) - 1;
+    if (pipe->attr_step) pipe->node_mask &= ~(1u << (pipe->size - 1));
+    return true;
+}
+
+/*
+ * Obtain the context node of a planned pipe, from the current evaluation state.
+ * NULL if the path has more than one context node.
+ */
+static void *_cxml_xp_pipe_context(_cxml_xp_pipe *pipe){
+    if (pipe->absolute) return _xpath_parser.root_node;
+    if (cxml_set_size(&_xpath_parser.nodeset) > 1) return NULL;
+    if (cxml_set_size(&_xpath_parser.nodeset) == 1) return cxml_set_get(&_xpath_parser.nodeset, 0);
+    return _xpath_parser.context.ctx_node ? _xpath_parser.context.ctx_node : _xpath_parser.root_node;
+}
+
+bool _cxml_xp_pipe_match(cxml_xp_step *step, void *node){
+    return _match_node_test(step->node_test, node);
+}
+
+/*
+ * Visit `node` with the states `exact`, opening a frame for its children,
+ * and collecting its attributes when selected by the (last) attribute step.
+ */
+static void _cxml_xp_pipe_enter(_cxml_xp_pipe *pipe, void *node, uint32_t exact, uint32_t desc){
+    desc |= exact & pipe->desc_from;
+    uint32_t src = ((exact & pipe->child_from) | desc);
+    if (pipe->attr_step
+        && _cxml_node_type(node) == CXML_ELEM_NODE
+        && (src & (1u << (pipe->size - 1))))
+    {
+        cxml_set_free(&pipe->attrs);
+        _save_attr_if_matches(node, pipe->steps[pipe->size]->node_test, &pipe->attrs);
+        pipe->next_attr = pipe->attrs.items.head;
+    }
+    src &= pipe->node_mask;
+    if (!(src | desc)
+        || (_cxml_node_type(node) != CXML_ELEM_NODE && _cxml_node_type(node) != CXML_ROOT_NODE))
+    {
+        return;
+    }
+    cxml_list *children = _cxml__get_node_children(node);
+    if (!children->head) return;
+    if (pipe->depth == pipe->capacity){
+        pipe->capacity *= 2;
+        if (pipe->frames == pipe->stack){
+            pipe->frames = ALLOC(struct _cxml_xp_pipe_frame, pipe->capacity);
+            memcpy(pipe->frames, pipe->stack, sizeof(pipe->stack));
+        }else{
+            pipe->frames = RALLOC(struct _cxml_xp_pipe_frame, pipe->frames, pipe->capacity);
+        }
+    }
+    struct _cxml_xp_pipe_frame *frame = &pipe->frames[pipe->depth++];
+    frame->node = node;
+    frame->next = children->head;
+    frame->src = src;
+    frame->desc = desc;
+    memset(frame->counts, 0, sizeof(frame->counts));
+}
+
+void _cxml_xp_pipe_open(_cxml_xp_pipe *pipe, void *context){
+    pipe->depth = 0;
+    pipe->capacity = _CXML_XP_PIPE_STACK_SIZE;
+    pipe->frames = pipe->stack;
+    cxml_set_init(&pipe->attrs);
+    pipe->next_attr = NULL;
+    pipe->visited = 0;
+    if (context) _cxml_xp_pipe_enter(pipe, context, 1u, 0);
+}
+
+/*
+ * Obtain the next node selected by the path, NULL when exhausted.
+ */
+void *_cxml_xp_pipe_next(_cxml_xp_pipe *pipe){
+    struct _cxml_xp_pipe_frame *frame;
+    uint32_t cand, exact;
+    void *node;
+    int j, count;
+    for (;;){
+        if (pipe->next_attr){
+            node = pipe->next_attr->item;
+            pipe->next_attr = pipe->next_attr->next;
+            return node;
+        }
+        if (!pipe->depth) return NULL;
+        frame = &pipe->frames[pipe->depth - 1];
+        // done with the children, or no child can continue any state
+        if (!frame->next || !(frame->src | frame->desc)){
+            pipe->depth--;
+            continue;
+        }
+        node = frame->next->item;
+        frame->next = frame->next->next;
+        pipe->visited++;
+        if (!_cxml_budget_visit(1)) return NULL;
+        exact = 0;
+        for (cand = frame->src, j = 1; cand; cand >>= 1, j++){
+            if (!(cand & 1) || !_cxml_xp_pipe_match(pipe->steps[j], node)) continue;
+            if (pipe->positions[j]){
+                count = ++frame->counts[pipe->slots[j]];
+                if (count < pipe->positions[j]) continue;
+                // no other child can be selected by the step
+                frame->src &= ~(1u << (j - 1));
+            }
+            exact |= 1u << j;
+        }
+        // (`frame` can be moved when the frames grow, and isn't used past this point)
+        _cxml_xp_pipe_enter(pipe, node, exact, frame->desc);
+        if (!pipe->attr_step && (exact & (1u << pipe->size))) return node;
+    }
+}
+
+void _cxml_xp_pipe_close(_cxml_xp_pipe *pipe){
+    if (pipe->frames != pipe->stack) FREE(pipe->frames);
+    pipe->frames = pipe->stack;
+    pipe->depth = 0;
+    cxml_set_free(&pipe->attrs);
+    pipe->next_attr = NULL;
+}
+
+/*
+ * Fold the nodes selected by the path `node` into `acc` as they are selected,
+ * without building (hashing or sorting) their node-set:
+ *  _CXML_XP_FOLD_EXISTS: 1 if any node is selected (stopping at the first node), 0 otherwise
+ *  _CXML_XP_FOLD_COUNT: the number of nodes selected
+ *  _CXML_XP_FOLD_SUM: the sum of the numeric values of the nodes selected
+ *                     (NaN, stopping at the first node with no numeric value)
+ * Returns false if `node` isn't a pipelined path (`acc` is left untouched).
+ */
+bool _cxml_xp_fold(cxml_xp_astnode *node, _cxml_xp_fold_t fold, cxml_number *acc){
+    // (the value of an invariant path is computed once, as a node-set)
+    if (!node || node->is_invariant || node->wrapped_type != CXML_XP_AST_PATH_NODE) return false;
+    _cxml_xp_pipe pipe;
+    void *context, *selected;
+    if (!_cxml_xp_pipe_plan(&pipe, node->wrapped_node.path)
+        || !(context = _cxml_xp_pipe_context(&pipe)))
+    {
+        return false;
+    }
+    cxml_number num;
+    long selected_n = 0;
+    _cxml_xp_profile_span span;
+    _cxml_xp_profile_begin(&span, node);
+    _cxml_xp_profile_rewrite(node, fold == _CXML_XP_FOLD_EXISTS ? CXML_XP_REWRITE_EXISTS : CXML_XP_REWRITE_FOLDED);
+    cxml_number_init(acc);
+    acc->type = CXML_NUMERIC_DOUBLE_T;
+    _cxml_xp_pipe_open(&pipe, context);
+    while ((selected = _cxml_xp_pipe_next(&pipe)))
+    {
+        selected_n++;
+        if (fold == _CXML_XP_FOLD_SUM){
+            _cxml_xp__node_num_val(selected, &num);
+            if (num.type != CXML_NUMERIC_DOUBLE_T){
+                acc->type = num.type;
+                acc->dec_val = 0;
+                break;
+            }
+            acc->dec_val += num.dec_val;
+            continue;
+        }
+        acc->dec_val++;
+        if (fold == _CXML_XP_FOLD_EXISTS) break;
+    }
+    _cxml_xp_pipe_close(&pipe);
+    // as with an evaluated path, the accumulating nodeset is left empty
+    cxml_set_free(&_xpath_parser.nodeset);
+    _cxml_xp_profile_end(&span, pipe.visited, selected_n, 0);
+    return true;
+}
+
+/*
+ * Check if the path `node` selects any node, stopping at the first node selected.
+ * Returns false if `node` isn't a pipelined path (`exists` is left untouched).
+ */
+bool _cxml_xp_exists(cxml_xp_astnode *node, bool *exists){
+    cxml_number acc;
+    if (!_cxml_xp_fold(node, _CXML_XP_FOLD_EXISTS, &acc)) return false;
+    *exists = acc.dec_val != 0;
+    return true;
+}
+
+
 //***********************************************//
 /*
  * /.
@@ -1183,8 +1501,277 @@ static void _set_state_24(cxml_xp_step* node){
 }
 
 
+/*
+ * Axes written out in full (AxisName '::', see cxml_xp_axis_t).
+ *
+ * A step on such an axis is evaluated one context node at a time: the nodes on the axis
+ * of a context node are visited in proximity order, i.e. in reverse document order on the
+ * reverse axes (ancestor, ancestor-or-self, preceding and preceding-sibling), and the
+ * predicates of the step are applied to them with positions relative to the axis,
+ * so 'ancestor::*[1]' selects the parent element, and 'preceding-sibling::*[1]'
+ * the closest preceding sibling element of the context node.
+ * Ancestors and siblings are reached through the parent links of the nodes. When the
+ * document is indexed (see cxindex.h), siblings are skipped to, and the descendants,
+ * following and preceding nodes are read off the index, instead of walking the tree.
+ */
+struct _cxml_xp_axis_walk{
+    cxml_xp_nodetest *node_test;
+    cxml_list nodes;        // nodes on the axis passing the node test, in proximity order
+    int limit;              // nodes needed by the predicates of the step (0 if all)
+};
+
+// parent of `node` (the root element of a virtual root has the virtual root as parent)
+inline static void *_axis_parent(void *node){
+    return node == _xpath_parser.root_element ? _xpath_parser.root_node : _get_parent(node);
+}
+
+inline static bool _has_children(void *node){
+    return _cxml_node_type(node) == CXML_ELEM_NODE || _cxml_node_type(node) == CXML_ROOT_NODE;
+}
+
+// returns false once the walk can stop
+static bool _axis_visit(struct _cxml_xp_axis_walk *walk, void *node){
+    if (!_cxml_budget_visit(1)) return false;
+    if (_match_node_test(walk->node_test, node)){
+        cxml_list_append(&walk->nodes, node);
+    }
+    return !walk->limit || cxml_list_size(&walk->nodes) < walk->limit;
+}
+
+static bool _axis_descendants(struct _cxml_xp_axis_walk *walk, void *node){
+    if (!_has_children(node)) return true;
+    cxml_node_index *index = _xpath_parser.root_node->index;
+    int i = cxml_index_find(index, node);
+    if (i != -1){
+        for (int j = i + 1; j <= index->end[i]; j++){
+            if (!_axis_visit(walk, index->nodes[j])) return false;
+        }
+        return true;
+    }
+    cxml_for_each(child, _cxml__get_node_children(node))
+    {
+        if (!_axis_visit(walk, child) || !_axis_descendants(walk, child)) return false;
+    }
+    return true;
+}
+
+// visit the descendants of `node`, then `node` (in reverse document order)
+static bool _axis_reverse_subtree(struct _cxml_xp_axis_walk *walk, void *node){
+    if (_has_children(node)){
+        cxml_list children = new_cxml_list();
+        cxml_for_each(child, _cxml__get_node_children(node)){
+            cxml_list_insert(&children, child, true);
+        }
+        bool more = true;
+        cxml_for_each(reversed, &children){
+            if (!(more = _axis_reverse_subtree(walk, reversed))) break;
+        }
+        cxml_list_free(&children);
+        if (!more) return false;
+    }
+    return _axis_visit(walk, node);
+}
+
+/*
+ * Visit the following (or preceding, if `reverse`) siblings of `node`,
+ * together with their subtrees if `deep`.
+ */
+static bool
+_axis_siblings(struct _cxml_xp_axis_walk *walk, void *node, bool reverse, bool deep){
+    void *par = _axis_parent(node);
+    // attributes have no siblings
+    if (!par || _cxml_node_type(node) == CXML_ATTR_NODE) return true;
+    cxml_list siblings = new_cxml_list();
+    cxml_node_index *index = _xpath_parser.root_node->index;
+    int i = deep ? -1 : cxml_index_find(index, node);
+    if (i != -1 && !reverse){
+        // the subtree of a sibling ends right before the next sibling
+        for (int j = index->end[i] + 1; j < index->size && index->parent[j] == index->parent[i];
+             j = index->end[j] + 1)
+        {
+            if (!_axis_visit(walk, index->nodes[j])) return false;
+        }
+        return true;
+    }else if (i != -1){
+        for (int j = index->parent[i] + 1; j < i; j = index->end[j] + 1){
+            cxml_list_insert(&siblings, index->nodes[j], true);
+        }
+    }else{
+        bool after = false;
+        cxml_for_each(sibling, _cxml__get_node_children(par))
+        {
+            if (sibling == node){
+                if (reverse) break;
+                after = true;
+            }else if (reverse || after){
+                cxml_list_insert(&siblings, sibling, reverse);
+            }
+        }
+    }
+    bool more = true;
+    cxml_for_each(sibling, &siblings)
+    {
+        more = !deep ? _axis_visit(walk, sibling) :
+               reverse ? _axis_reverse_subtree(walk, sibling) :
+               (_axis_visit(walk, sibling) && _axis_descendants(walk, sibling));
+        if (!more) break;
+    }
+    cxml_list_free(&siblings);
+    return more;
+}
+
+static void _axis_following(struct _cxml_xp_axis_walk *walk, void *node){
+    // the nodes following an attribute start with the descendants of its element
+    if (_cxml_node_type(node) == CXML_ATTR_NODE){
+        node = _get_parent(node);
+        if (!_axis_descendants(walk, node)) return;
+    }
+    cxml_node_index *index = _xpath_parser.root_node->index;
+    int i = cxml_index_find(index, node);
+    if (i != -1){
+        for (int j = index->end[i] + 1; j < index->size; j++){
+            if (!_axis_visit(walk, index->nodes[j])) return;
+        }
+        return;
+    }
+    for (; node; node = _axis_parent(node)){
+        if (!_axis_siblings(walk, node, false, true)) return;
+    }
+}
+
+static void _axis_preceding(struct _cxml_xp_axis_walk *walk, void *node){
+    // (the element of an attribute is one of its ancestors)
+    if (_cxml_node_type(node) == CXML_ATTR_NODE){
+        node = _get_parent(node);
+    }
+    cxml_node_index *index = _xpath_parser.root_node->index;
+    int i = cxml_index_find(index, node);
+    if (i != -1){
+        for (int j = i - 1; j >= 0; j--){
+            // skip the ancestors
+            if (index->end[j] < i && !_axis_visit(walk, index->nodes[j])) return;
+        }
+        return;
+    }
+    for (; node; node = _axis_parent(node)){
+        if (!_axis_siblings(walk, node, true, true)) return;
+    }
+}
+
+static void _axis_walk(cxml_xp_axis_t axis, struct _cxml_xp_axis_walk *walk, void *node){
+    switch (axis)
+    {
+        case CXML_XP_AXIS_ANCESTOR_OR_SELF:
+            if (!_axis_visit(walk, node)) return;
+            // fall through
+        case CXML_XP_AXIS_ANCESTOR:
+            for (void *par = _axis_parent(node); par; par = _axis_parent(par)){
+                if (!_axis_visit(walk, par)) return;
+            }
+            break;
+        case CXML_XP_AXIS_DESCENDANT_OR_SELF:
+            if (!_axis_visit(walk, node)) return;
+            // fall through
+        case CXML_XP_AXIS_DESCENDANT:
+            _axis_descendants(walk, node);
+            break;
+        case CXML_XP_AXIS_FOLLOWING:
+            _axis_following(walk, node);
+            break;
+        case CXML_XP_AXIS_FOLLOWING_SIBLING:
+            _axis_siblings(walk, node, false, false);
+            break;
+        case CXML_XP_AXIS_PRECEDING:
+            _axis_preceding(walk, node);
+            break;
+        case CXML_XP_AXIS_PRECEDING_SIBLING:
+            _axis_siblings(walk, node, true, false);
+            break;
+        case CXML_XP_AXIS_PARENT:
+            if (_axis_parent(node)) _axis_visit(walk, _axis_parent(node));
+            break;
+        case CXML_XP_AXIS_SELF:
+            _axis_visit(walk, node);
+            break;
+        default:
+            break;
+    }
+}
+
+// apply the predicates of `step` to the nodes on its axis (in proximity order)
+static void _axis_filter(cxml_xp_step *step, cxml_list *nodes){
+    int ctx_size, ctx_pos;
+    struct _cxml_xp_context_state ctx;
+    cxml_list filtered = new_cxml_list();
+    cxml_for_each(pred, &step->predicates)
+    {
+        ctx_size = cxml_list_size(nodes);
+        ctx_pos = 0;
+        cxml_for_each(ctx_node, nodes)
+        {
+            if (!_cxml_budget_visit(1)) break;
+            ctx_pos++;
+            cxml_set_add(&_xpath_parser.nodeset, ctx_node);
+            _cxml_xp_push_context(&_xpath_parser.ctx_stack,
+                    &_xpath_parser.context,
+                    &ctx, ctx_node, ctx_pos, ctx_size);
+            if (_test_predicate(pred)){
+                cxml_list_append(&filtered, ctx_node);
+            }
+            _cxml_xp_pop_context(&_xpath_parser.ctx_stack, &_xpath_parser.context);
+            cxml_set_free(&_xpath_parser.nodeset);
+        }
+        cxml_list_free(nodes);
+        cxml_list_init_with(nodes, &filtered);
+    }
+}
+
+static void _set_state_axis(cxml_xp_step *step){
+    // `axis::nm` | `axis::*` | `axis::nt()`  (and their predicates)
+    cxml_set contexts = new_cxml_set(), node_set = new_cxml_set();
+    if (cxml_set_is_empty(&_xpath_parser.nodeset)){
+        cxml_set_add(&contexts, _xpath_parser.root_node);
+    }else{
+        cxml_set__init_with(&contexts, &_xpath_parser.nodeset);
+    }
+    if (step->path_spec == 2){
+        // '//' -> the context nodes are the descendants-or-self of the nodes selected so far
+        cxml_for_each(_node, &contexts.items)
+        {
+            if (is_not_prolog_type(_cxml_node_type(_node))) cxml_set_add(&node_set, _node);
+            if (_has_children(_node)){
+                _recursive_find_all(_node, CXML_XP_ABBREV_STEP_TSELF, NULL, &node_set);
+            }
+        }
+        _cxml_xp_transfer_nodeset(&contexts, &node_set);
+    }
+    struct _cxml_xp_axis_walk walk;
+    walk.node_test = step->node_test;
+    cxml_list_init(&walk.nodes);
+    // 'axis::nm[n]' -> only the first n nodes on the axis are needed
+    walk.limit = cxml_list_is_empty(&step->predicates) ? 0 :
+            _cxml_xp_literal_position(((cxml_xp_predicate*)cxml_list_first(&step->predicates))->expr_node);
+    cxml_for_each(_node, &contexts.items)
+    {
+        if (_cxml_budget_exhausted()) break;
+        _axis_walk(step->axis, &walk, _node);
+        _axis_filter(step, &walk.nodes);
+        cxml_for_each(selected, &walk.nodes){
+            cxml_set_add(&node_set, selected);
+        }
+        cxml_list_free(&walk.nodes);
+    }
+    cxml_set_free(&contexts);
+    // (back to document order)
+    _sort_nodeset_by_pos(&node_set.items);
+    _cxml_xp_transfer_nodeset(&_xpath_parser.nodeset, &node_set);
+}
+
 static void cxml_xp_visit_Step(cxml_xp_step* node){
-    if (node->abbrev_step == 1){  // '.' -> state_1
+    if (node->axis){  // 'axis::' -> state_axis
+        _set_state_axis(node);
+    }
+    else if (node->abbrev_step == 1){  // '.' -> state_1
         switch(node->path_spec)
         {
             case 1:  _set_state_1(); break; // '/.'
@@ -1269,10 +1856,32 @@ static void cxml_xp_visit_Step(cxml_xp_step* node){
             }
         }
     }
+    // after a step on an axis, context nodes may nest, so the nodes selected interleave;
+    // sort them back into document order
+    if (_xpath_parser.after_axis && !node->axis){
+        _sort_nodeset_by_pos(&_xpath_parser.nodeset.items);
+    }
+    // an aborted evaluation selects nothing more (see cxbudget.h); the nodes
+    // selected were charged as visits by the walk that found them
+    if (!_cxml_budget_results(cxml_set_size(&_xpath_parser.nodeset))){
+        cxml_set_free(&_xpath_parser.nodeset);
+    }
     // track the resulting node-set by storing it's state into is_empty_nodeset
     // for further processing in visit_Path()
      _xpath_parser.is_empty_nodeset = cxml_set_is_empty(&_xpath_parser.nodeset);
 
+    // the predicates of a step on an axis have already been applied (see _set_state_axis()),
+    // the result is pushed as if by cxml_xp_visit_Predicate()
+    if (node->axis){
+        if (cxml_list_size(&node->predicates)){
+            _cxml_xp_data* data = _cxml_xp_new_data();
+            data->type = CXML_XP_DATA_NODESET;
+            cxml_set_copy(&data->nodeset, &_xpath_parser.nodeset);
+            _cxml_xp__e_push(data);
+        }
+        return;
+    }
+
      /*
       * only push to the stack when the step node has predicates and when the nodeset produced isn't empty.
       * this is a simple optimization. Since the data pushed to the stack in this function
@@ -1316,6 +1925,7 @@ static void cxml_xp_visit_Step(cxml_xp_step* node){
           */
          cxml_set_free(&_xpath_parser.nodeset);
         _cxml_xp_ret_t o_flag;
+        _cxml_xp_profile_span span;
          cxml_for_each(pred, &node->predicates)
          {
              o_flag = 1;
@@ -1326,8 +1936,10 @@ static void cxml_xp_visit_Step(cxml_xp_step* node){
                  cxml_xp_visit_Predicate(pred);
              }else{
                  _cxml_xp__e_pop();
-                 cxml_xp_visit(((cxml_xp_predicate*)pred)->expr_node);
-                 bool always_true = _evaluate_predicate_expr(_cxml_xp__e_pop());
+                 _cxml_xp_profile_begin(&span, pred);
+                 _cxml_xp_profile_rewrite(pred, CXML_XP_REWRITE_CONSTANT);
+                 long visited = cxml_set_size(&data->nodeset);
+                 bool always_true = _test_predicate_expr(((cxml_xp_predicate*)pred)->expr_node);
                  if (always_true){
                      /*
                       * always_true means that the result of the evaluated predicate expression
@@ -1357,6 +1969,7 @@ static void cxml_xp_visit_Step(cxml_xp_step* node){
                  }
                  _cxml_xp__e_push(data);
                  _xpath_parser.is_empty_nodeset = cxml_set_is_empty(&_xpath_parser.nodeset);
+                 _cxml_xp_profile_end(&span, visited, cxml_set_size(&data->nodeset), 0);
              }
         }
     }
@@ -1367,6 +1980,9 @@ void cxml_xp_visit_Path(cxml_xp_astnode *node){
     cxml_xp_path* path = node->wrapped_node.path;
     bool should_cache = false;
     cxml_xp_step *step_node = cxml_list_get(&path->steps, 0);
+    _cxml_xp_profile_span span, step_span;
+    _cxml_xp_profile_begin(&span, node);
+    long visited = 0, step_visited;
     if (path->from_predicate)
     {
         if (step_node->path_spec == 1 || step_node->path_spec == 2)
@@ -1384,6 +2000,7 @@ void cxml_xp_visit_Path(cxml_xp_astnode *node){
                 cxml_set_extend_list(&data->nodeset, cached_nodeset);
                 _cxml_xp__e_push(data);
                 cxml_set_free(&_xpath_parser.nodeset);
+                _cxml_xp_profile_end(&span, 0, cxml_set_size(&data->nodeset), 1);
                 return;
             }
              /*
@@ -1414,21 +2031,59 @@ void cxml_xp_visit_Path(cxml_xp_astnode *node){
      * from the context node, this prevents us from obtaining false results when
      * each step node contained in this current path node is being evaluated.
      */
-    if (step_node->path_spec == 0  // '.' | `name`
-        && cxml_set_is_empty(&_xpath_parser.nodeset)
-        && _xpath_parser.context.ctx_node)
+    bool has_no_predicate = 0, pushed = 0;
+    _cxml_xp_pipe pipe;
+    void *context;
+    if (_cxml_xp_pipe_plan(&pipe, path) && (context = _cxml_xp_pipe_context(&pipe)))
     {
-        cxml_set_add(&_xpath_parser.nodeset, _xpath_parser.context.ctx_node);
+        // pull the selected nodes through a pipe, the positional predicates
+        // of the steps are applied while walking the document.
+        cxml_set_free(&_xpath_parser.nodeset);
+        _cxml_xp_pipe_open(&pipe, context);
+        for (void *selected; (selected = _cxml_xp_pipe_next(&pipe));){
+            cxml_set_add(&_xpath_parser.nodeset, selected);
+        }
+        _cxml_xp_pipe_close(&pipe);
+        if (!_cxml_budget_results(cxml_set_size(&_xpath_parser.nodeset))){
+            cxml_set_free(&_xpath_parser.nodeset);
+        }
+        _xpath_parser.is_empty_nodeset = cxml_set_is_empty(&_xpath_parser.nodeset);
+        has_no_predicate = 1;
+        visited = pipe.visited;
+        _cxml_xp_profile_rewrite(node, CXML_XP_REWRITE_PIPELINED);
     }
-    bool has_no_predicate = 0;
-    cxml_for_each(step, &path->steps)
+    else
     {
-        cxml_xp_visit_Step(step);
-        has_no_predicate = cxml_list_is_empty(&((cxml_xp_step* )step)->predicates);
-        // stop evaluating if the result of evaluating a step is an empty node-set
-        if (_xpath_parser.is_empty_nodeset){
-            break;
+        if (step_node->path_spec == 0  // '.' | `name`
+            && cxml_set_is_empty(&_xpath_parser.nodeset)
+            && _xpath_parser.context.ctx_node)
+        {
+            cxml_set_add(&_xpath_parser.nodeset, _xpath_parser.context.ctx_node);
         }
+        // (the paths of the predicates of the steps keep their own flag)
+        bool after_axis = _xpath_parser.after_axis;
+        _xpath_parser.after_axis = false;
+        cxml_for_each(step, &path->steps)
+        {
+            // a step with predicate(s) pushes its result on the stack (see cxml_xp_visit_Step()),
+            // which is superseded by the result of the next step
+            if (pushed) _cxml_xp__e_pop();
+            // (a step starts from the root or context node when the accumulating nodeset is empty)
+            step_visited = cxml_set_is_empty(&_xpath_parser.nodeset) ? 1 : cxml_set_size(&_xpath_parser.nodeset);
+            visited += step_visited;
+            _cxml_xp_profile_begin(&step_span, step);
+            cxml_xp_visit_Step(step);
+            _cxml_xp_profile_end(&step_span, step_visited, cxml_set_size(&_xpath_parser.nodeset), 0);
+            has_no_predicate = cxml_list_is_empty(&((cxml_xp_step* )step)->predicates);
+            pushed = !has_no_predicate;
+            // the nodes selected on an axis are sorted, but may nest
+            if (((cxml_xp_step* )step)->axis) _xpath_parser.after_axis = true;
+            // stop evaluating if the result of evaluating a step is an empty node-set
+            if (_xpath_parser.is_empty_nodeset){
+                break;
+            }
+        }
+        _xpath_parser.after_axis = after_axis;
     }
     /*
      * no predicate? push accumulating nodeset on stack
@@ -1453,15 +2108,16 @@ void cxml_xp_visit_Path(cxml_xp_astnode *node){
     {
         // cache the result
         // copy `_xpath_parser.nodeset`, and cache result
-        cxml_list * cached_nodeset = new_alloc_cxml_list();
-        // store the nodeset in alloc_set_list for tracking, and eventually freeing.
-        cxml_list_append(&_xpath_parser.alloc_set_list, cached_nodeset);
+        cxml_list * cached_nodeset = cxml_arena_alloc(&_xpath_parser.arena, sizeof(cxml_list));
+        cxml_list_init(cached_nodeset);
+        // the list's nodes are freed when the arena is reset
+        cxml_arena_on_reset(&_xpath_parser.arena, _cxml_xp__free_cached_nodeset, cached_nodeset);
         // copy the accumulating nodeset into the cache
         cxml_list_copy(cached_nodeset, &_xpath_parser.nodeset.items);
         // store the nodeset in the cache, but check if an item was popped off the cache.
         void* removed = _cxml_cache_put(&_xpath_parser.lru_cache, node, cached_nodeset);
         if (removed){
-            // all allocated lists will be freed on destruction,
+            // the list itself lives in the arena,
             // for now, we just free this current list's contents
             cxml_list_free(removed);
         }
@@ -1472,6 +2128,7 @@ void cxml_xp_visit_Path(cxml_xp_astnode *node){
       * when a new path node needs to be evaluated, since it's a global object always
       * used in evaluating path nodes.
       */
+    _cxml_xp_profile_end(&span, visited, cxml_set_size(&_xpath_parser.nodeset), 0);
     cxml_set_free(&_xpath_parser.nodeset);
 }
 
@@ -1503,6 +2160,23 @@ bool _evaluate_predicate_expr(_cxml_xp_data *res_d) {
     return ret;
 }
 
+static bool _test_predicate_expr(cxml_xp_astnode *expr_node){
+    if (expr_node->is_invariant){
+        return _evaluate_predicate_expr(_cxml_xp_invariant_value(expr_node));
+    }
+    // a path used as a predicate only needs to select a single node
+    bool exists;
+    if (_cxml_xp_exists(expr_node, &exists)) return exists;
+    cxml_xp_visit(expr_node);
+    return _evaluate_predicate_expr(_cxml_xp__e_pop());
+}
+
+static bool _test_predicate(cxml_xp_predicate *predicate){
+    // run the compiled expression, if the predicate was compiled (see cxxpvm.c)
+    if (predicate->program) return _cxml_xp_run(predicate->program);
+    return _test_predicate_expr(predicate->expr_node);
+}
+
 static void _partition_nodeset(cxml_list* nodelist, cxml_list* gather){
     /*
      * group nodes into lists where each list contains only nodes
@@ -1582,6 +2256,9 @@ void cxml_xp_visit_Predicate(cxml_xp_predicate* node){
      * in the new node-set; otherwise, it is not included
      */
     _cxml_xp_data *data = _cxml_xp__e_pop();  // nodeset
+    _cxml_xp_profile_span span;
+    _cxml_xp_profile_begin(&span, node);
+    long visited = cxml_set_size(&data->nodeset);
 
      /*
       * get result of PredicateExpr evaluation
@@ -1605,10 +2282,12 @@ void cxml_xp_visit_Predicate(cxml_xp_predicate* node){
     struct _cxml_xp_context_state ctx;
     cxml_for_each(partition, &partitions)
     {
+        if (_cxml_budget_exhausted()) break;
         ctx_size = cxml_list_size(partition);
         ctx_pos = 0;
         cxml_for_each(ctx_node, (cxml_list*)partition)
         {
+            if (!_cxml_budget_visit(1)) break;
             ctx_pos++;
             cxml_set_add(&_xpath_parser.nodeset, ctx_node);
 
@@ -1616,11 +2295,10 @@ void cxml_xp_visit_Predicate(cxml_xp_predicate* node){
                     &_xpath_parser.context,
                     &ctx, ctx_node, ctx_pos, ctx_size);  // push new context state
 
-            cxml_xp_visit(node->expr_node);
-            // evaluate res_d against each node (as context node)
+            // evaluate the predicate expression against each node (as context node)
             // if the context node passes the predicate expression test, then
             // add it to the list of successfully filtered nodes.
-            if (_evaluate_predicate_expr(_cxml_xp__e_pop())){
+            if (_test_predicate(node)){
                 cxml_list_append(&filtered, ctx_node);
             }
             _cxml_xp_pop_context(&_xpath_parser.ctx_stack,
@@ -1653,6 +2331,81 @@ void cxml_xp_visit_Predicate(cxml_xp_predicate* node){
     // update is_empty_nodeset flag to be used in visit_Path() after the
     // Predicate node has been completely evaluated.
     _xpath_parser.is_empty_nodeset = cxml_set_is_empty(&_xpath_parser.nodeset);
+    _cxml_xp_profile_end(&span, visited, cxml_set_size(&data->nodeset), 0);
+}
+
+static void cxml_xp_visit_Filter(cxml_xp_filter *node){
+    /*
+     * '(' Expr ')' Predicate+
+     * Unlike the predicates of a step, the predicates of a filter expression filter
+     * the whole node-set (in document order), i.e. the node-set is never partitioned.
+     */
+    _cxml_xp_data *data;
+    struct _cxml_list__node *pred = node->predicates.head;
+    int position = _cxml_xp_literal_position(((cxml_xp_predicate*)pred->item)->expr_node);
+    _cxml_xp_pipe pipe;
+    void *context;
+    _cxml_xp_profile_span span, pred_span;
+    _cxml_xp_profile_begin(&span, node);
+    long visited;
+    if (position
+        && node->expr_node->wrapped_type == CXML_XP_AST_PATH_NODE
+        && _cxml_xp_pipe_plan(&pipe, node->expr_node->wrapped_node.path)
+        && (context = _cxml_xp_pipe_context(&pipe)))
+    {
+        // (path)[n] -> only the first n nodes selected by the path are needed
+        data = _cxml_xp_new_data();
+        data->type = CXML_XP_DATA_NODESET;
+        cxml_set_init(&data->nodeset);
+        void *selected;
+        _cxml_xp_pipe_open(&pipe, context);
+        while ((selected = _cxml_xp_pipe_next(&pipe)) && --position);
+        cxml_set_add(&data->nodeset, selected);
+        _cxml_xp_pipe_close(&pipe);
+        cxml_set_free(&_xpath_parser.nodeset);
+        pred = pred->next;
+        visited = pipe.visited;
+        _cxml_xp_profile_rewrite(node, CXML_XP_REWRITE_PIPELINED);
+    }else{
+        cxml_xp_visit(node->expr_node);
+        data = _cxml_xp__e_pop();
+        if (data->type != CXML_XP_DATA_NODESET){
+            _cxml_xp_eval_err("Predicates can only be used to filter node-sets.");
+        }
+        _sort_nodeset_by_pos(&data->nodeset.items);
+        visited = cxml_set_size(&data->nodeset);
+    }
+    int ctx_size, ctx_pos;
+    struct _cxml_xp_context_state ctx;
+    cxml_list filtered = new_cxml_list();
+    for (; pred; pred = pred->next)
+    {
+        ctx_size = cxml_set_size(&data->nodeset);
+        ctx_pos = 0;
+        _cxml_xp_profile_begin(&pred_span, pred->item);
+        cxml_for_each(ctx_node, &data->nodeset.items)
+        {
+            if (!_cxml_budget_visit(1)) break;
+            ctx_pos++;
+            cxml_set_add(&_xpath_parser.nodeset, ctx_node);
+            _cxml_xp_push_context(&_xpath_parser.ctx_stack,
+                    &_xpath_parser.context,
+                    &ctx, ctx_node, ctx_pos, ctx_size);
+            if (_test_predicate(pred->item)){
+                cxml_list_append(&filtered, ctx_node);
+            }
+            _cxml_xp_pop_context(&_xpath_parser.ctx_stack, &_xpath_parser.context);
+            cxml_set_free(&_xpath_parser.nodeset);
+        }
+        _cxml_xp_profile_end(&pred_span, ctx_size, cxml_list_size(&filtered), 0);
+        cxml_set_free(&data->nodeset);
+        cxml_for_each(_node, &filtered){
+            cxml_set_add(&data->nodeset, _node);
+        }
+        cxml_list_free(&filtered);
+    }
+    _cxml_xp__e_push(data);
+    _cxml_xp_profile_end(&span, visited, cxml_set_size(&data->nodeset), 0);
 }
 
 static void cxml_xp_visit_Num(cxml_xp_num *node) {
@@ -1670,19 +2423,33 @@ static void cxml_xp_visit_String(cxml_xp_string *node) {
     _cxml_xp__e_push(data);
 }
 
-// from cxxplib.c
-extern struct _cxml_xp_func_LU fn_LU_table[];
-
 static void cxml_xp_visit_FunctionCall(cxml_xp_functioncall* node){
     // lookup_func_name()
     // invoke func()
     // visit args
     // evaluate func
     // push result to stack
-    (*fn_LU_table[node->pos].fn)(node, _cxml_xp__e_pop, _cxml_xp__e_push);
+    _cxml_xp_call_fn(node, _cxml_xp__e_pop, _cxml_xp__e_push);
 }
 
 static void cxml_xp_visit_BinaryOp(cxml_xp_binaryop* node){
+    if (node->op == CXML_XP_OP_AND || node->op == CXML_XP_OP_OR){
+        // the right operand is only evaluated if the left operand doesn't decide the result
+        bool l_val;
+        cxml_xp_visit(node->l_node);
+        _cxml_xp_data* left = _cxml_xp__e_pop();
+        _cxml_xp_data_to_boolean(left, &l_val);
+        if (l_val == (node->op == CXML_XP_OP_OR)){
+            _cxml_xp_data_clear(left);
+            left->type = CXML_XP_DATA_BOOLEAN;
+            left->boolean = l_val;
+            _cxml_xp__e_push(left);
+            return;
+        }
+        cxml_xp_visit(node->r_node);
+        _cxml_xp_resolve_and_or_operation(left, _cxml_xp__e_pop(), _cxml_xp__e_push, node->op);
+        return;
+    }
     cxml_xp_visit(node->l_node);
     cxml_xp_visit(node->r_node);
     _cxml_xp_data* right = _cxml_xp__e_pop();
@@ -1703,10 +2470,6 @@ static void cxml_xp_visit_BinaryOp(cxml_xp_binaryop* node){
         case CXML_XP_OP_LT:
             _cxml_xp_resolve_relative_operation(left, right, _cxml_xp__e_push, node->op);
             break;
-        case CXML_XP_OP_AND:
-        case CXML_XP_OP_OR:
-            _cxml_xp_resolve_and_or_operation(left, right, _cxml_xp__e_push, node->op);
-            break;
         case CXML_XP_OP_PIPE:
             _cxml_xp_resolve_pipe_operation(left, right, _sort_nodeset_by_pos, _cxml_xp__e_push);
             break;
@@ -1734,7 +2497,35 @@ static void cxml_xp_visit_UnaryOp(cxml_xp_unaryop *node){
     _cxml_xp__e_push(r_node);
 }
 
-void cxml_xp_visit(cxml_xp_astnode * ast_node){  // generic cxml_xp_visit
+/*
+ * Obtain the value bound to the variable `name` in the (prepared) query
+ * being evaluated, NULL if the variable isn't bound.
+ */
+_cxml_xp_data *_cxml_xp_binding_value(cxml_string *name){
+    if (!_xpath_parser.bindings) return NULL;
+    cxml_for_each(binding, _xpath_parser.bindings){
+        if (cxml_string_equals(&((_cxml_xp_binding*)binding)->name, name)){
+            return &((_cxml_xp_binding*)binding)->value;
+        }
+    }
+    return NULL;
+}
+
+static void cxml_xp_visit_Variable(cxml_xp_variable *node){
+    _cxml_xp_data *value = _cxml_xp_binding_value(&node->name);
+    if (!value){
+        int buff_size = (int)cxml_string_len(&node->name) + 40;
+        char buff[buff_size];
+        snprintf(buff, buff_size, "Unbound variable - `$%s`", cxml_string_as_raw(&node->name));
+        _cxml_xp_eval_err(buff);
+    }
+    // the value is consumed by the caller, push a copy
+    _cxml_xp_data *data = _cxml_xp_new_data();
+    _cxml_xp_data_copy(data, value);
+    _cxml_xp__e_push(data);
+}
+
+static void _cxml_xp_visit_node(cxml_xp_astnode * ast_node){
     switch(ast_node->wrapped_type){
         case CXML_XP_AST_UNARYOP_NODE:
             cxml_xp_visit_UnaryOp(ast_node->wrapped_node.unary);
@@ -1760,19 +2551,64 @@ void cxml_xp_visit(cxml_xp_astnode * ast_node){  // generic cxml_xp_visit
         case CXML_XP_AST_PATH_NODE:
             cxml_xp_visit_Path(ast_node);
             break;
+        case CXML_XP_AST_FILTER_NODE:
+            cxml_xp_visit_Filter(ast_node->wrapped_node.filter);
+            break;
+        case CXML_XP_AST_VARIABLE_NODE:
+            cxml_xp_visit_Variable(ast_node->wrapped_node.variable);
+            break;
         default: break;
     }
 }
 
-cxml_set* cxml_xp_eval_expr(){
-    if (!_xpath_parser.root_node || !_xpath_parser.root_element) return NULL;
-    // don't pop the node off the stack since it's needed when calling cxml_xp_free_ast_nodes()
-    cxml_xp_astnode* node = _cxml_stack__get(&_xpath_parser.ast_stack);
+/*
+ * Obtain the value of the invariant node `ast_node`, evaluating it
+ * only the first time it is needed in the query.
+ */
+_cxml_xp_data *_cxml_xp_invariant_value(cxml_xp_astnode * ast_node){
+    if (!ast_node->value){
+        _cxml_xp_visit_node(ast_node);
+        _cxml_xp_data *value = _cxml_xp_new_data();
+        _cxml_xp_data_copy(value, _cxml_stack__get(&_xpath_parser.acc_stack));
+        _cxml_xp__e_pop();
+        ast_node->value = value;
+        cxml_list_append(&_xpath_parser.invariants, ast_node);
+    }
+    return ast_node->value;
+}
+
+void cxml_xp_visit(cxml_xp_astnode * ast_node){  // generic cxml_xp_visit
+    if (ast_node->is_invariant){
+        // the value is consumed by the caller, push a copy
+        _cxml_xp_data *data = _cxml_xp_new_data();
+        _cxml_xp_data_copy(data, _cxml_xp_invariant_value(ast_node));
+        _cxml_xp__e_push(data);
+        return;
+    }
+    _cxml_xp_visit_node(ast_node);
+}
+
+static cxml_set *_cxml_xp_eval_node(cxml_xp_astnode *node){
+    _cxml_budget_begin();
     cxml_xp_visit(node);
     _cxml_xp_data *d =  _cxml_xp__e_pop();
+    // (the result of an aborted evaluation is incomplete)
+    if (_cxml_budget_exhausted()) return NULL;
     cxml_set *set = ALLOC(cxml_set, 1);
+    if (d->type != CXML_XP_DATA_NODESET){
+        // (a variable bound to a string, for example)
+        cxml_set_init(set);
+        return set;
+    }
     cxml_set__init_with(set, &d->nodeset);
     d->nodeset = new_cxml_set();
+    return set;
+}
+
+cxml_set* cxml_xp_eval_expr(){
+    if (!_xpath_parser.root_node || !_xpath_parser.root_element) return NULL;
+    // don't pop the node off the stack since it's needed when calling cxml_xp_free_ast_nodes()
+    cxml_set *set = _cxml_xp_eval_node(_cxml_stack__get(&_xpath_parser.ast_stack));
     // free all data
     _cxml_xpath_parser_free();
     return set;
@@ -1846,3 +2682,247 @@ cxml_set * cxml_xpath(void * root, const char *expr) {
     return nodeset;
 }
 
+/*
+ * Evaluate `expr` (as cxml_xpath() does), recording the plan of the query, and how
+ * each of its paths, steps, and predicates was evaluated, in `profile`.
+ * `profile` must be freed with cxml_xp_profile_free(), and can be
+ * printed with cxml_xp_profile_print().
+ */
+cxml_set * cxml_xpath_profile(void *root, const char *expr, cxml_xp_profile *profile){
+    if (!root || !expr || !profile) return NULL;
+    _cxml_xp_profile_init(profile, expr);
+    _xpath_parser.profile = profile;
+    clock_t start = clock();
+    query_string(expr);
+    profile->parse_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+    _set_roots(root);
+    start = clock();
+    cxml_set *nodeset = cxml_xp_eval_expr();
+    profile->eval_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+    _xpath_parser.profile = NULL;
+    // the ast nodes have been freed with the parser's state
+    cxml_table_free(&profile->nodes);
+    profile->size = nodeset ? cxml_set_size(nodeset) : 0;
+    cxml_xp_profile_entry *entry = cxml_list_first(&profile->entries);
+    if (entry && entry->type == CXML_XP_PROFILE_EXPR){
+        entry->calls = 1;
+        entry->produced = profile->size;
+        entry->time = profile->eval_time;
+    }
+    return nodeset;
+}
+
+
+/*
+ * Initialize the cursor `iter` over the nodes selected by `expr`, skipping the first
+ * `offset` nodes, and producing at most `limit` nodes (0 for no limit).
+ * `root` can be a cxml_root_node, or a cxml_elem_node object.
+ */
+void cxml_xpath_iter_init(cxml_xpath_iter *iter, void *root, const char *expr, int offset, int limit){
+    if (!iter) return;
+    iter->offset = offset > 0 ? offset : 0;
+    iter->limit = limit;
+    iter->limited = limit > 0;
+    iter->ast = NULL;
+    iter->nodeset = NULL;
+    iter->next = NULL;
+    iter->virtual_root = NULL;
+    iter->xml_namespace = NULL;
+    _cxml_xp_pipe_open(&iter->pipe, NULL);
+    if (!root || !expr) return;
+    query_string(expr);
+    _set_roots(root);
+    if (_cxml_node_type(root) == CXML_ELEM_NODE){
+        iter->virtual_root = _xpath_parser.root_node;
+    }
+    cxml_xp_astnode *node = _cxml_stack__get(&_xpath_parser.ast_stack);
+    void *context;
+    if (node->wrapped_type == CXML_XP_AST_PATH_NODE
+        && _cxml_xp_pipe_plan(&iter->pipe, node->wrapped_node.path)
+        && (context = _cxml_xp_pipe_context(&iter->pipe)))
+    {
+        // keep the ast (referenced by the pipe's steps) past the parser's state
+        iter->ast = _cxml_stack__pop(&_xpath_parser.ast_stack);
+        // (the nodes pulled from the cursor share a budget)
+        _cxml_budget_begin();
+        _cxml_xp_pipe_open(&iter->pipe, context);
+        _cxml_xpath_parser_free();
+    }else{
+        iter->nodeset = cxml_xp_eval_expr();
+        iter->next = iter->nodeset ? iter->nodeset->items.head : NULL;
+    }
+}
+
+/*
+ * Parse (and optimize) `expr` once, for it to be evaluated any number of times
+ * with cxml_xp_query_eval(). The query can reference variables ($name), whose values
+ * are bound with the cxml_xp_query_bind_*() functions.
+ * The query must be freed with cxml_xp_query_free().
+ */
+cxml_xp_query *cxml_xpath_prepare(const char *expr){
+    if (!expr) return NULL;
+    cxml_xp_query *query = ALLOC(cxml_xp_query, 1);
+    query->expr = new_cxml_string();
+    cxml_string_raw_append(&query->expr, expr);
+    cxml_list_init(&query->bindings);
+    query->recompile = false;
+    query_string(cxml_string_as_raw(&query->expr));
+    // keep the ast past the parser's state
+    query->ast = _cxml_stack__pop(&_xpath_parser.ast_stack);
+    _cxml_xpath_parser_free();
+    return query;
+}
+
+static _cxml_xp_data *_cxml_xp_query__bind(cxml_xp_query *query, const char *name, _cxml_xp_data_t type){
+    _cxml_xp_binding *binding;
+    cxml_for_each(_binding, &query->bindings){
+        binding = _binding;
+        if (cxml_string_raw_equals(&binding->name, name)){
+            // the predicates are compiled for the type of the value bound
+            if (binding->value.type != type) query->recompile = true;
+            _cxml_xp_data_free(&binding->value);
+            binding->value.type = type;
+            return &binding->value;
+        }
+    }
+    binding = ALLOC(_cxml_xp_binding, 1);
+    binding->name = new_cxml_string();
+    cxml_string_raw_append(&binding->name, name);
+    binding->value.type = type;
+    cxml_list_append(&query->bindings, binding);
+    query->recompile = true;
+    return &binding->value;
+}
+
+/*
+ * Bind the variable `name` (without the '$') to a value, in `query`.
+ * A variable can be bound again (to a value of any type) between evaluations.
+ */
+void cxml_xp_query_bind_string(cxml_xp_query *query, const char *name, const char *value){
+    if (!query || !name || !value) return;
+    _cxml_xp_data *data = _cxml_xp_query__bind(query, name, CXML_XP_DATA_STRING);
+    data->str = new_cxml_string();
+    cxml_string_raw_append(&data->str, value);
+}
+
+void cxml_xp_query_bind_number(cxml_xp_query *query, const char *name, double value){
+    if (!query || !name) return;
+    _cxml_xp_data *data = _cxml_xp_query__bind(query, name, CXML_XP_DATA_NUMERIC);
+    cxml_number_init(&data->number);
+    if (!isnan(value)){
+        data->number.type = CXML_NUMERIC_DOUBLE_T;
+        data->number.dec_val = value;
+    }
+}
+
+void cxml_xp_query_bind_boolean(cxml_xp_query *query, const char *name, bool value){
+    if (!query || !name) return;
+    _cxml_xp_query__bind(query, name, CXML_XP_DATA_BOOLEAN)->boolean = value;
+}
+
+/*
+ * The nodes of `value` are copied, they must outlive the evaluations of the query.
+ */
+void cxml_xp_query_bind_nodeset(cxml_xp_query *query, const char *name, cxml_set *value){
+    if (!query || !name || !value) return;
+    _cxml_xp_data *data = _cxml_xp_query__bind(query, name, CXML_XP_DATA_NODESET);
+    cxml_set_copy(&data->nodeset, value);
+}
+
+/*
+ * Evaluate the prepared `query` against `root` (a cxml_root_node, or a cxml_elem_node object),
+ * with the values currently bound to its variables.
+ */
+cxml_set *cxml_xp_query_eval(cxml_xp_query *query, void *root){
+    if (!query || !root || !query->ast) return NULL;
+    // (errors are reported against the query's expression)
+    _cxml_xp_lexer_init(&_xpath_parser.lexer, cxml_string_as_raw(&query->expr));
+    _xpath_parser.bindings = &query->bindings;
+    if (query->recompile){
+        cxml_xp_recompile(query->ast);
+        query->recompile = false;
+    }
+    _cxml_stack__push(&_xpath_parser.ast_stack, query->ast);
+    _set_roots(root);
+    cxml_root_node *virtual_root = _cxml_node_type(root) == CXML_ELEM_NODE ? _xpath_parser.root_node : NULL;
+    cxml_set *nodeset = _cxml_xp_eval_node(query->ast);
+    // the ast is owned by the query
+    _cxml_stack__pop(&_xpath_parser.ast_stack);
+    _cxml_xpath_parser_free();
+    if (virtual_root){
+        // the root element belongs to the caller's document
+        cxml_list_free(&virtual_root->children);
+        cxml_string_free(&virtual_root->name);
+        FREE(virtual_root);
+    }
+    return nodeset;
+}
+
+void cxml_xp_query_free(cxml_xp_query *query){
+    if (!query) return;
+    if (query->ast) cxml_xp_fvisit(query->ast);
+    cxml_for_each(binding, &query->bindings){
+        cxml_string_free(&((_cxml_xp_binding*)binding)->name);
+        _cxml_xp_data_free(&((_cxml_xp_binding*)binding)->value);
+        FREE(binding);
+    }
+    cxml_list_free(&query->bindings);
+    cxml_string_free(&query->expr);
+    FREE(query);
+}
+
+inline static void *_cxml_xpath_iter__advance(cxml_xpath_iter *iter){
+    void *node = NULL;
+    if (iter->ast){
+        // the parser's state may have been reused since the last node was produced
+        cxml_ns_node *xml_ns = _xpath_parser.xml_namespace;
+        _xpath_parser.xml_namespace = iter->xml_namespace;
+        node = _cxml_xp_pipe_next(&iter->pipe);
+        iter->xml_namespace = _xpath_parser.xml_namespace;
+        _xpath_parser.xml_namespace = xml_ns;
+        // the document may change before the next node is produced
+        _cxml_xp__forget_string_vals();
+        memset(_xpath_parser.ns_memo, 0, sizeof(_xpath_parser.ns_memo));
+    }else if (iter->next){
+        node = iter->next->item;
+        iter->next = iter->next->next;
+    }
+    return node;
+}
+
+/*
+ * Obtain the next node selected, NULL when exhausted.
+ */
+void *cxml_xpath_iter_next(cxml_xpath_iter *iter){
+    if (!iter || (iter->limited && !iter->limit)) return NULL;
+    for (; iter->offset; iter->offset--){
+        if (!_cxml_xpath_iter__advance(iter)) return NULL;
+    }
+    void *node = _cxml_xpath_iter__advance(iter);
+    if (node && iter->limited) iter->limit--;
+    return node;
+}
+
+void cxml_xpath_iter_free(cxml_xpath_iter *iter){
+    if (!iter) return;
+    _cxml_xp_pipe_close(&iter->pipe);
+    if (iter->ast){
+        cxml_xp_fvisit(iter->ast);
+        iter->ast = NULL;
+    }
+    if (iter->nodeset){
+        cxml_set_free(iter->nodeset);
+        FREE(iter->nodeset);
+        iter->nodeset = NULL;
+    }
+    iter->next = NULL;
+    if (iter->virtual_root){
+        // the root element belongs to the caller's document
+        cxml_list_free(&iter->virtual_root->children);
+        cxml_string_free(&iter->virtual_root->name);
+        FREE(iter->virtual_root);
+        iter->virtual_root = NULL;
+    }
+    cxml_ns_node_free(iter->xml_namespace);
+    iter->xml_namespace = NULL;
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#include "xpath/cxxpfrozen.h"
+#include "xpath/cxxpparser.h"
+
+
+extern void query_string(const char *expr);
+
+typedef enum{
+    _CXML_XP_FROZEN_CHILD,
+    _CXML_XP_FROZEN_DESCENDANT,
+    _CXML_XP_FROZEN_DESCENDANT_OR_SELF,
+    _CXML_XP_FROZEN_SELF,
+    _CXML_XP_FROZEN_PARENT
+}_cxml_xp_frozen_axis_t;
+
+// a step, planned for frozen documents
+struct _cxml_xp_frozen_step{
+    _cxml_xp_frozen_axis_t axis;
+    int kind;       // node type matched, -1 for any (non-prolog) node
+    char *name;     // name matched (elements, processing-instructions), NULL for any
+};
+
+// a copy of `name`, outliving the parsed path
+static char *_cxml_xp_frozen__name(cxml_string *name){
+    char *copy = ALLOC(char, (cxml_string_len(name) + 1));
+    memcpy(copy, cxml_string_as_raw(name), cxml_string_len(name));
+    copy[cxml_string_len(name)] = '\0';
+    return copy;
+}
+
+/*
+ * Plan `step`. Returns false if the step can't be evaluated over a frozen document.
+ */
+static bool _cxml_xp_frozen__plan(cxml_xp_step *step, struct _cxml_xp_frozen_step *fs){
+    fs->kind = -1;
+    fs->name = NULL;
+    if (step->has_attr_axis || !cxml_list_is_empty(&step->predicates)) return false;
+    if (step->abbrev_step){
+        fs->axis = step->abbrev_step == 1 ? _CXML_XP_FROZEN_SELF : _CXML_XP_FROZEN_PARENT;
+    }else{
+        switch (step->axis)
+        {
+            case CXML_XP_AXIS_NIL:                  fs->axis = _CXML_XP_FROZEN_CHILD; break;
+            case CXML_XP_AXIS_DESCENDANT:           fs->axis = _CXML_XP_FROZEN_DESCENDANT; break;
+            case CXML_XP_AXIS_DESCENDANT_OR_SELF:   fs->axis = _CXML_XP_FROZEN_DESCENDANT_OR_SELF; break;
+            case CXML_XP_AXIS_SELF:                 fs->axis = _CXML_XP_FROZEN_SELF; break;
+            case CXML_XP_AXIS_PARENT:               fs->axis = _CXML_XP_FROZEN_PARENT; break;
+            default: return false;
+        }
+        cxml_xp_nodetest *test = step->node_test;
+        if (!test) return false;
+        if (test->t_type == CXML_XP_NODE_TEST_NAMETEST){
+            fs->kind = CXML_ELEM_NODE;
+            if (test->name_test.t_type == CXML_XP_NAME_TEST_NAME){
+                fs->name = _cxml_xp_frozen__name(&test->name_test.name.qname);
+            }else if (test->name_test.t_type != CXML_XP_NAME_TEST_WILDCARD){
+                // prefixes are resolved against the namespaces in scope, which aren't frozen
+                return false;
+            }
+        }else{
+            switch (test->type_test.t_type)
+            {
+                case CXML_XP_TYPE_TEST_NODE:    break;
+                case CXML_XP_TYPE_TEST_TEXT:    fs->kind = CXML_TEXT_NODE; break;
+                case CXML_XP_TYPE_TEST_COMMENT: fs->kind = CXML_COMM_NODE; break;
+                case CXML_XP_TYPE_TEST_PI:
+                    fs->kind = CXML_PI_NODE;
+                    if (test->type_test.has_target){
+                        fs->name = _cxml_xp_frozen__name(&test->type_test.target);
+                    }
+                    break;
+                default: return false;
+            }
+        }
+    }
+    // '//' step -> descendant-or-self::node()/step
+    if (step->path_spec == 2){
+        switch (fs->axis)
+        {
+            case _CXML_XP_FROZEN_CHILD:
+                fs->axis = _CXML_XP_FROZEN_DESCENDANT;
+                break;
+            case _CXML_XP_FROZEN_SELF:
+                fs->axis = _CXML_XP_FROZEN_DESCENDANT_OR_SELF;
+                break;
+            case _CXML_XP_FROZEN_PARENT:
+                return false;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+// `sym` is the symbol of the name of `fs` in `doc` (CXML_FROZEN_ANY_SYMBOL for any name)
+inline static bool _cxml_xp_frozen__match(cxml_frozen_doc *doc, struct _cxml_xp_frozen_step *fs, int sym, int node){
+    if (fs->kind == -1){
+        return doc->kind[node] != CXML_XHDR_NODE && doc->kind[node] != CXML_DTD_NODE;
+    }
+    return doc->kind[node] == fs->kind && (sym == CXML_FROZEN_ANY_SYMBOL || doc->name[node] == sym);
+}
+
+static int _cxml_xp_frozen__cmp(const void *a, const void *b){
+    return *(const int *)a - *(const int *)b;
+}
+
+/*
+ * Select the nodes reached by `fs` from each node of `context` (in document order) into `acc`,
+ * in document order.
+ */
+static void _cxml_xp_frozen__step(
+        cxml_frozen_doc *doc,
+        struct _cxml_xp_frozen_step *fs,
+        int sym,
+        cxml_frozen_set *context,
+        cxml_frozen_set *acc)
+{
+    int ctx, covered = -1;
+    bool ordered = true;
+    for (int i = 0; i < context->size; i++)
+    {
+        ctx = context->nodes[i];
+        switch (fs->axis)
+        {
+            case _CXML_XP_FROZEN_CHILD:
+                for (int c = doc->first_child[ctx]; c != -1; c = doc->next_sibling[c]){
+                    if (_cxml_xp_frozen__match(doc, fs, sym, c)) cxml_frozen_set_add(acc, c);
+                }
+                break;
+            case _CXML_XP_FROZEN_DESCENDANT:
+            case _CXML_XP_FROZEN_DESCENDANT_OR_SELF:
+                // the subtree of a context node nested in the previous one is already scanned
+                if (ctx <= covered) break;
+                covered = doc->end[ctx];
+                for (int n = fs->axis == _CXML_XP_FROZEN_DESCENDANT ? ctx + 1 : ctx; n <= covered; n++){
+                    if (_cxml_xp_frozen__match(doc, fs, sym, n)) cxml_frozen_set_add(acc, n);
+                }
+                break;
+            case _CXML_XP_FROZEN_SELF:
+                if (_cxml_xp_frozen__match(doc, fs, sym, ctx)) cxml_frozen_set_add(acc, ctx);
+                break;
+            case _CXML_XP_FROZEN_PARENT:
+                if (doc->parent[ctx] != -1 && _cxml_xp_frozen__match(doc, fs, sym, doc->parent[ctx])){
+                    cxml_frozen_set_add(acc, doc->parent[ctx]);
+                }
+                break;
+        }
+    }
+    // the children (and parents) of nested context nodes interleave
+    for (int i = 1; i < acc->size && ordered; i++){
+        ordered = acc->nodes[i - 1] < acc->nodes[i];
+    }
+    if (ordered) return;
+    qsort(acc->nodes, (size_t)acc->size, sizeof(int), _cxml_xp_frozen__cmp);
+    int size = 1;
+    for (int i = 1; i < acc->size; i++){
+        if (acc->nodes[i] != acc->nodes[size - 1]) acc->nodes[size++] = acc->nodes[i];
+    }
+    acc->size = size;
+}
+
+/*
+ * Prepare the path `expr` for frozen documents.
+ * Returns NULL if `expr` can't be evaluated over a frozen document (see cxxpfrozen.h).
+ * The path is parsed with the (shared) XPath parser, like cxml_xpath_prepare().
+ */
+cxml_xp_frozen_path *cxml_xpath_frozen_prepare(const char *expr){
+    if (!expr) return NULL;
+    query_string(expr);
+    cxml_xp_astnode *ast = _cxml_stack__get(&_xpath_parser.ast_stack);
+    if (!ast || ast->wrapped_type != CXML_XP_AST_PATH_NODE){
+        _cxml_xpath_parser_free();
+        return NULL;
+    }
+    cxml_list *steps = &ast->wrapped_node.path->steps;
+    cxml_xp_frozen_path *path = ALLOC(cxml_xp_frozen_path, 1);
+    path->size = 0;
+    path->steps = ALLOC(struct _cxml_xp_frozen_step, cxml_list_size(steps));
+    bool supported = true;
+    cxml_for_each(step, steps)
+    {
+        if (!(supported = _cxml_xp_frozen__plan(step, &path->steps[path->size]))) break;
+        path->size++;
+    }
+    _cxml_xpath_parser_free();
+    if (!supported){
+        cxml_xp_frozen_path_free(path);
+        return NULL;
+    }
+    return path;
+}
+
+/*
+ * Select the nodes of the frozen document `doc` matching the prepared `path` into `acc`
+ * (in document order). Relative paths are evaluated from the root node.
+ * No global state is read or written, so a path can be evaluated by several threads
+ * at once, against the same document or not.
+ */
+bool cxml_xp_frozen_path_eval(cxml_xp_frozen_path *path, cxml_frozen_doc *doc, cxml_frozen_set *acc){
+    if (!path || !doc || !acc) return false;
+    cxml_frozen_set context, selected;
+    cxml_frozen_set_init(&context);
+    cxml_frozen_set_init(&selected);
+    cxml_frozen_set_add(&context, 0);
+    int sym;
+    for (int i = 0; i < path->size && context.size; i++){
+        // -1 (no node has the name) matches nothing
+        sym = path->steps[i].name ? cxml_frozen_symbol(doc, path->steps[i].name) : CXML_FROZEN_ANY_SYMBOL;
+        selected.size = 0;
+        _cxml_xp_frozen__step(doc, &path->steps[i], sym, &context, &selected);
+        cxml_frozen_set tmp = context;
+        context = selected;
+        selected = tmp;
+    }
+    for (int i = 0; i < context.size; i++){
+        cxml_frozen_set_add(acc, context.nodes[i]);
+    }
+    cxml_frozen_set_free(&context);
+    cxml_frozen_set_free(&selected);
+    return true;
+}
+
+void cxml_xp_frozen_path_free(cxml_xp_frozen_path *path){
+    if (!path) return;
+    for (int i = 0; i < path->size; i++){
+        FREE(path->steps[i].name);
+    }
+    FREE(path->steps);
+    FREE(path);
+}
+
+/*
+ * Select the nodes of the frozen document `doc` matching `expr` into `acc` (in document order).
+ * Returns false (leaving `acc` untouched) if `expr` can't be evaluated over a frozen
+ * document (see cxxpfrozen.h).
+ * `expr` is prepared on each call (see cxml_xpath_frozen_prepare()), so unlike
+ * cxml_xp_frozen_path_eval(), calls can't be made from several threads at once.
+ */
+bool cxml_xpath_frozen(cxml_frozen_doc *doc, const char *expr, cxml_frozen_set *acc){
+    if (!doc || !expr || !acc) return false;
+    cxml_xp_frozen_path *path = cxml_xpath_frozen_prepare(expr);
+    if (!path) return false;
+    cxml_xp_frozen_path_eval(path, doc, acc);
+    cxml_xp_frozen_path_free(path);
+    return true;
+}
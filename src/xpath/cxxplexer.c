@@ -135,6 +135,19 @@ static _cxml_xp_token _cx_literal(_cxml_xp_lexer *xplexer){
     return _cx_create_xpath_token(xplexer, CXML_XP_TOKEN_LITERAL);
 }
 
+static _cxml_xp_token _cx_variable(_cxml_xp_lexer *xplexer){
+    // '$' QName
+    if (!_cxml__is_alpha(*xplexer->current)){
+        _cxml_xp_lex_error("Expected a variable name after '$' in xpath expression");
+    }
+    while (_cxml__is_identifier(*xplexer->current)
+           || (*xplexer->current == ':' && _cxml__is_alpha(*(xplexer->current + 1))))
+    {
+        _cxml_xp__move(xplexer);
+    }
+    return _cx_create_xpath_token(xplexer, CXML_XP_TOKEN_VARIABLE);
+}
+
 inline
 static void _cxml_xp__move(_cxml_xp_lexer *xplexer){
     if (_cx_at_end(xplexer)) return;
@@ -278,7 +291,9 @@ return _cx_create_xpath_token(xplexer, ttype);
             case ',':
                 return_token(CXML_XP_TOKEN_COMMA)
             case ':':
-                return_token(CXML_XP_TOKEN_COLON)
+                return_token(_cx_check(xplexer, ':') ? CXML_XP_TOKEN_D_COLON : CXML_XP_TOKEN_COLON)
+            case '$':
+                return _cx_variable(xplexer);
             default:
                 return_token(0xff)
         }
@@ -357,6 +372,10 @@ static char * _cxml_xp_get_token_type(_cxml_xp_token_t type) {
             return_type(CXML-XPATH-TOKEN-NODE-TYPE)
         case CXML_XP_TOKEN_COLON:
             return_type(CXML-XPATH-TOKEN-COLON)
+        case CXML_XP_TOKEN_VARIABLE:
+            return_type(CXML-XPATH-TOKEN-VARIABLE)
+        case CXML_XP_TOKEN_D_COLON:
+            return_type(CXML-XPATH-TOKEN-DOUBLE-COLON)
         default:
             return_type(CXML-XPATH-TOKEN-ERROR)
     }
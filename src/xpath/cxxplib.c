@@ -4,8 +4,14 @@
  */
 
 #include "xpath/cxxplib.h"
+#include "xpath/cxxpresolver.h"
+#include "utils/cxutf8hook.h"
 #include <math.h>
 
+// from cxxpeval.c
+extern bool _cxml_xp_exists(cxml_xp_astnode *node, bool *exists);
+
+extern bool _cxml_xp_fold(cxml_xp_astnode *node, _cxml_xp_fold_t fold, cxml_number *acc);
 
 /**
  * Core Functions
@@ -95,6 +101,26 @@ static void __cxml_xp_string_length_fn(cxml_xp_functioncall *node,
                                        _cxml_xp_data *(*_pop)(void),
                                        void (*_push)(_cxml_xp_data *));
 
+static void __cxml_xp_substring_fn(cxml_xp_functioncall *node,
+                                   _cxml_xp_data *(*_pop)(void),
+                                   void (*_push)(_cxml_xp_data *));
+
+static void __cxml_xp_substring_before_fn(cxml_xp_functioncall *node,
+                                          _cxml_xp_data *(*_pop)(void),
+                                          void (*_push)(_cxml_xp_data *));
+
+static void __cxml_xp_substring_after_fn(cxml_xp_functioncall *node,
+                                         _cxml_xp_data *(*_pop)(void),
+                                         void (*_push)(_cxml_xp_data *));
+
+static void __cxml_xp_translate_fn(cxml_xp_functioncall *node,
+                                   _cxml_xp_data *(*_pop)(void),
+                                   void (*_push)(_cxml_xp_data *));
+
+static void __cxml_xp_normalize_space_fn(cxml_xp_functioncall *node,
+                                         _cxml_xp_data *(*_pop)(void),
+                                         void (*_push)(_cxml_xp_data *));
+
 
 struct _cxml_xp_func_LU fn_LU_table[] = {
         // name         arg-count omittable     return-type         function-pointer
@@ -110,6 +136,7 @@ struct _cxml_xp_func_LU fn_LU_table[] = {
         {"local-name",      1,      1,      CXML_XP_RET_STRING,     __cxml_xp_lname_fn},
         {"name",            1,      1,      CXML_XP_RET_STRING,     __cxml_xp_name_fn},
         {"namespace-uri",   1,      1,      CXML_XP_RET_STRING,     __cxml_xp_namespace_uri_fn},
+        {"normalize-space", 1,      1,      CXML_XP_RET_STRING,     __cxml_xp_normalize_space_fn},
         {"not",             1,      0,      CXML_XP_RET_BOOLEAN,    __cxml_xp_not_fn},
         {"number",          1,      1,      CXML_XP_RET_NUMBER,     __cxml_xp_number_fn},
         {"position",        0,      0,      CXML_XP_RET_NUMBER,     __cxml_xp_position_fn},
@@ -117,19 +144,41 @@ struct _cxml_xp_func_LU fn_LU_table[] = {
         {"starts-with",     2,      0,      CXML_XP_RET_BOOLEAN,    __cxml_xp_starts_with_fn},
         {"string",          1,      1,      CXML_XP_RET_STRING,     __cxml_xp_string_fn},
         {"string-length",   1,      1,      CXML_XP_RET_NUMBER,     __cxml_xp_string_length_fn},
+        {"substring",       3,      1,      CXML_XP_RET_STRING,     __cxml_xp_substring_fn},
+        {"substring-after", 2,      0,      CXML_XP_RET_STRING,     __cxml_xp_substring_after_fn},
+        {"substring-before",2,      0,      CXML_XP_RET_STRING,     __cxml_xp_substring_before_fn},
         {"sum",             1,      0,      CXML_XP_RET_NUMBER,     __cxml_xp_sum_fn},
+        {"translate",       3,      0,      CXML_XP_RET_STRING,     __cxml_xp_translate_fn},
         {"true",            0,      0,      CXML_XP_RET_BOOLEAN,    __cxml_xp_true_fn}
 };
 
+#define _CXML_XP_FN_LU_SIZE     ((int)(sizeof(fn_LU_table) / sizeof(struct _cxml_xp_func_LU)))
+
+// registered extension functions, positioned after the built-in functions
+static struct{
+    int size;
+    int capacity;
+    struct _cxml_xp_ext_fn *fns;
+}_cxml_xp_ext_fns;
+
+bool _cxml_xp_is_ext_fn(int pos){
+    return pos >= _CXML_XP_FN_LU_SIZE;
+}
+
+inline static struct _cxml_xp_ext_fn *_cxml_xp_ext_fn_at(int pos){
+    return &_cxml_xp_ext_fns.fns[pos - _CXML_XP_FN_LU_SIZE];
+}
 
 // return true if a function found at the given position `pos`
 // uses the context node in its computation
 bool _is_poisonous_by_computation(int pos){
+    // (an impure extension function may use anything besides its arguments)
+    if (_cxml_xp_is_ext_fn(pos)) return !_cxml_xp_ext_fn_at(pos)->pure;
     switch (pos)
     {
         case 0x07:  // lang()
         case 0x08:  // last()
-        case 0xe:  return true; // position()
+        case 0xf:  return true; // position()
         default:    return false;
     }
 }
@@ -142,9 +191,10 @@ bool _is_poisonous_by_default_arg(int pos){
         case 0x09:                  // local-name()
         case 0xa:                   // name()
         case 0xb:                   // namespace-uri()
-        case 0xd:                   // number()
-        case 0x11:                  // string()
-        case 0x12:  return true;    // string-length()
+        case 0xc:                   // normalize-space()
+        case 0xe:                   // number()
+        case 0x12:                  // string()
+        case 0x13:  return true;    // string-length()
         default:    return false;
     }
 }
@@ -173,9 +223,30 @@ static struct _cxml_xp_func_LU_val _cxml_xp_new_fn_LU_val() {
 }
 
 
+static int _cxml_xp_find_ext_fn(const char *name){
+    for (int i = 0; i < _cxml_xp_ext_fns.size; i++){
+        if (cxml_string_raw_equals(&_cxml_xp_ext_fns.fns[i].name, name)){
+            return _CXML_XP_FN_LU_SIZE + i;
+        }
+    }
+    return -1;
+}
+
 struct _cxml_xp_func_LU_val _cxml_xp_lookup_fn_name(cxml_string* name, int arity){
     int index = _cxml_xp_find_fn(cxml_string_as_raw(name));
     struct _cxml_xp_func_LU_val ret = _cxml_xp_new_fn_LU_val();
+    if (index == -1 && (index = _cxml_xp_find_ext_fn(cxml_string_as_raw(name))) != -1){
+        struct _cxml_xp_ext_fn *ext = _cxml_xp_ext_fn_at(index);
+        if (ext->arity == arity || (ext->arity < 0 && arity >= abs(ext->arity))){
+            ret.arity = arity;
+            ret.pos = index;
+            ret.ret_type = ext->ret_type;
+            return ret;
+        }
+        ret.arity = ext->arity;
+        ret.pos = -2;
+        return ret;
+    }
     if (index != -1) {
         if ((fn_LU_table[index].arity == arity)  // check arity
             || ((fn_LU_table[index].arity - fn_LU_table[index].omittable) == arity)     // check if arg is omittable
@@ -194,6 +265,120 @@ struct _cxml_xp_func_LU_val _cxml_xp_lookup_fn_name(cxml_string* name, int arity
 }
 
 
+/*
+ * Register the extension function `fn` as `name` (see cxxplib.h), replacing the function
+ * registered as `name`, if any. `user_data` is passed to each call of the function.
+ * Returns false if the function can't be registered.
+ */
+bool cxml_xpath_register_function(const char *name, int arity, _cxml_xp_ret_t ret_type,
+                                  bool pure, cxml_xp_ext_fn fn, void *user_data)
+{
+    if (!name || !*name || !fn
+        || ret_type < CXML_XP_RET_STRING || ret_type > CXML_XP_RET_BOOLEAN
+        || _cxml_xp_find_fn(name) != -1)
+    {
+        return false;
+    }
+    struct _cxml_xp_ext_fn *ext;
+    int pos = _cxml_xp_find_ext_fn(name);
+    if (pos != -1){
+        ext = _cxml_xp_ext_fn_at(pos);
+    }else{
+        if (_cxml_xp_ext_fns.size == _cxml_xp_ext_fns.capacity){
+            _cxml_xp_ext_fns.capacity = _cxml_xp_ext_fns.capacity ? _cxml_xp_ext_fns.capacity * 2 : 8;
+            _cxml_xp_ext_fns.fns = RALLOC(struct _cxml_xp_ext_fn, _cxml_xp_ext_fns.fns,
+                                          (_cxml_xp_ext_fns.capacity));
+        }
+        ext = &_cxml_xp_ext_fns.fns[_cxml_xp_ext_fns.size++];
+        ext->name = new_cxml_string();
+        cxml_string_raw_append(&ext->name, name);
+    }
+    ext->arity = arity;
+    ext->ret_type = ret_type;
+    ext->pure = pure;
+    ext->fn = fn;
+    ext->user_data = user_data;
+    return true;
+}
+
+void cxml_xpath_unregister_functions(){
+    for (int i = 0; i < _cxml_xp_ext_fns.size; i++){
+        cxml_string_free(&_cxml_xp_ext_fns.fns[i].name);
+    }
+    FREE(_cxml_xp_ext_fns.fns);
+    _cxml_xp_ext_fns.fns = NULL;
+    _cxml_xp_ext_fns.size = _cxml_xp_ext_fns.capacity = 0;
+}
+
+/*
+ * Obtain the context node of the expression being evaluated
+ * (for impure extension functions).
+ */
+void *cxml_xpath_context_node(){
+    return _xpath_parser.context.ctx_node;
+}
+
+static void _cxml_xp_call_ext_fn(cxml_xp_functioncall *node,
+                                 _cxml_xp_data *(*_pop)(void),
+                                 void (*_push)(_cxml_xp_data *))
+{
+    struct _cxml_xp_ext_fn *ext = _cxml_xp_ext_fn_at(node->pos);
+    int argc = cxml_list_size(&node->args);
+    _cxml_xp_data *args[argc ? argc : 1];
+    cxml_for_each(arg, &node->args)
+    {
+        cxml_xp_visit(arg);
+    }
+    // the arguments are popped in reverse order
+    for (int i = argc - 1; i >= 0; i--){
+        args[i] = _pop();
+    }
+    _cxml_xp_data *res = _cxml_xp_new_data();
+    switch (ext->ret_type)
+    {
+        case CXML_XP_RET_STRING:
+            res->type = CXML_XP_DATA_STRING;
+            cxml_string_init(&res->str);
+            break;
+        case CXML_XP_RET_NUMBER:
+            res->type = CXML_XP_DATA_NUMERIC;
+            cxml_number_init(&res->number);
+            break;
+        case CXML_XP_RET_NODESET:
+            res->type = CXML_XP_DATA_NODESET;
+            cxml_set_init(&res->nodeset);
+            break;
+        default:
+            res->type = CXML_XP_DATA_BOOLEAN;
+            res->boolean = false;
+            break;
+    }
+    _cxml_xp_data_t type = res->type;
+    ext->fn(args, argc, res, ext->user_data);
+    if (res->type != type){
+        _cxml_xp_eval_err("Extension function returned a value of the wrong type.");
+    }
+    for (int i = 0; i < argc; i++){
+        _cxml_xp_data_clear(args[i]);
+    }
+    _push(res);
+}
+
+/*
+ * Call the (built-in or extension) function of `node`.
+ */
+void _cxml_xp_call_fn(cxml_xp_functioncall *node,
+                      _cxml_xp_data *(*_pop)(void),
+                      void (*_push)(_cxml_xp_data *))
+{
+    if (_cxml_xp_is_ext_fn(node->pos)){
+        _cxml_xp_call_ext_fn(node, _pop, _push);
+        return;
+    }
+    (*fn_LU_table[node->pos].fn)(node, _pop, _push);
+}
+
+
 /*
  * Helper functions
  */
@@ -274,6 +459,15 @@ void __cxml_xp_count_fn(cxml_xp_functioncall *node,
     /* count(node-set) -> number
      * The count function returns the number of nodes in the argument node-set.
      */
+    cxml_number num;
+    // the argument is a path? count the nodes as they are selected
+    if (_cxml_xp_fold(cxml_list_first(&node->args), _CXML_XP_FOLD_COUNT, &num)){
+        _cxml_xp_data *data = _cxml_xp_new_data();
+        data->type = CXML_XP_DATA_NUMERIC;
+        data->number = num;
+        _push(data);
+        return;
+    }
     cxml_for_each(arg, &node->args){
         cxml_xp_visit(arg);
     }
@@ -371,13 +565,19 @@ void __cxml_xp_boolean_fn(cxml_xp_functioncall *node,
     /* boolean(object) -> boolean
      * The boolean function converts its argument to a boolean.
      */
-    cxml_for_each(arg, &node->args){
-        cxml_xp_visit(arg);
-    }
-    _cxml_xp_data* res = _pop();
     bool ret;
-    _cxml_xp_data_to_boolean(res, &ret);
-    _cxml_xp_data_clear(res);
+    _cxml_xp_data* res;
+    // the argument is a path? stop at the first node selected
+    if (_cxml_xp_exists(cxml_list_first(&node->args), &ret)){
+        res = _cxml_xp_new_data();
+    }else{
+        cxml_for_each(arg, &node->args){
+            cxml_xp_visit(arg);
+        }
+        res = _pop();
+        _cxml_xp_data_to_boolean(res, &ret);
+        _cxml_xp_data_clear(res);
+    }
     res->type = CXML_XP_DATA_BOOLEAN;
     res->boolean = ret;
     _push(res);
@@ -420,13 +620,19 @@ void __cxml_xp_not_fn(cxml_xp_functioncall *node,
     /* not(boolean) -> boolean
      *  The not function returns true if its argument is false, and false otherwise
      */
-    cxml_for_each(arg, &node->args){
-        cxml_xp_visit(arg);
-    }
-    _cxml_xp_data* res = _pop();
     bool ret;
-    _cxml_xp_data_to_boolean(res, &ret);
-    _cxml_xp_data_clear(res);
+    _cxml_xp_data* res;
+    // the argument is a path? stop at the first node selected
+    if (_cxml_xp_exists(cxml_list_first(&node->args), &ret)){
+        res = _cxml_xp_new_data();
+    }else{
+        cxml_for_each(arg, &node->args){
+            cxml_xp_visit(arg);
+        }
+        res = _pop();
+        _cxml_xp_data_to_boolean(res, &ret);
+        _cxml_xp_data_clear(res);
+    }
     res->type = CXML_XP_DATA_BOOLEAN;
     res->boolean = !ret;
     _push(res);
@@ -488,7 +694,7 @@ void __cxml_xp_string_fn(cxml_xp_functioncall *node,
      */
     cxml_string str = new_cxml_string();
     if (cxml_list_is_empty(&node->args)){
-        _cxml_xp__node_string_val(&_xpath_parser.context.ctx_node, &str);
+        _cxml_xp__node_string_val(_xpath_parser.context.ctx_node, &str);
         _cxml_xp_data *data = _cxml_xp_new_data();
         data->type = CXML_XP_DATA_STRING;
         data->str = str;
@@ -650,7 +856,7 @@ void __cxml_xp_starts_with_fn(cxml_xp_functioncall* node,
         free_second = 0;
     }else{
         // if not, convert to a string
-        _cxml_xp_data_to_string(fst, &first);
+        _cxml_xp_data_to_string(sec, &second);
     }
     bool startswith = cxml_string_str_startswith(&first, &second);
     _cxml_xp_data_clear(fst);
@@ -662,13 +868,11 @@ void __cxml_xp_starts_with_fn(cxml_xp_functioncall* node,
     _push(fst);
 }
 
-extern bool is_valid_utf8_start(const char *raw);
-
 inline static int _len(cxml_string *str){
     char *raw = cxml_string_as_raw(str);
     if (!raw) return 0;
     // for len, only utf-8 is actually supported (for now)
-    if (is_valid_utf8_start(raw)) return cxml_string_mb_len(str);
+    if (u8_validate(raw, cxml_string_len(str), NULL)) return cxml_string_mb_len(str);
     else return (int)cxml_string_len(str);
 }
 
@@ -709,6 +913,279 @@ void __cxml_xp_string_length_fn(cxml_xp_functioncall *node,
     _push(d);
 }
 
+/*
+ * The string functions below work on the string of their first argument in place
+ * (the argument is consumed anyway), so their result is never copied.
+ */
+
+// convert `d` to a string (in place), and return its string
+static cxml_string *_str_arg(_cxml_xp_data *d){
+    if (d->type != CXML_XP_DATA_STRING){
+        cxml_string str = new_cxml_string();
+        _cxml_xp_data_to_string(d, &str);
+        _cxml_xp_data_clear(d);
+        d->type = CXML_XP_DATA_STRING;
+        d->str = str;
+    }
+    return &d->str;
+}
+
+// convert `d` to a number (NaN as a double NaN)
+static double _num_arg(_cxml_xp_data *d){
+    cxml_number number;
+    if (d->type != CXML_XP_DATA_NUMERIC){
+        _cxml_xp_data_to_numeric(d, &number);
+    }else{
+        number = d->number;
+    }
+    _cxml_xp_data_clear(d);
+    return number.type == CXML_NUMERIC_DOUBLE_T ? number.dec_val : NAN;
+}
+
+// byte offset of the first occurrence of `needle` in `hay` (-1 if not found)
+static long _find(const char *hay, unsigned h_len, const char *needle, unsigned n_len){
+    if (!n_len) return 0;
+    if (n_len > h_len) return -1;
+    const char *p = hay, *last = hay + (h_len - n_len);
+    // memchr() skips to the candidates (a word or a vector at a time)
+    while (p <= last && (p = memchr(p, needle[0], (size_t)(last - p) + 1))){
+        if (!memcmp(p + 1, needle + 1, n_len - 1)) return (long)(p - hay);
+        p++;
+    }
+    return -1;
+}
+
+// keep the `len` bytes of `str` starting at byte `start`
+inline static void _slice(cxml_string *str, unsigned start, unsigned len){
+    if (start && len) memmove(str->_raw_chars, str->_raw_chars + start, len);
+    str->_len = len;
+}
+
+// byte offset of the character `charnum` (0 based) of `str`
+inline static unsigned _char_offset(cxml_string *str, unsigned charnum, bool ascii){
+    if (ascii) return charnum < str->_len ? charnum : str->_len;
+    return (unsigned)u8_offset_n(str->_raw_chars, str->_len, charnum);
+}
+
+// xpath rounding (halves are rounded towards positive infinity)
+inline static double _xp_round(double d){
+    return isfinite(d) ? floor(d + 0.5) : d;
+}
+
+void __cxml_xp_substring_fn(cxml_xp_functioncall *node,
+                            _cxml_xp_data *(*_pop)(void),
+                            void (*_push)(_cxml_xp_data *))
+{
+    /* substring(string, number, number?) -> string
+     * The substring function returns the substring of the first argument starting at the position
+     * specified in the second argument with length specified in the third argument.
+     * If the third argument is not specified, it returns the substring starting at the position
+     * specified in the second argument and continuing to the end of the string.
+     * (the first character is at position 1, and the positions are rounded)
+     */
+    cxml_for_each(arg, &node->args){
+        cxml_xp_visit(arg);
+    }
+    double end = INFINITY;
+    if (cxml_list_size(&node->args) == 3){
+        end = _xp_round(_num_arg(_pop()));
+    }
+    double start = _xp_round(_num_arg(_pop()));
+    end += start;   // NaN if start or length is NaN, or for -infinity + infinity
+    _cxml_xp_data *d = _pop();
+    cxml_string *str = _str_arg(d);
+    // only utf-8 is actually supported (as with string-length())
+    bool ascii = u8_is_ascii(str->_raw_chars, str->_len)
+                 || !u8_validate(str->_raw_chars, str->_len, NULL);
+    unsigned n_chars = ascii ? str->_len : (unsigned)u8_count(str->_raw_chars, str->_len);
+    // characters at positions p, where start <= p < end
+    if (isnan(end) || start > n_chars || end <= 1 || end <= start){
+        str->_len = 0;
+    }else{
+        unsigned first = start > 1 ? (unsigned)start - 1 : 0;
+        unsigned last = end <= n_chars ? (unsigned)end - 1 : n_chars;
+        unsigned from = _char_offset(str, first, ascii);
+        unsigned to = _char_offset(str, last, ascii);
+        _slice(str, from, to - from);
+    }
+    _push(d);
+}
+
+void __cxml_xp_substring_before_fn(cxml_xp_functioncall *node,
+                                   _cxml_xp_data *(*_pop)(void),
+                                   void (*_push)(_cxml_xp_data *))
+{
+    /* substring-before(string, string) -> string
+     * The substring-before function returns the substring of the first argument string that
+     * precedes the first occurrence of the second argument string in the first argument string,
+     * or the empty string if the first argument string does not contain the second argument string.
+     */
+    cxml_for_each(arg, &node->args){
+        cxml_xp_visit(arg);
+    }
+    _cxml_xp_data *right = _pop();
+    _cxml_xp_data *left = _pop();
+    cxml_string *l_str = _str_arg(left), *r_str = _str_arg(right);
+    long pos = _find(l_str->_raw_chars, l_str->_len, r_str->_raw_chars, r_str->_len);
+    l_str->_len = pos > 0 ? (unsigned)pos : 0;
+    _cxml_xp_data_clear(right);
+    _push(left);
+}
+
+void __cxml_xp_substring_after_fn(cxml_xp_functioncall *node,
+                                  _cxml_xp_data *(*_pop)(void),
+                                  void (*_push)(_cxml_xp_data *))
+{
+    /* substring-after(string, string) -> string
+     * The substring-after function returns the substring of the first argument string that
+     * follows the first occurrence of the second argument string in the first argument string,
+     * or the empty string if the first argument string does not contain the second argument string.
+     */
+    cxml_for_each(arg, &node->args){
+        cxml_xp_visit(arg);
+    }
+    _cxml_xp_data *right = _pop();
+    _cxml_xp_data *left = _pop();
+    cxml_string *l_str = _str_arg(left), *r_str = _str_arg(right);
+    long pos = _find(l_str->_raw_chars, l_str->_len, r_str->_raw_chars, r_str->_len);
+    if (pos < 0){
+        l_str->_len = 0;
+    }else{
+        unsigned start = (unsigned)pos + r_str->_len;
+        _slice(l_str, start, l_str->_len - start);
+    }
+    _cxml_xp_data_clear(right);
+    _push(left);
+}
+
+// translate `str` in place, one byte at a time (ascii `from` and `to`, or non utf-8 strings)
+static void _translate_bytes(cxml_string *str, cxml_string *from, cxml_string *to){
+    // byte -> replacing byte, or -1 (removed)
+    short table[256];
+    bool mapped[256] = {0};
+    for (int i = 0; i < 256; i++) table[i] = (short)i;
+    for (unsigned i = 0; i < from->_len; i++){
+        unsigned char c = (unsigned char)from->_raw_chars[i];
+        // the first occurrence of a character in `from` decides
+        if (mapped[c]) continue;
+        mapped[c] = true;
+        table[c] = i < to->_len ? (short)(unsigned char)to->_raw_chars[i] : (short)-1;
+    }
+    unsigned w = 0;
+    for (unsigned r = 0; r < str->_len; r++){
+        short c = table[(unsigned char)str->_raw_chars[r]];
+        if (c >= 0) str->_raw_chars[w++] = (char)c;
+    }
+    str->_len = w;
+}
+
+// translate `str` one (utf-8) character at a time; `from` and `to` are nul terminated
+static void _translate_chars(cxml_string *str, cxml_string *from, cxml_string *to){
+    int n_from = (int)u8_count(from->_raw_chars, from->_len);
+    u_int32_t from_chs[n_from], to_chs[n_from];
+    int n_to = 0, i = 0, k;
+    for (k = 0; k < n_from; k++) from_chs[k] = u8_nextchar(from->_raw_chars, &i);
+    i = 0;
+    while (n_to < n_from && (unsigned)i < to->_len) to_chs[n_to++] = u8_nextchar(to->_raw_chars, &i);
+    cxml_string res = new_cxml_string();
+    char *raw = cxml_string_as_raw(str);
+    char buff[4];
+    u_int32_t ch;
+    int prev;
+    i = 0;
+    while ((unsigned)i < str->_len){
+        prev = i;
+        ch = u8_nextchar(raw, &i);
+        for (k = 0; k < n_from && from_chs[k] != ch; k++);
+        if (k == n_from){
+            cxml_string_append(&res, raw + prev, i - prev);
+        }else if (k < n_to){
+            cxml_string_append(&res, buff, u8_wc_toutf8(buff, to_chs[k]));
+        }
+    }
+    cxml_string_free(str);
+    *str = res;
+}
+
+void __cxml_xp_translate_fn(cxml_xp_functioncall *node,
+                            _cxml_xp_data *(*_pop)(void),
+                            void (*_push)(_cxml_xp_data *))
+{
+    /* translate(string, string, string) -> string
+     * The translate function returns the first argument string with occurrences of characters
+     * in the second argument string replaced by the character at the corresponding position
+     * in the third argument string. If a character of the second argument string has no
+     * corresponding character in the third argument string, its occurrences are removed.
+     */
+    cxml_for_each(arg, &node->args){
+        cxml_xp_visit(arg);
+    }
+    _cxml_xp_data *to_d = _pop();
+    _cxml_xp_data *from_d = _pop();
+    _cxml_xp_data *d = _pop();
+    cxml_string *str = _str_arg(d), *from = _str_arg(from_d), *to = _str_arg(to_d);
+    if (str->_len && from->_len){
+        // an ascii `from` never matches a byte of a multi-byte character
+        if ((u8_is_ascii(from->_raw_chars, from->_len) && u8_is_ascii(to->_raw_chars, to->_len))
+            || !u8_validate(str->_raw_chars, str->_len, NULL)
+            || !u8_validate(from->_raw_chars, from->_len, NULL)
+            || !u8_validate(to->_raw_chars, to->_len, NULL))
+        {
+            _translate_bytes(str, from, to);
+        }else{
+            cxml_string_as_raw(from);
+            cxml_string_as_raw(to);
+            _translate_chars(str, from, to);
+        }
+    }
+    _cxml_xp_data_clear(from_d);
+    _cxml_xp_data_clear(to_d);
+    _push(d);
+}
+
+inline static bool _is_xml_space(char c){
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+void __cxml_xp_normalize_space_fn(cxml_xp_functioncall *node,
+                                  _cxml_xp_data *(*_pop)(void),
+                                  void (*_push)(_cxml_xp_data *))
+{
+    /* normalize-space(string?) -> string
+     * The normalize-space function returns the argument string with whitespace normalized by
+     * stripping leading and trailing whitespace and replacing sequences of whitespace characters
+     * by a single space. If the argument is omitted, it defaults to the context node converted
+     * to a string, in other words the string-value of the context node.
+     */
+    _cxml_xp_data *d;
+    if (cxml_list_is_empty(&node->args)){
+        d = _cxml_xp_new_data();
+        d->type = CXML_XP_DATA_STRING;
+        d->str = new_cxml_string();
+        _cxml_xp__node_string_val(_xpath_parser.context.ctx_node, &d->str);
+    }else{
+        cxml_for_each(arg, &node->args){
+            cxml_xp_visit(arg);
+        }
+        d = _pop();
+        _str_arg(d);
+    }
+    char *raw = d->str._raw_chars;
+    unsigned w = 0;
+    bool space = false;
+    for (unsigned r = 0; r < d->str._len; r++){
+        if (_is_xml_space(raw[r])){
+            space = w > 0;
+        }else{
+            if (space) raw[w++] = ' ';
+            raw[w++] = raw[r];
+            space = false;
+        }
+    }
+    d->str._len = w;
+    _push(d);
+}
+
 /**
  *
  * Number Functions
@@ -726,7 +1203,7 @@ void __cxml_xp_number_fn(cxml_xp_functioncall* node,
     if (cxml_list_is_empty(&node->args)){
         _cxml_xp_data *d = _cxml_xp_new_data();
         d->type = CXML_XP_DATA_NUMERIC;
-        _cxml_xp__node_num_val(&_xpath_parser.context.ctx_node, &d->number);
+        _cxml_xp__node_num_val(_xpath_parser.context.ctx_node, &d->number);
         _push(d);
     }else{
         cxml_for_each(arg, &node->args){
@@ -750,11 +1227,17 @@ void __cxml_xp_sum_fn(cxml_xp_functioncall* node,
      * The sum function returns the sum, for each node in the argument node-set, of the result
        of converting the string-values of the node to a number.
      */
+    cxml_number num = new_cxml_number();
+    _cxml_xp_data* res;
+    // the argument is a path? add up the nodes as they are selected
+    if (_cxml_xp_fold(cxml_list_first(&node->args), _CXML_XP_FOLD_SUM, &num)){
+        res = _cxml_xp_new_data();
+        goto push;
+    }
     cxml_for_each(arg, &node->args){
         cxml_xp_visit(arg);
     }
-    _cxml_xp_data* res = _pop();
-    cxml_number num = new_cxml_number();
+    res = _pop();
     if (res->type != CXML_XP_DATA_NODESET){
         goto push;
     }
@@ -4,14 +4,16 @@
  */
 
 #include "xpath/cxxpvisitors.h"
+#include "xpath/cxxpvm.h"
+
+// from cxxpparser.c
+extern const char *_cxml_xp_axis_names[];
 
 /**expression building visitor**/
 static void cxml_xp_bvisit_NameTest(cxml_xp_nametest *node, cxml_string *acc);
 
 static void cxml_xp_bvisit_Step(cxml_xp_step *node, cxml_string *acc);
 
-static void cxml_xp_bvisit_Predicate(cxml_xp_predicate *node, cxml_string *acc);
-
 static void cxml_xp_bvisit_Num(cxml_xp_num *node, cxml_string *acc);
 
 static void cxml_xp_bvisit_TypeTest(cxml_xp_typetest *node, cxml_string *acc);
@@ -28,6 +30,10 @@ static void cxml_xp_bvisit_BinaryOp(cxml_xp_binaryop *node, cxml_string *acc);
 
 static void cxml_xp_bvisit_NodeTest(cxml_xp_nodetest *node, cxml_string *acc);
 
+static void cxml_xp_bvisit_Filter(cxml_xp_filter *node, cxml_string *acc);
+
+static void cxml_xp_bvisit_Variable(cxml_xp_variable *node, cxml_string *acc);
+
 /********************************/
 
 
@@ -55,6 +61,10 @@ static void cxml_xp_dvisit_BinaryOp(cxml_xp_binaryop *node);
 
 static void cxml_xp_dvisit_NodeTest(cxml_xp_nodetest *node);
 
+static void cxml_xp_dvisit_Filter(cxml_xp_filter *node);
+
+static void cxml_xp_dvisit_Variable(cxml_xp_variable *node);
+
 /********************************/
 
 
@@ -82,6 +92,10 @@ static void cxml_xp_fvisit_BinaryOp(cxml_xp_binaryop *node);
 
 static void cxml_xp_fvisit_NodeTest(cxml_xp_nodetest *node);
 
+static void cxml_xp_fvisit_Filter(cxml_xp_filter *node);
+
+static void cxml_xp_fvisit_Variable(cxml_xp_variable *node);
+
 /********************************/
 
 /*** debug visitors ***/
@@ -111,6 +125,12 @@ void cxml_xp_dvisit(cxml_xp_astnode * ast_node){  // generic cxml_xp_visit
         case CXML_XP_AST_PATH_NODE:
             cxml_xp_dvisit_Path(ast_node->wrapped_node.path);
             break;
+        case CXML_XP_AST_FILTER_NODE:
+            cxml_xp_dvisit_Filter(ast_node->wrapped_node.filter);
+            break;
+        case CXML_XP_AST_VARIABLE_NODE:
+            cxml_xp_dvisit_Variable(ast_node->wrapped_node.variable);
+            break;
         default: break;
     }
 }
@@ -126,6 +146,9 @@ _CXML__TRACE(
             _cxml_dprint("\t//\n")
         }
     }
+    if (node->axis){
+        _cxml_dprint("\t%s::\n", _cxml_xp_axis_names[node->axis])
+    }
     if (node->has_attr_axis){
         _cxml_dprint("\t@\n")
     }
@@ -218,6 +241,21 @@ void cxml_xp_dvisit_Path(cxml_xp_path* node){
 }
 
 
+void cxml_xp_dvisit_Filter(cxml_xp_filter* node){
+    _cxml_dprint("<--In cxml_xp_filter node-->\n")
+    cxml_xp_dvisit(node->expr_node);
+    cxml_for_each(pred, &node->predicates)
+    {
+        cxml_xp_dvisit_Predicate(pred);
+    }
+}
+
+void cxml_xp_dvisit_Variable(cxml_xp_variable* node){
+_CXML__TRACE(
+    _cxml_dprint("<--In cxml_xp_variable node-->\n")
+    _cxml_dprint("\t($%s)\n", cxml_string_as_raw(&node->name));)
+}
+
 void cxml_xp_dvisit_FunctionCall(cxml_xp_functioncall* node){
 _CXML__TRACE(
     _cxml_dprint("<--In cxml_xp_functioncall node-->\n")
@@ -323,6 +361,12 @@ void cxml_xp_fvisit(cxml_xp_astnode * ast_node){  // generic cxml_xp_visit
         case CXML_XP_AST_PATH_NODE:
             cxml_xp_fvisit_Path(ast_node->wrapped_node.path);
             break;
+        case CXML_XP_AST_FILTER_NODE:
+            cxml_xp_fvisit_Filter(ast_node->wrapped_node.filter);
+            break;
+        case CXML_XP_AST_VARIABLE_NODE:
+            cxml_xp_fvisit_Variable(ast_node->wrapped_node.variable);
+            break;
         default: break;
     }
     FREE(ast_node);
@@ -339,6 +383,9 @@ _CXML__TRACE(
             _cxml_dprint("\t//\n")
         }
     }
+    if (node->axis){
+        _cxml_dprint("\t%s::\n", _cxml_xp_axis_names[node->axis])
+    }
     if (node->has_attr_axis){
         _cxml_dprint("\t@\n")
     }
@@ -378,6 +425,7 @@ void cxml_xp_fvisit_Predicate(cxml_xp_predicate* node){
     _cxml_dprint("\t[\n")
     cxml_xp_fvisit(node->expr_node);
     _cxml_dprint("\t]\n")
+    _cxml_xp_program_free(node->program);
     FREE(node);
 }
 
@@ -449,6 +497,25 @@ void cxml_xp_fvisit_Path(cxml_xp_path* path){
     FREE(path);
 }
 
+// F
+void cxml_xp_fvisit_Filter(cxml_xp_filter* node){
+    _cxml_dprint("<--FREEING (cxml_xp_filter) node-->\n")
+    cxml_xp_fvisit(node->expr_node);
+    cxml_for_each(pred, &node->predicates)
+    {
+        cxml_xp_fvisit_Predicate(pred);
+    }
+    cxml_list_free(&node->predicates);
+    FREE(node);
+}
+
+// F
+void cxml_xp_fvisit_Variable(cxml_xp_variable* node){
+    _cxml_dprint("<--FREEING (cxml_xp_variable) node-->\n")
+    cxml_string_free(&node->name);
+    FREE(node);
+}
+
 // F
 void cxml_xp_fvisit_FunctionCall(cxml_xp_functioncall* node){
     _cxml_dprint("<--FREEING (cxml_xp_functioncall) node-->\n")
@@ -560,6 +627,12 @@ void cxml_xp_bvisit(cxml_xp_astnode * ast_node, cxml_string *acc){
         case CXML_XP_AST_PATH_NODE:
             cxml_xp_bvisit_Path(ast_node->wrapped_node.path, acc);
             break;
+        case CXML_XP_AST_FILTER_NODE:
+            cxml_xp_bvisit_Filter(ast_node->wrapped_node.filter, acc);
+            break;
+        case CXML_XP_AST_VARIABLE_NODE:
+            cxml_xp_bvisit_Variable(ast_node->wrapped_node.variable, acc);
+            break;
         default: break;
     }
 }
@@ -575,10 +648,10 @@ void cxml_xp_bvisit_NameTest(cxml_xp_nametest* node, cxml_string *acc){
             break;
         case CXML_XP_NAME_TEST_WILDCARD_LNAME:
             cxml_string_append(acc, "*:", 2);
-            cxml_string_append(acc, node->name.lname, node->name.lname_len);
+            cxml_string_append(acc, cxml_name_lname(&node->name), node->name.lname_len);
             break;
         case CXML_XP_NAME_TEST_PNAME_WILDCARD:
-            cxml_string_append(acc, node->name.pname, node->name.pname_len);
+            cxml_string_append(acc, cxml_name_pname(&node->name), node->name.pname_len);
             cxml_string_append(acc, ":*", 2);
             break;
         default:
@@ -634,11 +707,23 @@ static char* get_cxml_op_repr(cxml_xp_op op){
 }
 
 void cxml_xp_bvisit_Step(cxml_xp_step* node, cxml_string *acc){
+    cxml_xp_bvisit_StepTest(node, acc);
+    cxml_for_each (pred, &node->predicates){
+        cxml_xp_bvisit_Predicate(pred, acc);
+    }
+}
+
+void cxml_xp_bvisit_StepTest(cxml_xp_step* node, cxml_string *acc){
     switch (node->path_spec){
         case 1: cxml_string_append(acc, "/", 1);  break;
         case 2: cxml_string_append(acc, "//", 2); break;
         default: break;
     }
+    if (node->axis){
+        cxml_string_append(acc, _cxml_xp_axis_names[node->axis],
+                           strlen(_cxml_xp_axis_names[node->axis]));
+        cxml_string_append(acc, "::", 2);
+    }
     if (node->has_attr_axis){
         cxml_string_append(acc, "@", 1);
     }
@@ -652,9 +737,6 @@ void cxml_xp_bvisit_Step(cxml_xp_step* node, cxml_string *acc){
             cxml_string_append(acc, "..", 2);
         }
     }
-    cxml_for_each (pred, &node->predicates){
-        cxml_xp_bvisit_Predicate(pred, acc);
-    }
 }
 
 void cxml_xp_bvisit_Predicate(cxml_xp_predicate* node, cxml_string *acc){
@@ -672,7 +754,12 @@ void cxml_xp_bvisit_TypeTest(cxml_xp_typetest* node, cxml_string *acc){
 }
 
 void cxml_xp_bvisit_String(cxml_xp_string* node, cxml_string *acc){
+    // (a literal can't contain the quote delimiting it)
+    char *quote = cxml_string_len(&node->str)
+                  && memchr(cxml_string_as_raw(&node->str), '\'', cxml_string_len(&node->str)) ? "\"" : "'";
+    cxml_string_append(acc, quote, 1);
     cxml_string_str_append(acc, &node->str);
+    cxml_string_append(acc, quote, 1);
 }
 
 void cxml_xp_bvisit_Path(cxml_xp_path* node, cxml_string *acc){
@@ -682,10 +769,25 @@ void cxml_xp_bvisit_Path(cxml_xp_path* node, cxml_string *acc){
     }
 }
 
+void cxml_xp_bvisit_Filter(cxml_xp_filter* node, cxml_string *acc){
+    cxml_string_append(acc, "(", 1);
+    cxml_xp_bvisit(node->expr_node, acc);
+    cxml_string_append(acc, ")", 1);
+    cxml_for_each (pred, &node->predicates){
+        cxml_xp_bvisit_Predicate(pred, acc);
+    }
+}
+
+void cxml_xp_bvisit_Variable(cxml_xp_variable* node, cxml_string *acc){
+    cxml_string_append(acc, "$", 1);
+    cxml_string_str_append(acc, &node->name);
+}
+
 void cxml_xp_bvisit_FunctionCall(cxml_xp_functioncall* node, cxml_string *acc){
     cxml_string_str_append(acc, &node->name);
     cxml_string_append(acc, "(", 1);
     cxml_for_each(arg, &node->args){
+        if (arg != cxml_list_first(&node->args)) cxml_string_append(acc, ", ", 2);
         cxml_xp_bvisit(arg, acc);
     }
     cxml_string_append(acc, ")", 1);
@@ -4,6 +4,9 @@
  */
 
 #include "xpath/cxxpvisitors.h"
+#include "xpath/cxxpvm.h"
+#include "xpath/cxxpprofile.h"
+#include "xpath/cxxpdata.h"
 
 /*
  * These node visitors check if a predicate expression can be optimized.
@@ -40,6 +43,11 @@ extern bool _is_poisonous_by_computation(int pos);
 
 extern bool _is_poisonous_by_default_arg(int pos);
 
+extern bool _cxml_xp_is_ext_fn(int pos);
+
+// from cxxpeval.c
+extern _cxml_xp_data *_cxml_xp_binding_value(cxml_string *name);
+
 static void cxml_xp_ovisit_Step(cxml_xp_step *node, _cxml_xp_ret_t *ret_type);
 
 static void cxml_xp_ovisit_Predicate(cxml_xp_predicate *node, _cxml_xp_ret_t *ret_type);
@@ -56,6 +64,10 @@ static void cxml_xp_ovisit_UnaryOp(cxml_xp_unaryop *node, _cxml_xp_ret_t *ret_ty
 
 static void cxml_xp_ovisit_BinaryOp(cxml_xp_binaryop *node, _cxml_xp_ret_t *ret_type);
 
+static void cxml_xp_ovisit_Filter(cxml_xp_filter *node, _cxml_xp_ret_t *ret_type);
+
+static void cxml_xp_ovisit_Variable(cxml_xp_variable *node, _cxml_xp_ret_t *ret_type);
+
 
 inline static bool _is_arithmetic_op(cxml_xp_op op){
     switch (op)
@@ -131,6 +143,12 @@ void cxml_xp_ovisit(cxml_xp_astnode * ast_node, _cxml_xp_ret_t *ret_type){
         case CXML_XP_AST_PATH_NODE:
             cxml_xp_ovisit_Path(ast_node->wrapped_node.path, ret_type);
             break;
+        case CXML_XP_AST_FILTER_NODE:
+            cxml_xp_ovisit_Filter(ast_node->wrapped_node.filter, ret_type);
+            break;
+        case CXML_XP_AST_VARIABLE_NODE:
+            cxml_xp_ovisit_Variable(ast_node->wrapped_node.variable, ret_type);
+            break;
         default: break;
     }
 }
@@ -219,3 +237,282 @@ void cxml_xp_ovisit_BinaryOp(cxml_xp_binaryop* node, _cxml_xp_ret_t *ret_type){
     }
     *ret_type = _compute_type(node->op);
 }
+
+void cxml_xp_ovisit_Filter(cxml_xp_filter* node, _cxml_xp_ret_t *ret_type){
+    // return immediately we discover the expression is no longer optimizable
+    if (*ret_type == _CXML_XP_PS_POISON) return;
+    cxml_xp_ovisit(node->expr_node, ret_type);
+    if (*ret_type == _CXML_XP_PS_POISON) return;
+    // the predicates of a filter are evaluated against the nodes it filters, not the context node,
+    // but relative paths within them are still (conservatively) treated as poison.
+    cxml_for_each (pred, &node->predicates){
+        cxml_xp_ovisit_Predicate(pred, ret_type);
+        if (*ret_type == _CXML_XP_PS_POISON) return;
+    }
+    *ret_type = CXML_XP_RET_NODESET;
+}
+
+void cxml_xp_ovisit_Variable(cxml_xp_variable* node, _cxml_xp_ret_t *ret_type){
+    // the type of a variable is the type of the value bound to it (when evaluated)
+    _cxml_xp_data *value = _cxml_xp_binding_value(&node->name);
+    if (!value){
+        *ret_type = _CXML_XP_PS_POISON;
+        return;
+    }
+    switch (value->type)
+    {
+        case CXML_XP_DATA_NUMERIC: *ret_type = CXML_XP_RET_NUMBER; break;
+        case CXML_XP_DATA_STRING:  *ret_type = CXML_XP_RET_STRING; break;
+        case CXML_XP_DATA_BOOLEAN: *ret_type = CXML_XP_RET_BOOLEAN; break;
+        default:                   *ret_type = CXML_XP_RET_NODESET; break;
+    }
+}
+
+
+/*
+ * Optimization pass.
+ *
+ * cxml_xp_optimize() rewrites/annotates the ast of a query once it's been parsed:
+ *
+ * - Invariant sub-expressions: an expression inside a predicate whose value doesn't depend on
+ *   the context node (constants, variables, absolute paths, and functions/operators over those) is marked
+ *   as invariant, and evaluated once per query, instead of once per context node.
+ *   Extension functions (see cxxplib.h) are only invariant if registered as pure.
+ *   For example, `count(//b)` and `2 * 3` in:
+ *      //a[count(b) = count(//b) and @n > 2 * 3]
+ *
+ * - Conjunctions/disjunctions: the operands of `and`/`or` are ordered by their (estimated) cost,
+ *   so that the right operand, which is only evaluated if the left operand doesn't decide the
+ *   result, is the more expensive one. For example, `@id` is tested before `.//b` in:
+ *      //a[.//b and @id]
+ *   Extension functions are assumed to be as expensive as a filter expression.
+ */
+
+#define _CXML_XP_COST_STEP          (4)
+#define _CXML_XP_COST_DESC_STEP     (64)
+#define _CXML_XP_COST_FILTER        (16)
+#define _CXML_XP_COST_EXT_FN        (16)
+
+static bool _is_invariant(cxml_xp_astnode *node){
+    switch (node->wrapped_type)
+    {
+        case CXML_XP_AST_NUM_NODE:
+        case CXML_XP_AST_STR_LITERAL_NODE:
+        case CXML_XP_AST_VARIABLE_NODE:
+            return true;
+        case CXML_XP_AST_PATH_NODE:
+        {
+            // absolute paths are evaluated from the root node, the predicates of
+            // their steps are evaluated against the nodes selected by the steps.
+            cxml_xp_step *step = cxml_list_first(&node->wrapped_node.path->steps);
+            return step->path_spec != 0;
+        }
+        case CXML_XP_AST_FUNCTION_CALL_NODE:
+        {
+            cxml_xp_functioncall *func = node->wrapped_node.func_call;
+            if (_is_poisonous_by_computation(func->pos)
+                || (cxml_list_is_empty(&func->args) && _is_poisonous_by_default_arg(func->pos)))
+            {
+                return false;
+            }
+            cxml_for_each(arg, &func->args){
+                if (!_is_invariant(arg)) return false;
+            }
+            return true;
+        }
+        case CXML_XP_AST_UNARYOP_NODE:
+            return _is_invariant(node->wrapped_node.unary->node);
+        case CXML_XP_AST_BINOP_NODE:
+            return _is_invariant(node->wrapped_node.binary->l_node)
+                   && _is_invariant(node->wrapped_node.binary->r_node);
+        case CXML_XP_AST_FILTER_NODE:
+            return _is_invariant(node->wrapped_node.filter->expr_node);
+        default:
+            return false;
+    }
+}
+
+static int _step_cost(cxml_xp_step *step);
+
+// estimated cost of evaluating `node` (once)
+static int _cost(cxml_xp_astnode *node){
+    int cost = 0;
+    if (node->is_invariant) return 1;
+    switch (node->wrapped_type)
+    {
+        case CXML_XP_AST_PATH_NODE:
+        {
+            cxml_for_each(step, &node->wrapped_node.path->steps){
+                cost += _step_cost(step);
+            }
+            return cost;
+        }
+        case CXML_XP_AST_FUNCTION_CALL_NODE:
+            cost = _cxml_xp_is_ext_fn(node->wrapped_node.func_call->pos) ? _CXML_XP_COST_EXT_FN : 2;
+            cxml_for_each(arg, &node->wrapped_node.func_call->args){
+                cost += _cost(arg);
+            }
+            return cost;
+        case CXML_XP_AST_UNARYOP_NODE:
+            return 1 + _cost(node->wrapped_node.unary->node);
+        case CXML_XP_AST_BINOP_NODE:
+            return 1 + _cost(node->wrapped_node.binary->l_node) + _cost(node->wrapped_node.binary->r_node);
+        case CXML_XP_AST_FILTER_NODE:
+            cost = _CXML_XP_COST_FILTER + _cost(node->wrapped_node.filter->expr_node);
+            cxml_for_each(pred, &node->wrapped_node.filter->predicates){
+                cost += _cost(((cxml_xp_predicate*)pred)->expr_node);
+            }
+            return cost;
+        default:
+            return 0;
+    }
+}
+
+static int _step_cost(cxml_xp_step *step){
+    // attributes and '.'/'..' are looked up directly, children (and siblings or ancestors)
+    // are scanned, and descendants (and following or preceding nodes) are walked.
+    int cost = (step->has_attr_axis || step->abbrev_step) ? 1 :
+               (step->path_spec == 2
+                || step->axis == CXML_XP_AXIS_DESCENDANT
+                || step->axis == CXML_XP_AXIS_DESCENDANT_OR_SELF
+                || step->axis == CXML_XP_AXIS_FOLLOWING
+                || step->axis == CXML_XP_AXIS_PRECEDING) ? _CXML_XP_COST_DESC_STEP : _CXML_XP_COST_STEP;
+    cxml_for_each(pred, &step->predicates){
+        cost += _cost(((cxml_xp_predicate*)pred)->expr_node);
+    }
+    return cost;
+}
+
+static void _optimize(cxml_xp_astnode *node, bool in_predicate);
+
+static void _optimize_predicates(cxml_list *predicates){
+    cxml_for_each(pred, predicates){
+        _optimize(((cxml_xp_predicate*)pred)->expr_node, true);
+        // (once optimized, the expression no longer changes)
+        ((cxml_xp_predicate*)pred)->program = _cxml_xp_compile(((cxml_xp_predicate*)pred)->expr_node);
+        if (((cxml_xp_predicate*)pred)->program) _cxml_xp_profile_rewrite(pred, CXML_XP_REWRITE_COMPILED);
+    }
+}
+
+/*
+ * `in_predicate` is set when the value of `node` (if invariant) would otherwise be
+ * evaluated once per context node of a predicate.
+ */
+static void _optimize(cxml_xp_astnode *node, bool in_predicate){
+    if (in_predicate
+        && node->wrapped_type != CXML_XP_AST_NUM_NODE
+        && node->wrapped_type != CXML_XP_AST_STR_LITERAL_NODE
+        && _is_invariant(node))
+    {
+        node->is_invariant = true;
+        _cxml_xp_profile_rewrite(node, CXML_XP_REWRITE_HOISTED);
+        // the sub-expressions are only evaluated once, with the node
+        in_predicate = false;
+    }
+    switch (node->wrapped_type)
+    {
+        case CXML_XP_AST_PATH_NODE:
+        {
+            cxml_for_each(step, &node->wrapped_node.path->steps){
+                _optimize_predicates(&((cxml_xp_step*)step)->predicates);
+            }
+            break;
+        }
+        case CXML_XP_AST_FUNCTION_CALL_NODE:
+        {
+            cxml_for_each(arg, &node->wrapped_node.func_call->args){
+                _optimize(arg, in_predicate);
+            }
+            break;
+        }
+        case CXML_XP_AST_UNARYOP_NODE:
+            _optimize(node->wrapped_node.unary->node, in_predicate);
+            break;
+        case CXML_XP_AST_BINOP_NODE:
+        {
+            cxml_xp_binaryop *binop = node->wrapped_node.binary;
+            _optimize(binop->l_node, in_predicate);
+            _optimize(binop->r_node, in_predicate);
+            if ((binop->op == CXML_XP_OP_AND || binop->op == CXML_XP_OP_OR)
+                && _cost(binop->r_node) < _cost(binop->l_node))
+            {
+                cxml_xp_astnode *l_node = binop->l_node;
+                binop->l_node = binop->r_node;
+                binop->r_node = l_node;
+                _cxml_xp_profile_rewrite(node, CXML_XP_REWRITE_REORDERED);
+            }
+            break;
+        }
+        case CXML_XP_AST_FILTER_NODE:
+            _optimize(node->wrapped_node.filter->expr_node, in_predicate);
+            _optimize_predicates(&node->wrapped_node.filter->predicates);
+            break;
+        case CXML_XP_AST_PREDICATE_NODE:
+            _optimize(node->wrapped_node.predicate->expr_node, true);
+            break;
+        default:
+            break;
+    }
+}
+
+void cxml_xp_optimize(cxml_xp_astnode *ast_node){
+    if (!ast_node) return;
+    _optimize(ast_node, false);
+}
+
+
+static void _recompile(cxml_xp_astnode *node);
+
+static void _recompile_predicates(cxml_list *predicates){
+    cxml_xp_predicate *pred;
+    cxml_for_each(_pred, predicates){
+        pred = _pred;
+        _recompile(pred->expr_node);
+        _cxml_xp_program_free(pred->program);
+        pred->program = _cxml_xp_compile(pred->expr_node);
+    }
+}
+
+static void _recompile(cxml_xp_astnode *node){
+    switch (node->wrapped_type)
+    {
+        case CXML_XP_AST_PATH_NODE:
+        {
+            cxml_for_each(step, &node->wrapped_node.path->steps){
+                _recompile_predicates(&((cxml_xp_step*)step)->predicates);
+            }
+            break;
+        }
+        case CXML_XP_AST_FUNCTION_CALL_NODE:
+        {
+            cxml_for_each(arg, &node->wrapped_node.func_call->args){
+                _recompile(arg);
+            }
+            break;
+        }
+        case CXML_XP_AST_UNARYOP_NODE:
+            _recompile(node->wrapped_node.unary->node);
+            break;
+        case CXML_XP_AST_BINOP_NODE:
+            _recompile(node->wrapped_node.binary->l_node);
+            _recompile(node->wrapped_node.binary->r_node);
+            break;
+        case CXML_XP_AST_FILTER_NODE:
+            _recompile(node->wrapped_node.filter->expr_node);
+            _recompile_predicates(&node->wrapped_node.filter->predicates);
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Compile the predicates of the (optimized) ast `ast_node` again.
+ * The instructions compiled for a variable depend on the type of the value bound
+ * to it, so a prepared query is recompiled whenever that type changes
+ * (see cxml_xp_query_eval()). The ast itself isn't optimized again.
+ */
+void cxml_xp_recompile(cxml_xp_astnode *ast_node){
+    if (!ast_node) return;
+    _recompile(ast_node);
+}
@@ -49,8 +49,12 @@ static void num();
 
 static void group();
 
+static void filter_expr();
+
 static void str_literal();
 
+static void variable();
+
 static void _cxml_xp__err(
         _cxml_xp_token *token,
         const char *msg,
@@ -63,6 +67,8 @@ void _cxml_xpath_parser_init() {
 
     _xpath_parser.is_empty_nodeset = 0;
 
+    _xpath_parser.after_axis = 0;
+
     _cxml_xp_token_init(&_xpath_parser.current_tok);
 
     _cxml_xp_token_init(&_xpath_parser.prev_tok);
@@ -75,21 +81,27 @@ void _cxml_xpath_parser_init() {
 
     cxml_set_init(&_xpath_parser.nodeset);
 
-    cxml_list_init(&_xpath_parser.data_nodes);
-
     _cxml_xp_init_context(&_xpath_parser.context);
 
     _cxml_cache_init(&_xpath_parser.lru_cache);
 
-    cxml_list_init(&_xpath_parser.alloc_set_list);
+    cxml_list_init(&_xpath_parser.invariants);
+
+    cxml_table_init(&_xpath_parser.str_values);
 
     _xpath_parser.xml_namespace = NULL;
+
+    memset(_xpath_parser.ns_memo, 0, sizeof(_xpath_parser.ns_memo));
+
+    _xpath_parser.bindings = NULL;
 }
 
 extern struct _cxml_xp_func_LU_val _cxml_xp_lookup_fn_name(cxml_string *name, int arity);
 
 void cxml_xp_free_ast_nodes(_cxml_xp_parser *xpp){
-    cxml_xp_fvisit(_cxml_stack__pop(&xpp->ast_stack));
+    // the ast may have been taken off the stack (see cxml_xpath_iter_init())
+    cxml_xp_astnode *node = _cxml_stack__pop(&xpp->ast_stack);
+    if (node) cxml_xp_fvisit(node);
 }
 
 void _cxml_xpath_parser_free(){
@@ -99,15 +111,18 @@ _CXML__TRACE(
     printf("Built/Debugged expression: %s\n", cxml_string_as_raw(&acc));
     cxml_string_free(&acc);
 )
+    // forget the values of the invariant nodes (the values are freed with the data nodes)
+    cxml_for_each(invariant, &_xpath_parser.invariants){
+        ((cxml_xp_astnode*)invariant)->value = NULL;
+    }
+    cxml_list_free(&_xpath_parser.invariants);
+
+    // free the memoized string values of the nodes
+    _cxml_xp__forget_string_vals();
+
     // free the ast nodes
     cxml_xp_free_ast_nodes(&_xpath_parser);
 
-    // free all data nodes, and list storing the nodes
-    cxml_for_each(data, &_xpath_parser.data_nodes){
-        _cxml_xp_data_free(data);
-    }
-    cxml_list_free(&_xpath_parser.data_nodes);
-
     // free accumulating nodeset
     cxml_set_free(&_xpath_parser.nodeset);
 
@@ -126,13 +141,9 @@ _CXML__TRACE(
     // free the xml namespace
     cxml_ns_node_free(_xpath_parser.xml_namespace);
 
-    // free all allocated lists used in caching nodesets,
-    // as well as the outer list storing the allocated lists
-    cxml_for_each(list, &_xpath_parser.alloc_set_list){
-        cxml_list_free(list);
-        FREE(list);
-    }
-    cxml_list_free(&_xpath_parser.alloc_set_list);
+    // free all data nodes, and the lists used in caching nodesets
+    // (the arena itself persists across queries, and isn't re-initialized)
+    cxml_arena_reset(&_xpath_parser.arena);
 
     // init parser
     _cxml_xpath_parser_init();
@@ -254,6 +265,8 @@ struct _cxml_xp_binding_power_LU bpow_LUTable[] = {
         {None, relative_location_path, NULL},           // CXML_XP_TOKEN_COMMENT_F
         {None,  relative_location_path, NULL},          // CXML_XP_TOKEN_PI_F
         {None, relative_location_path, NULL},           // CXML_XP_TOKEN_NODE_F
+        {None, variable, NULL},                         // CXML_XP_TOKEN_VARIABLE
+        {None, NULL, NULL},                             // CXML_XP_TOKEN_D_COLON
         {None, NULL, NULL}                              // CXML_XP_TOKEN_END
 };
 
@@ -296,6 +309,8 @@ static cxml_xp_astnode* new_astnode(){
     cxml_xp_astnode* node = ALLOC(cxml_xp_astnode, 1);
     node->type = CXML_XP_AST_OBJECT;
     node->wrapped_type = CXML_XP_AST_NIL;
+    node->is_invariant = false;
+    node->value = NULL;
     return node;
 }
 
@@ -335,9 +350,18 @@ static cxml_xp_predicate* new_predicate(){
     cxml_xp_predicate* pred = ALLOC(cxml_xp_predicate, 1);
     pred->type = CXML_XP_AST_PREDICATE_NODE;
     pred->expr_node = NULL;
+    pred->program = NULL;
     return pred;
 }
 
+static cxml_xp_filter* new_filter(){
+    cxml_xp_filter* filter = ALLOC(cxml_xp_filter, 1);
+    filter->type = CXML_XP_AST_FILTER_NODE;
+    filter->expr_node = NULL;
+    cxml_list_init(&filter->predicates);
+    return filter;
+}
+
 static cxml_xp_string* new_str_literal(){
     cxml_xp_string* literal = ALLOC(cxml_xp_string, 1);
     literal->type = CXML_XP_AST_STR_LITERAL_NODE;
@@ -345,6 +369,13 @@ static cxml_xp_string* new_str_literal(){
     return literal;
 }
 
+static cxml_xp_variable* new_variable(){
+    cxml_xp_variable* var = ALLOC(cxml_xp_variable, 1);
+    var->type = CXML_XP_AST_VARIABLE_NODE;
+    cxml_string_init(&var->name);
+    return var;
+}
+
 static cxml_xp_nodetest* new_node_test(){
     cxml_xp_nodetest* nt = ALLOC(cxml_xp_nodetest, 1);
     nt->type = CXML_XP_AST_NODETEST_NODE;
@@ -356,6 +387,7 @@ static cxml_xp_step* new_step(){
     step->type = CXML_XP_AST_STEP_NODE;
     step->abbrev_step = 0;
     step->has_attr_axis = 0;
+    step->axis = CXML_XP_AXIS_NIL;
     step->node_test = NULL;
     step->path_spec = 0;
     cxml_list_init(&step->predicates);
@@ -434,10 +466,50 @@ void binary(){
     _cxml_xp_p__push(node);
 }
 
+/*
+ * FilterExpr ::= PrimaryExpr | FilterExpr Predicate
+ * (where PrimaryExpr is '(' Expr ')', or a VariableReference)
+ */
 void group(){
     _cxml_xp_p__consume(CXML_XP_TOKEN_L_BRACKET);
     expression(0);
     _cxml_xp_p__consume(CXML_XP_TOKEN_R_BRACKET);
+    filter_expr();
+}
+
+/*
+ * VariableReference ::= '$' QName
+ * (which can also be filtered: VariableReference Predicate*)
+ */
+void variable(){
+    cxml_xp_variable* var = new_variable();
+    cxml_string_append(&var->name, _xpath_parser.current_tok.start + 1,
+                       _xpath_parser.current_tok.length - 1);
+    _cxml_xp_p__consume(CXML_XP_TOKEN_VARIABLE);
+    cxml_xp_astnode* node = new_astnode();
+    node->wrapped_node.variable = var;
+    node->wrapped_type = CXML_XP_AST_VARIABLE_NODE;
+    _cxml_xp_p__push(node);
+    filter_expr();
+}
+
+// wrap the primary expression on the stack in a filter expression, if followed by predicates
+static void filter_expr(){
+    if (_xpath_parser.current_tok.type != CXML_XP_TOKEN_L_SQR_BRACKET) return;
+    cxml_xp_filter* filter = new_filter();
+    filter->expr_node = _cxml_xp_p__pop();
+    bool from_predicate = _xpath_parser.from_predicate;
+    while (_xpath_parser.current_tok.type == CXML_XP_TOKEN_L_SQR_BRACKET)
+    {
+        predicate();
+        cxml_list_append(&filter->predicates, _cxml_xp_p__pop());
+    }
+    // the filter could itself be in a predicate
+    _xpath_parser.from_predicate = from_predicate;
+    cxml_xp_astnode* node = new_astnode();
+    node->wrapped_node.filter = filter;
+    node->wrapped_type = CXML_XP_AST_FILTER_NODE;
+    _cxml_xp_p__push(node);
 }
 
 
@@ -566,10 +638,11 @@ void function_call(){
 void predicate(){
     _cxml_xp_p__consume(CXML_XP_TOKEN_L_SQR_BRACKET);
     // set flag to determine if the parsed path nodes resides inside a predicate node
+    bool from_predicate = _xpath_parser.from_predicate;
     _xpath_parser.from_predicate = true;
     expression(0);
-    // turn off flag
-    _xpath_parser.from_predicate = false;
+    // restore flag (the predicate could itself be in a predicate)
+    _xpath_parser.from_predicate = from_predicate;
     _cxml_xp_p__consume(CXML_XP_TOKEN_R_SQR_BRACKET);
     cxml_xp_predicate* pred = new_predicate();
     pred->expr_node = _cxml_xp_p__pop();
@@ -580,20 +653,16 @@ void predicate(){
 
 inline static void _set_lname(cxml_name *name, int lname_len){
     // for setting only local name in name object
-    name->lname = cxml_string_as_raw(&name->qname);
     name->lname_len = lname_len;
 }
 
 inline static void _set_pname(cxml_name *name, int pname_len){
     // for setting only prefix name in name object
-    name->pname = cxml_string_as_raw(&name->qname);
     name->pname_len = pname_len;
 }
 
 inline static void _set_name(cxml_name *name, int pname_len, int lname_len){
     // for when name has a prefix
-    name->pname = cxml_string_as_raw(&name->qname);
-    name->lname = name->pname + pname_len + 1;
     name->pname_len = pname_len;
     name->lname_len = lname_len;
 }
@@ -758,8 +827,53 @@ inline static short get_path_spec(_cxml_xp_token_t type){
     return 0;
 }
 
+// axis names, indexed by cxml_xp_axis_t
+const char *_cxml_xp_axis_names[] = {
+        NULL,
+        "ancestor",
+        "ancestor-or-self",
+        "descendant",
+        "descendant-or-self",
+        "following",
+        "following-sibling",
+        "parent",
+        "preceding",
+        "preceding-sibling",
+        "self"
+};
+
+inline static bool _is_axis_name(_cxml_xp_token *name, const char *axis_name){
+    return (size_t)name->length == strlen(axis_name)
+           && memcmp(name->start, axis_name, name->length) == 0;
+}
+
+/*
+ * AxisSpecifier ::= AxisName '::' | AbbreviatedAxisSpecifier
+ * `name` is the AxisName, the child and attribute axes are stored in
+ * their abbreviated forms.
+ */
+static void axis_specifier(cxml_xp_step *step_node, _cxml_xp_token *name){
+    _cxml_xp_p__consume(CXML_XP_TOKEN_D_COLON);
+    if (_is_axis_name(name, "child")) return;
+    if (_is_axis_name(name, "attribute")){
+        step_node->has_attr_axis = 1;
+        return;
+    }
+    for (int axis = CXML_XP_AXIS_ANCESTOR; axis <= CXML_XP_AXIS_SELF; axis++){
+        if (_is_axis_name(name, _cxml_xp_axis_names[axis])){
+            step_node->axis = axis;
+            return;
+        }
+    }
+    _cxml_xp__err(name,
+                  _is_axis_name(name, "namespace") ?
+                  "The namespace axis is not supported." : "Unknown axis name.",
+                  NULL, NULL);
+}
+
 /*
- * Step ::= '@'? NameTest Predicate* | ('.' | '..')
+ * Step ::= AxisSpecifier NodeTest Predicate* | ('.' | '..')
+ * AxisSpecifier ::= AxisName '::' | '@'?
  */
 void step(){
     cxml_xp_step* step_node = new_step();
@@ -773,7 +887,20 @@ void step(){
         _cxml_xp_p__consume(_xpath_parser.current_tok.type);
     }
     else{
-        if (_xpath_parser.current_tok.type == CXML_XP_TOKEN_AT)
+        // a name is either an AxisName or a NameTest (see node_test()),
+        // it may already have been consumed, in function_call().
+        if (_xpath_parser.current_tok.type == CXML_XP_TOKEN_NAME
+            && _xpath_parser.prev_tok.type != CXML_XP_TOKEN_NAME)
+        {
+            _cxml_xp_p__consume(CXML_XP_TOKEN_NAME);
+        }
+        if (_xpath_parser.current_tok.type == CXML_XP_TOKEN_D_COLON
+            && _xpath_parser.prev_tok.type == CXML_XP_TOKEN_NAME)
+        {
+            _cxml_xp_token name = _xpath_parser.prev_tok;
+            axis_specifier(step_node, &name);
+        }
+        else if (_xpath_parser.current_tok.type == CXML_XP_TOKEN_AT)
         {
             _cxml_xp_p__consume(CXML_XP_TOKEN_AT);
             step_node->has_attr_axis = 1;
@@ -790,6 +917,17 @@ void step(){
             predicate();
             cxml_list_append(&step_node->predicates, _cxml_xp_p__pop());
         }
+        // 'self::node()' -> '.' | 'parent::node()' -> '..'
+        if ((step_node->axis == CXML_XP_AXIS_SELF || step_node->axis == CXML_XP_AXIS_PARENT)
+            && step_node->node_test->t_type == CXML_XP_NODE_TEST_TYPETEST
+            && step_node->node_test->type_test.t_type == CXML_XP_TYPE_TEST_NODE
+            && cxml_list_is_empty(&step_node->predicates))
+        {
+            step_node->abbrev_step = (step_node->axis == CXML_XP_AXIS_SELF) ? 1 : 2;
+            step_node->axis = CXML_XP_AXIS_NIL;
+            FREE(step_node->node_test);
+            step_node->node_test = NULL;
+        }
     }
     // no need to wrap in ASTNode since cxml_xp_step node goes directly into steps
     // field of cxml_xp_path node.
@@ -865,7 +1003,14 @@ void absolute_location_path(){
  * LocationPath ::= RelativeLocationPath | AbsoluteLocationPath
  */
 void location_path() {
-    absolute_location_path();
+    // '(' LocationPath ')' Predicate* | VariableReference Predicate*
+    if (_xpath_parser.current_tok.type == CXML_XP_TOKEN_L_BRACKET){
+        group();
+    }else if (_xpath_parser.current_tok.type == CXML_XP_TOKEN_VARIABLE){
+        variable();
+    }else{
+        absolute_location_path();
+    }
     while (_xpath_parser.current_tok.type == CXML_XP_TOKEN_PIPE){
         binary();
     }
@@ -882,4 +1027,9 @@ void query_string(const char *query_string) {
     /***/
     location_path();
     _cxml_xp_p__consume(CXML_XP_TOKEN_END);
+    if (_xpath_parser.profile){
+        // (the plan shows the query as written, before it is optimized)
+        _cxml_xp_profile_plan(_xpath_parser.profile, _cxml_stack__get(&_xpath_parser.ast_stack));
+    }
+    cxml_xp_optimize(_cxml_stack__get(&_xpath_parser.ast_stack));
 }
@@ -0,0 +1,183 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#include "xpath/cxxpprofile.h"
+#include "xpath/cxxpparser.h"
+
+
+void _cxml_xp_profile_init(cxml_xp_profile *profile, const char *expr){
+    profile->expr = new_cxml_string();
+    cxml_string_raw_append(&profile->expr, expr);
+    profile->parse_time = 0;
+    profile->eval_time = 0;
+    profile->size = 0;
+    cxml_list_init(&profile->entries);
+    cxml_table_init(&profile->nodes);
+}
+
+static cxml_xp_profile_entry *
+_new_entry(cxml_xp_profile *profile, cxml_xp_profile_t type, int depth, void *node){
+    cxml_xp_profile_entry *entry = CALLOC(cxml_xp_profile_entry, 1);
+    entry->type = type;
+    entry->depth = depth;
+    entry->expr = new_cxml_string();
+    cxml_list_append(&profile->entries, entry);
+    cxml_table_put_raw(&profile->nodes, node, entry);
+    return entry;
+}
+
+static void _plan(cxml_xp_profile *profile, cxml_xp_astnode *node, cxml_xp_profile_entry *owner, int depth);
+
+static void _plan_predicates(cxml_xp_profile *profile, cxml_list *predicates, int depth){
+    cxml_xp_profile_entry *entry;
+    cxml_for_each(pred, predicates){
+        entry = _new_entry(profile, CXML_XP_PROFILE_PREDICATE, depth, pred);
+        cxml_xp_bvisit_Predicate(pred, &entry->expr);
+        _plan(profile, ((cxml_xp_predicate*)pred)->expr_node, entry, depth + 1);
+    }
+}
+
+// `node` is accounted to the entry `owner` (if any)
+inline static void _own(cxml_xp_profile *profile, void *node, cxml_xp_profile_entry *owner){
+    if (owner) cxml_table_put_raw(&profile->nodes, node, owner);
+}
+
+/*
+ * Add the entries of the paths, steps, predicates, and filter expressions in `node`,
+ * nested at `depth`. Every other node is owned by the entry `owner`.
+ */
+static void _plan(cxml_xp_profile *profile, cxml_xp_astnode *node, cxml_xp_profile_entry *owner, int depth){
+    cxml_xp_profile_entry *entry;
+    switch (node->wrapped_type)
+    {
+        case CXML_XP_AST_PATH_NODE:
+        {
+            entry = _new_entry(profile, CXML_XP_PROFILE_PATH, depth, node);
+            cxml_xp_bvisit(node, &entry->expr);
+            cxml_for_each(step, &node->wrapped_node.path->steps){
+                entry = _new_entry(profile, CXML_XP_PROFILE_STEP, depth + 1, step);
+                cxml_xp_bvisit_StepTest(step, &entry->expr);
+                _plan_predicates(profile, &((cxml_xp_step*)step)->predicates, depth + 2);
+            }
+            break;
+        }
+        case CXML_XP_AST_FILTER_NODE:
+            entry = _new_entry(profile, CXML_XP_PROFILE_FILTER, depth, node);
+            // (filter expressions are evaluated through their wrapped node)
+            _own(profile, node->wrapped_node.filter, entry);
+            cxml_xp_bvisit(node, &entry->expr);
+            _plan(profile, node->wrapped_node.filter->expr_node, entry, depth + 1);
+            _plan_predicates(profile, &node->wrapped_node.filter->predicates, depth + 1);
+            break;
+        case CXML_XP_AST_FUNCTION_CALL_NODE:
+        {
+            _own(profile, node, owner);
+            cxml_for_each(arg, &node->wrapped_node.func_call->args){
+                _plan(profile, arg, owner, depth);
+            }
+            break;
+        }
+        case CXML_XP_AST_BINOP_NODE:
+            _own(profile, node, owner);
+            _plan(profile, node->wrapped_node.binary->l_node, owner, depth);
+            _plan(profile, node->wrapped_node.binary->r_node, owner, depth);
+            break;
+        case CXML_XP_AST_UNARYOP_NODE:
+            _own(profile, node, owner);
+            _plan(profile, node->wrapped_node.unary->node, owner, depth);
+            break;
+        default:
+            _own(profile, node, owner);
+            break;
+    }
+}
+
+/*
+ * Build the plan of the (parsed) query `ast_node`.
+ */
+void _cxml_xp_profile_plan(cxml_xp_profile *profile, cxml_xp_astnode *ast_node){
+    if (!ast_node) return;
+    if (ast_node->wrapped_type == CXML_XP_AST_PATH_NODE || ast_node->wrapped_type == CXML_XP_AST_FILTER_NODE){
+        _plan(profile, ast_node, NULL, 0);
+        return;
+    }
+    // an entry for the whole query owns the expressions outside any path
+    cxml_xp_profile_entry *entry = _new_entry(profile, CXML_XP_PROFILE_EXPR, 0, ast_node);
+    cxml_xp_bvisit(ast_node, &entry->expr);
+    _plan(profile, ast_node, entry, 1);
+}
+
+/*
+ * Record that `rewrite` was applied to the ast node `node`, when profiling.
+ */
+void _cxml_xp_profile_rewrite(void *node, cxml_xp_rewrite_t rewrite){
+    if (!_xpath_parser.profile) return;
+    cxml_xp_profile_entry *entry = cxml_table_get_raw(&_xpath_parser.profile->nodes, node);
+    if (entry) entry->rewrites |= rewrite;
+}
+
+/*
+ * Begin timing the evaluation of the entry of `node` (a path, step, predicate,
+ * or filter expression), when profiling.
+ */
+void _cxml_xp_profile_begin(_cxml_xp_profile_span *span, void *node){
+    span->entry = _xpath_parser.profile ? cxml_table_get_raw(&_xpath_parser.profile->nodes, node) : NULL;
+    if (!span->entry) return;
+    span->entry->calls++;
+    span->start = clock();
+}
+
+void _cxml_xp_profile_end(_cxml_xp_profile_span *span, long visited, long produced, long cache_hits){
+    if (!span->entry) return;
+    span->entry->time += (double)(clock() - span->start) / CLOCKS_PER_SEC;
+    span->entry->visited += visited;
+    span->entry->produced += produced;
+    span->entry->cache_hits += cache_hits;
+}
+
+
+static const char *_entry_types[] = {"expr", "path", "step", "predicate", "filter"};
+
+static const char *_rewrites[] = {"pipelined", "folded", "exists", "hoisted", "reordered", "compiled", "constant"};
+
+/*
+ * Print the plan of the query profiled, with the statistics of each entry.
+ */
+void cxml_xp_profile_print(cxml_xp_profile *profile){
+    if (!profile) return;
+    printf("query: %s\n"
+           "parse: %.3f ms, eval: %.3f ms, nodes: %d\n"
+           "%8s %9s %9s %6s %10s  %s\n",
+           cxml_string_as_raw(&profile->expr),
+           profile->parse_time * 1e3, profile->eval_time * 1e3, profile->size,
+           "calls", "visited", "produced", "hits", "time (ms)", "plan");
+    cxml_xp_profile_entry *entry;
+    int n;
+    cxml_for_each(_entry, &profile->entries)
+    {
+        entry = _entry;
+        printf("%8ld %9ld %9ld %6ld %10.3f  %*s%s %s",
+               entry->calls, entry->visited, entry->produced, entry->cache_hits, entry->time * 1e3,
+               entry->depth * 2, "", _entry_types[entry->type], cxml_string_as_raw(&entry->expr));
+        n = 0;
+        for (int i = 0; i < (int)(sizeof(_rewrites) / sizeof(*_rewrites)); i++){
+            if (entry->rewrites & (1 << i)){
+                printf(n++ ? ", %s" : "  (%s", _rewrites[i]);
+            }
+        }
+        printf(n ? ")\n" : "\n");
+    }
+}
+
+void cxml_xp_profile_free(cxml_xp_profile *profile){
+    if (!profile) return;
+    cxml_for_each(entry, &profile->entries){
+        cxml_string_free(&((cxml_xp_profile_entry*)entry)->expr);
+        FREE(entry);
+    }
+    cxml_list_free(&profile->entries);
+    cxml_table_free(&profile->nodes);
+    cxml_string_free(&profile->expr);
+}
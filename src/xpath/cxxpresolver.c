@@ -162,7 +162,6 @@ _cmp_nodeset_and_nodeset_equality_template(
     /*
      * nodeset equality comparison works with strings
      */
-    cxml_string l_str = new_cxml_string(), r_str = new_cxml_string();
     cxml_list *curr = (cxml_list_size(&left->nodeset.items) <
                        cxml_list_size(&right->nodeset.items)) ?
                       &left->nodeset.items :
@@ -171,21 +170,18 @@ _cmp_nodeset_and_nodeset_equality_template(
                        &right->nodeset.items :
                        &left->nodeset.items;
     bool ret = false;
+    cxml_string *l_str;
     cxml_for_each(node, curr)
     {
+        l_str = _cxml_xp__node_string_ref(node);
         cxml_for_each(_node, other)
         {
-            _cxml_xp__node_string_val(node, &l_str);
-            _cxml_xp__node_string_val(_node, &r_str);
-            if (cmp(&l_str, &r_str)) {
-                cxml_string_free(&l_str);
-                cxml_string_free(&r_str);
+            if (cmp(l_str, _cxml_xp__node_string_ref(_node))) {
                 ret = true;
                 break;
             }
-            cxml_string_free(&l_str);
-            cxml_string_free(&r_str);
         }
+        if (ret) break;
     }
     _cxml_xp_data_clear(left);
     left->type = CXML_XP_DATA_BOOLEAN;
@@ -209,15 +205,16 @@ _cmp_nodeset_and_nodeset_relative_template(
     cxml_number l_num = new_cxml_number(), r_num = new_cxml_number();
     cxml_for_each(node, &left->nodeset.items)
     {
+        _cxml_xp__node_num_val(node, &l_num);
         cxml_for_each(_node, &right->nodeset.items)
         {
-            _cxml_xp__node_num_val(node, &l_num);
             _cxml_xp__node_num_val(_node, &r_num);
             if (cmp(&l_num, &r_num)) {
                 ret = true;
                 break;
             }
         }
+        if (ret) break;
     }
     _cxml_xp_data_clear(left);
     left->type = CXML_XP_DATA_BOOLEAN;
@@ -234,17 +231,14 @@ _cmp_nodeset_and_string_equality_template(
         // direction of args doesn't matter in equality comparision
 {
     bool ret = false;
-    cxml_string l_str = new_cxml_string(), *r_str = &right->str;
+    cxml_string *r_str = &right->str;
     cxml_for_each(node, &left->nodeset.items)
     {
-        _cxml_xp__node_string_val(node, &l_str);
-        if (cmp(&l_str, r_str))
+        if (cmp(_cxml_xp__node_string_ref(node), r_str))
         {
-            cxml_string_free(&l_str);
             ret = true;
             break;
         }
-        cxml_string_free(&l_str);
     }
     _cxml_xp_data_clear(left);
     left->type = CXML_XP_DATA_BOOLEAN;
@@ -1100,7 +1094,7 @@ _cxml_xp_resolve_relative_operation_on_non_nodeset(
                 l_num = left->number;
                 _cxml_xp_data_to_numeric(right, &r_num);
             }else{
-                _cxml_xp_data_to_numeric(right, &l_num);
+                _cxml_xp_data_to_numeric(left, &l_num);
                 r_num = right->number;
             }
             ret = op == CXML_XP_OP_EQ ?
@@ -0,0 +1,771 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#include "xpath/cxxpvm.h"
+#include "xpath/cxxpparser.h"
+#include "xpath/cxxpresolver.h"
+#include "utils/cxutf8hook.h"
+
+// from cxxpeval.c
+extern _cxml_xp_data *_cxml_xp_invariant_value(cxml_xp_astnode *ast_node);
+
+extern bool _cxml_xp_pipe_match(cxml_xp_step *step, void *node);
+
+extern _cxml_xp_data *_cxml_xp_binding_value(cxml_string *name);
+
+#define _CXML_XP_VM_INIT_CAP    (8)
+
+static char _cxml_xp_vm__true[] = "true", _cxml_xp_vm__false[] = "false";
+
+static cxml_string _cxml_xp_vm__true_str = {_cxml_xp_vm__true, 4, 5},
+                   _cxml_xp_vm__false_str = {_cxml_xp_vm__false, 5, 6},
+                   _cxml_xp_vm__empty_str = {0};
+
+
+/*
+ * Compilation
+ */
+
+static int _emit(struct _cxml_xp_program *program, _cxml_xp_vm_op op, int dst, int a, int b){
+    if (program->size == program->capacity){
+        program->capacity = program->capacity ? program->capacity * 2 : _CXML_XP_VM_INIT_CAP;
+        program->code = RALLOC(_cxml_xp_vm_ins, program->code, (program->capacity));
+    }
+    _cxml_xp_vm_ins *ins = &program->code[program->size];
+    memset(ins, 0, sizeof(_cxml_xp_vm_ins));
+    ins->op = op;
+    ins->dst = dst;
+    ins->a = a;
+    ins->b = b;
+    return program->size++;
+}
+
+// allocate a register, -1 if all registers are in use
+static int _reg(struct _cxml_xp_program *program){
+    return program->n_regs < _CXML_XP_VM_MAX_REGS ? program->n_regs++ : -1;
+}
+
+// allocate a node-set operand
+static int _nodes(struct _cxml_xp_program *program, _cxml_xp_vm_nodes_t type){
+    program->nodes = RALLOC(struct _cxml_xp_vm_nodes, program->nodes, (program->n_nodes + 1));
+    program->nodes[program->n_nodes].type = type;
+    return program->n_nodes++;
+}
+
+/*
+ * Obtain the node-set operand of the relative path `path`, -1 if it isn't a single
+ * step from the context node (optionally following a '.' step).
+ */
+static int _compile_path(struct _cxml_xp_program *program, cxml_xp_path *path){
+    cxml_xp_step *step = cxml_list_first(&path->steps);
+    int n_steps = cxml_list_size(&path->steps);
+    if (n_steps == 2 && step->abbrev_step == 1 && !step->path_spec && cxml_list_is_empty(&step->predicates)){
+        step = cxml_list_last(&path->steps);
+        n_steps--;
+    }
+    if (n_steps != 1 || step->path_spec || step->axis || !cxml_list_is_empty(&step->predicates)) return -1;
+    int nodes;
+    if (step->abbrev_step){
+        if (step->abbrev_step != 1) return -1;
+        return _nodes(program, _CXML_XP_VM_SELF);
+    }
+    if (step->has_attr_axis){
+        // prefixed attribute names are resolved against the namespaces in scope
+        if (step->node_test->t_type != CXML_XP_NODE_TEST_NAMETEST
+            || (step->node_test->name_test.t_type != CXML_XP_NAME_TEST_NAME
+                && step->node_test->name_test.t_type != CXML_XP_NAME_TEST_WILDCARD))
+        {
+            return -1;
+        }
+        nodes = _nodes(program, _CXML_XP_VM_ATTR);
+    }else{
+        nodes = _nodes(program, _CXML_XP_VM_CHILD);
+    }
+    program->nodes[nodes].step = step;
+    return nodes;
+}
+
+static int _compile(struct _cxml_xp_program *program, cxml_xp_astnode *node, _cxml_xp_vm_t *type);
+
+// convert the value in `r` (of type `from`) to the type `to`
+static int _convert(struct _cxml_xp_program *program, int r, _cxml_xp_vm_t from, _cxml_xp_vm_t to){
+    if (r == -1 || from == to) return r;
+    _cxml_xp_vm_op op;
+    switch (to)
+    {
+        case _CXML_XP_VM_BOOL:
+            op = from == _CXML_XP_VM_NUM ? _CXML_XP_VM_NUM_TO_BOOL :
+                 from == _CXML_XP_VM_STR ? _CXML_XP_VM_STR_TO_BOOL : _CXML_XP_VM_NODES_TO_BOOL;
+            break;
+        case _CXML_XP_VM_NUM:
+            op = from == _CXML_XP_VM_STR ? _CXML_XP_VM_STR_TO_NUM :
+                 from == _CXML_XP_VM_BOOL ? _CXML_XP_VM_BOOL_TO_NUM : _CXML_XP_VM_NODES_TO_NUM;
+            break;
+        case _CXML_XP_VM_STR:
+            // (numbers are formatted into new strings, which registers don't hold)
+            if (from == _CXML_XP_VM_NUM) return -1;
+            op = from == _CXML_XP_VM_BOOL ? _CXML_XP_VM_BOOL_TO_STR : _CXML_XP_VM_NODES_TO_STR;
+            break;
+        default:
+            return -1;
+    }
+    int dst = _reg(program);
+    if (dst == -1) return -1;
+    _emit(program, op, dst, r, 0);
+    return dst;
+}
+
+static int _compile_as(struct _cxml_xp_program *program, cxml_xp_astnode *node, _cxml_xp_vm_t type){
+    _cxml_xp_vm_t from;
+    int r = _compile(program, node, &from);
+    return _convert(program, r, from, type);
+}
+
+static int _compile_invariant(struct _cxml_xp_program *program, cxml_xp_astnode *node, _cxml_xp_vm_t *type){
+    switch (node->wrapped_type)
+    {
+        case CXML_XP_AST_FUNCTION_CALL_NODE:
+            switch (node->wrapped_node.func_call->ret_type)
+            {
+                case CXML_XP_RET_STRING:  *type = _CXML_XP_VM_STR; break;
+                case CXML_XP_RET_NUMBER:  *type = _CXML_XP_VM_NUM; break;
+                case CXML_XP_RET_BOOLEAN: *type = _CXML_XP_VM_BOOL; break;
+                default:                  *type = _CXML_XP_VM_NODES; break;
+            }
+            break;
+        case CXML_XP_AST_BINOP_NODE:
+            switch (node->wrapped_node.binary->op)
+            {
+                case CXML_XP_OP_PLUS:
+                case CXML_XP_OP_MINUS:
+                case CXML_XP_OP_MULT:
+                case CXML_XP_OP_DIV:
+                case CXML_XP_OP_MOD:  *type = _CXML_XP_VM_NUM; break;
+                case CXML_XP_OP_PIPE: *type = _CXML_XP_VM_NODES; break;
+                default:              *type = _CXML_XP_VM_BOOL; break;
+            }
+            break;
+        case CXML_XP_AST_UNARYOP_NODE:
+            *type = _CXML_XP_VM_NUM;
+            break;
+        case CXML_XP_AST_VARIABLE_NODE:
+        {
+            // the program is compiled again when the type of the value bound changes
+            _cxml_xp_data *value = _cxml_xp_binding_value(&node->wrapped_node.variable->name);
+            if (!value) return -1;
+            switch (value->type)
+            {
+                case CXML_XP_DATA_STRING:  *type = _CXML_XP_VM_STR; break;
+                case CXML_XP_DATA_NUMERIC: *type = _CXML_XP_VM_NUM; break;
+                case CXML_XP_DATA_BOOLEAN: *type = _CXML_XP_VM_BOOL; break;
+                default:                   *type = _CXML_XP_VM_NODES; break;
+            }
+            break;
+        }
+        default:  // paths, filters
+            *type = _CXML_XP_VM_NODES;
+            break;
+    }
+    if (*type == _CXML_XP_VM_NODES){
+        int nodes = _nodes(program, _CXML_XP_VM_INV);
+        program->nodes[nodes].inv = node;
+        return nodes;
+    }
+    int dst = _reg(program);
+    if (dst == -1) return -1;
+    int ins = _emit(program, _CXML_XP_VM_LOAD_INV, dst, 0, 0);
+    program->code[ins].k.inv = node;
+    return dst;
+}
+
+static int _compile_comparison(struct _cxml_xp_program *program, cxml_xp_binaryop *binop){
+    _cxml_xp_vm_t l_type, r_type;
+    int l = _compile(program, binop->l_node, &l_type);
+    if (l == -1) return -1;
+    int r = _compile(program, binop->r_node, &r_type);
+    if (r == -1) return -1;
+    int dst = _reg(program), ins;
+    if (dst == -1) return -1;
+    bool equality = binop->op == CXML_XP_OP_EQ || binop->op == CXML_XP_OP_NEQ;
+    if (l_type == _CXML_XP_VM_NODES && r_type == _CXML_XP_VM_NODES){
+        ins = _emit(program, _CXML_XP_VM_CMP_NODES_NODES, dst, l, r);
+    }
+    else if (l_type == _CXML_XP_VM_NODES || r_type == _CXML_XP_VM_NODES){
+        bool flip = r_type == _CXML_XP_VM_NODES;
+        _cxml_xp_vm_t type = flip ? l_type : r_type;
+        ins = _emit(program,
+                    type == _CXML_XP_VM_NUM ? _CXML_XP_VM_CMP_NODES_NUM :
+                    type == _CXML_XP_VM_STR ? _CXML_XP_VM_CMP_NODES_STR : _CXML_XP_VM_CMP_NODES_BOOL,
+                    dst, flip ? r : l, flip ? l : r);
+        program->code[ins].flip = flip;
+    }
+    else{
+        // = and != compare booleans, then numbers, then strings,
+        // the other operators always compare numbers
+        _cxml_xp_vm_t type = (equality && (l_type == _CXML_XP_VM_BOOL || r_type == _CXML_XP_VM_BOOL)) ?
+                             _CXML_XP_VM_BOOL :
+                             (!equality || l_type == _CXML_XP_VM_NUM || r_type == _CXML_XP_VM_NUM) ?
+                             _CXML_XP_VM_NUM : _CXML_XP_VM_STR;
+        if ((l = _convert(program, l, l_type, type)) == -1
+            || (r = _convert(program, r, r_type, type)) == -1)
+        {
+            return -1;
+        }
+        ins = _emit(program,
+                    type == _CXML_XP_VM_BOOL ? _CXML_XP_VM_CMP_BOOL :
+                    type == _CXML_XP_VM_NUM ? _CXML_XP_VM_CMP_NUM : _CXML_XP_VM_CMP_STR,
+                    dst, l, r);
+    }
+    program->code[ins].cmp = binop->op;
+    return dst;
+}
+
+static int _compile_binop(struct _cxml_xp_program *program, cxml_xp_binaryop *binop, _cxml_xp_vm_t *type){
+    int l, r, dst, jump;
+    switch (binop->op)
+    {
+        case CXML_XP_OP_AND:
+        case CXML_XP_OP_OR:
+        {
+            // the right operand is skipped when the left operand decides the result
+            *type = _CXML_XP_VM_BOOL;
+            if ((dst = _reg(program)) == -1
+                || (l = _compile_as(program, binop->l_node, _CXML_XP_VM_BOOL)) == -1)
+            {
+                return -1;
+            }
+            _emit(program, _CXML_XP_VM_MOVE, dst, l, 0);
+            jump = _emit(program,
+                         binop->op == CXML_XP_OP_AND ? _CXML_XP_VM_JUMP_IF_FALSE : _CXML_XP_VM_JUMP_IF_TRUE,
+                         0, dst, 0);
+            if ((r = _compile_as(program, binop->r_node, _CXML_XP_VM_BOOL)) == -1) return -1;
+            _emit(program, _CXML_XP_VM_MOVE, dst, r, 0);
+            program->code[jump].k.target = program->size;
+            return dst;
+        }
+        case CXML_XP_OP_PLUS:
+        case CXML_XP_OP_MINUS:
+        case CXML_XP_OP_MULT:
+        case CXML_XP_OP_DIV:
+        case CXML_XP_OP_MOD:
+        {
+            *type = _CXML_XP_VM_NUM;
+            if ((l = _compile_as(program, binop->l_node, _CXML_XP_VM_NUM)) == -1
+                || (r = _compile_as(program, binop->r_node, _CXML_XP_VM_NUM)) == -1
+                || (dst = _reg(program)) == -1)
+            {
+                return -1;
+            }
+            int ins = _emit(program, _CXML_XP_VM_ARITH, dst, l, r);
+            program->code[ins].cmp = binop->op;
+            return dst;
+        }
+        case CXML_XP_OP_PIPE:
+            return -1;
+        default:
+            *type = _CXML_XP_VM_BOOL;
+            return _compile_comparison(program, binop);
+    }
+}
+
+static int _compile_function(struct _cxml_xp_program *program, cxml_xp_functioncall *func, _cxml_xp_vm_t *type){
+    cxml_string *name = &func->name;
+    int n_args = cxml_list_size(&func->args), dst, a, b;
+    cxml_xp_astnode *arg = n_args ? cxml_list_first(&func->args) : NULL;
+    if (cxml_string_raw_equals(name, "position") || cxml_string_raw_equals(name, "last")){
+        *type = _CXML_XP_VM_NUM;
+        if ((dst = _reg(program)) == -1) return -1;
+        _emit(program, cxml_string_raw_equals(name, "position") ? _CXML_XP_VM_LOAD_POS : _CXML_XP_VM_LOAD_LAST,
+              dst, 0, 0);
+        return dst;
+    }
+    if (cxml_string_raw_equals(name, "true") || cxml_string_raw_equals(name, "false")){
+        *type = _CXML_XP_VM_BOOL;
+        if ((dst = _reg(program)) == -1) return -1;
+        _emit(program, _CXML_XP_VM_LOAD_BOOL, dst, cxml_string_raw_equals(name, "true"), 0);
+        return dst;
+    }
+    if (cxml_string_raw_equals(name, "boolean")){
+        *type = _CXML_XP_VM_BOOL;
+        return _compile_as(program, arg, _CXML_XP_VM_BOOL);
+    }
+    if (cxml_string_raw_equals(name, "not")){
+        *type = _CXML_XP_VM_BOOL;
+        if ((a = _compile_as(program, arg, _CXML_XP_VM_BOOL)) == -1 || (dst = _reg(program)) == -1) return -1;
+        _emit(program, _CXML_XP_VM_NOT, dst, a, 0);
+        return dst;
+    }
+    if (cxml_string_raw_equals(name, "count")){
+        *type = _CXML_XP_VM_NUM;
+        _cxml_xp_vm_t arg_type;
+        if ((a = _compile(program, arg, &arg_type)) == -1
+            || arg_type != _CXML_XP_VM_NODES
+            || (dst = _reg(program)) == -1)
+        {
+            return -1;
+        }
+        _emit(program, _CXML_XP_VM_COUNT, dst, a, 0);
+        return dst;
+    }
+    if (cxml_string_raw_equals(name, "string") || cxml_string_raw_equals(name, "number")){
+        *type = cxml_string_raw_equals(name, "string") ? _CXML_XP_VM_STR : _CXML_XP_VM_NUM;
+        if (arg) return _compile_as(program, arg, *type);
+        if ((dst = _reg(program)) == -1) return -1;
+        _emit(program, *type == _CXML_XP_VM_STR ? _CXML_XP_VM_CTX_STR : _CXML_XP_VM_CTX_NUM, dst, 0, 0);
+        return dst;
+    }
+    if (cxml_string_raw_equals(name, "string-length")){
+        *type = _CXML_XP_VM_NUM;
+        if (arg){
+            a = _compile_as(program, arg, _CXML_XP_VM_STR);
+        }else if ((a = _reg(program)) != -1){
+            _emit(program, _CXML_XP_VM_CTX_STR, a, 0, 0);
+        }
+        if (a == -1 || (dst = _reg(program)) == -1) return -1;
+        _emit(program, _CXML_XP_VM_STR_LEN, dst, a, 0);
+        return dst;
+    }
+    if (cxml_string_raw_equals(name, "contains") || cxml_string_raw_equals(name, "starts-with")){
+        *type = _CXML_XP_VM_BOOL;
+        if ((a = _compile_as(program, arg, _CXML_XP_VM_STR)) == -1
+            || (b = _compile_as(program, cxml_list_last(&func->args), _CXML_XP_VM_STR)) == -1
+            || (dst = _reg(program)) == -1)
+        {
+            return -1;
+        }
+        _emit(program, cxml_string_raw_equals(name, "contains") ? _CXML_XP_VM_CONTAINS : _CXML_XP_VM_STARTS_WITH,
+              dst, a, b);
+        return dst;
+    }
+    return -1;
+}
+
+/*
+ * Compile `node` into `program`.
+ * Returns the register (or node-set operand) holding its value (of type `type`),
+ * -1 if `node` cannot be compiled.
+ */
+static int _compile(struct _cxml_xp_program *program, cxml_xp_astnode *node, _cxml_xp_vm_t *type){
+    int dst, a, ins;
+    if (node->is_invariant) return _compile_invariant(program, node, type);
+    switch (node->wrapped_type)
+    {
+        case CXML_XP_AST_NUM_NODE:
+            *type = _CXML_XP_VM_NUM;
+            if ((dst = _reg(program)) == -1) return -1;
+            ins = _emit(program, _CXML_XP_VM_LOAD_NUM, dst, 0, 0);
+            program->code[ins].k.num = cxml_literal_to_num(&node->wrapped_node.num->val);
+            return dst;
+        case CXML_XP_AST_STR_LITERAL_NODE:
+            *type = _CXML_XP_VM_STR;
+            if ((dst = _reg(program)) == -1) return -1;
+            ins = _emit(program, _CXML_XP_VM_LOAD_STR, dst, 0, 0);
+            program->code[ins].k.str = &node->wrapped_node.str_literal->str;
+            return dst;
+        case CXML_XP_AST_PATH_NODE:
+            *type = _CXML_XP_VM_NODES;
+            return _compile_path(program, node->wrapped_node.path);
+        case CXML_XP_AST_UNARYOP_NODE:
+            *type = _CXML_XP_VM_NUM;
+            if ((a = _compile_as(program, node->wrapped_node.unary->node, _CXML_XP_VM_NUM)) == -1
+                || (dst = _reg(program)) == -1)
+            {
+                return -1;
+            }
+            _emit(program, node->wrapped_node.unary->op == CXML_XP_OP_MINUS ? _CXML_XP_VM_NEG : _CXML_XP_VM_MOVE,
+                  dst, a, 0);
+            return dst;
+        case CXML_XP_AST_BINOP_NODE:
+            return _compile_binop(program, node->wrapped_node.binary, type);
+        case CXML_XP_AST_FUNCTION_CALL_NODE:
+            return _compile_function(program, node->wrapped_node.func_call, type);
+        default:
+            return -1;
+    }
+}
+
+/*
+ * Compile the predicate expression `expr_node`.
+ * Returns NULL if the expression cannot be compiled.
+ */
+struct _cxml_xp_program *_cxml_xp_compile(cxml_xp_astnode *expr_node){
+    // (the value of an invariant predicate is computed once anyway)
+    if (!expr_node || expr_node->is_invariant) return NULL;
+    struct _cxml_xp_program *program = CALLOC(struct _cxml_xp_program, 1);
+    program->ret = _compile(program, expr_node, &program->ret_type);
+    if (program->ret == -1){
+        _cxml_xp_program_free(program);
+        return NULL;
+    }
+    return program;
+}
+
+void _cxml_xp_program_free(struct _cxml_xp_program *program){
+    if (!program) return;
+    FREE(program->code);
+    FREE(program->nodes);
+    FREE(program);
+}
+
+
+/*
+ * Execution
+ */
+
+typedef union{
+    cxml_number num;
+    cxml_string *str;
+    bool bol;
+}_cxml_xp_vm_reg;
+
+// iterates the nodes of a node-set operand
+struct _cxml_xp_vm_cursor{
+    struct _cxml_xp_vm_nodes *nodes;
+    cxml_elem_node *elem;
+    int attr;       // next attribute of `elem` (in the order of its attribute table)
+    struct _cxml_list__node *next;
+    void *node;     // the only node of the operand ('.', or a named attribute)
+};
+
+static void _cursor_open(struct _cxml_xp_vm_cursor *cursor, struct _cxml_xp_vm_nodes *nodes, void *ctx_node){
+    cursor->nodes = nodes;
+    cursor->elem = NULL;
+    cursor->attr = 0;
+    cursor->next = NULL;
+    cursor->node = NULL;
+    switch (nodes->type)
+    {
+        case _CXML_XP_VM_SELF:
+            cursor->node = ctx_node;
+            break;
+        case _CXML_XP_VM_CHILD:
+            if (_cxml_node_type(ctx_node) == CXML_ELEM_NODE || _cxml_node_type(ctx_node) == CXML_ROOT_NODE){
+                cursor->next = (_cxml__get_node_children(ctx_node))->head;
+            }
+            break;
+        case _CXML_XP_VM_ATTR:
+        {
+            cxml_elem_node *elem = ctx_node;
+            if (_cxml_node_type(ctx_node) != CXML_ELEM_NODE || !elem->has_attribute) break;
+            if (nodes->step->node_test->name_test.t_type == CXML_XP_NAME_TEST_NAME){
+                cursor->node = cxml_table_get(
+                        elem->attributes,
+                        cxml_string_as_raw(&nodes->step->node_test->name_test.name.qname));
+            }else{
+                cursor->elem = elem;
+            }
+            break;
+        }
+        case _CXML_XP_VM_INV:
+        {
+            _cxml_xp_data *data = _cxml_xp_invariant_value(nodes->inv);
+            if (data->type == CXML_XP_DATA_NODESET) cursor->next = data->nodeset.items.head;
+            break;
+        }
+    }
+}
+
+static void *_cursor_next(struct _cxml_xp_vm_cursor *cursor){
+    void *node = cursor->node;
+    if (node){
+        cursor->node = NULL;
+        return node;
+    }
+    if (cursor->elem){
+        // attributes are read off the entries of the table, in place
+        if (cursor->attr < cxml_table_size(cursor->elem->attributes)){
+            return cxml_table_entry(cursor->elem->attributes, cursor->attr++)->value;
+        }
+        return NULL;
+    }
+    while (cursor->next){
+        node = cursor->next->item;
+        cursor->next = cursor->next->next;
+        switch (cursor->nodes->type)
+        {
+            case _CXML_XP_VM_CHILD:
+                if (_cxml_xp_pipe_match(cursor->nodes->step, node)) return node;
+                break;
+            default:
+                return node;
+        }
+    }
+    return NULL;
+}
+
+// compare numbers as the resolver (cxxpresolver.c) does
+static bool _cmp_num(cxml_xp_op op, cxml_number *l, cxml_number *r){
+    switch (op)
+    {
+        case CXML_XP_OP_EQ:  return cxml_number_is_equal(l, r);
+        case CXML_XP_OP_NEQ: return cxml_number_is_not_equal(l, r);
+        case CXML_XP_OP_LT:  return cxml_number_is_less(l, r);
+        case CXML_XP_OP_GT:  return cxml_number_is_greater(l, r);
+        case CXML_XP_OP_LEQ: return !cxml_number_is_greater(l, r);
+        case CXML_XP_OP_GEQ: return !cxml_number_is_less(l, r);
+        default:             return false;
+    }
+}
+
+inline static bool _cmp_num_flip(cxml_xp_op op, cxml_number *node_num, cxml_number *num, bool flip){
+    return flip ? _cmp_num(op, num, node_num) : _cmp_num(op, node_num, num);
+}
+
+static void _arith(_cxml_xp_vm_ins *ins, cxml_number *l, cxml_number *r, cxml_number *res){
+    if (l->type == CXML_NUMERIC_NAN_T || r->type == CXML_NUMERIC_NAN_T){
+        cxml_number_init(res);
+        return;
+    }
+    res->type = CXML_NUMERIC_DOUBLE_T;
+    switch (ins->cmp)
+    {
+        case CXML_XP_OP_PLUS:  res->dec_val = l->dec_val + r->dec_val; break;
+        case CXML_XP_OP_MINUS: res->dec_val = l->dec_val - r->dec_val; break;
+        case CXML_XP_OP_MULT:  res->dec_val = l->dec_val * r->dec_val; break;
+        case CXML_XP_OP_DIV:
+            if (l->dec_val == 0 || r->dec_val == 0){
+                _cxml_xp_eval_err("Division operation by Zero.");
+            }
+            res->dec_val = l->dec_val / r->dec_val;
+            break;
+        case CXML_XP_OP_MOD:
+            if (l->dec_val == 0 || r->dec_val == 0){
+                _cxml_xp_eval_err("Modulus operation on Zero.");
+            }
+            res->dec_val = (double)((long)l->dec_val % (long)r->dec_val);
+            break;
+        default: break;
+    }
+}
+
+/*
+ * node-set comparisons (see the algorithm described in cxxpresolver.c)
+ */
+static bool _cmp_nodes(struct _cxml_xp_program *program, _cxml_xp_vm_ins *ins,
+                       _cxml_xp_vm_reg *regs, void *ctx_node)
+{
+    bool equality = ins->cmp == CXML_XP_OP_EQ || ins->cmp == CXML_XP_OP_NEQ;
+    struct _cxml_xp_vm_cursor cursor, other;
+    cxml_number num, other_num, scalar;
+    void *node, *_node;
+    _cursor_open(&cursor, &program->nodes[ins->a], ctx_node);
+    switch (ins->op)
+    {
+        case _CXML_XP_VM_CMP_NODES_NUM:
+            while ((node = _cursor_next(&cursor))){
+                _cxml_xp__node_num_val(node, &num);
+                if (_cmp_num_flip(ins->cmp, &num, &regs[ins->b].num, ins->flip)) return true;
+            }
+            return false;
+        case _CXML_XP_VM_CMP_NODES_STR:
+            if (equality){
+                while ((node = _cursor_next(&cursor))){
+                    if (cxml_string_equals(_cxml_xp__node_string_ref(node), regs[ins->b].str)
+                        == (ins->cmp == CXML_XP_OP_EQ))
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            scalar = cxml_literal_to_num(regs[ins->b].str);
+            while ((node = _cursor_next(&cursor))){
+                _cxml_xp__node_num_val(node, &num);
+                if (_cmp_num_flip(ins->cmp, &num, &scalar, ins->flip)) return true;
+            }
+            return false;
+        case _CXML_XP_VM_CMP_NODES_BOOL:
+            node = _cursor_next(&cursor);
+            if (equality) return ((node != NULL) == regs[ins->b].bol) == (ins->cmp == CXML_XP_OP_EQ);
+            cxml_number_init(&num);
+            if (node) _cxml_xp__node_num_val(node, &num);
+            scalar.type = CXML_NUMERIC_DOUBLE_T;
+            scalar.dec_val = regs[ins->b].bol ? 1.0 : 0.0;
+            return _cmp_num_flip(ins->cmp, &num, &scalar, ins->flip);
+        case _CXML_XP_VM_CMP_NODES_NODES:
+            while ((node = _cursor_next(&cursor))){
+                if (!equality) _cxml_xp__node_num_val(node, &num);
+                _cursor_open(&other, &program->nodes[ins->b], ctx_node);
+                while ((_node = _cursor_next(&other))){
+                    if (equality){
+                        if (cxml_string_equals(_cxml_xp__node_string_ref(node), _cxml_xp__node_string_ref(_node))
+                            == (ins->cmp == CXML_XP_OP_EQ))
+                        {
+                            return true;
+                        }
+                        continue;
+                    }
+                    _cxml_xp__node_num_val(_node, &other_num);
+                    if (_cmp_num(ins->cmp, &num, &other_num)) return true;
+                }
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+inline static int _str_len(cxml_string *str){
+    char *raw = cxml_string_as_raw(str);
+    if (!raw) return 0;
+    // (as string-length() does, only utf-8 is supported)
+    if (u8_validate(raw, cxml_string_len(str), NULL)) return cxml_string_mb_len(str);
+    return (int)cxml_string_len(str);
+}
+
+/*
+ * Run `program` with the current context (node, position and size),
+ * converting the value of the expression as a predicate does.
+ */
+bool _cxml_xp_run(struct _cxml_xp_program *program){
+    _cxml_xp_vm_reg regs[_CXML_XP_VM_MAX_REGS];
+    struct _cxml_xp_context_state *context = &_xpath_parser.context;
+    struct _cxml_xp_vm_cursor cursor;
+    _cxml_xp_vm_ins *ins;
+    _cxml_xp_data *data;
+    void *node;
+    int count;
+    for (int pc = 0; pc < program->size;)
+    {
+        ins = &program->code[pc++];
+        switch (ins->op)
+        {
+            case _CXML_XP_VM_LOAD_NUM:
+                regs[ins->dst].num = ins->k.num;
+                break;
+            case _CXML_XP_VM_LOAD_STR:
+                regs[ins->dst].str = ins->k.str;
+                break;
+            case _CXML_XP_VM_LOAD_BOOL:
+                regs[ins->dst].bol = ins->a;
+                break;
+            case _CXML_XP_VM_LOAD_POS:
+            case _CXML_XP_VM_LOAD_LAST:
+                regs[ins->dst].num.type = CXML_NUMERIC_DOUBLE_T;
+                regs[ins->dst].num.dec_val = ins->op == _CXML_XP_VM_LOAD_POS ? context->ctx_pos : context->ctx_size;
+                break;
+            case _CXML_XP_VM_LOAD_INV:
+            {
+                data = _cxml_xp_invariant_value(ins->k.inv);
+                switch (data->type)
+                {
+                    case CXML_XP_DATA_NUMERIC: regs[ins->dst].num = data->number; break;
+                    case CXML_XP_DATA_BOOLEAN: regs[ins->dst].bol = data->boolean; break;
+                    case CXML_XP_DATA_STRING:  regs[ins->dst].str = &data->str; break;
+                    default:                   regs[ins->dst].str = &_cxml_xp_vm__empty_str; break;
+                }
+                break;
+            }
+            case _CXML_XP_VM_CTX_STR:
+                regs[ins->dst].str = _cxml_xp__node_string_ref(context->ctx_node);
+                break;
+            case _CXML_XP_VM_CTX_NUM:
+                _cxml_xp__node_num_val(context->ctx_node, &regs[ins->dst].num);
+                break;
+            case _CXML_XP_VM_MOVE:
+                regs[ins->dst] = regs[ins->a];
+                break;
+            case _CXML_XP_VM_NUM_TO_BOOL:
+                regs[ins->dst].bol = regs[ins->a].num.type != CXML_NUMERIC_NAN_T && regs[ins->a].num.dec_val != 0;
+                break;
+            case _CXML_XP_VM_STR_TO_BOOL:
+                regs[ins->dst].bol = cxml_string_len(regs[ins->a].str) != 0;
+                break;
+            case _CXML_XP_VM_STR_TO_NUM:
+                regs[ins->dst].num = cxml_literal_to_num(regs[ins->a].str);
+                break;
+            case _CXML_XP_VM_BOOL_TO_NUM:
+                regs[ins->dst].num.type = CXML_NUMERIC_DOUBLE_T;
+                regs[ins->dst].num.dec_val = regs[ins->a].bol ? 1.0 : 0.0;
+                break;
+            case _CXML_XP_VM_BOOL_TO_STR:
+                regs[ins->dst].str = regs[ins->a].bol ? &_cxml_xp_vm__true_str : &_cxml_xp_vm__false_str;
+                break;
+            case _CXML_XP_VM_NODES_TO_BOOL:
+            case _CXML_XP_VM_NODES_TO_NUM:
+            case _CXML_XP_VM_NODES_TO_STR:
+            {
+                // the first node decides the value
+                _cursor_open(&cursor, &program->nodes[ins->a], context->ctx_node);
+                node = _cursor_next(&cursor);
+                if (ins->op == _CXML_XP_VM_NODES_TO_BOOL){
+                    regs[ins->dst].bol = node != NULL;
+                }else if (ins->op == _CXML_XP_VM_NODES_TO_STR){
+                    regs[ins->dst].str = node ? _cxml_xp__node_string_ref(node) : &_cxml_xp_vm__empty_str;
+                }else{
+                    cxml_number_init(&regs[ins->dst].num);
+                    if (node) _cxml_xp__node_num_val(node, &regs[ins->dst].num);
+                }
+                break;
+            }
+            case _CXML_XP_VM_COUNT:
+            {
+                _cursor_open(&cursor, &program->nodes[ins->a], context->ctx_node);
+                for (count = 0; _cursor_next(&cursor); count++);
+                regs[ins->dst].num.type = CXML_NUMERIC_DOUBLE_T;
+                regs[ins->dst].num.dec_val = count;
+                break;
+            }
+            case _CXML_XP_VM_ARITH:
+                _arith(ins, &regs[ins->a].num, &regs[ins->b].num, &regs[ins->dst].num);
+                break;
+            case _CXML_XP_VM_NEG:
+                regs[ins->dst].num = regs[ins->a].num;
+                if (regs[ins->dst].num.type == CXML_NUMERIC_DOUBLE_T){
+                    regs[ins->dst].num.dec_val = -regs[ins->dst].num.dec_val;
+                }
+                break;
+            case _CXML_XP_VM_NOT:
+                regs[ins->dst].bol = !regs[ins->a].bol;
+                break;
+            case _CXML_XP_VM_CMP_NUM:
+                regs[ins->dst].bol = _cmp_num(ins->cmp, &regs[ins->a].num, &regs[ins->b].num);
+                break;
+            case _CXML_XP_VM_CMP_STR:
+                regs[ins->dst].bol = cxml_string_equals(regs[ins->a].str, regs[ins->b].str)
+                                     == (ins->cmp == CXML_XP_OP_EQ);
+                break;
+            case _CXML_XP_VM_CMP_BOOL:
+                regs[ins->dst].bol = (regs[ins->a].bol == regs[ins->b].bol) == (ins->cmp == CXML_XP_OP_EQ);
+                break;
+            case _CXML_XP_VM_CMP_NODES_NUM:
+            case _CXML_XP_VM_CMP_NODES_STR:
+            case _CXML_XP_VM_CMP_NODES_BOOL:
+            case _CXML_XP_VM_CMP_NODES_NODES:
+                regs[ins->dst].bol = _cmp_nodes(program, ins, regs, context->ctx_node);
+                break;
+            case _CXML_XP_VM_STR_LEN:
+                regs[ins->dst].num.type = CXML_NUMERIC_DOUBLE_T;
+                regs[ins->dst].num.dec_val = _str_len(regs[ins->a].str);
+                break;
+            case _CXML_XP_VM_CONTAINS:
+                regs[ins->dst].bol = cxml_string_contains(regs[ins->a].str, regs[ins->b].str);
+                break;
+            case _CXML_XP_VM_STARTS_WITH:
+                regs[ins->dst].bol = cxml_string_str_startswith(regs[ins->a].str, regs[ins->b].str);
+                break;
+            case _CXML_XP_VM_JUMP_IF_TRUE:
+                if (regs[ins->a].bol) pc = ins->k.target;
+                break;
+            case _CXML_XP_VM_JUMP_IF_FALSE:
+                if (!regs[ins->a].bol) pc = ins->k.target;
+                break;
+        }
+    }
+    // the value of a predicate expression (see _evaluate_predicate_expr() in cxxpeval.c)
+    switch (program->ret_type)
+    {
+        case _CXML_XP_VM_NUM:
+            return regs[program->ret].num.type == CXML_NUMERIC_DOUBLE_T
+                   && cxml_number_is_d_equal((double)context->ctx_pos, regs[program->ret].num.dec_val);
+        case _CXML_XP_VM_STR:
+            return cxml_string_len(regs[program->ret].str) != 0;
+        case _CXML_XP_VM_BOOL:
+            return regs[program->ret].bol;
+        default:
+            _cursor_open(&cursor, &program->nodes[program->ret], context->ctx_node);
+            return _cursor_next(&cursor) != NULL;
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#include "cxfixture.h"
+
+static void _count_cleanup(void *item){
+    (*(int *)item)++;
+}
+
+cts test_cxml_arena_alloc(){
+    cxml_arena arena;
+    cxml_arena_init(&arena);
+    cxml_assert__null(arena.block)
+    char *a = cxml_arena_alloc(&arena, 3);
+    char *b = cxml_arena_alloc(&arena, 8);
+    cxml_assert__not_null(a)
+    cxml_assert__not_null(b)
+    // allocations are aligned, and don't overlap
+    cxml_assert__zero((uintptr_t)a % _CXML_ARENA_ALIGN)
+    cxml_assert__zero((uintptr_t)b % _CXML_ARENA_ALIGN)
+    cxml_assert__geq(b - a, 3)
+    memset(a, 'a', 3);
+    memset(b, 'b', 8);
+    cxml_assert__eq(a[2], 'a')
+    int *z = cxml_arena_calloc(&arena, sizeof(int) * 4);
+    cxml_assert__zero((z[0] | z[1] | z[2] | z[3]))
+    cxml_arena_free(&arena);
+    cxml_assert__null(arena.block)
+    cxml_pass()
+}
+
+cts test_cxml_arena_grow(){
+    cxml_arena arena;
+    cxml_arena_init(&arena);
+    cxml_arena_alloc(&arena, 16);
+    struct _cxml_arena_block *first = arena.block;
+    // larger than a block
+    char *big = cxml_arena_alloc(&arena, _CXML_ARENA_BLOCK_SIZE * 3);
+    memset(big, 0, _CXML_ARENA_BLOCK_SIZE * 3);
+    cxml_assert__true(arena.block != first)
+    cxml_assert__true(arena.block->prev == first)
+    cxml_assert__geq(arena.block->size, _CXML_ARENA_BLOCK_SIZE * 3)
+    // reset keeps the largest block only
+    struct _cxml_arena_block *largest = arena.block;
+    cxml_arena_reset(&arena);
+    cxml_assert__true(arena.block == largest)
+    cxml_assert__null(arena.block->prev)
+    cxml_assert__zero(arena.used)
+    // and reuses it
+    cxml_assert__true(cxml_arena_alloc(&arena, 16) == (void *)big)
+    cxml_arena_free(&arena);
+    cxml_pass()
+}
+
+cts test_cxml_arena_on_reset(){
+    cxml_arena arena;
+    cxml_arena_init(&arena);
+    int count = 0;
+    cxml_arena_on_reset(&arena, _count_cleanup, &count);
+    cxml_arena_on_reset(&arena, _count_cleanup, &count);
+    cxml_assert__zero(count)
+    cxml_arena_reset(&arena);
+    cxml_assert__two(count)
+    // cleanups run once
+    cxml_arena_reset(&arena);
+    cxml_assert__two(count)
+    cxml_arena_on_reset(&arena, _count_cleanup, &count);
+    cxml_arena_free(&arena);
+    cxml_assert__eq(count, 3)
+    cxml_pass()
+}
+
+void suite_cxarena(){
+    cxml_suite(cxarena)
+    {
+        cxml_add_m_test(3,
+                        test_cxml_arena_alloc,
+                        test_cxml_arena_grow,
+                        test_cxml_arena_on_reset
+                        )
+        cxml_run_suite()
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#include "cxfixture.h"
+
+cts test_cxml_budget_visits(){
+    cxml_budget budget;
+    cxml_budget_init(&budget);
+    // unbounded calls
+    cxml_budget_set(NULL);
+    _cxml_budget_begin();
+    cxml_assert__true(_cxml_budget_visit(1000000))
+    cxml_assert__false(_cxml_budget_exhausted())
+
+    budget.max_visits = 10;
+    budget.max_results = 5;
+    cxml_budget_set(&budget);
+    _cxml_budget_begin();
+    cxml_assert__true(_cxml_budget_visit(10))
+    cxml_assert__true(_cxml_budget_results(5))
+    cxml_assert__false(_cxml_budget_visit(1))
+    cxml_assert__eq(budget.status, CXML_BUDGET_VISITS_EXCEEDED)
+    cxml_assert__true(_cxml_budget_exhausted())
+    // each call starts with a fresh budget
+    _cxml_budget_begin();
+    cxml_assert__eq(budget.status, CXML_BUDGET_OK)
+    cxml_assert__zero(budget.visits)
+    cxml_assert__false(_cxml_budget_results(6))
+    cxml_assert__eq(budget.status, CXML_BUDGET_RESULTS_EXCEEDED)
+    cxml_budget_set(NULL);
+    cxml_pass()
+}
+
+cts test_cxml_budget_cancel(){
+    cxml_budget budget;
+    cxml_budget_init(&budget);
+    cxml_cancel_flag cancel = false;
+    budget.cancel = &cancel;
+    cxml_budget_set(&budget);
+    _cxml_budget_begin();
+    cxml_assert__true(_cxml_budget_visit(_CXML_BUDGET_CHECK_INTERVAL * 2))
+    cancel = true;
+    // the flag is read every _CXML_BUDGET_CHECK_INTERVAL visits
+    int visits = 0;
+    while (_cxml_budget_visit(1)) visits++;
+    cxml_assert__leq(visits, _CXML_BUDGET_CHECK_INTERVAL)
+    cxml_assert__eq(budget.status, CXML_BUDGET_CANCELLED)
+
+    cancel = false;
+    budget.cancel = NULL;
+    budget.timeout = 1e-6;
+    _cxml_budget_begin();
+    struct timespec start, now;
+    timespec_get(&start, TIME_UTC);
+    do{
+        timespec_get(&now, TIME_UTC);
+    }while (now.tv_sec == start.tv_sec && now.tv_nsec - start.tv_nsec < 10000);
+    cxml_assert__false(_cxml_budget_visit(_CXML_BUDGET_CHECK_INTERVAL))
+    cxml_assert__eq(budget.status, CXML_BUDGET_DEADLINE_EXCEEDED)
+    cxml_budget_set(NULL);
+    cxml_pass()
+}
+
+void suite_cxbudget(){
+    cxml_suite(cxbudget)
+    {
+        cxml_add_m_test(2,
+                        test_cxml_budget_visits,
+                        test_cxml_budget_cancel
+                        )
+        cxml_run_suite()
+    }
+}
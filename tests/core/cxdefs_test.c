@@ -31,7 +31,7 @@ int empty_text_asserts(cxml_text_node *node){
     cxml_assert__null(node->parent)
     cxml_assert__false(node->has_entity)
     cxml_assert__false(node->is_cdata)
-    cxml_assert__eq(node->number_value.type, CXML_NUMERIC_NAN_T)
+    cxml_assert__eq(node->number_value.type, CXML_NUMERIC_UNSET_T)
     cxml_assert__zero(node->number_value.dec_val)
     return 1;
 }
@@ -43,7 +43,7 @@ int empty_attr_asserts(cxml_attr_node *node){
     cxml_assert__zero(node->pos)
     cxml_assert__null(node->parent)
     cxml_assert__null(node->namespace)
-    cxml_assert__eq(node->number_value.type, CXML_NUMERIC_NAN_T)
+    cxml_assert__eq(node->number_value.type, CXML_NUMERIC_UNSET_T)
     cxml_assert__zero(node->number_value.dec_val)
     return 1;
 }
@@ -197,8 +197,8 @@ cts test_cxml_name_init(){
     cxml_assert__zero(cxml_string_len(&name.qname))
     cxml_assert__zero(name.pname_len)
     cxml_assert__zero(name.lname_len)
-    cxml_assert__null(name.lname)
-    cxml_assert__null(name.pname)
+    cxml_assert__null(cxml_name_lname(&name))
+    cxml_assert__null(cxml_name_pname(&name))
     cxml_pass()
 }
 
@@ -275,11 +275,47 @@ cts test__cxml_cmp_node(){
     cxml_pass()
 }
 
+cts test_cxml_memory_report(){
+    // <fruit a="boy"><name>apple</name></fruit>
+    cxml_root_node *root = cxml_load_string(wf_xml_09);
+    cxml_assert__not_null(root)
+    int ns = root->namespaces ? cxml_list_size(root->namespaces) : 0;
+    cxml_mem_report report;
+    cxml_memory_report(root, &report);
+    // root, fruit, a, name, apple (+ global namespaces)
+    cxml_assert__eq(report.nodes, 5 + ns)
+    cxml_assert__eq(report.node_bytes,
+                    sizeof(cxml_root_node) + 2 * sizeof(cxml_elem_node) + sizeof(cxml_attr_node)
+                    + sizeof(cxml_text_node) + ns * sizeof(cxml_ns_node))
+    cxml_assert__gt(report.data_bytes, 0)
+
+    cxml_memory_report(NULL, &report);
+    cxml_assert__zero(report.nodes)
+    cxml_assert__zero(report.node_bytes)
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test__cxml_find_pred_entity(){
+    const char *text = "no predefined entities in this text at all";
+    const char *end = text + strlen(text);
+    cxml_assert__eq(_cxml_find_pred_entity(text, end), end)
+    text = "entities: found after a few words -> &";
+    end = text + strlen(text);
+    cxml_assert__eq(_cxml_find_pred_entity(text, end), strchr(text, '>'))
+    text = "'quoted'";
+    cxml_assert__eq(_cxml_find_pred_entity(text, text + 8), text)
+    cxml_assert__eq(_cxml_find_pred_entity(text + 1, text + 7), text + 7)
+    // never scans past `end`
+    text = "abcdefgh&";
+    cxml_assert__eq(_cxml_find_pred_entity(text, text + 8), text + 8)
+    cxml_pass()
+}
 
 void suite_cxdefs(){
     cxml_suite(cxdefs)
     {
-        cxml_add_m_test(16,
+        cxml_add_m_test(18,
                         test_cxml_elem_node_init,
                         test_cxml_text_node_init,
                         test_cxml_attr_node_init,
@@ -295,7 +331,9 @@ void suite_cxdefs(){
                         test__cxml_get_node_parent,
                         test__cxml_node_parent,
                         test__cxml_unset_parent,
-                        test__cxml_cmp_node
+                        test__cxml_cmp_node,
+                        test_cxml_memory_report,
+                        test__cxml_find_pred_entity
                         )
         cxml_run_suite()
     }
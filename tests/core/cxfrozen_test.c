@@ -0,0 +1,132 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#include "cxfixture.h"
+
+cts test_cxml_freeze(){
+    // <noodles>indomie<seasoning>maggi<br/>mr-chef</seasoning>super-pack<others></others></noodles>
+    cxml_root_node *root = cxml_load_string(wf_xml_6);
+    cxml_assert__not_null(root)
+    cxml_frozen_doc *doc = cxml_freeze(root);
+    // the frozen document doesn't depend on the original document
+    cxml_destroy(root);
+    cxml_assert__not_null(doc)
+    cxml_assert__eq(doc->size, 9)
+    cxml_assert__eq(doc->kind[0], CXML_ROOT_NODE)
+    cxml_assert__eq(doc->kind[1], CXML_ELEM_NODE)
+    cxml_assert__eq(doc->kind[2], CXML_TEXT_NODE)
+    cxml_assert__eq(doc->parent[0], -1)
+    cxml_assert__eq(doc->first_child[0], 1)
+    cxml_assert__eq(doc->first_child[1], 2)
+    // indomie -> seasoning -> super-pack -> others
+    cxml_assert__eq(doc->next_sibling[2], 3)
+    cxml_assert__eq(doc->next_sibling[3], 7)
+    cxml_assert__eq(doc->next_sibling[7], 8)
+    cxml_assert__eq(doc->next_sibling[8], -1)
+    cxml_assert__eq(doc->parent[5], 3)
+    cxml_assert__eq(doc->end[3], 6)
+    cxml_assert__eq(doc->first_child[8], -1)
+    // noodles, seasoning, br, others
+    cxml_assert__eq(doc->sym_size, 4)
+    cxml_assert__null(cxml_freeze(NULL))
+    cxml_frozen_free(doc);
+    cxml_pass()
+}
+
+cts test_cxml_frozen_names_and_values(){
+    cxml_root_node *root = cxml_load_string(wf_xml_6);
+    cxml_assert__not_null(root)
+    cxml_frozen_doc *doc = cxml_freeze(root);
+    cxml_destroy(root);
+    int len = 0;
+    cxml_assert__zero(strcmp(cxml_frozen_name(doc, 3, &len), "seasoning"))
+    cxml_assert__eq(len, 9)
+    cxml_assert__zero(strcmp(cxml_frozen_value(doc, 4, &len), "maggi"))
+    cxml_assert__eq(len, 5)
+    cxml_assert__null(cxml_frozen_value(doc, 3, &len))
+    cxml_assert__null(cxml_frozen_name(doc, 2, &len))
+    cxml_assert__null(cxml_frozen_name(doc, 100, &len))
+
+    cxml_string str = new_cxml_string();
+    cxml_frozen_text(doc, 3, &str);
+    cxml_assert__true(cxml_string_raw_equals(&str, "maggimr-chef"))
+    cxml_string_free(&str);
+    cxml_frozen_free(doc);
+    cxml_pass()
+}
+
+cts test_cxml_frozen_symbol(){
+    cxml_root_node *root = cxml_load_string(wf_xml_10);
+    cxml_assert__not_null(root)
+    cxml_frozen_doc *doc = cxml_freeze(root);
+    cxml_destroy(root);
+    int name = cxml_frozen_symbol(doc, "name");
+    cxml_assert__neq(name, -1)
+    cxml_assert__eq(cxml_frozen_symbol(doc, "name"), name)
+    cxml_assert__eq(cxml_frozen_symbol(doc, "nope"), -1)
+    cxml_assert__eq(cxml_frozen_symbol(NULL, "name"), -1)
+    int len;
+    cxml_assert__zero(strcmp(cxml_frozen_symbol_name(doc, name, &len), "name"))
+    cxml_assert__null(cxml_frozen_symbol_name(doc, -1, &len))
+    cxml_frozen_free(doc);
+    cxml_pass()
+}
+
+cts test_cxml_frozen_attribute(){
+    cxml_root_node *root = cxml_load_string(wf_xml_09);
+    cxml_assert__not_null(root)
+    cxml_frozen_doc *doc = cxml_freeze(root);
+    cxml_destroy(root);
+    int len = 0;
+    cxml_assert__eq(doc->attr_size, 1)
+    cxml_assert__zero(strcmp(cxml_frozen_attribute(doc, 1, "a", &len), "boy"))
+    cxml_assert__eq(len, 3)
+    cxml_assert__null(cxml_frozen_attribute(doc, 1, "b", &len))
+    cxml_assert__null(cxml_frozen_attribute(doc, 2, "a", &len))
+    cxml_frozen_free(doc);
+    cxml_pass()
+}
+
+cts test_cxml_frozen_next_element(){
+    // <fruit><name>apple</name><name>banana</name></fruit>
+    cxml_root_node *root = cxml_load_string(wf_xml_10);
+    cxml_assert__not_null(root)
+    cxml_frozen_doc *doc = cxml_freeze(root);
+    cxml_destroy(root);
+    int sym = cxml_frozen_symbol(doc, "name"), count = 0;
+    char *expected[] = {"apple", "banana"};
+    cxml_string str = new_cxml_string();
+    for (int n = cxml_frozen_next_element(doc, 0, sym, 0); n != -1;
+         n = cxml_frozen_next_element(doc, 0, sym, n))
+    {
+        cxml_frozen_text(doc, n, &str);
+        cxml_assert__true(cxml_string_raw_equals(&str, expected[count]))
+        cxml_string_free(&str);
+        count++;
+    }
+    cxml_assert__two(count)
+    // any element
+    cxml_assert__eq(cxml_frozen_next_element(doc, 0, CXML_FROZEN_ANY_SYMBOL, 0), 1)
+    // a name that doesn't occur in the document matches no element
+    cxml_assert__eq(cxml_frozen_next_element(doc, 0, cxml_frozen_symbol(doc, "nope"), 0), -1)
+    // scope without matching descendants
+    cxml_assert__eq(cxml_frozen_next_element(doc, 2, sym, 2), -1)
+    cxml_frozen_free(doc);
+    cxml_pass()
+}
+
+void suite_cxfrozen(){
+    cxml_suite(cxfrozen)
+    {
+        cxml_add_m_test(5,
+                        test_cxml_freeze,
+                        test_cxml_frozen_names_and_values,
+                        test_cxml_frozen_symbol,
+                        test_cxml_frozen_attribute,
+                        test_cxml_frozen_next_element
+                        )
+        cxml_run_suite()
+    }
+}
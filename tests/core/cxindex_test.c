@@ -0,0 +1,167 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#include "cxfixture.h"
+
+cts test_cxml_index_document(){
+    // <noodles>indomie<seasoning>maggi<br/>mr-chef</seasoning>super-pack<others></others></noodles>
+    cxml_root_node *root = cxml_load_string(wf_xml_6);
+    cxml_assert__not_null(root)
+    cxml_assert__null(root->index)
+    cxml_node_index *index = cxml_index_document(root);
+    cxml_assert__not_null(index)
+    // building again returns the same index
+    cxml_assert__eq(cxml_index_document(root), index)
+    // root, noodles, indomie, seasoning, maggi, br, mr-chef, super-pack, others
+    cxml_assert__eq(index->size, 9)
+    cxml_assert__eq(index->nodes[0], root)
+    cxml_assert__eq(index->end[0], 8)
+    cxml_assert__eq(index->parent[0], -1)
+    // noodles
+    cxml_assert__eq(index->end[1], 8)
+    cxml_assert__eq(index->parent[1], 0)
+    // seasoning
+    cxml_assert__eq(index->end[3], 6)
+    cxml_assert__eq(index->parent[3], 1)
+    // br
+    cxml_assert__eq(index->end[5], 5)
+    cxml_assert__eq(index->parent[5], 3)
+    // others
+    cxml_assert__eq(index->parent[8], 1)
+    // parsed documents are located by position
+    cxml_assert__null(index->by_node)
+    for (int i = 1; i < index->size; i++){
+        cxml_assert__gt(index->pos[i], index->pos[i - 1])
+    }
+    cxml_assert__null(cxml_index_document(NULL))
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test_cxml_index_find(){
+    cxml_root_node *root = cxml_load_string(wf_xml_09);
+    cxml_assert__not_null(root)
+    cxml_node_index *index = cxml_index_document(root);
+    for (int i = 0; i < index->size; i++){
+        cxml_assert__eq(cxml_index_find(index, index->nodes[i]), i)
+    }
+    // attributes aren't indexed
+    cxml_elem_node *fruit = index->nodes[1];
+    cxml_assert__eq(cxml_index_find(index, cxml_table_get(fruit->attributes, "a")), -1)
+    cxml_assert__eq(cxml_index_find(NULL, fruit), -1)
+    cxml_assert__eq(cxml_index_find(index, NULL), -1)
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test_cxml_index_is_ancestor(){
+    cxml_root_node *root = cxml_load_string(wf_xml_6);
+    cxml_assert__not_null(root)
+    cxml_node_index *index = cxml_index_document(root);
+    // root -> everything
+    for (int i = 1; i < index->size; i++){
+        cxml_assert__true(cxml_index_is_ancestor(index, 0, i))
+        cxml_assert__false(cxml_index_is_ancestor(index, i, 0))
+    }
+    // seasoning -> br
+    cxml_assert__true(cxml_index_is_ancestor(index, 3, 5))
+    // seasoning -/-> super-pack
+    cxml_assert__false(cxml_index_is_ancestor(index, 3, 7))
+    // not ancestor of self
+    cxml_assert__false(cxml_index_is_ancestor(index, 3, 3))
+    cxml_assert__false(cxml_index_is_ancestor(index, -1, 3))
+    cxml_assert__false(cxml_index_is_ancestor(NULL, 0, 3))
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test__cxml_index_get(){
+    cxml_root_node *root = cxml_load_string(wf_xml_7);
+    cxml_assert__not_null(root)
+    cxml_assert__null(_cxml_index_get(root->root_element))
+    cxml_node_index *index = cxml_index_document(root);
+    cxml_assert__eq(_cxml_index_get(root), index)
+    cxml_assert__eq(_cxml_index_get(index->nodes[index->size - 1]), index)
+    cxml_assert__null(_cxml_index_get(NULL))
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test__cxml_index_invalidate(){
+    cxml_root_node *root = cxml_load_string(wf_xml_7);
+    cxml_assert__not_null(root)
+    cxml_node_index *index = cxml_index_document(root);
+    cxml_assert__not_null(index)
+    _cxml_index_invalidate(index->nodes[index->size - 1]);
+    cxml_assert__null(root->index)
+    // no-op
+    _cxml_index_invalidate(root);
+    _cxml_index_invalidate(NULL);
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test_cxml_index_unordered(){
+    // nodes created outside the parser have no position,
+    // they're located by address, and left as they are
+    cxml_root_node *root = ALLOC(cxml_root_node, 1);
+    cxml_elem_node *elem = ALLOC(cxml_elem_node, 1);
+    cxml_text_node *text = ALLOC(cxml_text_node, 1);
+    cxml_comm_node *comm = ALLOC(cxml_comm_node, 1);
+    cxml_root_node_init(root);
+    cxml_elem_node_init(elem);
+    cxml_text_node_init(text);
+    cxml_comm_node_init(comm);
+    cxml_list_append(&root->children, elem);
+    cxml_list_append(&elem->children, text);
+    cxml_list_append(&elem->children, comm);
+    elem->parent = root;
+    text->parent = elem;
+    comm->parent = elem;
+
+    cxml_node_index *index = cxml_index_document(root);
+    cxml_assert__eq(index->size, 4)
+    cxml_assert__not_null(index->by_node)
+    cxml_assert__zero(elem->pos)
+    cxml_assert__zero(text->pos)
+    cxml_assert__zero(comm->pos)
+    cxml_assert__zero(cxml_index_find(index, root))
+    cxml_assert__one(cxml_index_find(index, elem))
+    cxml_assert__two(cxml_index_find(index, text))
+    cxml_assert__eq(cxml_index_find(index, comm), 3)
+    cxml_assert__eq(index->end[1], 3)
+    cxml_destroy(root);
+
+    // nodes whose positions are out of document order
+    root = cxml_load_string(wf_xml_6);
+    cxml_assert__not_null(root)
+    cxml_elem_node *noodles = root->root_element;
+    void *others = cxml_list_last(&noodles->children);
+    cxml_list_delete(&noodles->children, true);
+    cxml_list_insert(&noodles->children, others, true);
+    index = cxml_index_document(root);
+    cxml_assert__not_null(index->by_node)
+    for (int i = 0; i < index->size; i++){
+        cxml_assert__eq(cxml_index_find(index, index->nodes[i]), i)
+    }
+    cxml_assert__gt(_cxml_get_node_pos(index->nodes[2]), _cxml_get_node_pos(index->nodes[3]))
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+void suite_cxindex(){
+    cxml_suite(cxindex)
+    {
+        cxml_add_m_test(6,
+                        test_cxml_index_document,
+                        test_cxml_index_find,
+                        test_cxml_index_is_ancestor,
+                        test__cxml_index_get,
+                        test__cxml_index_invalidate,
+                        test_cxml_index_unordered
+                        )
+        cxml_run_suite()
+    }
+}
@@ -154,6 +154,50 @@ cts test_cxml_literal_to_num(){
     cxml_assert__eq(number.type, CXML_NUMERIC_DOUBLE_T)
     cxml_string_free(&str);
 
+    str = new_cxml_string_s("12e");
+    number = cxml_literal_to_num(&str);
+    cxml_assert__eq(number.type, CXML_NUMERIC_NAN_T)
+    cxml_string_free(&str);
+
+    str = new_cxml_string_s(".");
+    number = cxml_literal_to_num(&str);
+    cxml_assert__eq(number.type, CXML_NUMERIC_NAN_T)
+    cxml_string_free(&str);
+
+    str = new_cxml_string_s("");
+    number = cxml_literal_to_num(&str);
+    cxml_assert__eq(number.type, CXML_NUMERIC_NAN_T)
+    cxml_string_free(&str);
+
+    cxml_pass()
+}
+
+cts test_cxml_literal_to_num_conversion(){
+    // values must be bit-for-bit equal to the (correctly rounded) compiler conversions,
+    // both for the exact (table) path and the fallback path.
+    char *literals[] = {
+            "0.1", "-2.5e-3", "  3.14159  ", "1e22", "1e23", "123456789012345678901234",
+            "0.000000000000000000000000000001", "9007199254740993", "-0.0", "1.7976931348623157e308",
+            "4.9e-324", "2.2250738585072014e-308", "00000000000000000000000000001.5", "1.", ".5e1"
+    };
+    double values[] = {
+            0.1, -2.5e-3, 3.14159, 1e22, 1e23, 123456789012345678901234.0,
+            0.000000000000000000000000000001, 9007199254740993.0, -0.0, 1.7976931348623157e308,
+            4.9e-324, 2.2250738585072014e-308, 1.5, 1.0, 5.0
+    };
+    cxml_string str;
+    cxml_number number;
+    for (int i = 0; i < 15; i++){
+        str = new_cxml_string_s(literals[i]);
+        number = cxml_literal_to_num(&str);
+        cxml_assert__eq(number.type, CXML_NUMERIC_DOUBLE_T)
+        cxml_assert__zero(memcmp(&number.dec_val, &values[i], sizeof(double)))
+        cxml_string_free(&str);
+    }
+    str = new_cxml_string_s("-0x1F");
+    number = cxml_literal_to_num(&str);
+    cxml_assert__eq(number.dec_val, -31)
+    cxml_string_free(&str);
     cxml_pass()
 }
 
@@ -283,7 +327,7 @@ cts test_cxml_number_is_not_equal(){
 void suite_cxliteral(){
     cxml_suite(cxliteral)
     {
-        cxml_add_m_test(13,
+        cxml_add_m_test(14,
                         test_cxml_number_init,
                         test_new_cxml_number,
                         test_cxml_literal_to_long,
@@ -292,6 +336,7 @@ void suite_cxliteral(){
                         test__cxml_is_integer,
                         test__cxml_is_double,
                         test_cxml_literal_to_num,
+                        test_cxml_literal_to_num_conversion,
                         test_cxml_number_is_d_equal,
                         test_cxml_number_is_equal,
                         test_cxml_number_is_greater,
@@ -599,6 +599,14 @@ cts test_cxml_string_mb_strstr(){
     cxml_assert__null(cxml_string_mb_strstr(&str, NULL))
     cxml_assert__null(cxml_string_mb_strstr(&str, "शुरू"))
     cxml_string_free(&str);
+    // only the characters of the string are searched, not the bytes left past its end
+    d = "इस नए साल शुरू";
+    str = new_cxml_string();
+    cxml_string_append(&str, d, (unsigned)strlen(d));
+    str._len -= (unsigned)strlen("शुरू");
+    cxml_assert__null(cxml_string_mb_strstr(&str, "शुरू"))
+    cxml_assert__not_null(cxml_string_mb_strstr(&str, "साल"))
+    cxml_string_free(&str);
     cxml_pass()
 }
 
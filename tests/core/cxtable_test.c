@@ -440,10 +440,34 @@ cts test_cxml_table_size(){
     cxml_pass()
 }
 
+cts test_cxml_table_for_each(){
+    cxml_table table = new_cxml_table();
+    char *keys[] = {"k", "j", "i", "h", "g", "f", "e", "d", "c", "b", "a"};
+    for (int i = 0; i < 11; i++){
+        cxml_table_put(&table, keys[i], keys[i]);
+    }
+    // insertion order survives the rehash
+    int i = 0;
+    cxml_table_for_each(entry, &table) {
+        cxml_assert__zero(strcmp(entry->value, keys[i++]))
+    }
+    cxml_assert__eq(i, 11)
+    cxml_table_remove(&table, "k");
+    cxml_table_remove(&table, "f");
+    char *left[] = {"j", "i", "h", "g", "e", "d", "c", "b", "a"};
+    i = 0;
+    cxml_table_for_each(_entry, &table) {
+        cxml_assert__zero(strcmp(_entry->value, left[i++]))
+    }
+    cxml_assert__eq(i, 9)
+    cxml_table_free(&table);
+    cxml_pass()
+}
+
 void suite_cxtable(){
     cxml_suite(cxtable)
     {
-        cxml_add_m_test(12,
+        cxml_add_m_test(13,
                         test_cxml_table_free,
                         test_new_cxml_table,
                         test_new_alloc_cxml_table,
@@ -455,7 +479,8 @@ void suite_cxtable(){
                         test_cxml_table_get,
                         test_cxml_table_get_raw,
                         test_cxml_table_is_empty,
-                        test_cxml_table_size
+                        test_cxml_table_size,
+                        test_cxml_table_for_each
                 )
         cxml_run_suite()
     }
@@ -103,10 +103,12 @@ int name_asserts(
         const char *qname)
 {
     if (pname){
-        cxml_assert__zero(strncmp(name->pname, pname, name->pname_len))
+        cxml_assert__zero(strncmp(cxml_string_as_raw(&name->qname), pname, name->pname_len))
     }
     if (lname){
-        cxml_assert__zero(strncmp(name->lname, lname, name->lname_len))
+        cxml_assert__zero(strncmp(cxml_string_as_raw(&name->qname)
+                                  + (name->pname_len ? name->pname_len + 1 : 0),
+                                  lname, name->lname_len))
     }
     if (qname){
         cxml_assert__true(cxml_string_raw_equals(&name->qname, qname))
@@ -155,6 +157,192 @@ cts test_cxml_find_all(){
     cxml_pass()
 }
 
+cts test_cxml_find_iter(){
+    deb()
+    cxml_root_node *root = get_root("wf_xml_2.xml", true);
+    cxml_assert__not_null(root)
+    cxml_list list = new_cxml_list();
+    cxml_find_all(root, "<term>/$text/", &list);
+    cxml_assert__eq(cxml_list_size(&list), 4)
+
+    // the cursor produces the nodes cxml_find_all() accumulates, in the same order
+    cxml_find_iter iter;
+    cxml_find_iter_init(&iter, root, "<term>/$text/", 0, 0);
+    int i = 0;
+    void *node;
+    while ((node = cxml_find_iter_next(&iter))){
+        cxml_assert__eq(node, cxml_list_get(&list, i++))
+    }
+    cxml_assert__eq(i, 4)
+    cxml_assert__null(cxml_find_iter_next(&iter))
+    cxml_find_iter_free(&iter);
+
+    // pages
+    cxml_find_iter_init(&iter, root, "<term>/$text/", 1, 2);
+    cxml_assert__eq(cxml_find_iter_next(&iter), cxml_list_get(&list, 1))
+    cxml_assert__eq(cxml_find_iter_next(&iter), cxml_list_get(&list, 2))
+    cxml_assert__null(cxml_find_iter_next(&iter))
+    cxml_find_iter_free(&iter);
+    cxml_find_iter_init(&iter, root, "<term>/$text/", 4, 0);
+    cxml_assert__null(cxml_find_iter_next(&iter))
+    cxml_find_iter_free(&iter);
+
+    cxml_find_iter_init(&iter, NULL, "<term>/$text/", 0, 0);
+    cxml_assert__null(cxml_find_iter_next(&iter))
+    cxml_find_iter_free(&iter);
+    cxml_find_iter_init(&iter, root, NULL, 0, 0);
+    cxml_assert__null(cxml_find_iter_next(&iter))
+    cxml_find_iter_free(&iter);
+    cxml_list_free(&list);
+
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test_cxml_find_all_many(){
+    deb()
+    cxml_root_node *root = get_root("wf_xml_2.xml", true);
+    cxml_assert__not_null(root)
+    const char *queries[] = {"<term>/$text/", "<relationship>/", "<synonym>/", "<term>/$text='successful'/"};
+    cxml_list lists[4], accs[4];
+    for (int i = 0; i < 4; i++){
+        lists[i] = new_cxml_list();
+        accs[i] = new_cxml_list();
+        cxml_find_all(root, queries[i], &lists[i]);
+    }
+    // the lists cxml_find_all() accumulates, in a single walk
+    cxml_find_all_many(root, queries, 4, accs);
+    for (int i = 0; i < 4; i++){
+        cxml_assert__eq(cxml_list_size(&accs[i]), cxml_list_size(&lists[i]))
+        for (int j = 0; j < cxml_list_size(&lists[i]); j++){
+            cxml_assert__eq(cxml_list_get(&accs[i], j), cxml_list_get(&lists[i], j))
+        }
+        cxml_list_free(&accs[i]);
+    }
+    cxml_assert__eq(cxml_list_size(&lists[3]), 2)
+
+    // incrementally, through a cursor: nodes matching any query, in document order
+    cxml_find_iter iter;
+    cxml_find_many_iter_init(&iter, root, queries, 4, 0, 0);
+    cxml_assert__eq(cxml_find_iter_next(&iter), cxml_list_get(&lists[0], 0))
+    cxml_assert__zero(iter.match)
+    cxml_assert__eq(cxml_find_iter_next(&iter), cxml_list_get(&lists[2], 0))
+    cxml_assert__eq(iter.match, 2)
+    cxml_assert__eq(cxml_find_iter_collect(&iter, accs, 2), 2)
+    cxml_assert__eq(cxml_list_get(&accs[0], 0), cxml_list_get(&lists[0], 1))
+    cxml_assert__eq(cxml_list_get(&accs[1], 0), cxml_list_get(&lists[1], 0))
+    cxml_assert__zero(cxml_list_size(&accs[3]))
+    // the rest
+    cxml_assert__eq(cxml_find_iter_collect(&iter, accs, 0), 4)
+    cxml_assert__eq(cxml_list_size(&accs[0]), 3)
+    cxml_assert__eq(cxml_list_size(&accs[1]), 2)
+    cxml_assert__eq(cxml_list_size(&accs[2]), 1)
+    cxml_assert__eq(cxml_list_size(&accs[3]), 1)
+    cxml_assert__null(cxml_find_iter_next(&iter))
+    cxml_assert__zero(cxml_find_iter_collect(&iter, accs, 0))
+    cxml_find_iter_free(&iter);
+
+    cxml_find_many_iter_init(&iter, root, queries, 4, 8, 0);
+    cxml_assert__null(cxml_find_iter_next(&iter))
+    cxml_find_iter_free(&iter);
+    cxml_find_many_iter_init(&iter, root, queries, 0, 0, 0);
+    cxml_assert__null(cxml_find_iter_next(&iter))
+    cxml_find_iter_free(&iter);
+    cxml_find_all_many(NULL, queries, 4, accs);
+    cxml_assert__eq(cxml_list_size(&accs[2]), 1)
+    for (int i = 0; i < 4; i++){
+        cxml_list_free(&accs[i]);
+        cxml_list_free(&lists[i]);
+    }
+
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test_cxml_find_all_partial(){
+    deb()
+    cxml_root_node *root = cxml_load_string(
+            "<r><a k='aaab' v='x'>abcabd<!--nananab--></a><a k='aab'>ab</a>"
+            "<a v='b'><!--b--></a><a>aaa</a></r>");
+    cxml_assert__not_null(root)
+    cxml_list list = new_cxml_list();
+    // partial searches, with overlapping candidates
+    cxml_find_all(root, "<a>/k|='aab'/", &list);
+    cxml_assert__eq(cxml_list_size(&list), 2)
+    cxml_list_free(&list);
+    cxml_find_all(root, "<a>/k|='aaaab'/", &list);
+    cxml_assert__zero(cxml_list_size(&list))
+    cxml_find_all(root, "<a>/$text|='cabd'/", &list);
+    cxml_assert__one(cxml_list_size(&list))
+    cxml_list_free(&list);
+    cxml_find_all(root, "<a>/$text|='b'/", &list);
+    cxml_assert__eq(cxml_list_size(&list), 2)
+    cxml_list_free(&list);
+    cxml_find_all(root, "<a>/#comment|='anab'/", &list);
+    cxml_assert__one(cxml_list_size(&list))
+    cxml_list_free(&list);
+    cxml_find_all(root, "<a>/k|=''/", &list);
+    cxml_assert__eq(cxml_list_size(&list), 2)
+    cxml_list_free(&list);
+    // sub-expressions of any cost, in any order
+    cxml_find_all(root, "<a>/$text|='ab'/k='aab'/@k/", &list);
+    cxml_assert__one(cxml_list_size(&list))
+    cxml_assert__eq(cxml_list_get(&list, 0), cxml_find(root, "<a>/k='aab'/"))
+    cxml_list_free(&list);
+    cxml_find_all(root, "<a>/#comment/[v='b']/", &list);
+    cxml_assert__eq(cxml_list_size(&list), 2)
+    cxml_list_free(&list);
+    // elements satisfying the rigid sub-expressions, or else an optional one
+    cxml_find_all(root, "<a>/@v/[$text|='aa']/[#comment='b']/", &list);
+    cxml_assert__eq(cxml_list_size(&list), 3)
+    cxml_list_free(&list);
+    cxml_find_all(root, "<a>/@z/[k|='ab']/[v|='z']/", &list);
+    cxml_assert__eq(cxml_list_size(&list), 2)
+    cxml_list_free(&list);
+
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test_cxml_frozen_find_all(){
+    deb()
+    cxml_root_node *root = cxml_load_string(
+            "<r><a k='aaab' v='x'>abcabd<!--nananab--></a><a k='aab'>ab</a>"
+            "<a v='b'><!--b--></a><a>aaa</a><b k='aab'/></r>");
+    cxml_assert__not_null(root)
+    cxml_frozen_doc *doc = cxml_freeze(root);
+    cxml_assert__not_null(doc)
+    // frozen nodes are indexed in pre-order, after the root
+    cxml_list nodes = new_cxml_list();
+    cxml_descendants(root, &nodes);
+    const char *queries[] = {
+            "<a>/", "<a>/k|='aab'/", "<a>/$text|='cabd'/", "<a>/#comment='b'/",
+            "<a>/@v/[$text|='aa']/[#comment='b']/", "<a>/@z/[k|='ab']/[v|='z']/",
+            "<b>/k='aab'/", "<a>/@zz/", "<zz>/"
+    };
+    cxml_list list = new_cxml_list();
+    cxml_frozen_set set;
+    cxml_frozen_set_init(&set);
+    for (int i = 0; i < 9; i++){
+        // the nodes cxml_find_all() accumulates, in the same order
+        cxml_find_all(root, queries[i], &list);
+        cxml_frozen_find_all(doc, queries[i], &set);
+        cxml_assert__eq(set.size, cxml_list_size(&list))
+        for (int j = 0; j < set.size; j++){
+            cxml_assert__eq(cxml_list_get(&nodes, set.nodes[j] - 1), cxml_list_get(&list, j))
+        }
+        cxml_list_free(&list);
+        cxml_frozen_set_free(&set);
+    }
+    cxml_frozen_find_all(doc, "<a>/", &set);
+    cxml_assert__eq(set.size, 4)
+    cxml_frozen_set_free(&set);
+    cxml_list_free(&nodes);
+    cxml_frozen_free(doc);
+    cxml_destroy(root);
+    cxml_pass()
+}
+
 cts test_cxml_find_children(){
     deb()
     cxml_root_node *root = get_root("wf_xml_2.xml", true);
@@ -545,6 +733,36 @@ cts test_cxml_descendants(){
     cxml_pass()
 }
 
+cts test_cxml_descendants_indexed(){
+    deb()
+    cxml_root_node *root = cxml_load_string(wf_xml_6);
+    cxml_assert__not_null(root)
+    cxml_assert__not_null(cxml_index_document(root))
+    cxml_element_node *elem = cxml_find(root, "<seasoning>/");
+    cxml_assert__not_null(elem)
+
+    cxml_list descendants = new_cxml_list();
+    cxml_descendants(elem, &descendants);
+    cxml_assert__eq(cxml_list_size(&descendants), 3)
+    cxml_list_free(&descendants);
+
+    // modifying the document's structure discards its index
+    cxml_assert__one(cxml_add_child(elem, cxml_create_node(CXML_COMM_NODE)))
+    cxml_assert__null(root->index)
+    cxml_descendants(elem, &descendants);
+    cxml_assert__eq(cxml_list_size(&descendants), 4)
+    cxml_list_free(&descendants);
+
+    cxml_assert__not_null(cxml_index_document(root))
+    cxml_descendants(elem, &descendants);
+    cxml_assert__eq(cxml_list_size(&descendants), 4)
+    cxml_assert__eq(cxml_get_node_type(cxml_list_get(&descendants, 3)), CXML_COMM_NODE)
+    cxml_list_free(&descendants);
+
+    cxml_destroy(root);
+    cxml_pass()
+}
+
 cts test_cxml_find_descendants(){
     deb()
     cxml_root_node *root = cxml_load_string(wf_xml_6);
@@ -583,6 +801,43 @@ cts test_cxml_find_descendants(){
     cxml_pass()
 }
 
+cts test_cxml_find_descendants_iter(){
+    deb()
+    cxml_root_node *root = cxml_load_string(wf_xml_6);
+    cxml_assert__not_null(root)
+    cxml_list descendants = new_cxml_list();
+    cxml_find_descendants(root, "<noodles>/", &descendants);
+    cxml_assert__eq(cxml_list_size(&descendants), 7)
+
+    cxml_find_iter iter;
+    void *node;
+    int i;
+    // walking the document, then reading the descendants off the document's index
+    for (int indexed = 0; indexed < 2; indexed++){
+        if (indexed) cxml_assert__not_null(cxml_index_document(root))
+        cxml_find_descendants_iter_init(&iter, root, "<noodles>/", 0, 0);
+        i = 0;
+        while ((node = cxml_find_iter_next(&iter))){
+            cxml_assert__eq(node, cxml_list_get(&descendants, i++))
+        }
+        cxml_assert__eq(i, 7)
+        cxml_find_iter_free(&iter);
+
+        cxml_find_descendants_iter_init(&iter, root, "<noodles>/", 5, 3);
+        cxml_assert__eq(cxml_find_iter_next(&iter), cxml_list_get(&descendants, 5))
+        cxml_assert__eq(cxml_find_iter_next(&iter), cxml_list_get(&descendants, 6))
+        cxml_assert__null(cxml_find_iter_next(&iter))
+        cxml_find_iter_free(&iter);
+    }
+    cxml_find_descendants_iter_init(&iter, root, "<foobar>/", 0, 0);
+    cxml_assert__null(cxml_find_iter_next(&iter))
+    cxml_find_iter_free(&iter);
+    cxml_list_free(&descendants);
+
+    cxml_destroy(root);
+    cxml_pass()
+}
+
 cts test_cxml_next_sibling(){
     deb()
     cxml_root_node *root = cxml_load_string(wf_xml_7);
@@ -785,7 +1040,7 @@ cts test_cxml_attributes(){
     {
         cxml_assert__one(name_asserts(&((cxml_attribute_node*)attr)->name, NULL, attr_names[i], attr_names[i]))
         cxml_assert__true(cxml_string_raw_equals(&((cxml_attribute_node *) attr)->value, attr_values[i]))
-        cxml_assert__eq(((cxml_attribute_node*)attr)->number_value.dec_val, attr_num_values[i])
+        cxml_assert__eq(cxml_get_number(attr), attr_num_values[i])
         i++;
     }
 
@@ -819,7 +1074,7 @@ cts test_cxml_find_attributes(){
     {
         cxml_assert__one(name_asserts(&((cxml_attribute_node*)attr)->name, NULL, attr_names[i], attr_names[i]))
         cxml_assert__true(cxml_string_raw_equals(&((cxml_attribute_node *) attr)->value, attr_values[i]))
-        cxml_assert__eq(((cxml_attribute_node*)attr)->number_value.dec_val, attr_num_values[i])
+        cxml_assert__eq(cxml_get_number(attr), attr_num_values[i])
         i++;
     }
 
@@ -1123,7 +1378,7 @@ cts test_cxml_add_child(){
     cxml_set_text_value(text, "this is some text", false);
     cxml_assert__true(cxml_add_child(elem, text))
     cxml_assert__not_null(text->parent)
-    cxml_assert__zero(text->number_value.dec_val)
+    cxml_assert__zero(cxml_get_number(text))
     cxml_assert__eq(text->parent, elem)
     cxml_assert__true(elem->has_child)
     cxml_assert__true(elem->has_text)
@@ -1301,7 +1556,7 @@ cts test_cxml_set_attribute_value(){
     cxml_string_free(&attr->value);
 
     cxml_assert__true(cxml_set_attribute_value(attr, "0xfeedbac"))
-    cxml_assert__eq(attr->number_value.dec_val, 0xfeedbac)
+    cxml_assert__eq(cxml_get_number(attr), 0xfeedbac)
 
     cxml_assert__false(cxml_set_attribute_value(attr, NULL))
     cxml_assert__false(cxml_set_attribute_value(NULL, "sweet"))
@@ -1360,7 +1615,7 @@ cts test_cxml_set_text_value(){
     cxml_assert__true(cxml_set_text_value(text, "this is some <![CDATA[stuffy]]>", true))
     cxml_assert__true(cxml_string_raw_equals(&text->value, "this is some <![CDATA[stuffy]]>"))
     cxml_assert__true(cxml_set_text_value(text, " 12356\r ", false))
-    cxml_assert__eq(text->number_value.dec_val, 12356)
+    cxml_assert__eq(cxml_get_number(text), 12356)
     cxml_assert__false(cxml_set_text_value(NULL, "this is some text", false))
     cxml_assert__false(cxml_set_text_value(text, NULL, false))
     cxml_destroy(text);
@@ -2892,8 +3147,17 @@ cts test_cxml_get_number(){
 
     cxml_text_node *text = cxml_create_node(CXML_TEXT_NODE);
     cxml_set_text_value(text, "0x100", false);
+    // the number value is computed on first use
+    cxml_assert__eq(text->number_value.type, CXML_NUMERIC_UNSET_T)
     n = cxml_get_number(text);
     cxml_assert__eq(n, 0x100)
+    cxml_assert__eq(text->number_value.type, CXML_NUMERIC_DOUBLE_T)
+    // and recomputed when the value changes
+    cxml_set_text_value(text, "2.5", false);
+    cxml_assert__eq(cxml_get_number(text), 2.5)
+    cxml_set_text_value(text, "abc", false);
+    cxml_assert__zero(cxml_get_number(text))
+    cxml_assert__eq(text->number_value.type, CXML_NUMERIC_NAN_T)
 
     cxml_element_node *elem = cxml_create_node(CXML_ELEM_NODE);
     cxml_assert__zero(cxml_get_number(elem))
@@ -2905,13 +3169,32 @@ cts test_cxml_get_number(){
     cxml_pass()
 }
 
+cts test_cxml_find_budget(){
+    cxml_root_node *root = get_root("wf_xml_2.xml", true);
+    cxml_assert__not_null(root)
+    cxml_budget budget;
+    cxml_budget_init(&budget);
+    budget.max_visits = 3;
+    cxml_budget_set(&budget);
+    cxml_list list = new_cxml_list();
+    cxml_find_all(root, "<term>/", &list);
+    cxml_assert__eq(budget.status, CXML_BUDGET_VISITS_EXCEEDED)
+    cxml_assert__eq(budget.visits, 4)
+    cxml_list_free(&list);
+    cxml_budget_set(NULL);
+    cxml_find_all(root, "<term>/", &list);
+    cxml_assert__eq(cxml_list_size(&list), 4)
+    cxml_list_free(&list);
+    cxml_destroy(root);
+    cxml_pass()
+}
 
 void suite_cxqapi(){
     cxml_suite(cxqapi)
     {
         cxml_add_test_setup(fixture_no_fancy_printing_and_warnings)
         cxml_add_test_teardown(fixture_no_fancy_printing_and_warnings)
-        cxml_add_m_test(95,
+        cxml_add_m_test(100,
                         test_cxml_is_well_formed,
                         test_cxml_get_node_type,
                         test_cxml_get_dtd_node,
@@ -2919,6 +3202,10 @@ void suite_cxqapi(){
                         test_cxml_get_root_element,
                         test_cxml_find,
                         test_cxml_find_all,
+                        test_cxml_find_iter,
+                        test_cxml_find_all_many,
+                        test_cxml_find_all_partial,
+                        test_cxml_frozen_find_all,
                         test_cxml_find_children,
                         test_cxml_children,
                         test_cxml_next_element,
@@ -2934,7 +3221,9 @@ void suite_cxqapi(){
                         test_cxml_ancestors,
                         test_cxml_find_ancestors,
                         test_cxml_descendants,
+                        test_cxml_descendants_indexed,
                         test_cxml_find_descendants,
+                        test_cxml_find_descendants_iter,
                         test_cxml_next_sibling,
                         test_cxml_previous_sibling,
                         test_cxml_find_next_sibling,
@@ -3006,7 +3295,8 @@ void suite_cxqapi(){
                         test_cxml_delete_document,
                         test_cxml_delete,
                         test_cxml_clear,
-                        test_cxml_get_number
+                        test_cxml_get_number,
+                        test_cxml_find_budget
         )
         cxml_run_suite()
     }
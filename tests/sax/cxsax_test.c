@@ -278,7 +278,7 @@ cts test_cxml_sax_as_attribute_list(){
         attr = n;
         cxml_assert__true(cxml_string_raw_equals(&attr->name.qname, keys[i]))
         cxml_assert__true(cxml_string_raw_equals(&attr->value, values[i]))
-        cxml_assert__eq(attr->number_value.dec_val, num[i])
+        cxml_assert__eq(_cxml_get_node_number(attr)->dec_val, num[i])
         cxml_free_attribute_node(attr);
         i++;
     }
@@ -320,7 +320,7 @@ cts test_cxml_sax_as_attribute_node(){
         attr = n;
         cxml_assert__true(cxml_string_raw_equals(&attr->name.qname, keys[i]))
         cxml_assert__true(cxml_string_raw_equals(&attr->value, values[i]))
-        cxml_assert__eq(attr->number_value.dec_val, num[i])
+        cxml_assert__eq(_cxml_get_node_number(attr)->dec_val, num[i])
         cxml_free_attribute_node(attr);
         i++;
     }
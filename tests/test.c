@@ -18,9 +18,14 @@ extern void suite_cxlrucache();
 extern void suite_cxliteral();
 extern void suite_cxmem();
 extern void suite_cxdefs();
+extern void suite_cxindex();
+extern void suite_cxfrozen();
+extern void suite_cxarena();
+extern void suite_cxbudget();
 extern void suite_cxqapi();
 extern void suite_cxsax();
 extern void suite_cxutils();
+extern void suite_cxutf8hook();
 extern void suite_cxlexer();
 extern void suite_cxparser();
 extern void suite_cxxpath();
@@ -51,10 +56,18 @@ void super_suite_internals(){
     suite_cxmem();
     // cxdefs.c module test suite
     suite_cxdefs();
+    // cxindex.c module test suite
+    suite_cxindex();
+    // cxfrozen.c module test suite
+    suite_cxfrozen();
+    // cxarena.c module test suite
+    suite_cxarena();
+    suite_cxbudget();
 }
 
 void super_suite_utils(){
     suite_cxutils();
+    suite_cxutf8hook();
 }
 
 void super_suite_xml(){
@@ -0,0 +1,132 @@
+/*
+ * Copyright © 2021 Jeremiah Ikosin
+ * Distributed under the terms of the MIT license.
+ */
+
+#include "cxfixture.h"
+#include "utils/cxutf8hook.h"
+
+cts test_u8_validate(){
+    size_t valid_len = 0;
+    char *d = "इस नए साल खुशियों की बरसातें हों";
+    cxml_assert__true(u8_validate(d, strlen(d), &valid_len))
+    cxml_assert__eq(valid_len, strlen(d))
+    cxml_assert__true(u8_validate("plain ascii text, longer than a word", 36, NULL))
+    cxml_assert__true(u8_validate("", 0, NULL))
+    cxml_assert__true(u8_validate("\xF0\x9F\x8E\x89", 4, NULL))
+    // overlong
+    cxml_assert__false(u8_validate("abc\xC0\x80", 5, &valid_len))
+    cxml_assert__eq(valid_len, 3)
+    cxml_assert__false(u8_validate("\xE0\x80\xAF", 3, NULL))
+    // surrogate
+    cxml_assert__false(u8_validate("\xED\xA0\x80", 3, NULL))
+    // > U+10FFFF
+    cxml_assert__false(u8_validate("\xF4\x90\x80\x80", 4, NULL))
+    // stray continuation byte after an ascii run
+    cxml_assert__false(u8_validate("0123456789abcdef\x80", 17, &valid_len))
+    cxml_assert__eq(valid_len, 16)
+    // truncated
+    cxml_assert__false(u8_validate("ab\xE0\xA4", 4, &valid_len))
+    cxml_assert__two(valid_len)
+    cxml_pass()
+}
+
+cts test_u8_is_partial(){
+    cxml_assert__true(u8_is_partial("\xE0\xA4", 2))
+    cxml_assert__true(u8_is_partial("\xF0", 1))
+    cxml_assert__false(u8_is_partial("\xE0\xA4\xB8", 3))
+    cxml_assert__false(u8_is_partial("\xE0\x41", 2))
+    cxml_assert__false(u8_is_partial("a", 1))
+    cxml_assert__false(u8_is_partial("", 0))
+    cxml_pass()
+}
+
+cts test_u8_count(){
+    char *d = "इस नए साल खुशियों की बरसातें हों";
+    cxml_assert__eq(u8_count(d, strlen(d)), 32)
+    cxml_assert__eq(u8_count("Ģğhķăls åâv än băåå", strlen("Ģğhķăls åâv än băåå")), 19)
+    cxml_assert__eq(u8_count("abcdefghijk", 11), 11)
+    cxml_assert__zero(u8_count("", 0))
+    cxml_assert__eq(u8_strlen(d), 32)
+    cxml_pass()
+}
+
+cts test_u8_offset_n(){
+    char *d = "abcdefgh इस नए साल";
+    size_t len = strlen(d);
+    cxml_assert__zero(u8_offset_n(d, len, 0))
+    cxml_assert__eq(u8_offset_n(d, len, 8), 8)
+    // each devanagari character here is 3 bytes
+    cxml_assert__eq(u8_offset_n(d, len, 10), 12)
+    cxml_assert__eq(u8_offset_n(d, len, 12), 16)
+    cxml_assert__eq(u8_offset_n(d, len, 100), len)
+    cxml_assert__eq(u8_offset_n(d, len, 10), (size_t)u8_offset(d, 10))
+    cxml_pass()
+}
+
+cts test_u8_strchr(){
+    char *d = "Ģğhķăls åâv än băåå";
+    int charn;
+    cxml_assert__not_null(u8_strchr(d, L'å', &charn))
+    cxml_assert__eq(charn, 8)
+    cxml_assert__true(u8_strchr(d, L'b', &charn) == strchr(d, 'b'))
+    cxml_assert__eq(charn, 15)
+    cxml_assert__null(u8_strchr(d, L'z', &charn))
+    cxml_assert__null(u8_strchr(d, 0, &charn))
+    cxml_pass()
+}
+
+cts test_u8_from_latin1(){
+    char dest[64];
+    size_t n = u8_from_latin1(dest, "gar\xE7on, \xD8l og \xE6" "bler", 18);
+    cxml_assert__eq(n, 21)
+    cxml_assert__zero(memcmp(dest, "garçon, Øl og æbler", n))
+    cxml_assert__eq(u8_from_latin1(dest, "plain ascii text", 16), 16)
+    cxml_assert__zero(u8_from_latin1(dest, "", 0))
+    cxml_pass()
+}
+
+cts test_u8_from_utf16(){
+    char dest[64];
+    size_t consumed;
+    // "a€b😀" in utf-16le and utf-16be
+    char le[] = {'a', 0, '\xAC', ' ', 'b', 0, '\x3D', '\xD8', '\x00', '\xDE'};
+    char be[] = {0, 'a', ' ', '\xAC', 0, 'b', '\xD8', '\x3D', '\xDE', '\x00'};
+    size_t n = u8_from_utf16(dest, le, 10, false, false, &consumed);
+    cxml_assert__eq(consumed, 10)
+    cxml_assert__eq(n, 9)
+    cxml_assert__zero(memcmp(dest, "a€b😀", n))
+    n = u8_from_utf16(dest, be, 10, true, false, &consumed);
+    cxml_assert__eq(n, 9)
+    cxml_assert__zero(memcmp(dest, "a€b😀", n))
+    // a surrogate pair cut short is left for the next call
+    n = u8_from_utf16(dest, le, 8, false, false, &consumed);
+    cxml_assert__eq(consumed, 6)
+    cxml_assert__eq(n, 5)
+    // ...unless it's the end of the input
+    n = u8_from_utf16(dest, le, 9, false, true, &consumed);
+    cxml_assert__eq(consumed, 9)
+    cxml_assert__zero(memcmp(dest + 5, "\xEF\xBF\xBD\xEF\xBF\xBD", 6))
+    // ascii fast path
+    char ascii[] = {'<', 0, 'a', 0, '/', 0, '>', 0, 'x', 0};
+    n = u8_from_utf16(dest, ascii, 10, false, false, &consumed);
+    cxml_assert__eq(n, 5)
+    cxml_assert__zero(memcmp(dest, "<a/>x", 5))
+    cxml_pass()
+}
+
+void suite_cxutf8hook(){
+    cxml_suite(cxutf8hook)
+    {
+        cxml_add_m_test(7,
+                        test_u8_validate,
+                        test_u8_is_partial,
+                        test_u8_count,
+                        test_u8_offset_n,
+                        test_u8_strchr,
+                        test_u8_from_latin1,
+                        test_u8_from_utf16
+        )
+        cxml_run_suite()
+    }
+}
@@ -76,7 +76,7 @@ cts test_cxml_get_token(){
     tok = cxml_get_token(&lexer);
     cxml_assert__eq(tok.type, CXML_TOKEN_STRING)
     cxml_assert__eq(tok.start, (src + 1))
-    cxml_assert__eq(tok.literal_type, CXML_XINTEGER_LITERAL)
+    cxml_assert__eq(tok.literal_type, CXML_STRING_LITERAL)
     cxml_assert__eq(tok.length, 9)
     cxml_assert__two(tok.line)
     _cxml_lexer_close(&lexer);
@@ -86,7 +86,7 @@ cts test_cxml_get_token(){
     tok = cxml_get_token(&lexer);
     cxml_assert__eq(tok.type, CXML_TOKEN_STRING)
     cxml_assert__eq(tok.start, (src + 1))
-    cxml_assert__eq(tok.literal_type, CXML_DOUBLE_LITERAL)
+    cxml_assert__eq(tok.literal_type, CXML_STRING_LITERAL)
     cxml_assert__eq(tok.length, 9)
     cxml_assert__one(tok.line)
     _cxml_lexer_close(&lexer);
@@ -96,7 +96,7 @@ cts test_cxml_get_token(){
     tok = cxml_get_token(&lexer);
     cxml_assert__eq(tok.type, CXML_TOKEN_TEXT)
     cxml_assert__eq(tok.start, (src + 1))
-    cxml_assert__eq(tok.literal_type, CXML_INTEGER_LITERAL)
+    cxml_assert__eq(tok.literal_type, CXML_STRING_LITERAL)
     cxml_assert__eq(tok.length, 5)
     cxml_assert__two(tok.line)
     _cxml_lexer_close(&lexer);
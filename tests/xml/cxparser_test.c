@@ -18,7 +18,6 @@ int parser_init_asserts(_cxml_parser *parser){
     cxml_assert__true(cxml_list_is_empty(&parser->attr_list))
     cxml_assert__true(cxml_list_is_empty(&parser->errors))
     cxml_assert__true(cxml_list_is_empty(&parser->errors))
-    cxml_assert__true(cxml_table_is_empty(&parser->attr_checker))
     cxml_assert__true(_cxml_stack_is_empty(&parser->_cx_stack))
     return 1;
 }
@@ -70,6 +69,73 @@ cts test_cxml_parse_xml_lazy(){
 }
 
 
+cts test_cxml_parse_validate_encoding(){
+    cxml_cfg_validate_encoding(1);
+    cxml_root_node *root = cxml_parse_xml("<hi>इस नए साल खुशियों की बरसातें हों</hi>");
+    cxml_assert__not_null(root)
+    cxml_assert__true(root->is_well_formed)
+    cxml_free_root_node(root);
+    // a small chunk size splits multi-byte sequences across reads
+    cxml_cfg_set_chunk_size(16);
+    char *fp = get_file_path("wf_xml_utf8.xml");
+    root = cxml_parse_xml_lazy(fp);
+    FREE(fp);
+    cxml_assert__not_null(root)
+    cxml_assert__true(root->is_well_formed)
+    cxml_free_root_node(root);
+    // a multi-byte sequence straddling the end of the first chunk
+    fp = get_file_path("wf_xml_utf8_split.xml");
+    root = cxml_parse_xml_lazy(fp);
+    FREE(fp);
+    cxml_assert__not_null(root)
+    cxml_assert__true(root->is_well_formed)
+    char *text = cxml_text(root, NULL);
+    cxml_assert__zero(strcmp(text, "0123456789ab\xc3\xa9 and \xc3\xa0 la fin"))
+    FREE(text);
+    cxml_free_root_node(root);
+    fixture_no_fancy_printing_and_warnings();
+    cxml_assert__false(cxml_get_config().validate_encoding)
+    cxml_pass()
+}
+
+
+static char *_element_string(char *file_name){
+    char *fp = get_file_path(file_name);
+    cxml_root_node *root = cxml_parse_xml_lazy(fp);
+    FREE(fp);
+    if (!root) return NULL;
+    char *str = cxml_element_to_rstring(root->root_element);
+    cxml_free_root_node(root);
+    return str;
+}
+
+cts test_cxml_parse_xml_lazy_transcoded(){
+    char *expected = _element_string("wf_xml_utf8.xml"), *str;
+    cxml_assert__not_null(expected)
+    int chunk_sizes[] = {0, 16, 17};
+    for (int i = 0; i < 3; i++){
+        cxml_cfg_set_chunk_size(chunk_sizes[i]);
+        cxml_cfg_validate_encoding(1);
+        // utf-16le with a byte order mark
+        str = _element_string("wf_xml_utf16le.xml");
+        cxml_assert__zero(strcmp(str, expected))
+        FREE(str);
+        // utf-16be without a byte order mark
+        str = _element_string("wf_xml_utf16be.xml");
+        cxml_assert__zero(strcmp(str, expected))
+        FREE(str);
+        // iso-8859-1 (from the xml declaration)
+        str = _element_string("wf_xml_latin1.xml");
+        cxml_assert__not_null(strstr(str, "Ça va, garçon? Où êtes-vous"))
+        cxml_assert__not_null(strstr(str, "Ø æ å"))
+        FREE(str);
+    }
+    FREE(expected);
+    fixture_no_fancy_printing_and_warnings();
+    cxml_pass()
+}
+
+
 cts test__cxml_parser_free(){
     _cxml_parser parser;
     _cxml_parser_init(&parser, wf_xml_9, NULL, false);
@@ -80,15 +146,77 @@ cts test__cxml_parser_free(){
     cxml_pass()
 }
 
+cts test_cxml_parse_xml_namespaces(){
+    cxml_root_node *root = cxml_parse_xml("<a xmlns:x=\"u1\" xmlns=\"d1\"><b xmlns:x=\"u2\">"
+                                          "<x:c x:k=\"1\"/><e/></b><x:d/><f/></a>");
+    cxml_assert__not_null(root)
+    cxml_elem_node *a = root->root_element;
+    cxml_elem_node *b = cxml_list_first(&a->children);
+    cxml_elem_node *c = cxml_list_first(&b->children);
+    cxml_elem_node *e = cxml_list_last(&b->children);
+    cxml_elem_node *d = cxml_list_get(&a->children, 1);
+    cxml_elem_node *f = cxml_list_last(&a->children);
+    // `x` is re-bound in <b>, and restored after </b>
+    cxml_assert__true(cxml_string_raw_equals(&c->namespace->uri, "u2"))
+    cxml_assert__eq(_unwrap__cxnode(attr, cxml_table_get(c->attributes, "x:k"))->namespace, c->namespace)
+    cxml_assert__true(cxml_string_raw_equals(&d->namespace->uri, "u1"))
+    // default namespace
+    cxml_assert__true(cxml_string_raw_equals(&e->namespace->uri, "d1"))
+    cxml_assert__eq(f->namespace, a->namespace)
+    cxml_free_root_node(root);
+    cxml_pass()
+}
+
+cts test__cxml_ns_scope(){
+    struct _cxml_ns_scope *scope = _cxml_ns_scope_new();
+    int ns1, ns2, x = _cxml_ns_scope_intern(scope, "x", 1);
+    cxml_assert__eq(_cxml_ns_scope_intern(scope, "xyz", 1), x)
+    cxml_assert__eq(_cxml_ns_scope_find(scope, "", 0), _CXML_NS_DEFAULT_SYMBOL)
+    cxml_assert__eq(_cxml_ns_scope_find(scope, "y", 1), -1)
+    cxml_assert__null(_cxml_ns_scope_lookup(scope, "x", 1))
+
+    _cxml_ns_scope_enter(scope);
+    cxml_assert__one(_cxml_ns_scope_bind(scope, x, 0, &ns1))
+    // already bound in this scope
+    cxml_assert__zero(_cxml_ns_scope_bind(scope, x, 0, &ns2))
+    _cxml_ns_scope_enter(scope);
+    cxml_assert__one(_cxml_ns_scope_bind(scope, x, 0, &ns2))
+    cxml_assert__eq(_cxml_ns_scope_lookup(scope, "x", 1)->ns, &ns2)
+    _cxml_ns_scope_leave(scope);
+    cxml_assert__eq(_cxml_ns_scope_lookup(scope, "x", 1)->ns, &ns1)
+    _cxml_ns_scope_leave(scope);
+    cxml_assert__null(_cxml_ns_scope_lookup(scope, "x", 1))
+
+    // many symbols
+    char name[8];
+    for (int i = 0; i < 100; i++){
+        snprintf(name, sizeof(name), "p%d", i);
+        cxml_assert__eq(_cxml_ns_scope_intern(scope, name, _cxml_int_cast strlen(name)), i + 2)
+    }
+    cxml_assert__eq(_cxml_ns_scope_find(scope, "p42", 3), 44)
+
+    cxml_assert__one(_cxml_ns_scope_add_attr(scope, 1, 2))
+    cxml_assert__one(_cxml_ns_scope_add_attr(scope, 2, 2))
+    cxml_assert__zero(_cxml_ns_scope_add_attr(scope, 1, 2))
+    _cxml_ns_scope_clear_attrs(scope);
+    cxml_assert__one(_cxml_ns_scope_add_attr(scope, 1, 2))
+    _cxml_ns_scope_free(scope);
+    cxml_pass()
+}
+
 void suite_cxparser(){
     cxml_suite(cxparser)
     {
-        cxml_add_m_test(5,
+        cxml_add_m_test(9,
                         test__cxml_parser_init,
                         test_create_root_node,
                         test_cxml_parse_xml,
                         test_cxml_parse_xml_lazy,
-                        test__cxml_parser_free
+                        test_cxml_parse_validate_encoding,
+                        test_cxml_parse_xml_lazy_transcoded,
+                        test__cxml_parser_free,
+                        test_cxml_parse_xml_namespaces,
+                        test__cxml_ns_scope
         )
         cxml_run_suite()
     }
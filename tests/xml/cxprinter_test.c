@@ -44,14 +44,85 @@ cts test_cxml_prettify(){
     cxml_pass()
 }
 
+cts test_cxml_text_entities_escape(){
+    cxml_cfg_preserve_space(0);
+    cxml_root_node *root = cxml_load_string("<a>x &amp; y &#60; z & w > v</a>");
+    cxml_assert__not_null(root)
+    cxml_text_node *text = cxml_list_first(&root->root_element->children);
+    cxml_assert__true(text->has_entity)
+    // entity references are kept, character references and standalone predefined
+    // entities are transposed
+    char *got = cxml_stringify(root->root_element);
+    char *expected = "<a>\n  x &amp; y &amp;#60; z &amp; w &gt; v\n</a>";
+    cxml_assert__true(cxml_string_llraw_equals(expected, got, strlen(expected), strlen(got)))
+    FREE(got);
+    cxml_destroy(root);
+
+    root = cxml_load_string("<a>no entities here</a>");
+    text = cxml_list_first(&root->root_element->children);
+    cxml_assert__false(text->has_entity)
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test_cxml_text_entities_decode(){
+    cxml_root_node *root = cxml_load_string("<a>1 &lt; 2 &amp;&amp; 3 &gt; 2 &#65;&#x42;&#x20AC; &foo; &#xD800; a > b</a>");
+    cxml_assert__not_null(root)
+    cxml_text_node *text = cxml_list_first(&root->root_element->children);
+    cxml_string str = new_cxml_string();
+    cxml_text_to_string(text, &str);
+    cxml_assert__true(cxml_string_raw_equals(&str, "1 < 2 && 3 > 2 AB\xe2\x82\xac &foo; &#xD800; a > b"))
+    cxml_string_free(&str);
+    // the node's value is left as is
+    cxml_assert__true(cxml_string_raw_equals(&text->value,
+                                             "1 &lt; 2 &amp;&amp; 3 &gt; 2 &#65;&#x42;&#x20AC; &foo; &#xD800; a > b"))
+    cxml_destroy(root);
+
+    // entity-free text is appended as is
+    root = cxml_load_string("<a>a > b</a>");
+    text = cxml_list_first(&root->root_element->children);
+    cxml_text_to_string(text, &str);
+    cxml_assert__true(cxml_string_raw_equals(&str, "a > b"))
+    cxml_string_free(&str);
+    cxml_destroy(root);
+
+    // decoded once, on first access
+    root = cxml_load_string("<a>x &lt; y<![CDATA[p &amp;&amp; q]]></a>");
+    text = cxml_list_first(&root->root_element->children);
+    cxml_assert__null(text->decoded)
+    cxml_text_to_string(text, &str);
+    cxml_assert__not_null(text->decoded)
+    cxml_string *decoded = text->decoded;
+    cxml_text_to_string(text, &str);
+    cxml_assert__eq(text->decoded, decoded)
+    cxml_assert__true(cxml_string_raw_equals(&str, "x < yx < y"))
+    cxml_string_free(&str);
+    // and again once the value changes
+    cxml_set_text_value(text, "x &gt; y", false);
+    cxml_assert__null(text->decoded)
+    cxml_text_to_string(text, &str);
+    cxml_assert__true(cxml_string_raw_equals(&str, "x > y"))
+    cxml_string_free(&str);
+    // cdata sections are decoded too
+    text = cxml_list_last(&root->root_element->children);
+    cxml_assert__true(text->is_cdata)
+    cxml_text_to_string(text, &str);
+    cxml_assert__true(cxml_string_raw_equals(&str, "p && q"))
+    cxml_string_free(&str);
+    cxml_destroy(root);
+    cxml_pass()
+}
+
 
 void suite_cxprinter() {
     cxml_suite(cxprinter)
     {
         cxml_add_test_setup(fixture_no_fancy_printing_and_warnings)
         cxml_add_test_teardown(fixture_no_fancy_printing_and_warnings)
-        cxml_add_m_test(1,
-                        test_cxml_prettify
+        cxml_add_m_test(3,
+                        test_cxml_prettify,
+                        test_cxml_text_entities_escape,
+                        test_cxml_text_entities_decode
         )
         cxml_run_suite()
     }
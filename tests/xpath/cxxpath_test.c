@@ -4,6 +4,9 @@
  */
 
 #include "cxfixture.h"
+#if !defined(__STDC_NO_THREADS__)
+    #include <threads.h>
+#endif
 
 // todo: more comprehensive tests
 
@@ -33,10 +36,837 @@ cts test_cxml_xpath(){
     cxml_pass()
 }
 
+cts test_cxml_xpath_indexed(){
+    cxml_root_node *root = cxml_load_string(wf_xml_6);
+    cxml_assert(root)
+    cxml_set *nodeset = cxml_xpath(root, "//*");
+    cxml_assert__not_null(nodeset)
+    // descendant steps over an indexed document yield the same nodes, in the same order
+    cxml_assert__not_null(cxml_index_document(root))
+    cxml_set *indexed = cxml_xpath(root, "//*");
+    cxml_assert__not_null(indexed)
+    cxml_assert__eq(cxml_set_size(indexed), cxml_set_size(nodeset))
+    for (int i = 0; i < cxml_set_size(nodeset); i++){
+        cxml_assert__eq(cxml_set_get(indexed, i), cxml_set_get(nodeset, i))
+    }
+    cxml_set_free(indexed);
+    FREE(indexed);
+    indexed = cxml_xpath(root, "//seasoning//text()");
+    cxml_assert__two(cxml_set_size(indexed))
+    cxml_destroy(root);
+    cxml_set_free(nodeset);
+    FREE(nodeset);
+    cxml_set_free(indexed);
+    FREE(indexed);
+    cxml_pass()
+}
+
+static char *wf_xml_nested = \
+"<r><a id=\"a1\"><b id=\"b1\"/><a id=\"a2\"><b id=\"b2\"/><c/><b id=\"b3\"/></a><b id=\"b4\"/></a>"
+"<a id=\"a3\"><c><b id=\"b5\"/></c></a></r>";
+
+// check that the ids of the nodes in `nodeset` are (in order) the ids in `expected` (frees `nodeset`)
+static bool _has_ids(cxml_set *nodeset, const char *expected){
+    cxml_string ids = new_cxml_string();
+    cxml_attr_node *attr;
+    cxml_for_each(node, &nodeset->items)
+    {
+        attr = cxml_table_get(_unwrap__cxnode(elem, node)->attributes, "id");
+        if (cxml_string_len(&ids)) cxml_string_append(&ids, " ", 1);
+        attr ? cxml_string_str_append(&ids, &attr->value) : cxml_string_append(&ids, "?", 1);
+    }
+    bool ret = cxml_string_raw_equals(&ids, expected);
+    cxml_string_free(&ids);
+    cxml_set_free(nodeset);
+    FREE(nodeset);
+    return ret;
+}
+
+// check that the ids of the nodes selected by `expr` are (in order) the ids in `expected`
+static bool _selects(cxml_root_node *root, const char *expr, const char *expected){
+    return _has_ids(cxml_xpath(root, expr), expected);
+}
+
+cts test_cxml_xpath_pipelined(){
+    cxml_root_node *root = cxml_load_string(wf_xml_nested);
+    cxml_assert(root)
+    // nodes are selected in document order, even from nested contexts
+    cxml_assert__true(_selects(root, "//a/b", "b1 b2 b3 b4"))
+    cxml_assert__true(_selects(root, "//a//b", "b1 b2 b3 b4 b5"))
+    // positional predicates select among the children of each parent
+    cxml_assert__true(_selects(root, "//a/b[1]", "b1 b2"))
+    cxml_assert__true(_selects(root, "//a/b[2]", "b3 b4"))
+    cxml_assert__true(_selects(root, "//b[1]", "b1 b2 b5"))
+    cxml_assert__true(_selects(root, "/r/a[2]//b", "b5"))
+    cxml_assert__true(_selects(root, "/r/a[3]", ""))
+    cxml_assert__true(_selects(root, "/r/a[1]/a/b[2]", "b3"))
+    // existence checks
+    cxml_assert__true(_selects(root, "//a[b]", "a1 a2"))
+    cxml_assert__true(_selects(root, "//a[.//b]", "a1 a2 a3"))
+    cxml_assert__true(_selects(root, "//a[not(c)]", "a1"))
+    cxml_assert__true(_selects(root, "//a[boolean(c/b)]", "a3"))
+    cxml_assert__true(_selects(root, "//a[//zz]", ""))
+    cxml_assert__true(_selects(root, "//a[b[3]]", ""))
+    // attribute steps
+    cxml_set *nodeset = cxml_xpath(root, "//a/b[1]/@id");
+    cxml_assert__two(cxml_set_size(nodeset))
+    cxml_assert__eq(_cxml_node_type(cxml_set_get(nodeset, 0)), CXML_ATTR_NODE)
+    cxml_set_free(nodeset);
+    FREE(nodeset);
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+// check that the ids of the nodes of `doc` selected by `expr` are (in order) the ids in `expected`
+static bool _frozen_selects(cxml_frozen_doc *doc, const char *expr, const char *expected){
+    cxml_frozen_set set;
+    cxml_frozen_set_init(&set);
+    if (!cxml_xpath_frozen(doc, expr, &set)) return false;
+    cxml_string ids = new_cxml_string();
+    const char *id;
+    int len;
+    for (int i = 0; i < set.size; i++){
+        id = cxml_frozen_attribute(doc, set.nodes[i], "id", &len);
+        if (cxml_string_len(&ids)) cxml_string_append(&ids, " ", 1);
+        id ? cxml_string_append(&ids, id, len) : cxml_string_append(&ids, "?", 1);
+    }
+    bool ret = cxml_string_raw_equals(&ids, expected);
+    cxml_string_free(&ids);
+    cxml_frozen_set_free(&set);
+    return ret;
+}
+
+cts test_cxml_xpath_frozen(){
+    cxml_root_node *root = cxml_load_string(wf_xml_nested);
+    cxml_assert(root)
+    cxml_frozen_doc *doc = cxml_freeze(root);
+    // the nodes selected from the document, in document order
+    char *paths[][2] = {
+            {"//a/b", "b1 b2 b3 b4"},
+            {"//a//b", "b1 b2 b3 b4 b5"},
+            {"/r/a/a/b", "b2 b3"},
+            {"r/a", "a1 a3"},
+            {"/r/a/*", "b1 a2 b4 ?"},
+            {"//c/..", "a2 a3"},
+            {"//b/parent::a", "a1 a2"},
+            {"//a/descendant::b", "b1 b2 b3 b4 b5"},
+            {"//a/descendant-or-self::a", "a1 a2 a3"},
+            {"//zz", ""},
+            {"//a/zz//b", ""},
+    };
+    for (int i = 0; i < 11; i++){
+        cxml_assert__true(_selects(root, paths[i][0], paths[i][1]))
+        cxml_assert__true(_frozen_selects(doc, paths[i][0], paths[i][1]))
+    }
+    cxml_frozen_set set;
+    cxml_frozen_set_init(&set);
+    cxml_assert__true(cxml_xpath_frozen(doc, "/", &set))
+    cxml_assert__one(set.size)
+    cxml_assert__zero(set.nodes[0])
+    cxml_frozen_set_free(&set);
+    cxml_assert__true(cxml_xpath_frozen(doc, "//b/text()", &set))
+    cxml_assert__zero(set.size)
+    // expressions that can't be evaluated over a frozen document
+    cxml_assert__false(cxml_xpath_frozen(doc, "//a[1]", &set))
+    cxml_assert__false(cxml_xpath_frozen(doc, "//a/@id", &set))
+    cxml_assert__false(cxml_xpath_frozen(doc, "//b/following::b", &set))
+    cxml_assert__false(cxml_xpath_frozen(doc, "//a | //b", &set))
+    cxml_assert__zero(set.size)
+    cxml_assert__false(cxml_xpath_frozen(NULL, "//a", &set))
+    cxml_frozen_free(doc);
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+#if !defined(__STDC_NO_THREADS__)
+struct _frozen_work{
+    cxml_frozen_doc *doc;
+    cxml_xp_frozen_path **paths;
+    cxml_frozen_set *expected;
+    int n;
+    bool ok;
+};
+
+// evaluate the prepared paths over and over, checking every result
+static int _frozen_worker(void *arg){
+    struct _frozen_work *work = arg;
+    cxml_frozen_set set;
+    work->ok = true;
+    for (int round = 0; round < 200 && work->ok; round++){
+        for (int i = 0; i < work->n; i++){
+            cxml_frozen_set_init(&set);
+            cxml_xp_frozen_path_eval(work->paths[i], work->doc, &set);
+            work->ok = work->ok && set.size == work->expected[i].size
+                       && !memcmp(set.nodes, work->expected[i].nodes, sizeof(int) * (size_t)set.size);
+            cxml_frozen_set_free(&set);
+        }
+    }
+    return 0;
+}
+#endif
+
+cts test_cxml_xpath_frozen_threads(){
+#if !defined(__STDC_NO_THREADS__)
+    cxml_root_node *root = cxml_load_file(get_file_path("wf_xml_2.xml"), false);
+    cxml_assert(root)
+    cxml_frozen_doc *doc = cxml_freeze(root);
+    const char *exprs[] = {"//term", "//relationship/..", "/*/*/synonym//text()", "//*", "//zz"};
+    cxml_xp_frozen_path *paths[5];
+    cxml_frozen_set expected[5];
+    for (int i = 0; i < 5; i++){
+        paths[i] = cxml_xpath_frozen_prepare(exprs[i]);
+        cxml_assert__not_null(paths[i])
+        cxml_frozen_set_init(&expected[i]);
+        cxml_assert__true(cxml_xp_frozen_path_eval(paths[i], doc, &expected[i]))
+    }
+    cxml_assert__true(expected[0].size > 0)
+    cxml_assert__zero(expected[4].size)
+    cxml_assert__null(cxml_xpath_frozen_prepare("//term[1]"))
+    // prepared paths are evaluated against the same document from several threads at once
+    thrd_t threads[4];
+    struct _frozen_work work[4];
+    for (int t = 0; t < 4; t++){
+        work[t] = (struct _frozen_work){.doc = doc, .paths = paths, .expected = expected, .n = 5};
+        cxml_assert__eq(thrd_create(&threads[t], _frozen_worker, &work[t]), thrd_success)
+    }
+    for (int t = 0; t < 4; t++){
+        thrd_join(threads[t], NULL);
+        cxml_assert__true(work[t].ok)
+    }
+    for (int i = 0; i < 5; i++){
+        cxml_xp_frozen_path_free(paths[i]);
+        cxml_frozen_set_free(&expected[i]);
+    }
+    cxml_frozen_free(doc);
+    cxml_destroy(root);
+#endif
+    cxml_pass()
+}
+
+cts test_cxml_xpath_filter(){
+    cxml_root_node *root = cxml_load_string(wf_xml_nested);
+    cxml_assert(root)
+    // predicates of a filter expression apply to the whole node-set
+    cxml_assert__true(_selects(root, "(//b)[1]", "b1"))
+    cxml_assert__true(_selects(root, "(//a/b)[2]", "b2"))
+    cxml_assert__true(_selects(root, "(//b)[5]", "b5"))
+    cxml_assert__true(_selects(root, "(//b)[6]", ""))
+    cxml_assert__true(_selects(root, "(//b)[last()]", "b5"))
+    cxml_assert__true(_selects(root, "(//b)[position() > 3]", "b4 b5"))
+    cxml_assert__true(_selects(root, "(//b)[2][@id='b2']", "b2"))
+    cxml_assert__true(_selects(root, "(//a | //c)[2]", "a2"))
+    cxml_assert__true(_selects(root, "(//a)[b][2]", "a2"))
+    cxml_assert__true(_selects(root, "//a[(.//b)[3]]", "a1"))
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test_cxml_xpath_aggregates(){
+    cxml_root_node *root = cxml_load_string(wf_xml_nested);
+    cxml_assert(root)
+    // counted as the nodes are selected
+    cxml_assert__true(_selects(root, "//a[count(b) = 2]", "a1 a2"))
+    cxml_assert__true(_selects(root, "//a[count(.//b) = 1]", "a3"))
+    cxml_assert__true(_selects(root, "//a[count(//b) = 5]", "a1 a2 a3"))
+    cxml_assert__true(_selects(root, "//a[count(b/@id) = 2]", "a1 a2"))
+    // counted off the node-set
+    cxml_assert__true(_selects(root, "//a[count(b[@id='b1'] | c) = 1]", "a1 a2 a3"))
+    cxml_destroy(root);
+
+    root = cxml_load_string("<r><l id=\"l1\"><v>1</v><v>2.5</v></l><l id=\"l2\"><v>4</v><v>x</v><v>3</v></l></r>");
+    cxml_assert(root)
+    cxml_assert__true(_selects(root, "//l[sum(v) = 3.5]", "l1"))
+    cxml_assert__true(_selects(root, "//l[sum(v[1]) = 4]", "l2"))
+    // a node with no numeric value makes the sum NaN
+    cxml_assert__true(_selects(root, "//l[sum(v) = sum(v)]", "l1"))
+    cxml_assert__true(_selects(root, "//l[sum(v[. > 2]) = 7]", "l2"))
+    cxml_assert__true(_selects(root, "//l[count(v) = 3]", "l2"))
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test_cxml_xpath_optimized(){
+    cxml_root_node *root = cxml_load_string(wf_xml_nested);
+    cxml_assert(root)
+    // invariant sub-expressions (evaluated once per query)
+    cxml_assert__true(_selects(root, "//a[count(b) = count(//a) - 1]", "a1 a2"))
+    cxml_assert__true(_selects(root, "//b[@id = string(//a[@id='a2']/b/@id)]", "b2"))
+    cxml_assert__true(_selects(root, "//a[//b[@id = 'b3']]", "a1 a2 a3"))
+    cxml_assert__true(_selects(root, "//a[not(//zz) and not(c)]", "a1"))
+    cxml_assert__true(_selects(root, "//a[b[count(//c) = 2]]", "a1 a2"))
+    cxml_assert__true(_selects(root, "//*[2 * 3 = 6 and c]", "a2 a3"))
+    cxml_assert__true(_selects(root, "//b[count(//b) - 3]", "b3 b4"))
+    // reordered conjunctions/disjunctions
+    cxml_assert__true(_selects(root, "//a[.//b and @id = 'a3']", "a3"))
+    cxml_assert__true(_selects(root, "//a[@id = 'a3' and .//b]", "a3"))
+    cxml_assert__true(_selects(root, "//b[.//zz or @id = 'b4']", "b4"))
+    cxml_assert__true(_selects(root, "//b[@id and position() = 2]", "b3 b4"))
+    cxml_assert__true(_selects(root, "//a[c or last() = 3]", "a2 a3"))
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test_cxml_xpath_string_values(){
+    cxml_root_node *root = cxml_load_string(
+            "<r><a id='a1'><p id='p1'> 12 </p><p id='p2'>7</p><q id='q1'>x<i id='i1'>y</i>z</q><e id='e1'/></a>"
+            "<a id='a2'><p id='p3'>12</p><p id='p4'>abc</p><q id='q2'>xyz</q><m id='m1'>2<i id='i2'>0</i></m></a>"
+            "<a id='a3'><p id='p5'>7</p><q id='q3'>x</q></a></r>");
+    cxml_assert(root)
+    // elements with a single text child
+    cxml_assert__true(_selects(root, "//p[. = '12']", "p3"))
+    cxml_assert__true(_selects(root, "//p[. = 12]", "p1 p3"))
+    cxml_assert__true(_selects(root, "//p[. > 10]", "p1 p3"))
+    // string() and number() default to the context node
+    cxml_assert__true(_selects(root, "//p[string() = '7']", "p2 p5"))
+    cxml_assert__true(_selects(root, "//p[number() = 12]", "p1 p3"))
+    cxml_assert__true(_selects(root, "//*[string() = '']", "e1"))
+    // (and so do they when called by the evaluator rather than a compiled predicate)
+    cxml_assert__true(_selects(root, "//p[concat(string(), '') = '7']", "p2 p5"))
+    cxml_assert__true(_selects(root, "//p[concat(number(), '') = '12']", "p1 p3"))
+    // elements with mixed content
+    cxml_assert__true(_selects(root, "//q[. = 'xyz']", "q1 q2"))
+    cxml_assert__true(_selects(root, "//*[. = 20]", "m1"))
+    cxml_assert__true(_selects(root, "//a[. = ' 12 7xyz']", "a1"))
+    // node-set comparisons
+    cxml_assert__true(_selects(root, "//a[q = //a[@id='a2']/q]", "a1 a2"))
+    cxml_assert__true(_selects(root, "//a[p = //a[@id='a3']/p]", "a1 a3"))
+    cxml_assert__true(_selects(root, "//a[p = ../a/q]", ""))
+    cxml_assert__true(_selects(root, "//a[m > //p]", "a2"))
+    // the result of a filtered intermediate step doesn't linger on the stack
+    cxml_assert__true(_selects(root, "//a[1 = count(/r/a[@id='a3']/p)]", "a1 a2 a3"))
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test_cxml_xpath_compiled_predicates(){
+    cxml_root_node *root = cxml_load_string(
+            "<r><a id='a1' k='x'><p id='p1'>12</p><p id='p2'>7</p><q id='q1'>xyz</q></a>"
+            "<a id='a2'><p id='p3'>abc</p><m id='m1'>3</m></a>"
+            "<a id='a3' k='y'><p id='p4'>7</p><q id='q2'>x</q></a></r>");
+    cxml_assert(root)
+    // comparisons
+    cxml_assert__true(_selects(root, "//a[p = 7]", "a1 a3"))
+    cxml_assert__true(_selects(root, "//a[10 > p]", "a1 a3"))
+    cxml_assert__true(_selects(root, "//a[p != 'abc']", "a1 a3"))
+    cxml_assert__true(_selects(root, "//a[@k = 'y' or m > 2]", "a2 a3"))
+    cxml_assert__true(_selects(root, "//a[m = true()]", "a2"))
+    cxml_assert__true(_selects(root, "//a[q = p]", ""))
+    cxml_assert__true(_selects(root, "//p[. = 'abc' or 'abc' = 12]", "p3"))
+    cxml_assert__true(_selects(root, "//p['abc' = 12]", ""))
+    // attributes, position and functions
+    cxml_assert__true(_selects(root, "//a[@k and not(q = 'x')]", "a1"))
+    cxml_assert__true(_selects(root, "//a[count(@*) = 2]", "a1 a3"))
+    cxml_assert__true(_selects(root, "//a[count(p) = 2]", "a1"))
+    cxml_assert__true(_selects(root, "//p[position() = last()]", "p2 p3 p4"))
+    cxml_assert__true(_selects(root, "//p[last() - 1]", "p1"))
+    cxml_assert__true(_selects(root, "//q[contains(., 'y') and starts-with(., 'x')]", "q1"))
+    cxml_assert__true(_selects(root, "//q[string-length() = 1]", "q2"))
+    cxml_assert__true(_selects(root, "//a[number(m) = 3]", "a2"))
+    // invariant operands
+    cxml_assert__true(_selects(root, "//a[p = //a[@id='a3']/p]", "a1 a3"))
+    cxml_assert__true(_selects(root, "//a[count(p) = count(/r/a[1]/p)]", "a1"))
+    // expressions that aren't compiled
+    cxml_assert__true(_selects(root, "//a[.//q = 'x']", "a3"))
+    cxml_assert__true(_selects(root, "//a[p[2] = 7]", "a1"))
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test_cxml_xpath_arena(){
+    cxml_root_node *root = cxml_load_string(
+            "<r><a id='a1'><p>12</p><p>7</p></a><a id='a2'><p>abc</p></a><a id='a3'><p>7</p></a></r>");
+    cxml_assert(root)
+    const char *expr = "//a[concat(p, '') = '7' or p = /r/a[2]/p][count(p) = 1]";
+    cxml_assert__true(_selects(root, expr, "a2 a3"))
+    // the intermediate data is released when the query has been evaluated,
+    // and the arena's memory is reused by the next query
+    struct _cxml_arena_block *block = _xpath_parser.arena.block;
+    cxml_assert__not_null(block)
+    cxml_assert__zero(_xpath_parser.arena.used)
+    cxml_assert__null(_xpath_parser.arena.cleanups)
+    cxml_assert__true(_selects(root, expr, "a2 a3"))
+    cxml_assert__true(_xpath_parser.arena.block == block)
+    cxml_assert__null(block->prev)
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+static cxml_xp_profile_entry *_profile_entry(cxml_xp_profile *profile, int index){
+    return cxml_list_get(&profile->entries, index);
+}
+
+cts test_cxml_xpath_profile(){
+    cxml_root_node *root = cxml_load_string(
+            "<r><a id='a1'><p>12</p><p>7</p></a><a id='a2'><p>abc</p></a><a id='a3'><p>7</p></a></r>");
+    cxml_assert(root)
+    cxml_xp_profile profile;
+    cxml_xp_profile_entry *entry;
+    cxml_set *nodeset = cxml_xpath_profile(root, "//a[p = 7]/p", &profile);
+    cxml_assert__eq(cxml_set_size(nodeset), 3)
+    cxml_assert__eq(profile.size, 3)
+    // path, steps, predicate, and the path (and its step) in the predicate
+    cxml_assert__eq(cxml_list_size(&profile.entries), 6)
+    entry = _profile_entry(&profile, 0);
+    cxml_assert__eq(entry->type, CXML_XP_PROFILE_PATH)
+    cxml_assert__true(cxml_string_raw_equals(&entry->expr, "//a[p = 7]/p"))
+    cxml_assert__eq(entry->calls, 1)
+    cxml_assert__eq(entry->produced, 3)
+    entry = _profile_entry(&profile, 1);
+    cxml_assert__eq(entry->type, CXML_XP_PROFILE_STEP)
+    cxml_assert__true(cxml_string_raw_equals(&entry->expr, "//a"))
+    cxml_assert__eq(entry->depth, 1)
+    cxml_assert__eq(entry->produced, 2)
+    entry = _profile_entry(&profile, 2);
+    cxml_assert__eq(entry->type, CXML_XP_PROFILE_PREDICATE)
+    cxml_assert__true(cxml_string_raw_equals(&entry->expr, "[p = 7]"))
+    cxml_assert__eq(entry->depth, 2)
+    cxml_assert__eq(entry->visited, 3)
+    cxml_assert__eq(entry->produced, 2)
+    cxml_assert__true((entry->rewrites & CXML_XP_REWRITE_COMPILED) != 0)
+    entry = _profile_entry(&profile, 5);
+    cxml_assert__true(cxml_string_raw_equals(&entry->expr, "/p"))
+    cxml_assert__eq(entry->visited, 2)
+    cxml_assert__eq(entry->produced, 3)
+    cxml_xp_profile_free(&profile);
+    cxml_set_free(nodeset);
+    FREE(nodeset);
+
+    // rewrites
+    nodeset = cxml_xpath_profile(root, "//a[count(//p) > 3 or @id = 'a2'][p = /r/a[1]/p]", &profile);
+    cxml_assert__eq(cxml_set_size(nodeset), 2)
+    entry = _profile_entry(&profile, 2);
+    cxml_assert__true((entry->rewrites & CXML_XP_REWRITE_HOISTED) != 0)
+    entry = _profile_entry(&profile, 3);
+    cxml_assert__true(cxml_string_raw_equals(&entry->expr, "//p"))
+    cxml_assert__eq(entry->calls, 1)
+    cxml_assert__true((entry->rewrites & CXML_XP_REWRITE_FOLDED) != 0)
+    entry = _profile_entry(&profile, 10);
+    cxml_assert__true(cxml_string_raw_equals(&entry->expr, "/r/a[1]/p"))
+    cxml_assert__eq(entry->rewrites, CXML_XP_REWRITE_PIPELINED | CXML_XP_REWRITE_HOISTED)
+    cxml_xp_profile_free(&profile);
+    cxml_set_free(nodeset);
+    FREE(nodeset);
+
+    nodeset = cxml_xpath_profile(root, "(//p)[2]", &profile);
+    cxml_assert__eq(cxml_set_size(nodeset), 1)
+    entry = _profile_entry(&profile, 0);
+    cxml_assert__eq(entry->type, CXML_XP_PROFILE_FILTER)
+    cxml_assert__true((entry->rewrites & CXML_XP_REWRITE_PIPELINED) != 0)
+    cxml_xp_profile_free(&profile);
+    cxml_set_free(nodeset);
+    FREE(nodeset);
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+// check that the nodes produced by a cursor over `expr` are the nodes selected by `expr`
+static bool _iterates(cxml_root_node *root, const char *expr, int offset, int limit){
+    cxml_set *nodeset = cxml_xpath(root, expr);
+    cxml_xpath_iter iter;
+    cxml_xpath_iter_init(&iter, root, expr, offset, limit);
+    int i = offset, size = cxml_set_size(nodeset);
+    if (limit && offset + limit < size) size = offset + limit;
+    bool ret = true;
+    void *node;
+    while ((node = cxml_xpath_iter_next(&iter))){
+        if (i >= size || node != cxml_set_get(nodeset, i++)) ret = false;
+    }
+    cxml_xpath_iter_free(&iter);
+    cxml_set_free(nodeset);
+    FREE(nodeset);
+    return ret && i >= size;
+}
+
+cts test_cxml_xpath_iter(){
+    cxml_root_node *root = cxml_load_string(wf_xml_nested);
+    cxml_assert(root)
+    // pipelined paths
+    cxml_assert__true(_iterates(root, "//a//b", 0, 0))
+    cxml_assert__true(_iterates(root, "//a//b", 2, 0))
+    cxml_assert__true(_iterates(root, "//a//b", 1, 2))
+    cxml_assert__true(_iterates(root, "//a//b", 7, 2))
+    cxml_assert__true(_iterates(root, "//b[1]/@id", 1, 1))
+    cxml_assert__true(_iterates(root, "r/a", 0, 1))
+    // evaluated expressions
+    cxml_assert__true(_iterates(root, "//a[b]", 0, 0))
+    cxml_assert__true(_iterates(root, "(//b)[position() > 1]", 1, 2))
+    cxml_assert__true(_iterates(root, "//a/b | //c", 2, 0))
+
+    // elements as roots
+    cxml_elem_node *elem = cxml_find(root, "<a>/");
+    cxml_xpath_iter iter;
+    cxml_xpath_iter_init(&iter, elem, "a/b", 1, 0);
+    void *node = cxml_xpath_iter_next(&iter);
+    cxml_assert__not_null(node)
+    cxml_assert__true(cxml_string_raw_equals(
+            &((cxml_attr_node *)cxml_table_get(_unwrap__cxnode(elem, node)->attributes, "id"))->value, "b4"))
+    cxml_assert__null(cxml_xpath_iter_next(&iter))
+    cxml_xpath_iter_free(&iter);
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test_cxml_xpath_prepared(){
+    cxml_root_node *root = cxml_load_string(
+            "<r><a id='a1' n='1'><p>x</p></a><a id='a2' n='2'><p>y</p></a><a id='a3' n='3'><p>x</p></a></r>");
+    cxml_assert(root)
+    cxml_xp_query *query = cxml_xpath_prepare("//a[p = $v]");
+    cxml_assert__not_null(query)
+    cxml_xp_query_bind_string(query, "v", "x");
+    cxml_assert__true(_has_ids(cxml_xp_query_eval(query, root), "a1 a3"))
+    // the predicate is compiled once the type of $v is known
+    cxml_xp_step *step = cxml_list_last(&query->ast->wrapped_node.path->steps);
+    cxml_assert__not_null(((cxml_xp_predicate *)cxml_list_first(&step->predicates))->program)
+    // evaluated again with another value, of the same type (not recompiled)
+    cxml_xp_query_bind_string(query, "v", "y");
+    cxml_assert__false(query->recompile)
+    cxml_assert__true(_has_ids(cxml_xp_query_eval(query, root), "a2"))
+    // and of another type (recompiled)
+    cxml_xp_query_bind_boolean(query, "v", true);
+    cxml_assert__true(query->recompile)
+    cxml_assert__true(_has_ids(cxml_xp_query_eval(query, root), "a1 a2 a3"))
+    cxml_assert__false(query->recompile)
+    cxml_xp_query_free(query);
+
+    // numbers, compared with the literal query
+    query = cxml_xpath_prepare("//a[@n > $lo and @n <= $hi]");
+    cxml_xp_query_bind_number(query, "lo", 1);
+    cxml_xp_query_bind_number(query, "hi", 3);
+    cxml_assert__true(_has_ids(cxml_xp_query_eval(query, root), "a2 a3"))
+    cxml_assert__true(_selects(root, "//a[@n > 1 and @n <= 3]", "a2 a3"))
+    cxml_xp_query_bind_number(query, "hi", 2);
+    cxml_assert__true(_has_ids(cxml_xp_query_eval(query, root), "a2"))
+    cxml_xp_query_free(query);
+
+    // a number as a predicate selects a position
+    query = cxml_xpath_prepare("//a[$i]");
+    cxml_xp_query_bind_number(query, "i", 2);
+    cxml_assert__true(_has_ids(cxml_xp_query_eval(query, root), "a2"))
+    cxml_xp_query_free(query);
+
+    // node-sets, filtered, and as arguments
+    cxml_set *nodeset = cxml_xpath(root, "//a[p = 'x']");
+    query = cxml_xpath_prepare("$s[2]");
+    cxml_xp_query_bind_nodeset(query, "s", nodeset);
+    cxml_assert__true(_has_ids(cxml_xp_query_eval(query, root), "a3"))
+    cxml_xp_query_free(query);
+    query = cxml_xpath_prepare("//a[count($s) = @n - 1]");
+    cxml_xp_query_bind_nodeset(query, "s", nodeset);
+    cxml_assert__true(_has_ids(cxml_xp_query_eval(query, root), "a3"))
+    cxml_xp_query_free(query);
+    cxml_set_free(nodeset);
+    FREE(nodeset);
+
+    // elements as roots
+    query = cxml_xpath_prepare("r/a[@n = $n]");
+    cxml_xp_query_bind_string(query, "n", "2");
+    cxml_assert__true(_has_ids(cxml_xp_query_eval(query, cxml_find(root, "<r>/")), "a2"))
+    cxml_xp_query_free(query);
+
+    // paths following a nested predicate are still known to be in a predicate
+    query = cxml_xpath_prepare("//a[p[1] = //p]");
+    step = cxml_list_last(&query->ast->wrapped_node.path->steps);
+    cxml_xp_binaryop *binop = ((cxml_xp_predicate *)cxml_list_first(&step->predicates))->expr_node->wrapped_node.binary;
+    cxml_assert__true(binop->l_node->wrapped_node.path->from_predicate)
+    cxml_assert__true(binop->r_node->wrapped_node.path->from_predicate)
+    cxml_assert__true(_has_ids(cxml_xp_query_eval(query, root), "a1 a2 a3"))
+    cxml_xp_query_free(query);
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+static void _ext_len(_cxml_xp_data **args, int argc, _cxml_xp_data *result, void *calls){
+    (void)argc;
+    cxml_string str = new_cxml_string();
+    _cxml_xp_data_to_string(args[0], &str);
+    result->number.type = CXML_NUMERIC_DOUBLE_T;
+    result->number.dec_val = cxml_string_len(&str);
+    cxml_string_free(&str);
+    (*(int *)calls)++;
+}
+
+static void _ext_max(_cxml_xp_data **args, int argc, _cxml_xp_data *result, void *calls){
+    cxml_number num;
+    for (int i = 0; i < argc; i++){
+        _cxml_xp_data_to_numeric(args[i], &num);
+        if (!i || num.dec_val > result->number.dec_val) result->number = num;
+    }
+    (*(int *)calls)++;
+}
+
+static void _ext_id(_cxml_xp_data **args, int argc, _cxml_xp_data *result, void *calls){
+    (void)args;
+    (void)argc;
+    cxml_attr_node *attr = cxml_table_get(_unwrap__cxnode(elem, cxml_xpath_context_node())->attributes, "id");
+    if (attr) cxml_string_str_append(&result->str, &attr->value);
+    (*(int *)calls)++;
+}
+
+cts test_cxml_xpath_extension_functions(){
+    cxml_root_node *root = cxml_load_string(
+            "<r><a id='a1'><p>xy</p></a><a id='a2'><p>xyz</p></a><a id='a3'><p>x</p></a></r>");
+    cxml_assert(root)
+    int len_calls = 0, max_calls = 0, id_calls = 0;
+    cxml_assert__true(cxml_xpath_register_function("ext-len", 1, CXML_XP_RET_NUMBER, true, _ext_len, &len_calls))
+    cxml_assert__true(cxml_xpath_register_function("ext-max", -2, CXML_XP_RET_NUMBER, true, _ext_max, &max_calls))
+    cxml_assert__true(cxml_xpath_register_function("ext-id", 0, CXML_XP_RET_STRING, false, _ext_id, &id_calls))
+    // built-in functions can't be shadowed
+    cxml_assert__false(cxml_xpath_register_function("count", 1, CXML_XP_RET_NUMBER, true, _ext_len, NULL))
+
+    cxml_assert__true(_selects(root, "//a[ext-len(p) = 3]", "a2"))
+    cxml_assert__eq(len_calls, 3)
+    cxml_assert__true(_selects(root, "//a[ext-len(p) < ext-max(1, 3, 2)]", "a1 a3"))
+    // calls to pure functions with invariant arguments are evaluated once per query
+    cxml_assert__eq(max_calls, 1)
+    cxml_assert__true(_selects(root, "//a[ext-len(p) = ext-len(/r/a[2]/p)]", "a2"))
+    cxml_assert__eq(len_calls, 10)
+    // but not calls to impure functions
+    cxml_assert__true(_selects(root, "//a[ext-id() != 'a2']", "a1 a3"))
+    cxml_assert__eq(id_calls, 3)
+    cxml_assert__true(_selects(root, "//a[ext-len(ext-id()) = ext-max(1, 2)]", "a1 a2 a3"))
+    cxml_assert__eq(max_calls, 2)
+
+    // the cheaper operand of `and` is evaluated first
+    id_calls = 0;
+    cxml_assert__true(_selects(root, "//a[ext-id() = 'a2' and p = 'x']", ""))
+    cxml_assert__eq(id_calls, 1)
+    cxml_xpath_unregister_functions();
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test_cxml_xpath_budget(){
+    cxml_string xml = new_cxml_string();
+    cxml_string_raw_append(&xml, "<r>");
+    for (int i = 0; i < 100; i++){
+        cxml_string_raw_append(&xml, "<a id='a'><b id='b'/></a>");
+    }
+    cxml_string_raw_append(&xml, "</r>");
+    cxml_root_node *root = cxml_load_string(cxml_string_as_raw(&xml));
+    cxml_string_free(&xml);
+    cxml_assert(root)
+    cxml_budget budget;
+    cxml_budget_init(&budget);
+    cxml_budget_set(&budget);
+    // unlimited
+    cxml_set *nodeset = cxml_xpath(root, "//*[.//*]");
+    cxml_assert__eq(cxml_set_size(nodeset), 101)
+    cxml_assert__eq(budget.status, CXML_BUDGET_OK)
+    cxml_assert__geq(budget.visits, 201)
+    cxml_set_free(nodeset);
+    FREE(nodeset);
+    // selected nodes aren't charged again: the 201 nodes walked, and the child scanned under each a
+    budget.max_visits = 301;
+    nodeset = cxml_xpath(root, "//a[b]");
+    cxml_assert__not_null(nodeset)
+    cxml_assert__eq(cxml_set_size(nodeset), 100)
+    cxml_assert__eq(budget.visits, 301)
+    cxml_set_free(nodeset);
+    FREE(nodeset);
+    // aborted evaluations produce no node-set
+    budget.max_visits = 100;
+    cxml_assert__null(cxml_xpath(root, "//*[.//*[.//*]]"))
+    cxml_assert__eq(budget.status, CXML_BUDGET_VISITS_EXCEEDED)
+    budget.max_visits = 0;
+    budget.max_results = 50;
+    cxml_assert__null(cxml_xpath(root, "//a"))
+    cxml_assert__eq(budget.status, CXML_BUDGET_RESULTS_EXCEEDED)
+    cxml_assert__true(_selects(root, "/r/a[1]/b", "b"))
+    cxml_assert__eq(budget.status, CXML_BUDGET_OK)
+    budget.max_results = 0;
+    cxml_cancel_flag cancel = true;
+    budget.cancel = &cancel;
+    cxml_assert__null(cxml_xpath(root, "//*[.//*]"))
+    cxml_assert__eq(budget.status, CXML_BUDGET_CANCELLED)
+    cxml_budget_set(NULL);
+    cxml_assert__true(_selects(root, "/r/a[100]/b", "b"))
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test_cxml_xpath_axes(){
+    cxml_root_node *root = cxml_load_string(
+            "<r id='r'><s id='s1'><p id='p1'>one</p><p id='p2'>two<b id='b1'/></p><q id='q1'/><p id='p3'/></s>"
+            "<s id='s2'><p id='p4'><b id='b2'><i id='i1'/></b></p><q id='q2'/><p id='p5' x='1'/></s>"
+            "<ancestor id='t1'/></r>");
+    cxml_assert(root)
+    char *cases[][2] = {
+            {"//i/ancestor::*", "r s2 p4 b2"},
+            // reverse axes count positions from the context node
+            {"//i/ancestor::*[1]", "b2"},
+            {"//i/ancestor::*[last()]", "r"},
+            {"//i/ancestor-or-self::*[2]", "b2"},
+            {"//p/preceding-sibling::*[1]", "p1 q1 q2"},
+            {"//q/preceding-sibling::p[1]", "p2 p4"},
+            {"//b/preceding::*[1]", "p1 p3"},
+            {"//b/preceding::p[2]", "p2"},
+            {"//b/preceding::*", "s1 p1 p2 b1 q1 p3"},
+            {"//p/following-sibling::*[1]", "p2 q1 q2"},
+            {"//p/following-sibling::p", "p2 p3 p5"},
+            {"//b/following::*", "q1 p3 s2 p4 b2 i1 q2 p5 t1"},
+            {"//b/following::*[1]", "q1 q2"},
+            {"/descendant::p[2]", "p2"},
+            {"//s/descendant::*[1]", "p1 p4"},
+            {"//s/descendant-or-self::*[1]", "s1 s2"},
+            {"//b/parent::p", "p2 p4"},
+            {"//p/self::p[@x]", "p5"},
+            {"//s[2]/child::p", "p4 p5"},
+            {"//p[attribute::x]", "p5"},
+            {"//p[following-sibling::*[1][self::q]]", "p2 p4"},
+            {"//*[ancestor::s[@id = 's2']]", "p4 b2 i1 q2 p5"},
+            {"//p/@x/ancestor::s", "s2"},
+            {"//p/@x/following::*", "t1"},
+            {"//p/@x/preceding::*[1]", "q2"},
+            {"//s//following-sibling::q", "q1 q2"},
+            {"//p[count(ancestor::*) = 2][1]", "p1 p4"},
+            {"//text()/parent::*", "p1 p2"},
+            // axis names are still valid element names
+            {"//ancestor", "t1"},
+    };
+    int n = sizeof(cases) / sizeof(cases[0]);
+    // walked, then read off the index
+    for (int pass = 0; pass < 2; pass++){
+        for (int i = 0; i < n; i++){
+            cxml_assert__true(_selects(root, cases[i][0], cases[i][1]))
+        }
+        cxml_index_document(root);
+    }
+    // the root element of a virtual root has no ancestors or siblings beyond it
+    cxml_set *nodeset = cxml_xpath(root, "//s[1]");
+    cxml_assert__true(_has_ids(cxml_xpath(cxml_set_get(nodeset, 0), "//p[1]/ancestor::*"), "s1"))
+    cxml_assert__true(_has_ids(cxml_xpath(cxml_set_get(nodeset, 0), "//q/following::*"), "p3"))
+    cxml_set_free(nodeset);
+    FREE(nodeset);
+    cxml_destroy(root);
+
+    // the steps after a step on an axis select from nested context nodes, in document order
+    root = cxml_load_string(wf_xml_nested);
+    cxml_assert(root)
+    char *paths[][2] = {
+            {"//b/preceding::*/a", "a2"},
+            {"//a/ancestor::*/b", "b1 b4"},
+            {"//a/parent::*/b", "b1 b4"},
+            {"//a/descendant::*/b", "b2 b3 b5"},
+            {"//a/ancestor-or-self::*/b", "b1 b2 b3 b4"},
+            {"//a/self::a/b", "b1 b2 b3 b4"},
+            {"//a/self::a/b[1]", "b1 b2"},
+            {"//c/ancestor::*/*/b", "b1 b2 b3 b4 b5"},
+    };
+    for (int pass = 0; pass < 2; pass++){
+        for (int i = 0; i < 8; i++){
+            cxml_assert__true(_selects(root, paths[i][0], paths[i][1]))
+        }
+        cxml_index_document(root);
+    }
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test_cxml_xpath_string_functions(){
+    cxml_root_node *root = cxml_load_string(
+            "<r><p id='p1'>2021-10-19</p><p id='p2'>  a   b\n c </p><p id='p3'>caf\xc3\xa9 cr\xc3\xa8me</p>"
+            "<p id='p4' k='x:y:z'>HELLO</p><p id='p5'/></r>");
+    cxml_assert(root)
+    // substring() counts characters from 1, and rounds its positions
+    cxml_assert__true(_selects(root, "//p[substring(., 1, 4) = '2021']", "p1"))
+    cxml_assert__true(_selects(root, "//p[substring(., 6) = '10-19']", "p1"))
+    cxml_assert__true(_selects(root, "//p[substring(., 1.5, 2.6) = '021']", "p1"))
+    cxml_assert__true(_selects(root, "//p[substring(., 0, 3) = '20']", "p1"))
+    cxml_assert__true(_selects(root, "//p[substring(., -100, 200) = .]", "p1 p2 p3 p4 p5"))
+    cxml_assert__true(_selects(root, "//p[substring(., number('x'), 3) = '']", "p1 p2 p3 p4 p5"))
+    cxml_assert__true(_selects(root, "//p[substring(., 3, -1) = '']", "p1 p2 p3 p4 p5"))
+    cxml_assert__true(_selects(root, "//p[substring(., 4, 5) = '\xc3\xa9 cr\xc3\xa8']", "p3"))
+    cxml_assert__true(_selects(root, "//p[substring(@k, 3) = 'y:z']", "p4"))
+    // substring-before() and substring-after()
+    cxml_assert__true(_selects(root, "//p[substring-before(., '-') = '2021']", "p1"))
+    cxml_assert__true(_selects(root, "//p[substring-after(., '-') = '10-19']", "p1"))
+    cxml_assert__true(_selects(root, "//p[substring-after(@k, ':') = 'y:z']", "p4"))
+    cxml_assert__true(_selects(root, "//p[substring-before(@k, ':z') = 'x:y']", "p4"))
+    cxml_assert__true(_selects(root, "//p[substring-after(., 'cr') = '\xc3\xa8me']", "p3"))
+    cxml_assert__true(_selects(root, "//p[substring-before(., '/') != '' or substring-after(., '/') != '']", ""))
+    cxml_assert__true(_selects(root, "//p[substring-after(., '') = .]", "p1 p2 p3 p4 p5"))
+    // translate()
+    cxml_assert__true(_selects(root, "//p[translate(., 'ELO', 'elo') = 'Hello']", "p4"))
+    cxml_assert__true(_selects(root, "//p[translate(., 'HELO', 'helo') = 'hello']", "p4"))
+    cxml_assert__true(_selects(root, "//p[translate(., '-', '') = '20211019']", "p1"))
+    cxml_assert__true(_selects(root, "//p[translate(., '01-', 'ab') = '2a2bbab9']", "p1"))
+    cxml_assert__true(_selects(root, "//p[translate(., '\xc3\xa9\xc3\xa8', 'ee') = 'cafe creme']", "p3"))
+    cxml_assert__true(_selects(root, "//p[translate(., 'ae', '\xc3\xa0') = 'c\xc3\xa0" "f\xc3\xa9 cr\xc3\xa8m']", "p3"))
+    // normalize-space() defaults to the context node
+    cxml_assert__true(_selects(root, "//p[normalize-space() = 'a b c']", "p2"))
+    cxml_assert__true(_selects(root, "//p[normalize-space(concat(' ', ., ' ')) = .]", "p1 p3 p4 p5"))
+    cxml_assert__true(_selects(root, "//p[string-length(normalize-space(.)) = 5]", "p2 p4"))
+    // string-length() over any expression
+    cxml_assert__true(_selects(root, "//p[string-length(substring-before(., ' ')) = 4]", "p3"))
+    cxml_assert__true(_selects(root, "//p[string-length(translate(@k, ':', '')) = 3]", "p4"))
+    cxml_destroy(root);
+
+    // numbers convert to strings the way string() writes them
+    root = cxml_load_string("<r><a id='a1' n='x1'/><a id='a2' n='-2x'/><a id='a3' n='12'/><a id='a4' n='1'/>"
+                            "<a id='a5' n='0.5'/><a id='a6' n='NaN'/></r>");
+    cxml_assert(root)
+    cxml_assert__true(_selects(root, "//a[starts-with(@n, 1)]", "a3 a4"))
+    cxml_assert__true(_selects(root, "//a[starts-with(@n, -2)]", "a2"))
+    cxml_assert__true(_selects(root, "//a[@n = concat(1 div 2, '')]", "a5"))
+    cxml_assert__true(_selects(root, "//a[@n = string(number('x'))]", "a6"))
+    cxml_assert__true(_selects(root, "//a[string(-0) = '0' and string(-0.5) = '-0.5' and string(1.25) = '1.25']",
+                               "a1 a2 a3 a4 a5 a6"))
+    cxml_assert__true(_selects(root, "//a[string(12 * 100000) = '1200000' and string(0.000001) = '0.000001']",
+                               "a1 a2 a3 a4 a5 a6"))
+    cxml_destroy(root);
+    cxml_pass()
+}
+
+cts test_cxml_xpath_namespaces(){
+    cxml_root_node *root = cxml_load_string(
+            "<r xmlns:x='u1' xmlns:y='u1' xmlns:z='u2' id='r0'>"
+            "<x:a id='a1' x:k='1' z:k='2'><y:a id='a2'/><z:a id='a3' y:k='3'/></x:a>"
+            "<s id='s1' xmlns:x='u2'><x:a id='a4'/><y:a id='a5'/><x:b id='b1'/></s>"
+            "<t id='t1' xmlns:w='u1' xml:lang='en'><w:a id='a6'/><w:c id='c1' xml:lang='fr'/></t>"
+            "<y:b id='b2'/></r>");
+    cxml_assert(root)
+    // prefixes are resolved in the scope of each node, and compared by namespace name
+    cxml_assert__true(_selects(root, "//x:a", "a1 a2 a4 a6"))
+    cxml_assert__true(_selects(root, "//y:a", "a1 a2 a5 a6"))
+    cxml_assert__true(_selects(root, "//z:a", "a3 a4"))
+    cxml_assert__true(_selects(root, "//x:*", "a1 a2 a4 b1 a6 c1 b2"))
+    cxml_assert__true(_selects(root, "//z:*", "a3 a4 b1"))
+    cxml_assert__true(_selects(root, "//x:b", "b1 b2"))
+    cxml_assert__true(_selects(root, "/r/s/y:a", "a5"))
+    // attributes
+    cxml_assert__true(_selects(root, "//x:a[@x:k]", "a1"))
+    cxml_assert__true(_selects(root, "//*[@y:k]", "a1 a3"))
+    cxml_assert__true(_selects(root, "//*[@z:*]", "a1"))
+    cxml_assert__true(_selects(root, "//*[@xml:lang]", "t1 c1"))
+    // name tests of nested paths
+    cxml_assert__true(_selects(root, "//x:a[y:a]", "a1"))
+    cxml_assert__true(_selects(root, "//*[x:a or z:a]", "r0 a1 s1 t1"))
+    cxml_destroy(root);
+    cxml_pass()
+}
+
 void suite_cxxpath(){
     cxml_suite(cxxpath)
     {
         cxml_add_test(test_cxml_xpath)
+        cxml_add_test(test_cxml_xpath_indexed)
+        cxml_add_test(test_cxml_xpath_pipelined)
+        cxml_add_test(test_cxml_xpath_frozen)
+        cxml_add_test(test_cxml_xpath_frozen_threads)
+        cxml_add_test(test_cxml_xpath_filter)
+        cxml_add_test(test_cxml_xpath_aggregates)
+        cxml_add_test(test_cxml_xpath_optimized)
+        cxml_add_test(test_cxml_xpath_string_values)
+        cxml_add_test(test_cxml_xpath_compiled_predicates)
+        cxml_add_test(test_cxml_xpath_arena)
+        cxml_add_test(test_cxml_xpath_profile)
+        cxml_add_test(test_cxml_xpath_iter)
+        cxml_add_test(test_cxml_xpath_prepared)
+        cxml_add_test(test_cxml_xpath_extension_functions)
+        cxml_add_test(test_cxml_xpath_budget)
+        cxml_add_test(test_cxml_xpath_axes)
+        cxml_add_test(test_cxml_xpath_string_functions)
+        cxml_add_test(test_cxml_xpath_namespaces)
         cxml_run_suite()
     }
 }